@@ -0,0 +1,175 @@
+#ifndef __LITE_DRIVE_ARENA_H__
+#define __LITE_DRIVE_ARENA_H__
+
+#include "common.h"
+#include "memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+/**
+ * @brief 请求级的线性分配区，从IMemory整块申请，块内按指针递增分配
+ * @note 处理一个请求时构造的目录项、字符串、响应缓冲区都从同一个分配区分配，单个释放只回退最后一次分配，
+ *       响应发出后调用Reset一次性回收，保留一个块供下一个请求复用。
+ *       不会调用对象的析构函数，使用分配区的容器必须在Reset之前析构；非线程安全，一个分配区只在一个线程中使用
+ */
+class Arena
+{
+public:
+    static constexpr uint32_t kDefaultChunkBytes = 64 * 1024; // 默认块大小，包括块头
+    static constexpr size_t kDefaultAlign = 16;               // 默认对齐，与IMemory一致
+
+    /**
+     * @brief 构造分配区，首次分配时才申请内存
+     * @param pMemory 内存对象，生命周期必须长于分配区
+     * @param uChunkBytes 每次向内存对象申请的块大小，超过其1/4的请求单独申请
+     */
+    explicit Arena(IMemory *pMemory, uint32_t uChunkBytes = kDefaultChunkBytes);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * @brief 分配内存
+     * @param uBytes 字节数
+     * @param uAlign 对齐，必须是2的幂
+     * @return 内存指针，内存不足返回NULL
+     */
+    void *Allocate(size_t uBytes, size_t uAlign = kDefaultAlign)
+    {
+        uintptr_t uBegin = (reinterpret_cast<uintptr_t>(m_pCursor) + uAlign - 1) & ~static_cast<uintptr_t>(uAlign - 1);
+        uintptr_t uEnd = reinterpret_cast<uintptr_t>(m_pEnd);
+        if (likely(m_pCursor != nullptr && uBegin <= uEnd && uBytes <= uEnd - uBegin))
+        {
+            m_pCursor = reinterpret_cast<char *>(uBegin + uBytes);
+            m_uUsedBytes += uBytes;
+            return reinterpret_cast<void *>(uBegin);
+        }
+        return AllocateSlow(uBytes, uAlign);
+    }
+
+    /**
+     * @brief 释放内存，只有最后一次分配能回退，其余等到Reset时统一回收
+     * @param pMem 由Allocate分配的内存指针
+     * @param uBytes 分配时的字节数
+     */
+    void Deallocate(void *pMem, size_t uBytes)
+    {
+        if (static_cast<char *>(pMem) + uBytes == m_pCursor)
+        {
+            m_pCursor = static_cast<char *>(pMem);
+            m_uUsedBytes -= uBytes;
+        }
+    }
+
+    /**
+     * @brief 回收全部分配，保留一个块
+     */
+    void Reset();
+
+    /**
+     * @brief 获取已分配的字节数，不含对齐填充
+     * @return 字节数
+     */
+    uint64_t GetUsedBytes() const { return m_uUsedBytes; }
+
+    /**
+     * @brief 获取从内存对象申请的字节数
+     * @return 字节数
+     */
+    uint64_t GetReservedBytes() const { return m_uReservedBytes; }
+
+private:
+    // 块头，位于从内存对象申请的内存起始位置
+    struct Chunk
+    {
+        Chunk *pNext;
+        uint64_t uBytes; // 申请的字节数，包括块头
+    };
+
+    static constexpr uint32_t kChunkHeaderBytes = 16;
+
+    void *AllocateSlow(size_t uBytes, size_t uAlign);
+    Chunk *NewChunk(uint64_t uBytes);
+    void FreeChunks(Chunk *pChunk);
+
+private:
+    IMemory *m_pMemory{nullptr};
+    uint32_t m_uChunkBytes{0};
+    Chunk *m_pChunk{nullptr};     // 普通块，链表头是当前分配的块
+    Chunk *m_pLarge{nullptr};     // 单独申请的大块
+    char *m_pCursor{nullptr};     // 当前块中未分配的起始位置
+    char *m_pEnd{nullptr};
+    uint64_t m_uUsedBytes{0};
+    uint64_t m_uReservedBytes{0};
+};
+
+/**
+ * @brief 从Arena分配的STL分配器
+ * @note 内存不足时抛出std::bad_alloc，与std::allocator一致
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena *pArena) noexcept : m_pArena(pArena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : m_pArena(other.GetArena()) {}
+
+    T *allocate(size_t uCount)
+    {
+        if (uCount > SIZE_MAX / sizeof(T))
+        {
+            throw std::bad_alloc();
+        }
+        void *pMem = m_pArena->Allocate(uCount * sizeof(T), alignof(T));
+        if (pMem == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(pMem);
+    }
+
+    void deallocate(T *pMem, size_t uCount) noexcept
+    {
+        m_pArena->Deallocate(pMem, uCount * sizeof(T));
+    }
+
+    Arena *GetArena() const noexcept { return m_pArena; }
+
+private:
+    Arena *m_pArena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) noexcept
+{
+    return lhs.GetArena() == rhs.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) noexcept
+{
+    return lhs.GetArena() != rhs.GetArena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+}
+}
+
+#endif // __LITE_DRIVE_ARENA_H__
@@ -31,6 +31,20 @@ enum ErrorCode : int32_t
     kDirNotFound = 2000,
     kDirCreateFailed = 2001,
     kReadDirFailed = 2002,
+
+    // 网络相关错误
+    kSocketFailed = 3000,
+    kBindFailed = 3001,
+    kListenFailed = 3002,
+    kConnectFailed = 3003,
+    kNotConnected = 3004,
+    kEpollFailed = 3005,
+    kUringFailed = 3006,
+    kCallTimeout = 3007,
+    kTooManyCalls = 3008,
+    kTooManyConnections = 3009,
+    kWouldBlock = 3010,
+    kShmFailed = 3011,
 };
 
 }
@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cinttypes>
 #include <type_traits>
+#include <initializer_list>
 
 namespace lite_drive
 {
@@ -141,6 +142,13 @@ template<> struct SizeHelper<float>    { enum { value = 32 }; };
 template<> struct SizeHelper<double>   { enum { value = 32 }; };
 template<> struct SizeHelper<bool>     { enum { value = 8 }; };
 
+// 参数列表作为调用实参传入，保证Wrap临时对象在Log返回前有效
+inline void LogParams(ILogger *pLogger, int32_t iErrorNo, LogLevel eLevel, const char *pModuleName, const char *pFileLine,
+                      const char *pFunction, const char *fmt, std::initializer_list<const char *> params)
+{
+    pLogger->Log(iErrorNo, eLevel, pModuleName, pFileLine, pFunction, fmt, const_cast<const char **>(params.begin() + 1), static_cast<uint32_t>(params.size() - 1));
+}
+
 }
 
 template<uint32_t Size, typename T>
@@ -188,8 +196,7 @@ using WrapB = Wrap<8, bool>;
     {                                                                                                                                  \
         if (_logger != nullptr && eLevel >= _logger->GetLogLevel())                                                                    \
         {                                                                                                                              \
-            const char *pParams[] = {"", ##__VA_ARGS__};                                                                               \
-            _logger->Log(iErrorNo, eLevel, kModuleName, _POSITION_STRING, fmt, &pParams[1], sizeof(pParams) / sizeof(pParams[0]) - 1); \
+            ::lite_drive::logger::wrap_detail::LogParams(_logger, iErrorNo, eLevel, kModuleName, _POSITION_STRING, fmt, {"", ##__VA_ARGS__}); \
         }                                                                                                                              \
     }
 
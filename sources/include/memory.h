@@ -9,6 +9,20 @@ namespace lite_drive
 namespace utilities
 {
 
+/**
+ * @brief 内存的使用方标签，按标签分别统计，分配时记录在块上，释放时按记录的标签计入
+ */
+enum class MemoryTag : uint8_t
+{
+    kGeneral = 0, // 未分类
+    kNetEngine,   // 网络引擎的消息缓冲区
+    kArena,       // 请求级分配区
+    kStorage,     // 存储
+    kUserManager, // 用户管理
+    kLogger,      // 日志
+    kMax,
+};
+
 class IMemory
 {
 protected:
@@ -43,9 +57,10 @@ public:
     /**
      * @brief 分配内存
      * @param uSize 内存大小
+     * @param eTag 使用方标签，未分类时传kGeneral
      * @return 内存指针,失败返回NULL
      */
-    virtual void *New(uint32_t uSize) = 0;
+    virtual void *New(uint32_t uSize, MemoryTag eTag) = 0;
 
     /**
      * @brief 释放内存
@@ -54,11 +69,18 @@ public:
     virtual void Delete(void *pMem) = 0;
 
     /**
-     * @brief 获取内存大小
-     * @param pMem 内存指针
-     * @return 内存大小
+     * @brief 获取内存统计信息，包括各大小级别和各标签的在用字节数、峰值、分配释放速率和碎片率
+     * @param strStats 统计信息，JSON格式
+     * @return 0表示成功,否则失败
      */
     virtual int32_t GetStats(std::string &strStats) const = 0;
+
+    /**
+     * @brief 导出采样的堆分析结果，按调用栈汇总仍未释放的采样分配
+     * @param strProfile 分析结果，JSON格式
+     * @return 0表示成功,未开启采样(profile_sample_rate为0)返回kInvalidCall
+     */
+    virtual int32_t DumpHeapProfile(std::string &strProfile) const = 0;
 };
 
 namespace config
@@ -67,9 +89,18 @@ namespace config
 /* ============================== 内存配置 ============================== */
 constexpr const char *kSection = "memory"; // 配置文件中的节名，类型: string
 constexpr const char *kMaxMemoryMB = "max_memory_mb"; // 最大内存大小，类型: uint32_t
+constexpr const char *kHugePages = "huge_pages"; // 区域和大块内存的大页模式，类型: string，可选值: none、thp(透明大页)、hugetlb(预留大页，不足时退化为透明大页)
+constexpr const char *kProfileSampleRate = "profile_sample_rate"; // 堆分析的采样间隔，平均每N次分配记录一次调用栈，0表示不采样，类型: uint32_t
 
 }
 
+namespace default_value
+{
+/* ============================== 内存默认值 ============================== */
+constexpr const char *kHugePages = "none"; // 大页模式，默认只使用普通页
+constexpr uint32_t kProfileSampleRate = 0; // 堆分析默认不采样
+}
+
 }
 }
 
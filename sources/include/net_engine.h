@@ -3,6 +3,9 @@
 
 #include "config.h"
 #include "logger.h"
+#include "memory.h"
+#include "storage.h"
+#include <cstring>
 #include <string>
 
 namespace lite_drive
@@ -11,6 +14,7 @@ namespace net_engine
 {
 
 constexpr const char *kModuleName = "net_engine"; // 模块名称
+constexpr uint32_t kMessageHeadroomBytes = 64;    // NewMessage在数据前预留的字节数，足够写入协议头和常用可选头
 
 struct IMessage
 {
@@ -19,6 +23,21 @@ public:
     uint32_t uLength; // 消息长度
 };
 
+class ICallCallback
+{
+protected:
+    virtual ~ICallCallback() = default;
+
+public:
+    /**
+     * @brief 异步调用完成回调，通常在IO线程中执行，不能阻塞
+     * @param iResult 0表示成功，kCallTimeout表示超时，kNotConnected表示连接已断开
+     * @param pData 响应消息数据，仅在回调内有效，失败时为NULL
+     * @param uLength 响应消息长度
+     */
+    virtual void OnCallResult(int32_t iResult, const uint8_t *pData, uint32_t uLength) = 0;
+};
+
 class IConnection
 {
 protected:
@@ -29,19 +48,49 @@ public:
      * @brief 创建消息
      * @param uLength 消息长度
      * @return 消息指针,失败返回NULL
+     * @note 缓冲区来自网络引擎的消息池，数据前预留kMessageHeadroomBytes字节，可用PrependMessage不拷贝地写入协议头；
+     *       消息可以交给同一网络引擎的任意连接发送，可以在任意线程释放
      */
     virtual IMessage *NewMessage(uint32_t uLength) = 0;
 
     /**
      * @brief 释放消息
      * @param pMessage 消息指针
+     * @note 缓冲区在引用它的所有消息都释放后才归还
      */
     virtual void DeleteMessage(IMessage *pMessage) = 0;
+
+    /**
+     * @brief 创建引用已有消息一段数据的新消息，两者共享缓冲区，不拷贝数据
+     * @param pMessage 已有消息，必须由NewMessage或SliceMessage创建
+     * @param uOffset 片段在已有消息数据中的偏移
+     * @param uLength 片段长度
+     * @return 消息指针，需要单独发送或释放，片段越界或内存不足返回NULL
+     * @note 同一份数据转发给多个连接时，每个连接发送一个切片；共享期间数据只读
+     */
+    virtual IMessage *SliceMessage(IMessage *pMessage, uint32_t uOffset, uint32_t uLength) = 0;
+
+    /**
+     * @brief 使用头部预留空间向前扩展消息数据，不拷贝
+     * @param pMessage 消息指针，必须由NewMessage或SliceMessage创建
+     * @param uLength 扩展的字节数
+     * @return 扩展后的数据起始位置，即新的pMessage->pData；空间不足或缓冲区被其他消息共享时返回NULL
+     */
+    virtual uint8_t *PrependMessage(IMessage *pMessage, uint32_t uLength) = 0;
+
+    /**
+     * @brief 使用尾部余量向后扩展消息数据，不拷贝
+     * @param pMessage 消息指针，必须由NewMessage或SliceMessage创建
+     * @param uLength 扩展的字节数
+     * @return 扩展部分的起始位置；空间不足或缓冲区被其他消息共享时返回NULL
+     */
+    virtual uint8_t *AppendMessage(IMessage *pMessage, uint32_t uLength) = 0;
     
     /**
      * @brief 零拷贝发送消息
-     * @param pMessage 消息指针
-     * @return 0表示成功,否则失败
+     * @param pMessage 消息指针，必须由NewMessage创建
+     * @return 0表示成功，kWouldBlock表示待发送数据超过高水位，否则失败
+     * @note 成功时消息所有权转移给连接，内核不再引用后由连接释放，调用方不能再访问或释放；失败时所有权仍属于调用方
      */
     virtual int32_t SendMessage(IMessage *pMessage) = 0;
 
@@ -49,26 +98,61 @@ public:
      * @brief 非零拷贝发送消息
      * @param pData 消息数据
      * @param uLength 消息长度
-     * @return 0表示成功,否则失败
+     * @return 0表示成功，kWouldBlock表示待发送数据超过高水位，否则失败
+     * @note 返回kWouldBlock后，待发送数据降到低水位以下时回调OnEvent(event::kSendDrained)
      */
     virtual int32_t SendMessage(const uint8_t *pData, uint32_t uLength) = 0;
 
+    /**
+     * @brief 发送文件的一段内容，数据不经过用户态缓冲区
+     * @param pFileHandler 文件句柄
+     * @param uOffset 文件内偏移量，单位: 字节
+     * @param uLength 发送长度，单位: 字节
+     * @return 0表示成功，kWouldBlock表示待发送数据超过高水位，kFileReadFailed表示读取文件失败，否则失败
+     * @note 与其他消息按调用顺序发送，消息头需先用SendMessage发出；TCP连接且文件可直接访问时由IO线程用sendfile发送，
+     *       加密存储或其他连接类型退化为在调用线程逐段读取后拷贝发送，已读出未发出的数据较多时阻塞等待IO线程发送，
+     *       此时不能在IO线程的回调中调用；返回后即可关闭文件，发送期间文件不能被截断
+     */
+    virtual int32_t SendFile(storage::FileHandler *pFileHandler, uint64_t uOffset, uint32_t uLength) = 0;
+
     /**
      * @brief 零拷贝同步调用
-     * @param pRequest 请求消息指针
-     * @param pResponse 响应消息指针
+     * @param pRequest 请求消息指针，以protocol::ProtocolHeader开头，所有权同SendMessage
+     * @param pResponse 响应消息指针，调用方提供缓冲区，uLength传入容量，成功时返回响应长度
      * @return 0表示成功,否则失败
+     * @note 阻塞直到收到响应、超时(call_timeout_ms)或连接断开，不能在IO线程的回调中调用
      */
     virtual int32_t Call(IMessage *pRequest, IMessage *pResponse) = 0;
 
     /**
      * @brief 非零拷贝同步调用
-     * @param pRequest 请求消息数据
+     * @param pRequest 请求消息数据，以protocol::ProtocolHeader开头
      * @param uRequestLength 请求消息长度
-     * @param pResponse 响应消息指针
+     * @param pResponse 响应消息指针，调用方提供缓冲区，uLength传入容量，成功时返回响应长度
      * @return 0表示成功,否则失败
+     * @note 阻塞直到收到响应、超时(call_timeout_ms)或连接断开，不能在IO线程的回调中调用
      */
     virtual int32_t Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse) = 0;
+
+    /**
+     * @brief 零拷贝异步调用，立即返回，同一连接上可以有多个未完成的调用
+     * @param pRequest 请求消息指针，以protocol::ProtocolHeader开头，所有权同SendMessage
+     * @param pCallback 完成回调，必须保持有效直到OnCallResult被调用
+     * @param uTimeoutMs 超时时间，单位: 毫秒，0表示使用call_timeout_ms
+     * @return 0表示已发出，之后OnCallResult必定被调用一次；否则失败且不会回调
+     * @note 连接改写请求头中的uSequence，对端回复时需原样带回并设置protocol::kFlagResponse标志
+     */
+    virtual int32_t AsyncCall(IMessage *pRequest, ICallCallback *pCallback, uint32_t uTimeoutMs) = 0;
+
+    /**
+     * @brief 非零拷贝异步调用，立即返回，同一连接上可以有多个未完成的调用
+     * @param pRequest 请求消息数据，以protocol::ProtocolHeader开头
+     * @param uRequestLength 请求消息长度
+     * @param pCallback 完成回调，必须保持有效直到OnCallResult被调用
+     * @param uTimeoutMs 超时时间，单位: 毫秒，0表示使用call_timeout_ms
+     * @return 0表示已发出，之后OnCallResult必定被调用一次；否则失败且不会回调
+     */
+    virtual int32_t AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs) = 0;
     
     /**
      * @brief 连接远程服务器
@@ -133,6 +217,60 @@ struct Handler
 using ConnectionHandler = Handler<IConnection>;
 using ListenerHandler = Handler<IListener>;
 
+class IConnectionPool
+{
+protected:
+    virtual ~IConnectionPool() = default;
+
+public:
+    /**
+     * @brief 选取负载最低的健康连接，负载按未完成的调用数和待发送字节数衡量
+     * @return 连接句柄，没有可用连接时pHandler为NULL；池中的连接只在断开后原地重连，句柄在连接池销毁前一直有效
+     */
+    virtual ConnectionHandler Select() = 0;
+
+    /**
+     * @brief 通过负载最低的连接发送消息
+     * @param pData 消息数据
+     * @param uLength 消息长度
+     * @return 0表示成功，kNotConnected表示没有可用连接，否则失败
+     */
+    virtual int32_t SendMessage(const uint8_t *pData, uint32_t uLength) = 0;
+
+    /**
+     * @brief 通过负载最低的连接同步调用
+     * @param pRequest 请求消息数据
+     * @param uRequestLength 请求消息长度
+     * @param pResponse 响应消息，由调用方提供缓冲区
+     * @return 0表示成功，kNotConnected表示没有可用连接，否则失败
+     */
+    virtual int32_t Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse) = 0;
+
+    /**
+     * @brief 通过负载最低的连接异步调用
+     * @param pRequest 请求消息数据
+     * @param uRequestLength 请求消息长度
+     * @param pCallback 结果回调，在IO线程中执行
+     * @param uTimeoutMs 超时时间，单位: 毫秒，0表示使用默认超时
+     * @return 0表示成功，kNotConnected表示没有可用连接，否则失败
+     */
+    virtual int32_t AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs) = 0;
+
+    /**
+     * @brief 获取池中的连接数量
+     * @return 连接数量
+     */
+    virtual uint32_t GetSize() const = 0;
+
+    /**
+     * @brief 获取当前已连接且健康的连接数量
+     * @return 可用连接数量
+     */
+    virtual uint32_t GetAvailableCount() const = 0;
+};
+
+using ConnectionPoolHandler = Handler<IConnectionPool>;
+
 class ICallback
 {
 protected:
@@ -167,6 +305,7 @@ public:
     /**
      * @brief 连接成功回调
      * @param pConnHandler 连接句柄
+     * @note 监听器接入的连接回调后，应用保存的句柄在DestroyConnection之前一直有效，断开后也需要调用DestroyConnection释放
      */
     virtual void OnConnected(ConnectionHandler *pConnHandler) = 0;
 
@@ -177,11 +316,31 @@ public:
     virtual void OnDisconnected(ConnectionHandler *pConnHandler) = 0;
 };
 
+namespace event
+{
+constexpr const char *kSendDrained = "send_drained";                 // 发送曾因超过高水位被拒绝，待发送数据已降到低水位以下
+constexpr const char *kConnectFailed = "connect_failed";             // 主动连接失败，连接回到关闭状态
+constexpr const char *kCreateSocketFailed = "create_socket_failed"; // 主动连接时创建套接字失败，连接回到关闭状态
+
+/**
+ * @brief 判断OnEvent收到的事件消息是否为指定事件，不同编译单元中同一常量的地址可能不同，按内容比较
+ * @param pEventMsg 事件消息，可以为空
+ * @param pEvent 事件常量
+ * @return 是否为该事件
+ */
+inline bool IsEvent(const char *pEventMsg, const char *pEvent)
+{
+    return pEventMsg != nullptr && strcmp(pEventMsg, pEvent) == 0;
+}
+}
+
 enum class NetEngineType
 {
-    kTcp, // TCP协议
-    kUdp, // UDP协议
-    kP2P, // P2P协议
+    kTcp,      // TCP协议
+    kUdp,      // UDP协议，每个远程地址对应一个连接，每条消息单独作为一个数据报发送，不超过65507字节
+    kP2P,      // P2P协议
+    kTcpUring, // 基于io_uring的TCP协议
+    kShm,      // 同一主机上的共享内存传输，监听器和连接只使用端口，IP被忽略
 };
 
 class INetEngine
@@ -193,9 +352,10 @@ public:
     /**
      * @brief 创建网络引擎
      * @param pLogger 日志器
+     * @param pMemory 消息缓冲区使用的内存对象，需比网络引擎和所有消息存活更久；NULL表示网络引擎按memory配置自行创建
      * @return 网络引擎指针,失败返回NULL
      */
-    static INetEngine* Create(logger::ILogger *pLogger);
+    static INetEngine* Create(logger::ILogger *pLogger, utilities::IMemory *pMemory = nullptr);
 
     /**
      * @brief 销毁网络引擎
@@ -250,11 +410,25 @@ public:
     virtual ConnectionHandler CreateConnection(utilities::IConfig *pConfig, ICallback *pCallback) = 0;
 
     /**
-     * @brief 销毁连接
-     * @param pConnHandler 连接句柄
+     * @brief 销毁连接，包括已回调OnConnected的接入连接
+     * @param pConnHandler 连接句柄，返回时已清空，之后不能再通过原句柄指针调用
      */
     virtual void DestroyConnection(ConnectionHandler *pConnHandler) = 0;
 
+    /**
+     * @brief 创建连接池，按连接配置建立多个到同一远程地址的连接，断开后在后台重连，长时间收不到数据的连接被剔除并重连
+     * @param pConfig 配置，连接相关配置同CreateConnection
+     * @param pCallback 回调，池中各连接的消息和事件都交给它
+     * @return 连接池句柄,失败返回NULL
+     */
+    virtual ConnectionPoolHandler CreateConnectionPool(utilities::IConfig *pConfig, ICallback *pCallback) = 0;
+
+    /**
+     * @brief 销毁连接池及其所有连接，调用方需保证没有线程仍在使用该连接池或从中选出的连接
+     * @param pPoolHandler 连接池句柄
+     */
+    virtual void DestroyConnectionPool(ConnectionPoolHandler *pPoolHandler) = 0;
+
     /**
      * @brief 获取网络引擎统计信息
      * @param strStats 统计信息
@@ -267,24 +441,52 @@ namespace config
 {
 /* ============================== 网络引擎配置 ============================== */
 constexpr const char *kSection = "net_engine";            // 配置文件中的节名，类型: string
-constexpr const char *kNetEngineType = "net_engine_type"; // 网络引擎类型，类型: string
+constexpr const char *kNetEngineType = "net_engine_type"; // 网络引擎类型，类型: string，可选值: tcp、tcp_uring、udp、shm
 constexpr const char *kNetEngineName = "net_engine_name"; // 网络引擎名称，类型: string
 constexpr const char *kIOThreadCount = "io_thread_count"; // IO线程数量，类型: uint32_t
+constexpr const char *kUringQueueDepth = "uring_queue_depth";   // io_uring提交队列深度，类型: uint32_t
+constexpr const char *kUringBufferCount = "uring_buffer_count"; // 每个IO线程的io_uring接收缓冲区数量，类型: uint32_t
+constexpr const char *kUringBufferBytes = "uring_buffer_bytes"; // 单个io_uring接收缓冲区字节大小，类型: uint32_t
+constexpr const char *kIOThreadCpus = "io_thread_cpus";         // IO线程绑定的CPU列表，如"2-5,8"，第i个IO线程绑定第i个CPU，不足时循环使用，空表示不绑定，类型: string
+constexpr const char *kManagerThreadCpu = "manager_thread_cpu"; // 管理线程绑定的CPU，格式同io_thread_cpus，只使用第一个，空表示不绑定，类型: string
+constexpr const char *kNumaLocalAlloc = "numa_local_alloc";     // 绑定CPU的线程是否优先从所在NUMA节点分配内存，类型: bool
+constexpr const char *kBusyPollUs = "busy_poll_us";             // IO线程空闲后继续非阻塞轮询的时间，同时设置套接字SO_BUSY_POLL，0表示关闭，类型: uint32_t
+constexpr const char *kRebalanceIntervalMs = "rebalance_interval_ms"; // 管理线程检查IO线程负载并迁移连接的周期，0表示不迁移，仅epoll后端的TCP连接支持，类型: uint32_t
+constexpr const char *kRebalanceThresholdPercent = "rebalance_threshold_percent"; // 最忙的IO线程负载超过平均值的百分比达到该值时迁移连接，类型: uint32_t
 
 /* ============================== 网络引擎Listener配置 ============================== */
 constexpr const char *kListenerName = "listener_name"; // 监听器名称，类型: string
 constexpr const char *kListenerIP = "listener_ip";     // 网络引擎IP地址，类型: string
 constexpr const char *kListenerPort = "listener_port"; // 网络引擎端口，类型: uint16_t
+constexpr const char *kListenerReusePort = "listener_reuse_port"; // 是否每个IO线程独立监听(SO_REUSEPORT)，类型: bool
 
 /* ============================== 网络引擎Connection配置 ============================== */
 constexpr const char *kConnectionName = "connection_name";              // 连接名称，类型: string
 constexpr const char *kConnectionRemoteIP = "connection_remote_ip";     // 远程服务器IP地址，类型: string
 constexpr const char *kConnectionRemotePort = "connection_remote_port"; // 远程服务器端口，类型: uint16_t
 
+/* ============================== 网络引擎ConnectionPool配置 ============================== */
+constexpr const char *kConnectionPoolSize = "connection_pool_size";               // 连接池中的连接数量，类型: uint32_t
+constexpr const char *kConnectionPoolReconnectMs = "connection_pool_reconnect_ms"; // 连接断开或连接失败后首次重连的等待时间，连续失败时倍增，类型: uint32_t
+constexpr const char *kConnectionPoolUnhealthyMs = "connection_pool_unhealthy_ms"; // 连接超过该时间未收到任何数据(包括心跳)时剔除并重连，0表示只依赖心跳超时，类型: uint32_t
+
 /* ============================== 网络引擎公共配置,全局和监听器、连接都可以使用 ============================== */
 constexpr const char *kSocketBufferBytes = "socket_buffer_bytes";     // 套接字缓冲区字节大小，类型: uint32_t
 constexpr const char *kHeartbeatIntervalMs = "heartbeat_interval_ms"; // 心跳间隔，类型: uint32_t
 constexpr const char *kHeartbeatTimeoutMs = "heartbeat_timeout_ms";   // 心跳超时，类型: uint32_t
+constexpr const char *kZeroCopyThresholdBytes = "zero_copy_threshold_bytes"; // 零拷贝发送的最小消息字节数，0表示关闭，类型: uint32_t
+constexpr const char *kSendMaxIovecs = "send_max_iovecs";       // 一次发送系统调用合并的最大分段数，类型: uint32_t
+constexpr const char *kSendBatchBytes = "send_batch_bytes";     // 一次发送系统调用合并的字节预算，类型: uint32_t
+constexpr const char *kMaxConnections = "max_connections";       // 网络引擎最大连接数，类型: uint32_t
+constexpr const char *kCallTimeoutMs = "call_timeout_ms";       // 调用默认超时时间，类型: uint32_t
+constexpr const char *kMaxPendingCalls = "max_pending_calls";   // 单个连接未完成调用的最大数量，类型: uint32_t
+constexpr const char *kSendHighWatermarkBytes = "send_high_watermark_bytes"; // 单个连接待发送字节数高水位，超过后拒绝发送，0表示不限制，类型: uint32_t
+constexpr const char *kSendLowWatermarkBytes = "send_low_watermark_bytes";   // 单个连接待发送字节数低水位，降到以下时通知可以继续发送，类型: uint32_t
+constexpr const char *kEngineSendHighWatermarkBytes = "engine_send_high_watermark_bytes"; // 网络引擎所有连接待发送字节数高水位，0表示不限制，仅全局配置，类型: int64_t
+constexpr const char *kEngineSendLowWatermarkBytes = "engine_send_low_watermark_bytes";   // 网络引擎所有连接待发送字节数低水位，仅全局配置，类型: int64_t
+constexpr const char *kUdpBatchSize = "udp_batch_size"; // UDP单次recvmmsg/sendmmsg处理的最大数据报数，类型: uint32_t
+constexpr const char *kUdpOffload = "udp_offload";       // UDP是否在内核支持时启用UDP_SEGMENT/UDP_GRO分段卸载，类型: bool
+constexpr const char *kShmRingBytes = "shm_ring_bytes"; // 共享内存传输单个方向的环形缓冲区字节大小，向上取整为2的幂，由客户端决定，类型: uint32_t
 }
 
 namespace default_value
@@ -293,21 +495,49 @@ namespace default_value
 constexpr const char *kNetEngineType = "tcp"; // 网络引擎类型，默认TCP
 constexpr const char *kNetEngineName = "anonymous_net_engine"; // 网络引擎名称，默认匿名网络引擎
 constexpr const uint32_t kIOThreadCount = 1; // IO线程数量，默认1
+constexpr const uint32_t kUringQueueDepth = 1024; // io_uring提交队列深度，默认1024
+constexpr const uint32_t kUringBufferCount = 1024; // io_uring接收缓冲区数量，默认1024
+constexpr const uint32_t kUringBufferBytes = 16 * 1024; // io_uring接收缓冲区大小，默认16KB
+constexpr const char *kIOThreadCpus = "";        // IO线程绑定的CPU列表，默认不绑定
+constexpr const char *kManagerThreadCpu = "";     // 管理线程绑定的CPU，默认不绑定
+constexpr const bool kNumaLocalAlloc = true;     // 绑定CPU后优先使用本地NUMA节点内存，默认启用
+constexpr const uint32_t kBusyPollUs = 0;        // 忙轮询时间，默认关闭，开启后空闲的IO线程会占满CPU
+constexpr const uint32_t kRebalanceIntervalMs = 1000; // 负载均衡周期，默认1秒
+constexpr const uint32_t kRebalanceThresholdPercent = 50; // 负载均衡阈值，默认超过平均值50%
 
 /* ============================== 网络引擎Listener默认值 ============================== */
 constexpr const char *kListenerName = "anonymous_listener"; // 监听器名称，默认匿名监听器
 constexpr const char *kListenerIP = "0.0.0.0"; // 监听器IP地址，默认所有IP
 constexpr const uint32_t kListenerPort = 8080; // 监听器端口，默认8080
+constexpr const bool kListenerReusePort = false; // 是否每个IO线程独立监听，默认单个监听套接字
 
 /* ============================== 网络引擎Connection默认值 ============================== */
 constexpr const char *kConnectionName = "anonymous_connection"; // 连接名称，默认匿名连接
 constexpr const char *kConnectionRemoteIP = "127.0.0.1"; // 远程服务器IP地址，默认127.0.0.1
 constexpr const uint32_t kConnectionRemotePort = 8080; // 远程服务器端口，默认8080
 
+/* ============================== 网络引擎ConnectionPool默认值 ============================== */
+constexpr const uint32_t kConnectionPoolSize = 4;           // 连接池中的连接数量，默认4
+constexpr const uint32_t kConnectionPoolReconnectMs = 1000; // 首次重连等待时间，默认1秒，最长不超过32秒
+constexpr const uint32_t kConnectionPoolUnhealthyMs = 3000; // 未收到数据的剔除时间，默认3秒，即连续三个心跳间隔
+
 /* ============================== 网络引擎公共默认值 ============================== */
 constexpr const uint32_t kSocketBufferBytes = 0; // 套接字缓冲区字节大小，默认不设置,使用系统默认值
 constexpr const uint32_t kHeartbeatIntervalMs = 1000; // 心跳间隔，默认1秒
 constexpr const uint32_t kHeartbeatTimeoutMs = 30000; // 心跳超时，默认30秒
+constexpr const uint32_t kZeroCopyThresholdBytes = 16 * 1024; // 零拷贝发送的最小消息字节数，默认16KB，更小的消息拷贝发送更快
+constexpr const uint32_t kSendMaxIovecs = 64; // 一次发送合并的最大分段数，默认64，不超过IOV_MAX
+constexpr const uint32_t kSendBatchBytes = 256 * 1024; // 一次发送合并的字节预算，默认256KB
+constexpr const uint32_t kMaxConnections = 128 * 1024; // 网络引擎最大连接数，默认128K，句柄表按此预分配
+constexpr const uint32_t kCallTimeoutMs = 5000; // 调用默认超时时间，默认5秒
+constexpr const uint32_t kMaxPendingCalls = 1024; // 单个连接未完成调用的最大数量，默认1024，不超过序列号空间的一半
+constexpr const uint32_t kSendHighWatermarkBytes = 16 * 1024 * 1024; // 单个连接待发送字节数高水位，默认16MB
+constexpr const uint32_t kSendLowWatermarkBytes = 4 * 1024 * 1024;   // 单个连接待发送字节数低水位，默认4MB，不超过高水位
+constexpr const int64_t kEngineSendHighWatermarkBytes = 0; // 网络引擎待发送字节数高水位，默认不限制
+constexpr const int64_t kEngineSendLowWatermarkBytes = 0;  // 网络引擎待发送字节数低水位，默认为高水位的一半
+constexpr const uint32_t kUdpBatchSize = 32; // UDP单次批量收发的最大数据报数，默认32
+constexpr const bool kUdpOffload = true;     // UDP分段卸载，默认启用
+constexpr const uint32_t kShmRingBytes = 8 * 1024 * 1024; // 共享内存环形缓冲区大小，默认8MB
 }
 
 }
@@ -51,6 +51,9 @@ enum class Method : uint16_t
     kMax,
 };
 
+constexpr const uint8_t kFlagResponse = 0x01;  // 响应消息，uSequence与对应请求相同
+constexpr const uint8_t kFlagHeartbeat = 0x02; // 心跳消息，只有协议头，由网络引擎处理，不交给业务
+
 struct ProtocolHeader
 {
     char szMagic[4];       // 魔数
@@ -0,0 +1,28 @@
+#ifndef __LITE_DRIVE_STAT_COUNTER_H__
+#define __LITE_DRIVE_STAT_COUNTER_H__
+
+#include <atomic>
+#include <cstdint>
+
+namespace lite_drive
+{
+
+/**
+ * @brief 单写者计数器，只由所属线程修改，任意线程可以无锁读取
+ * @note 单写者不需要原子的读改写，relaxed读写即可避免lock前缀的开销
+ */
+class StatCounter
+{
+public:
+    void Add(uint64_t uValue = 1) { m_uValue.store(m_uValue.load(std::memory_order_relaxed) + uValue, std::memory_order_relaxed); }
+    void Sub(uint64_t uValue = 1) { m_uValue.store(m_uValue.load(std::memory_order_relaxed) - uValue, std::memory_order_relaxed); }
+    void Set(uint64_t uValue) { m_uValue.store(uValue, std::memory_order_relaxed); }
+    uint64_t Get() const { return m_uValue.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_uValue{0};
+};
+
+} // namespace lite_drive
+
+#endif // __LITE_DRIVE_STAT_COUNTER_H__
@@ -80,6 +80,13 @@ public:
      * @return 0表示成功,否则失败
      */
     virtual int32_t Truncate(uint64_t uSize) = 0;
+
+    /**
+     * @brief 获取底层文件描述符，供网络引擎用sendfile直接从页缓存发送文件内容
+     * @return 文件描述符，内容经过加密(is_crypt)等变换、不能直接发送时返回-1
+     * @note 描述符仍归文件对象所有，调用方不能关闭
+     */
+    virtual int32_t GetFd() = 0;
 };
 
 template<typename T>
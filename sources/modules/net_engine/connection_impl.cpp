@@ -0,0 +1,2324 @@
+#include "connection_impl.h"
+#include "message_impl.h"
+#include "net_engine_impl.h"
+#include "udp_socket.h"
+#include "shm_channel.h"
+#include <error_code.h>
+#include <protocol.h>
+#include <new>
+#include <condition_variable>
+#include <cstddef>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint32_t kMaxUdpBatchSize = 1024; // udp_batch_size的上限
+constexpr uint32_t kMinShmRingBytes = 64 * 1024;          // shm_ring_bytes的下限
+constexpr uint32_t kMaxShmRingBytes = 1024 * 1024 * 1024; // shm_ring_bytes的上限
+
+void SetSocketOptions(int32_t iFd, const ConnectionOptions &options)
+{
+    int32_t iValue = 1;
+    setsockopt(iFd, IPPROTO_TCP, TCP_NODELAY, &iValue, sizeof(iValue));
+    if (options.uSocketBufferBytes > 0)
+    {
+        iValue = static_cast<int32_t>(options.uSocketBufferBytes);
+        setsockopt(iFd, SOL_SOCKET, SO_SNDBUF, &iValue, sizeof(iValue));
+        setsockopt(iFd, SOL_SOCKET, SO_RCVBUF, &iValue, sizeof(iValue));
+    }
+    SetBusyPoll(iFd, options);
+}
+
+bool EnableZeroCopy(int32_t iFd, const ConnectionOptions &options)
+{
+    int32_t iValue = 1;
+    return options.uZeroCopyThresholdBytes > 0 && setsockopt(iFd, SOL_SOCKET, SO_ZEROCOPY, &iValue, sizeof(iValue)) == 0;
+}
+
+void ToAddress(const struct sockaddr_in &addr, std::string &strIP, uint16_t &uPort)
+{
+    char szIP[INET_ADDRSTRLEN] = {0};
+    inet_ntop(AF_INET, &addr.sin_addr, szIP, sizeof(szIP));
+    strIP = szIP;
+    uPort = ntohs(addr.sin_port);
+}
+
+/**
+ * @brief 心跳消息，只有协议头
+ */
+struct HeartbeatMessage
+{
+    uint8_t arrData[sizeof(protocol::ProtocolHeader)];
+
+    HeartbeatMessage()
+    {
+        protocol::ProtocolHeader header = {};
+        memcpy(header.szMagic, protocol::kMagic, sizeof(header.szMagic));
+        header.uTotalLength = sizeof(header);
+        header.uHeaderLength = sizeof(header);
+        header.eVersion = protocol::Version::kVersion1;
+        header.uOptionBegin = sizeof(header);
+        header.uFlags = protocol::kFlagHeartbeat;
+        memcpy(arrData, &header, sizeof(header));
+    }
+};
+
+const HeartbeatMessage kHeartbeatMessage;
+
+/**
+ * @brief 同步调用等待异步调用完成，响应在IO线程中拷贝到调用方的缓冲区
+ */
+class SyncCall : public ICallCallback
+{
+public:
+    SyncCall(IMessage *pResponse) : m_pResponse(pResponse) {}
+
+    void OnCallResult(int32_t iResult, const uint8_t *pData, uint32_t uLength) override
+    {
+        if (iResult == ErrorCode::kSuccess)
+        {
+            if (uLength <= m_pResponse->uLength)
+            {
+                memcpy(m_pResponse->pData, pData, uLength);
+                m_pResponse->uLength = uLength;
+            }
+            else
+            {
+                iResult = ErrorCode::kNoMemory;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_iResult = iResult;
+        m_bDone = true;
+        m_cv.notify_one();
+    }
+
+    int32_t Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_bDone; });
+        return m_iResult;
+    }
+
+private:
+    IMessage *m_pResponse{nullptr};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_bDone{false};
+    int32_t m_iResult{ErrorCode::kSuccess};
+};
+
+}
+
+int32_t FileCopyStream::Push(MessageImpl *pChunk, bool bLast)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bAborted.load())
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    try
+    {
+        m_dequeChunk.push_back(pChunk);
+    }
+    catch(const std::exception& e)
+    {
+        return ErrorCode::kNoMemory;
+    }
+    m_bDone = bLast;
+    return ErrorCode::kSuccess;
+}
+
+bool FileCopyStream::Take(std::deque<MessageImpl *> &dequeChunk)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    dequeChunk.swap(m_dequeChunk);
+    return m_bDone;
+}
+
+void FileCopyStream::Release()
+{
+    if (m_uRefs.fetch_sub(1) == 1)
+    {
+        delete this;
+    }
+}
+
+FileCopyStream::~FileCopyStream()
+{
+    for (auto pChunk : m_dequeChunk)
+    {
+        MessageImpl::Destroy(pChunk);
+    }
+}
+
+void ConnectionOptions::Load(utilities::IConfig *pConfig)
+{
+    uSocketBufferBytes = pConfig->GetInt32(config::kSection, config::kSocketBufferBytes, default_value::kSocketBufferBytes);
+    uHeartbeatIntervalMs = pConfig->GetInt32(config::kSection, config::kHeartbeatIntervalMs, default_value::kHeartbeatIntervalMs);
+    uHeartbeatTimeoutMs = pConfig->GetInt32(config::kSection, config::kHeartbeatTimeoutMs, default_value::kHeartbeatTimeoutMs);
+    uZeroCopyThresholdBytes = pConfig->GetInt32(config::kSection, config::kZeroCopyThresholdBytes, default_value::kZeroCopyThresholdBytes);
+    uSendMaxIovecs = pConfig->GetInt32(config::kSection, config::kSendMaxIovecs, default_value::kSendMaxIovecs);
+    uSendBatchBytes = pConfig->GetInt32(config::kSection, config::kSendBatchBytes, default_value::kSendBatchBytes);
+
+    // 至少合并一个分段，且不超过内核单次调用的上限
+    uSendMaxIovecs = std::min<uint32_t>(std::max<uint32_t>(uSendMaxIovecs, 1), IOV_MAX);
+    uSendBatchBytes = std::max<uint32_t>(uSendBatchBytes, 1);
+
+    uCallTimeoutMs = pConfig->GetInt32(config::kSection, config::kCallTimeoutMs, default_value::kCallTimeoutMs);
+    uMaxPendingCalls = pConfig->GetInt32(config::kSection, config::kMaxPendingCalls, default_value::kMaxPendingCalls);
+
+    // 序列号只有16位，未完成的调用数不超过一半，回绕时不会与仍在途的请求冲突
+    uMaxPendingCalls = std::min<uint32_t>(std::max<uint32_t>(uMaxPendingCalls, 1), UINT16_MAX / 2);
+
+    uSendHighWatermarkBytes = pConfig->GetInt32(config::kSection, config::kSendHighWatermarkBytes, default_value::kSendHighWatermarkBytes);
+    uSendLowWatermarkBytes = pConfig->GetInt32(config::kSection, config::kSendLowWatermarkBytes, default_value::kSendLowWatermarkBytes);
+    uSendLowWatermarkBytes = std::min(uSendLowWatermarkBytes, uSendHighWatermarkBytes);
+
+    uUdpBatchSize = pConfig->GetInt32(config::kSection, config::kUdpBatchSize, default_value::kUdpBatchSize);
+    uUdpBatchSize = std::min(std::max<uint32_t>(uUdpBatchSize, 1), kMaxUdpBatchSize);
+    bUdpOffload = pConfig->GetBool(config::kSection, config::kUdpOffload, default_value::kUdpOffload);
+
+    // 环大小为2的幂，读写位置取模只需按位与
+    uint32_t uRingBytes = pConfig->GetInt32(config::kSection, config::kShmRingBytes, default_value::kShmRingBytes);
+    uRingBytes = std::min(std::max(uRingBytes, kMinShmRingBytes), kMaxShmRingBytes);
+    uShmRingBytes = kMinShmRingBytes;
+    while (uShmRingBytes < uRingBytes)
+    {
+        uShmRingBytes <<= 1;
+    }
+
+    uBusyPollUs = pConfig->GetInt32(config::kSection, config::kBusyPollUs, default_value::kBusyPollUs);
+}
+
+void SetBusyPoll(int32_t iFd, const ConnectionOptions &options)
+{
+    // 超过net.core.busy_read需要CAP_NET_ADMIN，设置失败时仍由IO线程的忙轮询降低唤醒延迟
+    if (options.uBusyPollUs > 0)
+    {
+        int32_t iValue = static_cast<int32_t>(std::min<uint32_t>(options.uBusyPollUs, INT32_MAX));
+        setsockopt(iFd, SOL_SOCKET, SO_BUSY_POLL, &iValue, sizeof(iValue));
+    }
+}
+
+ConnectionImpl::ConnectionImpl(logger::ILogger *pLogger) : m_pLogger(pLogger)
+{
+    m_heartbeatTimer.callback = [this]() { OnHeartbeatTimer(); };
+    m_callTimer.callback = [this]() { OnCallTimer(); };
+}
+
+ConnectionImpl::~ConnectionImpl()
+{
+    Exit();
+}
+
+int32_t ConnectionImpl::Init(utilities::IConfig *pConfig, ICallback *pCallback)
+{
+    if (pConfig == nullptr || pCallback == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return ErrorCode::kInvalidParam;
+    }
+
+    try
+    {
+        m_strConnectionName = pConfig->GetStr(config::kSection, config::kConnectionName, default_value::kConnectionName);
+        m_strRemoteIP = pConfig->GetStr(config::kSection, config::kConnectionRemoteIP, default_value::kConnectionRemoteIP);
+        m_uRemotePort = pConfig->GetInt32(config::kSection, config::kConnectionRemotePort, default_value::kConnectionRemotePort);
+        m_options.Load(pConfig);
+        m_vecSendIovec.resize(m_options.uSendMaxIovecs);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "failed to init connection");
+        return ErrorCode::kThrowException;
+    }
+
+    if (!m_recvRing.Init(kInitRecvBufferBytes))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "failed to alloc recv buffer");
+        return ErrorCode::kNoMemory;
+    }
+
+    m_pCallback = pCallback;
+    return ErrorCode::kSuccess;
+}
+
+int32_t ConnectionImpl::InitAccepted(int32_t iFd, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName)
+{
+    if (iFd < 0 || pCallback == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return ErrorCode::kInvalidParam;
+    }
+
+    try
+    {
+        m_strConnectionName = strName;
+        m_options = options;
+        m_vecSendIovec.resize(m_options.uSendMaxIovecs);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "failed to init accepted connection");
+        return ErrorCode::kThrowException;
+    }
+
+    if (!m_recvRing.Init(kInitRecvBufferBytes))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "failed to alloc recv buffer");
+        return ErrorCode::kNoMemory;
+    }
+
+    m_iFd = iFd;
+    m_bAccepted = true;
+    m_pCallback = pCallback;
+    SetSocketOptions(m_iFd, m_options);
+    m_bZeroCopy = EnableZeroCopy(m_iFd, m_options);
+    UpdateAddress();
+    return ErrorCode::kSuccess;
+}
+
+int32_t ConnectionImpl::InitDatagram(UdpSocket *pSocket, const struct sockaddr_in &addr, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName)
+{
+    if (pSocket == nullptr || pCallback == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return ErrorCode::kInvalidParam;
+    }
+
+    try
+    {
+        m_strConnectionName = strName;
+        m_options = options;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "failed to init datagram connection");
+        return ErrorCode::kThrowException;
+    }
+
+    m_pUdpSocket = pSocket;
+    m_peerAddr = addr;
+    m_bAccepted = true;
+    m_pCallback = pCallback;
+    ToAddress(addr, m_strRemoteIP, m_uRemotePort);
+    UpdateAddress();
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionImpl::Exit()
+{
+    StopTimers();
+    FailCalls(ErrorCode::kNotConnected);
+    if (m_iFd >= 0)
+    {
+        // 释放连接时不再等待零拷贝完成通知，中止连接后释放
+        if (!m_zeroCopyTracker.Empty())
+        {
+            AbortSocket(m_iFd);
+        }
+        else
+        {
+            close(m_iFd);
+        }
+        m_iFd = -1;
+    }
+    m_eState = ConnectionState::kClosed;
+    m_pCallback = nullptr;
+    ReleaseDatagram();
+    ReleaseShm();
+    m_pReactor = nullptr;
+    m_recvRing.Release();
+    m_uPendingFrameLength = 0;
+    std::vector<uint8_t>().swap(m_vecFrameBuffer);
+    std::vector<struct iovec>().swap(m_vecSendIovec);
+    ClearSendQueue();
+}
+
+IMessage *ConnectionImpl::NewMessage(uint32_t uLength)
+{
+    return NewMessageBuffer(uLength, kMessageHeadroomBytes);
+}
+
+void ConnectionImpl::DeleteMessage(IMessage *pMessage)
+{
+    MessageImpl::Destroy(pMessage);
+}
+
+IMessage *ConnectionImpl::SliceMessage(IMessage *pMessage, uint32_t uOffset, uint32_t uLength)
+{
+    if (pMessage == nullptr)
+    {
+        return nullptr;
+    }
+
+    MessageImpl *pImpl = static_cast<MessageImpl *>(pMessage);
+    MessageImpl *pSlice = pImpl->pBuffer->pPool->Slice(pImpl, uOffset, uLength);
+    if (pSlice == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} failed to slice message, length: {}, offset: {}, slice length: {}",
+            m_strConnectionName.c_str(), Wrap(pMessage->uLength), Wrap(uOffset), Wrap(uLength));
+    }
+    return pSlice;
+}
+
+uint8_t *ConnectionImpl::PrependMessage(IMessage *pMessage, uint32_t uLength)
+{
+    return pMessage != nullptr ? static_cast<MessageImpl *>(pMessage)->Prepend(uLength) : nullptr;
+}
+
+uint8_t *ConnectionImpl::AppendMessage(IMessage *pMessage, uint32_t uLength)
+{
+    return pMessage != nullptr ? static_cast<MessageImpl *>(pMessage)->Append(uLength) : nullptr;
+}
+
+MessageImpl *ConnectionImpl::NewMessageBuffer(uint32_t uLength, uint32_t uHeadroom)
+{
+    return m_pNetEngine != nullptr ? m_pNetEngine->GetMessagePool()->New(uLength, uHeadroom) : nullptr;
+}
+
+int32_t ConnectionImpl::SendMessage(IMessage *pMessage)
+{
+    if (pMessage == nullptr || pMessage->pData == nullptr || pMessage->uLength == 0)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    // 小消息由内核拷贝的开销低于锁定页面和处理完成通知
+    bool bZeroCopy = !m_bDatagram && m_options.uZeroCopyThresholdBytes > 0 && pMessage->uLength >= m_options.uZeroCopyThresholdBytes;
+    return EnqueueMessage(static_cast<MessageImpl *>(pMessage), bZeroCopy);
+}
+
+int32_t ConnectionImpl::SendMessage(const uint8_t *pData, uint32_t uLength)
+{
+    if (pData == nullptr || uLength == 0)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    // 每条消息单独拷贝一份，连续的小消息由IO线程合并为一次writev发出，发送方之间不共享缓冲区
+    MessageImpl *pMessage = NewMessageBuffer(uLength, 0);
+    if (pMessage == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate send buffer", m_strConnectionName.c_str());
+        return ErrorCode::kNoMemory;
+    }
+    memcpy(pMessage->pData, pData, uLength);
+
+    int32_t iRet = EnqueueMessage(pMessage, false);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        MessageImpl::Destroy(pMessage);
+    }
+    return iRet;
+}
+
+int32_t ConnectionImpl::EnqueueMessage(MessageImpl *pMessage, bool bZeroCopy)
+{
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    if (m_bDatagram && pMessage->uLength > UdpBatch::kMaxDatagramBytes)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} message length {} exceeds udp datagram limit", m_strConnectionName.c_str(), Wrap(pMessage->uLength));
+        return ErrorCode::kInvalidParam;
+    }
+
+    SendItem *pItem = new(std::nothrow) SendItem();
+    if (pItem == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to append send queue", m_strConnectionName.c_str());
+        return ErrorCode::kNoMemory;
+    }
+    pItem->pMessage = pMessage;
+    pItem->bZeroCopy = bZeroCopy;
+
+    int32_t iRet = PushSend(pItem, pItem, pMessage->uLength);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        delete pItem;
+    }
+    return iRet;
+}
+
+int32_t ConnectionImpl::SendFile(storage::FileHandler *pFileHandler, uint64_t uOffset, uint32_t uLength)
+{
+    if (pFileHandler == nullptr || pFileHandler->pHandler == nullptr || uLength == 0)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    // 加密存储的页缓存中是密文，只能读出解密后的内容再发送；异步发送后端和UDP、共享内存连接没有sendfile路径
+    int32_t iFd = pFileHandler->pHandler->GetFd();
+    if (!m_bSendFile || iFd < 0)
+    {
+        return EnqueueFileCopy(pFileHandler->pHandler, uOffset, uLength);
+    }
+
+    // 复制描述符，调用方返回后即可关闭文件
+    int32_t iFileFd = fcntl(iFd, F_DUPFD_CLOEXEC, 0);
+    if (iFileFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kFileReadFailed, "{} failed to dup file descriptor, errno: {}", m_strConnectionName.c_str(), Wrap(errno));
+        return ErrorCode::kFileReadFailed;
+    }
+
+    SendItem *pItem = new(std::nothrow) SendItem();
+    if (pItem == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to append send queue", m_strConnectionName.c_str());
+        close(iFileFd);
+        return ErrorCode::kNoMemory;
+    }
+    pItem->iFileFd = iFileFd;
+    pItem->uFileOffset = uOffset;
+    pItem->uFileLength = uLength;
+
+    int32_t iRet = PushSend(pItem, pItem, uLength);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        close(iFileFd);
+        delete pItem;
+    }
+    return iRet;
+}
+
+int32_t ConnectionImpl::EnqueueFileCopy(storage::IFile *pFile, uint64_t uOffset, uint32_t uLength)
+{
+    // UDP的每条消息单独作为一个数据报发送，长度不能超过数据报上限
+    uint32_t uMaxBytes = m_bDatagram ? UdpBatch::kMaxDatagramBytes : kSendFileCopyBytes;
+    bool bZeroCopy = !m_bDatagram && m_options.uZeroCopyThresholdBytes > 0;
+    std::lock_guard<std::mutex> copyLock(m_fileCopyMutex);
+
+    // 先读出第一段，再与sendfile路径一样按水位准入整段，被拒绝时对端什么也收不到
+    MessageImpl *pChunk = nullptr;
+    int32_t iRet = ReadFileChunk(pFile, uOffset, std::min(uLength, uMaxBytes), pChunk);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    if (m_eState != ConnectionState::kConnected)
+    {
+        MessageImpl::Destroy(pChunk);
+        return ErrorCode::kNotConnected;
+    }
+
+    FileCopyStream *pStream = new(std::nothrow) FileCopyStream(bZeroCopy);
+    SendItem *pItem = new(std::nothrow) SendItem();
+    if (pStream == nullptr || pItem == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to append send queue", m_strConnectionName.c_str());
+        if (pStream != nullptr)
+        {
+            pStream->Release();
+            pStream->Release();
+        }
+        delete pItem;
+        MessageImpl::Destroy(pChunk);
+        return ErrorCode::kNoMemory;
+    }
+    pItem->pCopy = pStream;
+
+    m_uFileCopyPendingBytes.store(uLength);
+    iRet = PushSend(pItem, pItem, uLength);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        m_uFileCopyPendingBytes.store(0);
+        pStream->Release();
+        pStream->Release();
+        delete pItem;
+        MessageImpl::Destroy(pChunk);
+        return iRet;
+    }
+
+    // 之后逐段读出交给IO线程，内存占用不随文件长度增长
+    for (uint32_t uPosted = 0;;)
+    {
+        uint32_t uBytes = pChunk->uLength;
+        bool bLast = uPosted + uBytes == uLength;
+        iRet = pStream->Push(pChunk, bLast);
+        if (iRet != ErrorCode::kSuccess)
+        {
+            MessageImpl::Destroy(pChunk);
+            break;
+        }
+        m_uFileCopyPendingBytes.fetch_sub(uBytes);
+        uPosted += uBytes;
+
+        Reactor *pReactor = GetOwnerReactor();
+        if (pReactor != nullptr)
+        {
+            pReactor->RequestFlush(m_uID);
+        }
+
+        if (bLast)
+        {
+            break;
+        }
+
+        if (!WaitFileCopyWindow(pStream))
+        {
+            iRet = ErrorCode::kNotConnected;
+            break;
+        }
+        iRet = ReadFileChunk(pFile, uOffset + uPosted, std::min(uLength - uPosted, uMaxBytes), pChunk);
+        if (iRet != ErrorCode::kSuccess)
+        {
+            break;
+        }
+    }
+    m_uFileCopyPendingBytes.store(0);
+
+    // 对端已收到部分文件内容，消息边界已被破坏，只能关闭连接
+    if (iRet != ErrorCode::kSuccess && !pStream->IsAborted())
+    {
+        LOG_ERROR(m_pLogger, iRet, "{} failed to copy file, close it", m_strConnectionName.c_str());
+        Close();
+    }
+    pStream->Release();
+    return iRet;
+}
+
+int32_t ConnectionImpl::ReadFileChunk(storage::IFile *pFile, uint64_t uOffset, uint32_t uLength, MessageImpl *&pChunk)
+{
+    pChunk = NewMessageBuffer(uLength, 0);
+    if (pChunk == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate send buffer", m_strConnectionName.c_str());
+        return ErrorCode::kNoMemory;
+    }
+
+    if (pFile->Read(uOffset, pChunk->pData, uLength) != ErrorCode::kSuccess)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kFileReadFailed, "{} failed to read file, offset: {}, length: {}",
+            m_strConnectionName.c_str(), Wrap(uOffset), Wrap(uLength));
+        MessageImpl::Destroy(pChunk);
+        pChunk = nullptr;
+        return ErrorCode::kFileReadFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+bool ConnectionImpl::WaitFileCopyWindow(const FileCopyStream *pStream)
+{
+    // 只计入已交给IO线程尚未发出的数据，不含文件尚未读出的部分和排在文件之后暂存的数据，后者要等文件交完才能发出
+    std::unique_lock<std::mutex> lock(m_copyWaitMutex);
+    m_uCopyWaiters.fetch_add(1);
+    m_copyWaitCv.wait(lock, [this, pStream]() {
+        return pStream->IsAborted()
+            || m_uSendQueuedBytes.load() <= m_uFileCopyPendingBytes.load() + m_uSendParkedBytes.load() + kSendFileCopyWindowBytes;
+    });
+    m_uCopyWaiters.fetch_sub(1);
+    return !pStream->IsAborted();
+}
+
+void ConnectionImpl::NotifyFileCopy()
+{
+    // 等待方先登记再检查条件，这里先修改条件再检查登记，两边至少有一方看到对方的修改
+    if (m_uCopyWaiters.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_copyWaitMutex);
+        m_copyWaitCv.notify_all();
+    }
+}
+
+int32_t ConnectionImpl::PushSend(SendItem *pFirst, SendItem *pLast, uint32_t uLength)
+{
+    int32_t iRet = ReserveSend(uLength);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+    PostSend(pFirst, pLast);
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionImpl::PostSend(SendItem *pFirst, SendItem *pLast)
+{
+    // 收件箱由空变为非空时才需要通知IO线程，否则上一次通知尚未处理，IO线程取走收件箱时会一并发送
+    if (m_sendInbox.Push(pFirst, pLast))
+    {
+        Reactor *pReactor = GetOwnerReactor();
+        if (pReactor != nullptr)
+        {
+            pReactor->RequestFlush(m_uID);
+        }
+    }
+}
+
+void ConnectionImpl::SendHeartbeat()
+{
+    // 心跳不经过水位检查，被反压的连接也要让对端感知存活；字节数照常计入，交给内核后与业务数据一起扣减
+    uint32_t uLength = sizeof(kHeartbeatMessage.arrData);
+    MessageImpl *pMessage = NewMessageBuffer(uLength, 0);
+    SendItem *pItem = pMessage != nullptr ? new(std::nothrow) SendItem() : nullptr;
+    if (pItem == nullptr)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate heartbeat", m_strConnectionName.c_str());
+        MessageImpl::Destroy(pMessage);
+        return;
+    }
+    memcpy(pMessage->pData, kHeartbeatMessage.arrData, uLength);
+    pItem->pMessage = pMessage;
+
+    m_uSendQueuedBytes.fetch_add(uLength);
+    m_pNetEngine->ChargeSend(uLength);
+    PostSend(pItem, pItem);
+}
+
+void ConnectionImpl::DrainSendInbox()
+{
+    bool bFailed = false;
+    SendItem *pItem = m_sendInbox.PopAll();
+    while (pItem != nullptr)
+    {
+        SendItem *pNext = pItem->pNext;
+        if (!QueueSendItem(*pItem))
+        {
+            bFailed = true;
+        }
+        delete pItem;
+        pItem = pNext;
+    }
+
+    if (m_pFileCopy != nullptr && !ExpandFileCopy())
+    {
+        bFailed = true;
+    }
+
+    // 丢弃的数据会破坏对端的消息边界，只能关闭连接
+    if (bFailed)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to append send queue, close it", m_strConnectionName.c_str());
+        Close();
+    }
+}
+
+bool ConnectionImpl::QueueSendItem(const SendItem &item)
+{
+    try
+    {
+        // 文件内容交完之前，后来的数据暂存，保证文件内容在发送队列中连续
+        if (m_pFileCopy != nullptr)
+        {
+            m_dequeParked.push_back(item);
+            m_uSendParkedBytes.fetch_add(item.pCopy != nullptr ? 0 : item.GetLength());
+        }
+        else if (item.pCopy != nullptr)
+        {
+            m_pFileCopy = item.pCopy;
+        }
+        else
+        {
+            m_dequeSend.push_back(item);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        if (item.pCopy == nullptr)
+        {
+            ReleaseSend(item.GetLength());
+        }
+        SendItem failed = item;
+        DestroySendItem(failed);
+        return false;
+    }
+    return true;
+}
+
+bool ConnectionImpl::ExpandFileCopy()
+{
+    std::deque<MessageImpl *> dequeChunk;
+    while (m_pFileCopy != nullptr)
+    {
+        bool bDone = m_pFileCopy->Take(dequeChunk);
+        while (!dequeChunk.empty())
+        {
+            // 数据块直接进入发送队列，字节数在整段准入时已经计入
+            SendItem item;
+            item.pMessage = dequeChunk.front();
+            item.bZeroCopy = m_pFileCopy->IsZeroCopy() && item.pMessage->uLength >= m_options.uZeroCopyThresholdBytes;
+            try
+            {
+                m_dequeSend.push_back(item);
+            }
+            catch(const std::exception& e)
+            {
+                for (auto pChunk : dequeChunk)
+                {
+                    MessageImpl::Destroy(pChunk);
+                }
+                return false;
+            }
+            dequeChunk.pop_front();
+        }
+
+        if (!bDone)
+        {
+            return true;
+        }
+
+        // 文件已全部交完，暂存的数据按原顺序继续入队，其中可能还有下一个文件
+        m_pFileCopy->Release();
+        m_pFileCopy = nullptr;
+        std::deque<SendItem> dequeParked;
+        dequeParked.swap(m_dequeParked);
+        m_uSendParkedBytes.store(0);
+        for (size_t i = 0; i < dequeParked.size(); i++)
+        {
+            if (!QueueSendItem(dequeParked[i]))
+            {
+                for (size_t j = i + 1; j < dequeParked.size(); j++)
+                {
+                    DestroySendItem(dequeParked[j]);
+                }
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int32_t ConnectionImpl::ReserveSend(uint32_t uLength)
+{
+    // 先设置标志再复查字节数，IO线程先扣减再检查标志，两边至少有一方看到对方的修改，不会漏掉通知
+    if (m_options.uSendHighWatermarkBytes > 0 && m_uSendQueuedBytes.load() >= m_options.uSendHighWatermarkBytes)
+    {
+        m_bSendBlocked.store(true);
+        if (m_uSendQueuedBytes.load() > m_options.uSendLowWatermarkBytes)
+        {
+            return ErrorCode::kWouldBlock;
+        }
+    }
+
+    if (!m_pNetEngine->ReserveSend(uLength))
+    {
+        m_bSendBlocked.store(true);
+        return ErrorCode::kWouldBlock;
+    }
+    m_uSendQueuedBytes.fetch_add(uLength);
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionImpl::ReleaseSend(uint64_t uBytes)
+{
+    m_pReactor->GetStats().uBytesOut.Add(uBytes);
+    m_uLoad += uBytes;
+    m_uSendQueuedBytes.fetch_sub(uBytes);
+    m_pNetEngine->ReleaseSend(uBytes);
+    NotifyFileCopy();
+}
+
+void ConnectionImpl::CheckSendDrained()
+{
+    if (!m_bSendBlocked.load() || m_uSendQueuedBytes.load() > m_options.uSendLowWatermarkBytes || m_pNetEngine->IsSendBlocked())
+    {
+        return;
+    }
+
+    if (m_bSendBlocked.exchange(false) && m_eState == ConnectionState::kConnected)
+    {
+        m_pCallback->OnEvent(&m_connHandler, event::kSendDrained);
+    }
+}
+
+int32_t ConnectionImpl::Call(IMessage *pRequest, IMessage *pResponse)
+{
+    if (pResponse == nullptr || pResponse->pData == nullptr)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    SyncCall call(pResponse);
+    int32_t iRet = AsyncCall(pRequest, &call, 0);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+    return call.Wait();
+}
+
+int32_t ConnectionImpl::Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse)
+{
+    if (pResponse == nullptr || pResponse->pData == nullptr)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    SyncCall call(pResponse);
+    int32_t iRet = AsyncCall(pRequest, uRequestLength, &call, 0);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+    return call.Wait();
+}
+
+int32_t ConnectionImpl::AsyncCall(IMessage *pRequest, ICallCallback *pCallback, uint32_t uTimeoutMs)
+{
+    if (pRequest == nullptr || pRequest->pData == nullptr || pRequest->uLength < sizeof(protocol::ProtocolHeader) || pCallback == nullptr)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    // 先登记再发送，响应不会早于登记到达
+    uint16_t uSequence = 0;
+    int32_t iRet = RegisterCall(pCallback, uTimeoutMs, uSequence);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+    memcpy(pRequest->pData + offsetof(protocol::ProtocolHeader, uSequence), &uSequence, sizeof(uSequence));
+
+    bool bZeroCopy = !m_bDatagram && m_options.uZeroCopyThresholdBytes > 0 && pRequest->uLength >= m_options.uZeroCopyThresholdBytes;
+    iRet = EnqueueMessage(static_cast<MessageImpl *>(pRequest), bZeroCopy);
+    if (iRet != ErrorCode::kSuccess && UnregisterCall(uSequence) == nullptr)
+    {
+        // 登记已被关闭或超时取走，回调必定发生，按已发出处理，请求随之归连接所有
+        MessageImpl::Destroy(static_cast<MessageImpl *>(pRequest));
+        return ErrorCode::kSuccess;
+    }
+    return iRet;
+}
+
+int32_t ConnectionImpl::AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs)
+{
+    if (pRequest == nullptr || uRequestLength < sizeof(protocol::ProtocolHeader) || pCallback == nullptr)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    // 请求头需要改写序列号，拷贝一份后按零拷贝方式发送
+    MessageImpl *pMessage = NewMessageBuffer(uRequestLength, 0);
+    if (pMessage == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate request", m_strConnectionName.c_str());
+        return ErrorCode::kNoMemory;
+    }
+    memcpy(pMessage->pData, pRequest, uRequestLength);
+
+    int32_t iRet = AsyncCall(pMessage, pCallback, uTimeoutMs);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        MessageImpl::Destroy(pMessage);
+    }
+    return iRet;
+}
+
+int32_t ConnectionImpl::Connect(const char *pRemoteIP, uint16_t iRemotePort)
+{
+    struct in_addr addr;
+    if (pRemoteIP == nullptr || inet_pton(AF_INET, pRemoteIP, &addr) != 1)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid remote ip");
+        return ErrorCode::kInvalidParam;
+    }
+
+    Reactor *pReactor = GetOwnerReactor();
+    if (pReactor == nullptr || m_bAccepted)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidCall, "{} can not connect", m_strConnectionName.c_str());
+        return ErrorCode::kInvalidCall;
+    }
+
+    // IO线程可能正在读取当前的远程地址，新地址按值带入任务，由IO线程改写
+    try
+    {
+        std::string strRemoteIP(pRemoteIP);
+        pReactor->PostToConnection(m_uID, [strRemoteIP, iRemotePort](ConnectionImpl *pConnection) {
+            if (pConnection != nullptr)
+            {
+                pConnection->DoConnect(strRemoteIP, iRemotePort);
+            }
+        });
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to connect", m_strConnectionName.c_str());
+        return ErrorCode::kThrowException;
+    }
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionImpl::Close()
+{
+    Reactor *pReactor = GetOwnerReactor();
+    if (pReactor == nullptr)
+    {
+        return;
+    }
+
+    try
+    {
+        pReactor->PostToConnection(m_uID, [](ConnectionImpl *pConnection) {
+            if (pConnection != nullptr)
+            {
+                pConnection->HandleClose();
+            }
+        });
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to close", m_strConnectionName.c_str());
+    }
+}
+
+bool ConnectionImpl::IsConnected() const
+{
+    return m_eState == ConnectionState::kConnected;
+}
+
+const char *ConnectionImpl::GetRemoteIP() const
+{
+    return m_strRemoteIP.c_str();
+}
+
+uint16_t ConnectionImpl::GetRemotePort() const
+{
+    return m_uRemotePort;
+}
+
+const char *ConnectionImpl::GetLocalIP() const
+{
+    return m_strLocalIP.c_str();
+}
+
+uint16_t ConnectionImpl::GetLocalPort() const
+{
+    return m_uLocalPort;
+}
+
+const std::string &ConnectionImpl::GetName() const
+{
+    return m_strConnectionName;
+}
+
+void ConnectionImpl::Bind(uint64_t uID, Reactor *pReactor)
+{
+    m_uID = uID;
+    m_pReactor = pReactor;
+    m_pNetEngine = pReactor->GetNetEngine();
+    m_bDatagram = m_pNetEngine->GetType() == NetEngineType::kUdp;
+    m_bShm = m_pNetEngine->GetType() == NetEngineType::kShm;
+    m_bSendFile = m_pNetEngine->GetType() == NetEngineType::kTcp;
+    m_connHandler.uID = uID;
+    m_connHandler.pHandler = this;
+}
+
+void ConnectionImpl::OnAttached()
+{
+    if (!m_bAccepted)
+    {
+        return;
+    }
+
+    m_pReactor->GetStats().uAccepts.Add();
+
+    // 共享内存接入连接先完成握手，之后由通道通知连接成功
+    if (m_bShm)
+    {
+        AcceptShm();
+        return;
+    }
+
+    // UDP接入连接共用监听器的套接字，只需登记远程地址
+    bool bWatched = m_pUdpSocket != nullptr ? m_pUdpSocket->AddPeer(m_peerAddr, m_uID) : m_pReactor->WatchConnection(this) == ErrorCode::kSuccess;
+    if (!bWatched)
+    {
+        HandleClose();
+        return;
+    }
+
+    m_eState = ConnectionState::kConnected;
+    StartHeartbeat();
+    m_bHandleExposed = true;
+    m_pCallback->OnConnected(&m_connHandler);
+}
+
+bool ConnectionImpl::IsMigratable() const
+{
+    // UDP连接共用监听器的套接字，共享内存连接和io_uring后端有在途的内核操作，都留在原IO线程
+    return m_pNetEngine->GetType() == NetEngineType::kTcp && m_iFd >= 0 && m_eState == ConnectionState::kConnected;
+}
+
+void ConnectionImpl::OnMigrateOut()
+{
+    m_pReactor->UnwatchConnection(this);
+    StopTimers();
+}
+
+void ConnectionImpl::OnMigrateIn(Reactor *pReactor)
+{
+    m_pReactor = pReactor;
+    if (m_pReactor->WatchConnection(this) != ErrorCode::kSuccess)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "{} failed to watch after migration", m_strConnectionName.c_str());
+        HandleClose();
+        return;
+    }
+
+    // 保留收发时间，心跳按原来的周期继续
+    uint32_t uPeriodMs = m_options.uHeartbeatIntervalMs > 0 ? m_options.uHeartbeatIntervalMs : m_options.uHeartbeatTimeoutMs;
+    if (uPeriodMs > 0)
+    {
+        m_pReactor->GetTimerWheel().Schedule(&m_heartbeatTimer, m_pReactor->GetLoopTimeMs() + uPeriodMs);
+    }
+    if (m_uPendingCalls > 0)
+    {
+        ArmCallTimer();
+    }
+
+    // 迁移期间的刷新请求可能被原IO线程丢弃，迁入后统一发送一次；重新注册时套接字已就绪的事件会再次上报
+    m_pReactor->FlushConnection(this);
+}
+
+void ConnectionImpl::DoConnect(const std::string &strRemoteIP, uint16_t uRemotePort)
+{
+    if (m_eState != ConnectionState::kClosed)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kInvalidCall, "{} is already connected", m_strConnectionName.c_str());
+        return;
+    }
+
+    try
+    {
+        m_strRemoteIP = strRemoteIP;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to set remote ip", m_strConnectionName.c_str());
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+        return;
+    }
+    m_uRemotePort = uRemotePort;
+
+    if (m_bShm)
+    {
+        DoConnectShm();
+        return;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_uRemotePort);
+    inet_pton(AF_INET, m_strRemoteIP.c_str(), &addr.sin_addr);
+    if (m_bDatagram)
+    {
+        DoConnectDatagram(addr);
+        return;
+    }
+
+    m_iFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_iFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to create socket, errno: {}", m_strConnectionName.c_str(), Wrap(errno));
+        m_pCallback->OnEvent(&m_connHandler, event::kCreateSocketFailed);
+        return;
+    }
+    SetSocketOptions(m_iFd, m_options);
+    m_bZeroCopy = EnableZeroCopy(m_iFd, m_options);
+
+    m_eState = ConnectionState::kConnecting;
+    if (m_pReactor->StartConnect(this, addr) != ErrorCode::kSuccess)
+    {
+        DoClose(false);
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+    }
+}
+
+void ConnectionImpl::DoConnectDatagram(const struct sockaddr_in &addr)
+{
+    struct sockaddr_in localAddr = {};
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    ReleaseDatagram();
+
+    UdpSocket *pSocket = new(std::nothrow) UdpSocket(m_pLogger, m_options, m_strConnectionName);
+    if (pSocket == nullptr || pSocket->Open(localAddr, &addr, false) != ErrorCode::kSuccess)
+    {
+        delete pSocket;
+        m_pCallback->OnEvent(&m_connHandler, event::kCreateSocketFailed);
+        return;
+    }
+
+    pSocket->SetOwner(m_uID);
+    if (pSocket->Watch(m_pReactor) != ErrorCode::kSuccess)
+    {
+        delete pSocket;
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+        return;
+    }
+
+    // UDP没有握手，套接字connect后即视为已连接，对端失效由心跳超时发现
+    m_pUdpSocket = pSocket;
+    m_peerAddr = addr;
+    m_eState = ConnectionState::kConnecting;
+    OnConnectResult(0);
+}
+
+void ConnectionImpl::CloseDatagram()
+{
+    if (m_pUdpSocket == nullptr)
+    {
+        return;
+    }
+
+    // 接入连接的套接字属于监听器，只注销远程地址；主动创建的连接独占套接字，随连接关闭。
+    // 关闭可能发生在套接字自身的事件处理中，对象留到重连或连接释放时再删除
+    if (m_bAccepted)
+    {
+        m_pUdpSocket->RemovePeer(m_peerAddr);
+        m_pUdpSocket = nullptr;
+    }
+    else
+    {
+        m_pUdpSocket->Close();
+    }
+}
+
+void ConnectionImpl::ReleaseDatagram()
+{
+    CloseDatagram();
+    if (!m_bAccepted)
+    {
+        delete m_pUdpSocket;
+    }
+    m_pUdpSocket = nullptr;
+}
+
+void ConnectionImpl::DoConnectShm()
+{
+    ReleaseShm();
+    ShmChannel *pChannel = new(std::nothrow) ShmChannel(m_pLogger, m_strConnectionName);
+    if (pChannel == nullptr || pChannel->Connect(m_uRemotePort, m_options.uShmRingBytes) != ErrorCode::kSuccess)
+    {
+        delete pChannel;
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+        return;
+    }
+
+    if (pChannel->Watch(m_pReactor, m_uID) != ErrorCode::kSuccess)
+    {
+        delete pChannel;
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+        return;
+    }
+
+    // 服务端映射共享内存并回复后连接成功
+    m_pShmChannel = pChannel;
+    m_eState = ConnectionState::kConnecting;
+}
+
+void ConnectionImpl::AcceptShm()
+{
+    // 接受的Unix域套接字交给通道，之后连接不再直接持有套接字
+    ShmChannel *pChannel = new(std::nothrow) ShmChannel(m_pLogger, m_strConnectionName);
+    if (pChannel == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create shm channel", m_strConnectionName.c_str());
+        HandleClose();
+        return;
+    }
+
+    m_pShmChannel = pChannel;
+    int32_t iFd = m_iFd;
+    m_iFd = -1;
+    m_eState = ConnectionState::kConnecting;
+    if (pChannel->Accept(iFd) != ErrorCode::kSuccess || pChannel->Watch(m_pReactor, m_uID) != ErrorCode::kSuccess)
+    {
+        HandleClose();
+    }
+}
+
+void ConnectionImpl::CloseShm()
+{
+    // 关闭可能发生在通道自身的事件处理中，对象留到重连或连接释放时再删除
+    if (m_pShmChannel != nullptr)
+    {
+        m_pShmChannel->Close();
+    }
+}
+
+void ConnectionImpl::ReleaseShm()
+{
+    delete m_pShmChannel;
+    m_pShmChannel = nullptr;
+}
+
+void ConnectionImpl::OnConnectResult(int32_t iError)
+{
+    if (m_eState != ConnectionState::kConnecting)
+    {
+        return;
+    }
+
+    if (iError != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kConnectFailed, "{} failed to connect {}:{}, errno: {}",
+            m_strConnectionName.c_str(), m_strRemoteIP.c_str(), Wrap(m_uRemotePort), Wrap(iError));
+        DoClose(false);
+        m_pCallback->OnEvent(&m_connHandler, event::kConnectFailed);
+        return;
+    }
+
+    UpdateAddress();
+    m_eState = ConnectionState::kConnected;
+    StartHeartbeat();
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} connected to {}:{}, id: {}",
+        m_strConnectionName.c_str(), m_strRemoteIP.c_str(), Wrap(m_uRemotePort), Wrap(m_uID));
+    m_bHandleExposed = true;
+    m_pCallback->OnConnected(&m_connHandler);
+}
+
+void ConnectionImpl::DoClose(bool bNotify)
+{
+    ConnectionState eOldState = m_eState.exchange(ConnectionState::kClosed);
+    if (m_iFd >= 0)
+    {
+        if (m_pReactor != nullptr)
+        {
+            m_pReactor->UnwatchConnection(this);
+        }
+        CloseSocket();
+    }
+
+    CloseDatagram();
+    CloseShm();
+    m_recvRing.Clear();
+    m_uPendingFrameLength = 0;
+    ClearSendQueue();
+    StopTimers();
+    FailCalls(ErrorCode::kNotConnected);
+
+    if (eOldState == ConnectionState::kConnected && m_pReactor != nullptr)
+    {
+        m_pReactor->GetStats().uDisconnects.Add();
+    }
+
+    if (bNotify && eOldState == ConnectionState::kConnected)
+    {
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} disconnected, id: {}", m_strConnectionName.c_str(), Wrap(m_uID));
+        m_pCallback->OnDisconnected(&m_connHandler);
+    }
+}
+
+void ConnectionImpl::HandleClose()
+{
+    DoClose(true);
+
+    // 接入的连接断开后不再复用。句柄交给应用后，应用可能在任意线程通过句柄指针调用，
+    // 对象保留到应用DestroyConnection或引擎退出；句柄从未交出时由所属Reactor直接回收
+    if (m_bAccepted && !m_bHandleExposed)
+    {
+        m_pReactor->Detach(m_uID);
+    }
+}
+
+void ConnectionImpl::FlushSend()
+{
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return;
+    }
+
+    DrainSendInbox();
+    if (m_pUdpSocket != nullptr)
+    {
+        FlushDatagrams();
+        return;
+    }
+
+    if (m_pShmChannel != nullptr)
+    {
+        FlushShm();
+        return;
+    }
+
+    bool bError = false;
+    int32_t iError = 0;
+    while (!m_dequeSend.empty())
+    {
+        if (m_dequeSend.front().IsFile())
+        {
+            if (!SendFileItem(m_dequeSend.front(), iError))
+            {
+                bError = iError != 0;
+                break;
+            }
+            continue;
+        }
+
+        // 队首之后发送方式相同的数据一起发出，一次系统调用发送一轮循环内入队的所有小消息
+        bool bZeroCopy = m_dequeSend.front().bZeroCopy && m_bZeroCopy;
+        uint32_t uBytes = 0;
+        struct msghdr msg = {};
+        msg.msg_iov = m_vecSendIovec.data();
+        msg.msg_iovlen = GatherSend(m_dequeSend, bZeroCopy, m_vecSendIovec.data(), uBytes);
+
+        // 后面紧跟文件内容时(通常是消息头)先不推送，与文件的第一段合并成完整的报文
+        int32_t iFlags = MSG_NOSIGNAL | (bZeroCopy ? MSG_ZEROCOPY : 0);
+        if (msg.msg_iovlen < m_dequeSend.size() && m_dequeSend[msg.msg_iovlen].IsFile())
+        {
+            iFlags |= MSG_MORE;
+        }
+
+        ssize_t iSent = sendmsg(m_iFd, &msg, iFlags);
+        m_pReactor->GetStats().uSyscalls.Add();
+        if (iSent > 0)
+        {
+            ConsumeSend(static_cast<uint32_t>(iSent), bZeroCopy);
+            continue;
+        }
+
+        if (iSent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        // 锁定的页面超出optmem限制，队首消息退回拷贝发送
+        if (iSent < 0 && errno == ENOBUFS && bZeroCopy)
+        {
+            m_dequeSend.front().bZeroCopy = false;
+            continue;
+        }
+
+        // 套接字发送缓冲区已满，等待EPOLLOUT边沿再继续
+        if (iSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            m_pReactor->GetStats().uEagains.Add();
+            break;
+        }
+
+        bError = true;
+        iError = errno;
+        break;
+    }
+
+    if (bError)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kNotConnected, "{} send failed, errno: {}", m_strConnectionName.c_str(), Wrap(iError));
+        HandleClose();
+        return;
+    }
+    CheckSendDrained();
+}
+
+bool ConnectionImpl::SendFileItem(SendItem &item, int32_t &iError)
+{
+    // 内核直接从页缓存发送，数据不经过用户态；单次发送量与writev一致受send_batch_bytes限制，避免一个大文件长时间占住IO线程
+    iError = 0;
+    while (true)
+    {
+        off_t iOffset = static_cast<off_t>(item.uFileOffset + item.uOffset);
+        uint32_t uBatchBytes = m_options.uSendBatchBytes > kSendFileMinBatchBytes ? m_options.uSendBatchBytes : kSendFileMinBatchBytes;
+        size_t uBytes = std::min(item.uFileLength - item.uOffset, uBatchBytes);
+        ssize_t iSent = sendfile(m_iFd, item.iFileFd, &iOffset, uBytes);
+        m_pReactor->GetStats().uSyscalls.Add();
+        if (iSent > 0)
+        {
+            ConsumeSend(static_cast<uint32_t>(iSent), false);
+            return true;
+        }
+
+        if (iSent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (iSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            m_pReactor->GetStats().uEagains.Add();
+            return false;
+        }
+
+        // 文件在发送期间被截断，剩余部分无法补齐，对端的消息边界已被破坏，只能关闭连接
+        iError = iSent == 0 ? EIO : errno;
+        LOG_WARN(m_pLogger, ErrorCode::kFileReadFailed, "{} sendfile failed, offset: {}, errno: {}",
+            m_strConnectionName.c_str(), Wrap(static_cast<uint64_t>(iOffset)), Wrap(iError));
+        return false;
+    }
+}
+
+void ConnectionImpl::FlushDatagrams()
+{
+    int32_t iRet = ErrorCode::kSuccess;
+    while (!m_dequeSend.empty())
+    {
+        uint32_t uItems = 0;
+        uint64_t uBytes = 0;
+        iRet = m_pUdpSocket->Send(m_bAccepted ? &m_peerAddr : nullptr, m_dequeSend, uItems, uBytes);
+        ReleaseSend(uBytes);
+        m_pReactor->GetStats().uMessagesOut.Add(uItems);
+        for (uint32_t i = 0; i < uItems; i++)
+        {
+            MessageImpl::Destroy(m_dequeSend.front().pMessage);
+            m_dequeSend.pop_front();
+        }
+
+        if (iRet != ErrorCode::kSuccess)
+        {
+            break;
+        }
+    }
+
+    // 套接字发送缓冲区已满，可写后由套接字再次刷新
+    if (iRet == ErrorCode::kWouldBlock)
+    {
+        m_pUdpSocket->WaitWritable(m_uID);
+        return;
+    }
+
+    if (iRet != ErrorCode::kSuccess)
+    {
+        HandleClose();
+        return;
+    }
+    CheckSendDrained();
+}
+
+void ConnectionImpl::FlushShm()
+{
+    int32_t iRet = ErrorCode::kSuccess;
+    while (!m_dequeSend.empty())
+    {
+        SendItem &item = m_dequeSend.front();
+        uint32_t uWritten = 0;
+        iRet = m_pShmChannel->Write(item.pMessage->pData + item.uOffset, item.pMessage->uLength - item.uOffset, uWritten);
+        if (uWritten > 0)
+        {
+            ConsumeSend(uWritten, false);
+        }
+
+        if (iRet != ErrorCode::kSuccess)
+        {
+            break;
+        }
+    }
+
+    // 一轮写入只敲一次对端门铃；环满时对端腾出空间后会敲响本端门铃再次刷新
+    m_pShmChannel->Notify();
+    if (iRet != ErrorCode::kSuccess && iRet != ErrorCode::kWouldBlock)
+    {
+        HandleClose();
+        return;
+    }
+    CheckSendDrained();
+}
+
+uint32_t ConnectionImpl::GatherSend(const std::deque<SendItem> &dequeItems, bool bZeroCopy, struct iovec *pIovec, uint32_t &uBytes) const
+{
+    uint32_t uCount = 0;
+    uBytes = 0;
+    for (const SendItem &item : dequeItems)
+    {
+        if (uCount == m_options.uSendMaxIovecs || uBytes >= m_options.uSendBatchBytes
+            || item.IsFile() || (item.bZeroCopy && m_bZeroCopy) != bZeroCopy)
+        {
+            break;
+        }
+
+        pIovec[uCount].iov_base = item.pMessage->pData + item.uOffset;
+        pIovec[uCount].iov_len = item.pMessage->uLength - item.uOffset;
+        uBytes += static_cast<uint32_t>(pIovec[uCount].iov_len);
+        uCount++;
+    }
+    return uCount;
+}
+
+void ConnectionImpl::ConsumeSend(uint32_t uSent, bool bZeroCopy)
+{
+    // 每次成功的零拷贝发送占用一个序号，完成通知按序号区间返回，同一次发送涉及的消息共用序号
+    uint32_t uSeq = bZeroCopy ? m_zeroCopyTracker.NextSeq() : 0;
+    ReleaseSend(uSent);
+    while (uSent > 0)
+    {
+        SendItem &item = m_dequeSend.front();
+        uint32_t uLength = std::min(uSent, item.GetLength() - item.uOffset);
+        if (bZeroCopy)
+        {
+            item.uZeroCopySeq = uSeq;
+            item.bZeroCopySent = true;
+        }
+
+        item.uOffset += uLength;
+        uSent -= uLength;
+        if (item.uOffset == item.GetLength())
+        {
+            CompleteSendItem(item);
+            m_dequeSend.pop_front();
+        }
+    }
+}
+
+void ConnectionImpl::CompleteSendItem(SendItem &item)
+{
+    m_pReactor->GetStats().uMessagesOut.Add();
+    if (!item.bZeroCopySent)
+    {
+        DestroySendItem(item);
+        return;
+    }
+
+    // 内核仍引用消息页面，收到完成通知后才能释放
+    if (!m_zeroCopyTracker.Track(item.pMessage, item.uZeroCopySeq))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to track zero copy message", m_strConnectionName.c_str());
+        MessageImpl::Destroy(item.pMessage);
+    }
+}
+
+void ConnectionImpl::ReapZeroCopy()
+{
+    bool bCopied = false;
+    if (m_zeroCopyTracker.Reap(m_iFd, bCopied) != ErrorCode::kSuccess)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to record zero copy completion", m_strConnectionName.c_str());
+    }
+
+    if (bCopied)
+    {
+        DisableZeroCopy();
+    }
+}
+
+void ConnectionImpl::DisableZeroCopy()
+{
+    if (m_bZeroCopy)
+    {
+        m_bZeroCopy = false;
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} zero copy send fell back to copy, disable it, id: {}", m_strConnectionName.c_str(), Wrap(m_uID));
+    }
+}
+
+void ConnectionImpl::DestroySendItem(SendItem &item)
+{
+    if (item.IsFile())
+    {
+        close(item.iFileFd);
+    }
+    if (item.pCopy != nullptr)
+    {
+        item.pCopy->Abort();
+        item.pCopy->Release();
+    }
+    MessageImpl::Destroy(item.pMessage);
+}
+
+void ConnectionImpl::ClearSendQueue()
+{
+    for (auto &item : m_dequeSend)
+    {
+        DestroySendItem(item);
+    }
+    m_dequeSend.clear();
+
+    for (auto &item : m_dequeParked)
+    {
+        DestroySendItem(item);
+    }
+    m_dequeParked.clear();
+    m_uSendParkedBytes.store(0);
+
+    SendItem *pItem = m_sendInbox.PopAll();
+    while (pItem != nullptr)
+    {
+        SendItem *pNext = pItem->pNext;
+        DestroySendItem(*pItem);
+        delete pItem;
+        pItem = pNext;
+    }
+
+    // 正在拷贝发送文件的调用线程停止读取
+    if (m_pFileCopy != nullptr)
+    {
+        m_pFileCopy->Abort();
+        m_pFileCopy->Release();
+        m_pFileCopy = nullptr;
+    }
+
+    // 包括异步发送后端已取出但未完成的部分，关闭后其完成结果不再计入
+    uint64_t uQueued = m_uSendQueuedBytes.exchange(0);
+    if (uQueued > 0)
+    {
+        m_pNetEngine->ReleaseSend(uQueued);
+    }
+    m_bSendBlocked.store(false);
+
+    // 仍被内核引用的零拷贝消息已随套接字交给Reactor，或已中止连接，剩下的可以释放
+    m_zeroCopyTracker.Release();
+    NotifyFileCopy();
+}
+
+void ConnectionImpl::CloseSocket()
+{
+    // 关闭套接字后无法再读取零拷贝完成通知，而内核可能仍在发送消息页面中的数据，此时释放消息会让内存池复用的页面被发出。
+    // 先读取已到达的通知，仍有未完成的消息时连同套接字交给Reactor，全部完成或超时中止连接后再释放
+    if (!m_zeroCopyTracker.Empty())
+    {
+        ReapZeroCopy();
+    }
+
+    if (m_zeroCopyTracker.Empty())
+    {
+        close(m_iFd);
+    }
+    else if (m_pReactor != nullptr)
+    {
+        m_pReactor->LingerZeroCopy(m_iFd, m_zeroCopyTracker, m_strConnectionName);
+    }
+    else
+    {
+        AbortSocket(m_iFd);
+        m_zeroCopyTracker.Release();
+    }
+    m_iFd = -1;
+}
+
+void ConnectionImpl::OnIOEvent(uint32_t uEvents)
+{
+    if (m_eState == ConnectionState::kConnecting)
+    {
+        if ((uEvents & (EPOLLOUT | EPOLLERR | EPOLLHUP)) == 0)
+        {
+            return;
+        }
+
+        int32_t iError = 0;
+        socklen_t uLen = sizeof(iError);
+        if (getsockopt(m_iFd, SOL_SOCKET, SO_ERROR, &iError, &uLen) != 0)
+        {
+            iError = errno;
+        }
+        OnConnectResult(iError);
+    }
+
+    if (m_eState != ConnectionState::kConnected)
+    {
+        return;
+    }
+
+    // 零拷贝完成通知通过错误队列以EPOLLERR上报
+    if (uEvents & EPOLLERR)
+    {
+        ReapZeroCopy();
+    }
+
+    if (uEvents & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    {
+        HandleRead(uEvents);
+    }
+
+    if ((uEvents & EPOLLOUT) && m_eState == ConnectionState::kConnected)
+    {
+        FlushSend();
+    }
+}
+
+void ConnectionImpl::HandleRead(uint32_t uEvents)
+{
+    // 边沿触发，必须读到EAGAIN，除非短读且没有挂起的关闭事件
+    while (m_eState == ConnectionState::kConnected)
+    {
+        // 已知长度的大消息一次预留足够空间，避免逐次翻倍
+        uint32_t uReserve = kMinRecvSpace;
+        if (m_uPendingFrameLength > m_recvRing.Size())
+        {
+            uReserve = std::max(uReserve, m_uPendingFrameLength - m_recvRing.Size());
+        }
+        if (!m_recvRing.Reserve(uReserve))
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to grow recv buffer", m_strConnectionName.c_str());
+            HandleClose();
+            return;
+        }
+
+        struct iovec arrIovec[2];
+        uint32_t uCount = m_recvRing.GetFreeSpace(arrIovec);
+        size_t uSpace = arrIovec[0].iov_len + (uCount > 1 ? arrIovec[1].iov_len : 0);
+        ssize_t iRecv = readv(m_iFd, arrIovec, static_cast<int>(uCount));
+        ReactorStats &stats = m_pReactor->GetStats();
+        stats.uSyscalls.Add();
+        if (iRecv > 0)
+        {
+            stats.uBytesIn.Add(static_cast<uint64_t>(iRecv));
+            m_uLoad += static_cast<uint64_t>(iRecv);
+            m_uLastRecvMs.store(m_pReactor->GetLoopTimeMs(), std::memory_order_relaxed);
+            m_recvRing.Commit(static_cast<uint32_t>(iRecv));
+            if (!ParseMessages())
+            {
+                HandleClose();
+                return;
+            }
+
+            if (static_cast<size_t>(iRecv) < uSpace && (uEvents & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) == 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        if (iRecv < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (iRecv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            stats.uEagains.Add();
+            return;
+        }
+
+        HandleClose();
+        return;
+    }
+}
+
+bool ConnectionImpl::OnReceived(const uint8_t *pData, uint32_t uLength)
+{
+    m_uLastRecvMs.store(m_pReactor->GetLoopTimeMs(), std::memory_order_relaxed);
+    m_pReactor->GetStats().uBytesIn.Add(uLength);
+    m_uLoad += uLength;
+
+    // 缓冲区中没有残留数据时直接在内核填充的缓冲区上解析，只拷贝不完整的尾部
+    bool bHasRemain = !m_recvRing.Empty();
+    if (!bHasRemain)
+    {
+        uint32_t uConsumed = 0;
+        if (!DeliverMessages(pData, uLength, uConsumed, m_uPendingFrameLength))
+        {
+            return false;
+        }
+        pData += uConsumed;
+        uLength -= uConsumed;
+        if (uLength == 0)
+        {
+            return true;
+        }
+    }
+
+    if (!m_recvRing.Reserve(std::max(uLength, m_uPendingFrameLength > m_recvRing.Size() ? m_uPendingFrameLength - m_recvRing.Size() : 0)))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to grow recv buffer", m_strConnectionName.c_str());
+        return false;
+    }
+
+    m_recvRing.Append(pData, uLength);
+    return bHasRemain ? ParseMessages() : true;
+}
+
+bool ConnectionImpl::OnDatagram(const uint8_t *pData, uint32_t uLength)
+{
+    m_uLastRecvMs.store(m_pReactor->GetLoopTimeMs(), std::memory_order_relaxed);
+    m_pReactor->GetStats().uBytesIn.Add(uLength);
+    m_uLoad += uLength;
+
+    uint32_t uConsumed = 0;
+    uint32_t uPendingLength = 0;
+    if (!DeliverMessages(pData, uLength, uConsumed, uPendingLength))
+    {
+        return false;
+    }
+
+    if (uConsumed < uLength)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "{} drop {} bytes of incomplete message in datagram",
+            m_strConnectionName.c_str(), Wrap(uLength - uConsumed));
+    }
+    return true;
+}
+
+bool ConnectionImpl::TakeSendItems(std::deque<SendItem> &dequeItems)
+{
+    DrainSendInbox();
+    if (m_dequeSend.empty())
+    {
+        return false;
+    }
+
+    dequeItems.swap(m_dequeSend);
+    return true;
+}
+
+bool ConnectionImpl::ParseMessages()
+{
+    while (!m_recvRing.Empty() && m_eState == ConnectionState::kConnected)
+    {
+        // 连续部分中完整的消息直接在环形缓冲区上投递，不拷贝
+        uint32_t uContiguous = 0;
+        const uint8_t *pData = m_recvRing.Peek(uContiguous);
+        uint32_t uConsumed = 0;
+        if (!DeliverMessages(pData, uContiguous, uConsumed, m_uPendingFrameLength))
+        {
+            return false;
+        }
+
+        if (uConsumed > 0)
+        {
+            m_recvRing.Consume(uConsumed);
+            continue;
+        }
+
+        // 首条消息不完整，数据没有环绕说明还需要继续接收
+        if (uContiguous == m_recvRing.Size())
+        {
+            return true;
+        }
+
+        bool bDelivered = false;
+        if (!DeliverWrappedMessage(m_uPendingFrameLength, bDelivered))
+        {
+            return false;
+        }
+
+        if (!bDelivered)
+        {
+            return true;
+        }
+    }
+    return true;
+}
+
+bool ConnectionImpl::DeliverWrappedMessage(uint32_t uPendingLength, bool &bDelivered)
+{
+    bDelivered = false;
+    uint32_t uSize = m_recvRing.Size();
+    try
+    {
+        // 长度未知时消息头本身跨越了末尾，先拷贝一小段解析长度
+        if (uPendingLength == 0)
+        {
+            uint32_t uContiguous = 0;
+            m_recvRing.Peek(uContiguous);
+            uint32_t uPeek = std::min(uSize, uContiguous + kFramePeekBytes);
+            if (m_vecFrameBuffer.size() < uPeek)
+            {
+                m_vecFrameBuffer.resize(uPeek);
+            }
+            m_recvRing.CopyOut(0, m_vecFrameBuffer.data(), uPeek);
+            uPendingLength = m_pCallback->OnMessageLength(&m_connHandler, m_vecFrameBuffer.data(), uPeek);
+            if (uPendingLength == UINT32_MAX)
+            {
+                LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} received invalid message", m_strConnectionName.c_str());
+                return false;
+            }
+
+            if (uPendingLength == 0)
+            {
+                if (uPeek == uSize)
+                {
+                    return true;
+                }
+
+                // 消息头超过预读长度，按全部数据重新解析
+                if (m_vecFrameBuffer.size() < uSize)
+                {
+                    m_vecFrameBuffer.resize(uSize);
+                }
+                m_recvRing.CopyOut(0, m_vecFrameBuffer.data(), uSize);
+                uPendingLength = m_pCallback->OnMessageLength(&m_connHandler, m_vecFrameBuffer.data(), uSize);
+                if (uPendingLength == UINT32_MAX)
+                {
+                    LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} received invalid message", m_strConnectionName.c_str());
+                    return false;
+                }
+                if (uPendingLength == 0)
+                {
+                    return true;
+                }
+            }
+        }
+
+        m_uPendingFrameLength = uPendingLength;
+        if (uPendingLength > uSize)
+        {
+            return true;
+        }
+
+        if (m_vecFrameBuffer.size() < uPendingLength)
+        {
+            m_vecFrameBuffer.resize(uPendingLength);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to alloc frame buffer", m_strConnectionName.c_str());
+        return false;
+    }
+
+    // 只投递这一条消息，之后的数据回到环形缓冲区上解析
+    m_recvRing.CopyOut(0, m_vecFrameBuffer.data(), uPendingLength);
+    m_uPendingFrameLength = 0;
+    if (!DispatchMessage(m_vecFrameBuffer.data(), uPendingLength))
+    {
+        return false;
+    }
+    m_recvRing.Consume(uPendingLength);
+    bDelivered = true;
+    return true;
+}
+
+bool ConnectionImpl::DeliverMessages(const uint8_t *pData, uint32_t uLength, uint32_t &uConsumed, uint32_t &uPendingLength)
+{
+    uConsumed = 0;
+    uPendingLength = 0;
+    while (uConsumed < uLength)
+    {
+        const uint8_t *pMessage = pData + uConsumed;
+        uint32_t uRemain = uLength - uConsumed;
+        uint32_t uMessageLength = m_pCallback->OnMessageLength(&m_connHandler, pMessage, uRemain);
+        if (uMessageLength == UINT32_MAX)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} received invalid message", m_strConnectionName.c_str());
+            return false;
+        }
+
+        if (uMessageLength == 0)
+        {
+            break;
+        }
+
+        if (uMessageLength > uRemain)
+        {
+            uPendingLength = uMessageLength;
+            break;
+        }
+
+        if (!DispatchMessage(pMessage, uMessageLength))
+        {
+            return false;
+        }
+        uConsumed += uMessageLength;
+    }
+    return true;
+}
+
+bool ConnectionImpl::DispatchMessage(const uint8_t *pData, uint32_t uLength)
+{
+    // 心跳和异步调用的响应由连接处理，不再回调OnMessage
+    if (HandleInternalMessage(pData, uLength))
+    {
+        return true;
+    }
+
+    ReactorStats &stats = m_pReactor->GetStats();
+    uint64_t uStartNs = Reactor::NowNs();
+    int32_t iRet = m_pCallback->OnMessage(&m_connHandler, pData, uLength);
+    uint64_t uElapsedNs = Reactor::NowNs() - uStartNs;
+    stats.handlerLatency.Record(uElapsedNs);
+    m_uLoad += uElapsedNs;
+    stats.uMessagesIn.Add();
+    return iRet == 0;
+}
+
+bool ConnectionImpl::HandleInternalMessage(const uint8_t *pData, uint32_t uLength)
+{
+    if (uLength < sizeof(protocol::ProtocolHeader))
+    {
+        return false;
+    }
+
+    // 接收缓冲区中的消息不保证对齐，拷贝出头部再读取
+    protocol::ProtocolHeader header;
+    memcpy(&header, pData, sizeof(header));
+    if (memcmp(header.szMagic, protocol::kMagic, sizeof(header.szMagic)) != 0)
+    {
+        return false;
+    }
+
+    // 心跳只用于刷新接收时间，读取数据时已经更新
+    if (header.uFlags & protocol::kFlagHeartbeat)
+    {
+        return true;
+    }
+
+    if ((header.uFlags & protocol::kFlagResponse) == 0 || m_uPendingCalls == 0)
+    {
+        return false;
+    }
+
+    uint64_t uStartNs = 0;
+    ICallCallback *pCallback = UnregisterCall(header.uSequence, &uStartNs);
+    if (pCallback == nullptr)
+    {
+        return false;
+    }
+    m_pReactor->GetStats().callLatency.Record(Reactor::NowNs() - uStartNs);
+    pCallback->OnCallResult(ErrorCode::kSuccess, pData, uLength);
+    return true;
+}
+
+int32_t ConnectionImpl::RegisterCall(ICallCallback *pCallback, uint32_t uTimeoutMs, uint16_t &uSequence)
+{
+    PendingCall call;
+    call.pCallback = pCallback;
+    call.uStartNs = Reactor::NowNs();
+    call.uDeadlineMs = Reactor::NowMs() + (uTimeoutMs > 0 ? uTimeoutMs : m_options.uCallTimeoutMs);
+    bool bEarliest = false;
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        if (m_umapCall.size() >= m_options.uMaxPendingCalls)
+        {
+            return ErrorCode::kTooManyCalls;
+        }
+
+        // 跳过仍在途的序列号，未完成调用数远小于序列号空间
+        do
+        {
+            uSequence = m_uNextCallSequence++;
+        } while (m_umapCall.count(uSequence) > 0);
+
+        bEarliest = m_umapCall.empty() || call.uDeadlineMs < m_uCallDeadlineMs;
+        m_umapCall.emplace(uSequence, call);
+        m_uPendingCalls++;
+        if (bEarliest)
+        {
+            m_uCallDeadlineMs = call.uDeadlineMs;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to register call", m_strConnectionName.c_str());
+        return ErrorCode::kThrowException;
+    }
+
+    // 时间轮只能在IO线程中操作，到期时间提前时才需要重新调度，超时时间相同的连续调用只投递一次
+    if (bEarliest)
+    {
+        try
+        {
+            Reactor *pReactor = GetOwnerReactor();
+            if (pReactor != nullptr)
+            {
+                pReactor->PostToConnection(m_uID, [](ConnectionImpl *pConnection) {
+                    if (pConnection != nullptr)
+                    {
+                        pConnection->ArmCallTimer();
+                    }
+                });
+            }
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to schedule call timeout", m_strConnectionName.c_str());
+        }
+    }
+    return ErrorCode::kSuccess;
+}
+
+ICallCallback *ConnectionImpl::UnregisterCall(uint16_t uSequence, uint64_t *pStartNs)
+{
+    ICallCallback *pCallback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        auto it = m_umapCall.find(uSequence);
+        if (it == m_umapCall.end())
+        {
+            return nullptr;
+        }
+        pCallback = it->second.pCallback;
+        if (pStartNs != nullptr)
+        {
+            *pStartNs = it->second.uStartNs;
+        }
+        m_umapCall.erase(it);
+        m_uPendingCalls--;
+    }
+    return pCallback;
+}
+
+void ConnectionImpl::ArmCallTimer()
+{
+    uint64_t uDeadlineMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        if (m_umapCall.empty())
+        {
+            return;
+        }
+        uDeadlineMs = m_uCallDeadlineMs;
+    }
+
+    if (!m_callTimer.IsActive() || uDeadlineMs < m_uCallTimerMs)
+    {
+        m_uCallTimerMs = uDeadlineMs;
+        m_pReactor->GetTimerWheel().Schedule(&m_callTimer, uDeadlineMs);
+    }
+}
+
+void ConnectionImpl::OnCallTimer()
+{
+    uint64_t uNowMs = m_pReactor->GetLoopTimeMs();
+    std::vector<ICallCallback *> vecExpired;
+    bool bHasPending = false;
+    uint64_t uDeadlineMs = UINT64_MAX;
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        for (auto it = m_umapCall.begin(); it != m_umapCall.end();)
+        {
+            if (it->second.uDeadlineMs > uNowMs)
+            {
+                uDeadlineMs = std::min(uDeadlineMs, it->second.uDeadlineMs);
+                ++it;
+                continue;
+            }
+            vecExpired.push_back(it->second.pCallback);
+            it = m_umapCall.erase(it);
+            m_uPendingCalls--;
+        }
+
+        bHasPending = !m_umapCall.empty();
+        if (bHasPending)
+        {
+            m_uCallDeadlineMs = uDeadlineMs;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to expire calls", m_strConnectionName.c_str());
+    }
+
+    if (bHasPending)
+    {
+        m_uCallTimerMs = uDeadlineMs;
+        m_pReactor->GetTimerWheel().Schedule(&m_callTimer, uDeadlineMs);
+    }
+
+    if (vecExpired.empty())
+    {
+        return;
+    }
+
+    LOG_WARN(m_pLogger, ErrorCode::kCallTimeout, "{} {} calls timed out", m_strConnectionName.c_str(), Wrap(vecExpired.size()));
+    m_pReactor->GetStats().uCallTimeouts.Add(vecExpired.size());
+    for (ICallCallback *pCallback : vecExpired)
+    {
+        pCallback->OnCallResult(ErrorCode::kCallTimeout, nullptr, 0);
+    }
+}
+
+void ConnectionImpl::FailCalls(int32_t iError)
+{
+    // 计数只在锁内随登记表修改，这里按登记表判断，不会漏掉刚登记的调用
+    std::unordered_map<uint16_t, PendingCall> umapCall;
+    {
+        std::lock_guard<std::mutex> lock(m_callMutex);
+        if (m_umapCall.empty())
+        {
+            return;
+        }
+        umapCall.swap(m_umapCall);
+        m_uPendingCalls -= static_cast<uint32_t>(umapCall.size());
+    }
+
+    for (auto &pair : umapCall)
+    {
+        pair.second.pCallback->OnCallResult(iError, nullptr, 0);
+    }
+}
+
+void ConnectionImpl::StartHeartbeat()
+{
+    // 未配置心跳间隔时仍按超时时间检查对端是否存活
+    uint64_t uNowMs = m_pReactor->GetLoopTimeMs();
+    m_uLastRecvMs.store(uNowMs, std::memory_order_relaxed);
+    m_uLastSendMs = uNowMs;
+    uint32_t uPeriodMs = m_options.uHeartbeatIntervalMs > 0 ? m_options.uHeartbeatIntervalMs : m_options.uHeartbeatTimeoutMs;
+    if (uPeriodMs > 0)
+    {
+        m_pReactor->GetTimerWheel().Schedule(&m_heartbeatTimer, uNowMs + uPeriodMs);
+    }
+}
+
+void ConnectionImpl::OnHeartbeatTimer()
+{
+    uint64_t uNowMs = m_pReactor->GetLoopTimeMs();
+    if (m_options.uHeartbeatTimeoutMs > 0 && uNowMs - m_uLastRecvMs.load(std::memory_order_relaxed) >= m_options.uHeartbeatTimeoutMs)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kNotConnected, "{} heartbeat timeout, nothing received for {} ms",
+            m_strConnectionName.c_str(), Wrap(uNowMs - m_uLastRecvMs.load(std::memory_order_relaxed)));
+        HandleClose();
+        return;
+    }
+
+    // 只在空闲时发送心跳，有业务数据在发送时对端已能感知存活
+    if (m_options.uHeartbeatIntervalMs > 0 && uNowMs - m_uLastSendMs >= m_options.uHeartbeatIntervalMs)
+    {
+        SendHeartbeat();
+    }
+
+    uint32_t uPeriodMs = m_options.uHeartbeatIntervalMs > 0 ? m_options.uHeartbeatIntervalMs : m_options.uHeartbeatTimeoutMs;
+    m_pReactor->GetTimerWheel().Schedule(&m_heartbeatTimer, uNowMs + uPeriodMs);
+}
+
+void ConnectionImpl::StopTimers()
+{
+    if (m_pReactor != nullptr)
+    {
+        m_pReactor->GetTimerWheel().Cancel(&m_heartbeatTimer);
+        m_pReactor->GetTimerWheel().Cancel(&m_callTimer);
+    }
+}
+
+Reactor *ConnectionImpl::GetOwnerReactor() const
+{
+    return m_pNetEngine != nullptr ? m_pNetEngine->GetReactor(m_uID) : nullptr;
+}
+
+void ConnectionImpl::UpdateAddress()
+{
+    int32_t iFd = m_pUdpSocket != nullptr ? m_pUdpSocket->GetFd() : m_iFd;
+    struct sockaddr_in addr = {};
+    socklen_t uLen = sizeof(addr);
+    if (getsockname(iFd, reinterpret_cast<struct sockaddr *>(&addr), &uLen) == 0 && addr.sin_family == AF_INET)
+    {
+        ToAddress(addr, m_strLocalIP, m_uLocalPort);
+    }
+
+    uLen = sizeof(addr);
+    if (getpeername(iFd, reinterpret_cast<struct sockaddr *>(&addr), &uLen) == 0 && addr.sin_family == AF_INET)
+    {
+        ToAddress(addr, m_strRemoteIP, m_uRemotePort);
+    }
+}
+
+}
+}
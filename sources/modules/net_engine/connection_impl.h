@@ -2,27 +2,171 @@
 #define __LITE_DRIVE_NET_ENGINE_CONNECTION_IMPL_H__
 
 #include <net_engine.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <sys/uio.h>
+#include "reactor.h"
+#include "message_impl.h"
+#include "recv_ring.h"
+#include "mpsc_queue.h"
+#include "zero_copy.h"
 
 namespace lite_drive
 {
 namespace net_engine
 {
 
-class ConnectionImpl : public IConnection
+/**
+ * @brief 连接选项，监听器解析一次后复用于所有接入的连接
+ */
+struct ConnectionOptions
+{
+    uint32_t uSocketBufferBytes{default_value::kSocketBufferBytes};
+    uint32_t uHeartbeatIntervalMs{default_value::kHeartbeatIntervalMs};
+    uint32_t uHeartbeatTimeoutMs{default_value::kHeartbeatTimeoutMs};
+    uint32_t uZeroCopyThresholdBytes{default_value::kZeroCopyThresholdBytes};
+    uint32_t uSendMaxIovecs{default_value::kSendMaxIovecs};
+    uint32_t uSendBatchBytes{default_value::kSendBatchBytes};
+    uint32_t uCallTimeoutMs{default_value::kCallTimeoutMs};
+    uint32_t uMaxPendingCalls{default_value::kMaxPendingCalls};
+    uint32_t uSendHighWatermarkBytes{default_value::kSendHighWatermarkBytes};
+    uint32_t uSendLowWatermarkBytes{default_value::kSendLowWatermarkBytes};
+    uint32_t uUdpBatchSize{default_value::kUdpBatchSize};
+    bool bUdpOffload{default_value::kUdpOffload};
+    uint32_t uShmRingBytes{default_value::kShmRingBytes};
+    uint32_t uBusyPollUs{default_value::kBusyPollUs};
+
+    void Load(utilities::IConfig *pConfig);
+};
+
+/**
+ * @brief 按连接选项设置套接字的SO_BUSY_POLL，未开启忙轮询时不做任何事
+ * @param iFd 套接字
+ * @param options 连接选项
+ */
+void SetBusyPoll(int32_t iFd, const ConnectionOptions &options);
+
+/**
+ * @brief 文件退化为拷贝发送时，调用线程逐段读出的数据块交给IO线程
+ * @note 整个文件在收件箱中只占一个发送项，IO线程取到它后把陆续读出的数据块依次放入发送队列，
+ *       全部交完之前后来入队的数据暂存在连接中，不会插入文件内容中间。调用线程和IO线程各持有一个引用
+ */
+class FileCopyStream
+{
+public:
+    explicit FileCopyStream(bool bZeroCopy) : m_bZeroCopy(bZeroCopy) {}
+
+    FileCopyStream(const FileCopyStream &) = delete;
+    FileCopyStream &operator=(const FileCopyStream &) = delete;
+
+    /**
+     * @brief 追加一个数据块，调用线程使用
+     * @param pChunk 数据块，成功后所有权转移
+     * @param bLast 是否为最后一块
+     * @return 0表示成功，kNotConnected表示连接已关闭，kNoMemory表示内存不足
+     */
+    int32_t Push(MessageImpl *pChunk, bool bLast);
+
+    /**
+     * @brief 取走已追加的数据块，IO线程使用
+     * @param dequeChunk 输出数据块，调用前必须为空
+     * @return 调用方是否已追加完全部数据块
+     */
+    bool Take(std::deque<MessageImpl *> &dequeChunk);
+
+    /**
+     * @brief 连接关闭后通知调用线程停止追加，IO线程使用
+     */
+    void Abort() { m_bAborted.store(true); }
+
+    bool IsAborted() const { return m_bAborted.load(); }
+    bool IsZeroCopy() const { return m_bZeroCopy; }
+
+    /**
+     * @brief 释放一个引用，最后一个引用释放时销毁剩余的数据块
+     */
+    void Release();
+
+private:
+    ~FileCopyStream();
+
+private:
+    std::mutex m_mutex;
+    std::deque<MessageImpl *> m_dequeChunk; // 已读出尚未放入发送队列的数据块，由m_mutex保护
+    bool m_bDone{false};                    // 已追加完全部数据块，由m_mutex保护
+    bool m_bZeroCopy{false};                // 数据块是否尝试零拷贝发送
+    std::atomic<bool> m_bAborted{false};
+    std::atomic<uint32_t> m_uRefs{2};
+};
+
+/**
+ * @brief 发送队列中的一段数据，消息或文件范围二选一
+ * @note 发送方在任意线程创建节点并压入连接的无锁收件箱，IO线程取出后拷贝到自己独占的发送队列
+ */
+struct SendItem
+{
+    SendItem *pNext{nullptr};       // 收件箱中的下一个节点
+    MessageImpl *pMessage{nullptr}; // 待发送的消息
+    FileCopyStream *pCopy{nullptr}; // 拷贝发送的文件，不进入发送队列，IO线程取到后展开为消息
+    int32_t iFileFd{-1};            // 待发送文件的描述符，由发送项持有，发送完成后关闭
+    uint64_t uFileOffset{0};        // 文件范围的起始偏移量
+    uint32_t uFileLength{0};        // 文件范围的长度
+    uint32_t uOffset{0};            // 已发送字节数
+    uint32_t uZeroCopySeq{0};       // 最后一次零拷贝发送的序号
+    bool bZeroCopy{false};          // 是否尝试零拷贝发送
+    bool bZeroCopySent{false};      // 是否有数据以零拷贝方式交给了内核
+
+    bool IsFile() const { return iFileFd >= 0; }
+    uint32_t GetLength() const { return IsFile() ? uFileLength : pMessage->uLength; }
+};
+
+class UdpSocket;
+class ShmChannel;
+
+enum class ConnectionState : uint8_t
+{
+    kClosed,     // 未连接
+    kConnecting, // 连接中
+    kConnected,  // 已连接
+};
+
+class ConnectionImpl : public IConnection, public IEventHandler
 {
 public:
     ConnectionImpl(logger::ILogger *pLogger);
-    ~ConnectionImpl() override = default;
+    ~ConnectionImpl() override;
 
     int32_t Init(utilities::IConfig *pConfig, ICallback *pCallback);
+    int32_t InitAccepted(int32_t iFd, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName);
+
+    /**
+     * @brief 初始化UDP监听套接字上的接入连接
+     * @param pSocket 收发使用的UDP套接字，由监听器持有
+     * @param addr 远程地址
+     * @param options 连接选项
+     * @param pCallback 回调
+     * @param strName 连接名称
+     * @return 0表示成功,否则失败
+     */
+    int32_t InitDatagram(UdpSocket *pSocket, const struct sockaddr_in &addr, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName);
     void Exit();
 
     IMessage *NewMessage(uint32_t uLength) override;
     void DeleteMessage(IMessage *pMessage) override;
+    IMessage *SliceMessage(IMessage *pMessage, uint32_t uOffset, uint32_t uLength) override;
+    uint8_t *PrependMessage(IMessage *pMessage, uint32_t uLength) override;
+    uint8_t *AppendMessage(IMessage *pMessage, uint32_t uLength) override;
     int32_t SendMessage(IMessage *pMessage) override;
     int32_t SendMessage(const uint8_t *pData, uint32_t uLength) override;
+    int32_t SendFile(storage::FileHandler *pFileHandler, uint64_t uOffset, uint32_t uLength) override;
     int32_t Call(IMessage *pRequest, IMessage *pResponse) override;
     int32_t Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse) override;
+    int32_t AsyncCall(IMessage *pRequest, ICallCallback *pCallback, uint32_t uTimeoutMs) override;
+    int32_t AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs) override;
     int32_t Connect(const char *pRemoteIP, uint16_t iRemotePort) override;
     void Close() override;
     bool IsConnected() const override;
@@ -31,11 +175,275 @@ public:
     const char *GetLocalIP() const override;
     uint16_t GetLocalPort() const override;
 
-    std::string &GetName() const;
+    void OnIOEvent(uint32_t uEvents) override;
+
+    /**
+     * @brief 绑定连接ID和所属Reactor，由网络引擎在交给Reactor之前调用
+     */
+    void Bind(uint64_t uID, Reactor *pReactor);
+
+    /**
+     * @brief 连接交给Reactor后在IO线程中调用，注册套接字并通知已接入的连接
+     */
+    void OnAttached();
+
+    /**
+     * @brief 在IO线程中发起连接
+     * @param strRemoteIP 远程IP
+     * @param uRemotePort 远程端口
+     * @note 远程地址只在IO线程中改写，调用线程不直接修改连接的成员
+     */
+    void DoConnect(const std::string &strRemoteIP, uint16_t uRemotePort);
+
+    /**
+     * @brief 是否可以迁移到其他IO线程，仅epoll后端已连接的TCP连接支持，在IO线程中调用
+     */
+    bool IsMigratable() const;
+
+    /**
+     * @brief 迁出前在原IO线程中调用，注销套接字和定时器，发送队列和未完成的调用随连接一起迁移
+     */
+    void OnMigrateOut();
+
+    /**
+     * @brief 迁入后在新的IO线程中调用，重新注册套接字和定时器，并发送迁移期间提交的数据
+     * @param pReactor 新的Reactor
+     */
+    void OnMigrateIn(Reactor *pReactor);
+
+    /**
+     * @brief 获取上次采样以来的负载，按收发字节数加回调耗时计算，与Reactor::GetLoad的单位相同，在IO线程中调用
+     */
+    uint64_t GetLoad() const { return m_uLoad; }
+    void ResetLoad() { m_uLoad = 0; }
+
+    /**
+     * @brief 在IO线程中关闭连接
+     * @param bNotify 是否回调OnDisconnected
+     */
+    void DoClose(bool bNotify);
+
+    /**
+     * @brief 连接结果通知，在IO线程中由Reactor调用
+     * @param iError 0表示连接成功，否则为错误码errno
+     */
+    void OnConnectResult(int32_t iError);
+
+    /**
+     * @brief 在IO线程中将发送缓冲区写入套接字，epoll后端使用
+     */
+    void FlushSend();
+
+    /**
+     * @brief 处理由Reactor接收的数据，完整的消息直接在pData上回调，不完整的部分拷贝到接收缓冲区
+     * @param pData 数据
+     * @param uLength 数据长度
+     * @return true表示成功，false表示需要关闭连接
+     */
+    bool OnReceived(const uint8_t *pData, uint32_t uLength);
+
+    /**
+     * @brief 处理UDP套接字收到的一个数据报，数据报中只能包含完整的消息，不完整的尾部被丢弃
+     * @param pData 数据
+     * @param uLength 数据长度
+     * @return true表示成功，false表示需要关闭连接
+     */
+    bool OnDatagram(const uint8_t *pData, uint32_t uLength);
+
+    /**
+     * @brief 取出发送队列中的全部数据，由异步提交发送的Reactor调用
+     * @param dequeItems 输出待发送数据，调用前必须为空
+     * @return 是否有待发送的数据
+     */
+    bool TakeSendItems(std::deque<SendItem> &dequeItems);
+
+    /**
+     * @brief 把收件箱中各线程提交的数据按提交顺序移到发送队列，在IO线程中调用
+     */
+    void DrainSendInbox();
+
+    /**
+     * @brief 读取套接字错误队列中的零拷贝完成通知，释放内核不再引用的消息，epoll后端使用
+     */
+    void ReapZeroCopy();
+
+    /**
+     * @brief 内核以拷贝方式完成了零拷贝发送（如回环地址），之后的消息不再尝试零拷贝
+     */
+    void DisableZeroCopy();
+
+    bool IsZeroCopyEnabled() const { return m_bZeroCopy; }
+
+    /**
+     * @brief 从队首开始收集发送方式相同的连续数据，供一次writev/sendmsg发出
+     * @param dequeItems 发送队列
+     * @param bZeroCopy 收集零拷贝发送的数据还是拷贝发送的数据
+     * @param pIovec 输出分段，容量不小于GetSendMaxIovecs()
+     * @param uBytes 输出收集的字节数
+     * @return 收集的分段数，受send_max_iovecs和send_batch_bytes限制，队首数据总会被收集
+     */
+    uint32_t GatherSend(const std::deque<SendItem> &dequeItems, bool bZeroCopy, struct iovec *pIovec, uint32_t &uBytes) const;
+
+    uint32_t GetSendMaxIovecs() const { return m_options.uSendMaxIovecs; }
+
+    /**
+     * @brief 记录发送活动，空闲超过心跳间隔才发送心跳，在IO线程中由Reactor刷新发送缓冲区时调用
+     * @param uNowMs 当前单调时钟时间，单位: 毫秒
+     */
+    void MarkSendActive(uint64_t uNowMs) { m_uLastSendMs = uNowMs; }
+
+    /**
+     * @brief 数据已交给内核，扣减待发送字节数，在IO线程中调用
+     * @param uBytes 字节数
+     */
+    void ReleaseSend(uint64_t uBytes);
+
+    /**
+     * @brief 发送曾被拒绝且待发送数据已降到低水位以下时回调OnEvent(event::kSendDrained)，在IO线程中调用
+     */
+    void CheckSendDrained();
+
+    /**
+     * @brief 在IO线程中关闭连接，句柄未交给应用的接入连接同时交还网络引擎回收
+     * @note 已回调OnConnected的接入连接只关闭不释放，由应用DestroyConnection或引擎退出时释放
+     */
+    void HandleClose();
+
+    /**
+     * @brief 获取已入队未交给内核的字节数、未完成的调用数和最近一次收到数据的时间，供连接池选择和检查连接，线程安全
+     */
+    uint64_t GetSendQueuedBytes() const { return m_uSendQueuedBytes.load(std::memory_order_relaxed); }
+    uint32_t GetPendingCalls() const { return m_uPendingCalls.load(std::memory_order_relaxed); }
+    uint64_t GetLastRecvMs() const { return m_uLastRecvMs.load(std::memory_order_relaxed); }
+
+    int32_t GetFd() const { return m_iFd; }
+    uint64_t GetID() const { return m_uID; }
+    Reactor *GetReactor() const { return m_pReactor; }
+    uint32_t GetReactorPosition() const { return m_uReactorPosition; }
+    void SetReactorPosition(uint32_t uPosition) { m_uReactorPosition = uPosition; }
+    bool IsAccepted() const { return m_bAccepted; }
+    const std::string &GetName() const;
+
+private:
+    void HandleRead(uint32_t uEvents);
+    void DoConnectDatagram(const struct sockaddr_in &addr);
+    void FlushDatagrams();
+    void CloseDatagram();
+    void ReleaseDatagram();
+    void DoConnectShm();
+    void AcceptShm();
+    void FlushShm();
+    void CloseShm();
+    void ReleaseShm();
+    bool ParseMessages();
+    bool DeliverMessages(const uint8_t *pData, uint32_t uLength, uint32_t &uConsumed, uint32_t &uPendingLength);
+    bool DeliverWrappedMessage(uint32_t uPendingLength, bool &bDelivered);
+    MessageImpl *NewMessageBuffer(uint32_t uLength, uint32_t uHeadroom);
+    int32_t EnqueueMessage(MessageImpl *pMessage, bool bZeroCopy);
+    int32_t EnqueueFileCopy(storage::IFile *pFile, uint64_t uOffset, uint32_t uLength);
+    int32_t ReadFileChunk(storage::IFile *pFile, uint64_t uOffset, uint32_t uLength, MessageImpl *&pChunk);
+    bool WaitFileCopyWindow(const FileCopyStream *pStream);
+    void NotifyFileCopy();
+    bool QueueSendItem(const SendItem &item);
+    bool ExpandFileCopy();
+    int32_t PushSend(SendItem *pFirst, SendItem *pLast, uint32_t uLength);
+    void PostSend(SendItem *pFirst, SendItem *pLast);
+    void DestroySendItem(SendItem &item);
+    bool SendFileItem(SendItem &item, int32_t &iError);
+    int32_t ReserveSend(uint32_t uLength);
+    void CompleteSendItem(SendItem &item);
+    void ConsumeSend(uint32_t uSent, bool bZeroCopy);
+    void ClearSendQueue();
+    void CloseSocket();
+    bool DispatchMessage(const uint8_t *pData, uint32_t uLength);
+    bool HandleInternalMessage(const uint8_t *pData, uint32_t uLength);
+    int32_t RegisterCall(ICallCallback *pCallback, uint32_t uTimeoutMs, uint16_t &uSequence);
+    ICallCallback *UnregisterCall(uint16_t uSequence, uint64_t *pStartNs = nullptr);
+    void FailCalls(int32_t iError);
+    void ArmCallTimer();
+    void OnCallTimer();
+    void StartHeartbeat();
+    void OnHeartbeatTimer();
+    void SendHeartbeat();
+    void StopTimers();
+    void UpdateAddress();
+    Reactor *GetOwnerReactor() const;
 
 private:
+    static constexpr uint32_t kMinRecvSpace = 16 * 1024; // 单次recv最少预留的缓冲区空间
+    static constexpr uint32_t kInitRecvBufferBytes = 64 * 1024; // 接收缓冲区初始大小
+    static constexpr uint32_t kFramePeekBytes = 256; // 消息头跨越环形缓冲区末尾时拷贝出来解析长度的字节数
+    static constexpr uint32_t kSendFileMinBatchBytes = 64 * 1024; // sendfile单次发送的最少字节数
+    static constexpr uint32_t kSendFileCopyBytes = 1024 * 1024; // 文件退化为拷贝发送时每条消息的最大长度
+    static constexpr uint32_t kSendFileCopyWindowBytes = 4 * kSendFileCopyBytes; // 拷贝发送文件时已读出未发出的数据超过该值后等待
+
     int32_t m_iFd{-1};
+    uint64_t m_uID{0};
+    bool m_bAccepted{false};
+    bool m_bHandleExposed{false}; // 是否已回调OnConnected，之后应用可能持有句柄指针，仅IO线程访问
+    bool m_bDatagram{false}; // 是否为UDP连接，绑定时确定
+    bool m_bShm{false};      // 是否为共享内存连接，绑定时确定
+    bool m_bSendFile{false}; // 是否由IO线程用sendfile发送文件，仅epoll后端的TCP连接支持，绑定时确定
+    std::atomic<ConnectionState> m_eState{ConnectionState::kClosed};
     ICallback *m_pCallback{nullptr};
+    Reactor *m_pReactor{nullptr}; // 连接可能迁移，只在IO线程中使用，业务线程通过句柄表查找所属Reactor
+    NetEngineImpl *m_pNetEngine{nullptr};
+    uint32_t m_uReactorPosition{0}; // 在所属Reactor连接列表中的下标
+    ConnectionHandler m_connHandler{0, nullptr};
+    ConnectionOptions m_options;
+
+    // UDP连接收发使用的套接字和远程地址，主动创建的连接独占该套接字
+    UdpSocket *m_pUdpSocket{nullptr};
+    struct sockaddr_in m_peerAddr{};
+
+    // 共享内存连接的通道，握手期间连接处于连接中状态
+    ShmChannel *m_pShmChannel{nullptr};
+
+    RecvRing m_recvRing; // 仅IO线程访问
+    std::vector<uint8_t> m_vecFrameBuffer; // 跨越环形缓冲区末尾的消息拷贝到这里再投递，仅IO线程访问
+    uint32_t m_uPendingFrameLength{0}; // 已知长度但未收全的消息长度，用于提前扩容
+
+    // 发送方不加锁，只在收件箱由空变为非空时请求IO线程刷新
+    MpscQueue<SendItem> m_sendInbox;
+    std::deque<SendItem> m_dequeSend;         // 仅IO线程访问
+    std::vector<struct iovec> m_vecSendIovec; // 仅IO线程访问
+    std::atomic<uint64_t> m_uSendQueuedBytes{0}; // 已入队未交给内核的字节数，入队前增加
+    std::atomic<bool> m_bSendBlocked{false};     // 发送因超过高水位被拒绝，等待通知
+
+    // 文件退化为拷贝发送时逐段读出，同一连接同时只有一个调用线程在读，已读出未发出的数据超过窗口后等待IO线程发送
+    std::mutex m_fileCopyMutex;
+    std::mutex m_copyWaitMutex;
+    std::condition_variable m_copyWaitCv;
+    std::atomic<uint32_t> m_uCopyWaiters{0};
+    std::atomic<uint64_t> m_uFileCopyPendingBytes{0}; // 已按水位计入但尚未读出的文件字节数
+    std::atomic<uint64_t> m_uSendParkedBytes{0};      // 暂存在m_dequeParked中的字节数
+    FileCopyStream *m_pFileCopy{nullptr};             // 正在展开的文件，仅IO线程访问
+    std::deque<SendItem> m_dequeParked;               // 文件交完之前后来入队的数据，仅IO线程访问
+
+    // 零拷贝发送状态，仅IO线程访问
+    bool m_bZeroCopy{false};
+    ZeroCopyTracker m_zeroCopyTracker; // 已发送完等待完成通知的消息
+
+    // 未完成的异步调用，按请求头中的序列号索引
+    struct PendingCall
+    {
+        ICallCallback *pCallback{nullptr};
+        uint64_t uStartNs{0}; // 发出时间，用于统计调用延迟
+        uint64_t uDeadlineMs{0};
+    };
+    std::mutex m_callMutex;
+    std::unordered_map<uint16_t, PendingCall> m_umapCall;
+    uint16_t m_uNextCallSequence{0};
+    uint64_t m_uCallDeadlineMs{0};            // 未完成调用中最早的到期时间
+    std::atomic<uint32_t> m_uPendingCalls{0}; // 在m_callMutex内随登记表修改，无调用时接收路径免于加锁
+
+    // 定时器和收发时间，仅IO线程访问
+    Timer m_heartbeatTimer;
+    Timer m_callTimer;
+    uint64_t m_uCallTimerMs{0}; // 调用超时定时器的到期时间
+    std::atomic<uint64_t> m_uLastRecvMs{0}; // 连接池在管理线程中读取以判断健康状况
+    uint64_t m_uLastSendMs{0};
+    uint64_t m_uLoad{0}; // 上次采样以来的负载，仅IO线程访问
 
     std::string m_strConnectionName;
     std::string m_strRemoteIP;
@@ -44,7 +452,6 @@ private:
     uint16_t m_uLocalPort{0};
 
     logger::ILogger *m_pLogger{nullptr};
-    utilities::IConfig *m_pConfig{nullptr};
 };
 
 }
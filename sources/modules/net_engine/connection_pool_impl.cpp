@@ -0,0 +1,288 @@
+#include "connection_pool_impl.h"
+#include "net_engine_impl.h"
+#include <error_code.h>
+#include <algorithm>
+#include <utility>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+ConnectionPoolImpl::ConnectionPoolImpl(logger::ILogger *pLogger, NetEngineImpl *pNetEngine)
+    : m_pNetEngine(pNetEngine), m_pLogger(pLogger)
+{
+}
+
+ConnectionPoolImpl::~ConnectionPoolImpl()
+{
+    Exit();
+}
+
+int32_t ConnectionPoolImpl::Init(utilities::IConfig *pConfig, ICallback *pCallback)
+{
+    if (pConfig == nullptr || pCallback == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return ErrorCode::kInvalidParam;
+    }
+
+    utilities::IConfig *pSlotConfig = nullptr;
+    try
+    {
+        m_strPoolName = pConfig->GetStr(config::kSection, config::kConnectionName, default_value::kConnectionName);
+        m_strRemoteIP = pConfig->GetStr(config::kSection, config::kConnectionRemoteIP, default_value::kConnectionRemoteIP);
+        m_uRemotePort = pConfig->GetInt32(config::kSection, config::kConnectionRemotePort, default_value::kConnectionRemotePort);
+        uint32_t uSize = pConfig->GetInt32(config::kSection, config::kConnectionPoolSize, default_value::kConnectionPoolSize);
+        m_uReconnectMs = pConfig->GetInt32(config::kSection, config::kConnectionPoolReconnectMs, default_value::kConnectionPoolReconnectMs);
+        m_uUnhealthyMs = pConfig->GetInt32(config::kSection, config::kConnectionPoolUnhealthyMs, default_value::kConnectionPoolUnhealthyMs);
+        uSize = std::max(uSize, 1u);
+        m_uReconnectMs = std::min(std::max(m_uReconnectMs, 1u), UINT32_MAX >> kMaxBackoffShift);
+        m_pCallback = pCallback;
+
+        // 连接以池为回调，先全部创建再发起连接，回调到达时已能找到对应的槽位
+        pSlotConfig = utilities::IConfig::Create();
+        if (pSlotConfig == nullptr || pSlotConfig->Copy(pConfig) != ErrorCode::kSuccess)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to copy config", m_strPoolName.c_str());
+            utilities::IConfig::Destroy(pSlotConfig);
+            return ErrorCode::kNoMemory;
+        }
+
+        m_vecSlot.reserve(uSize);
+        for (uint32_t i = 0; i < uSize; i++)
+        {
+            std::string strName = m_strPoolName + "#" + std::to_string(i);
+            pSlotConfig->SetStr(config::kSection, config::kConnectionName, strName.c_str());
+            std::unique_ptr<Slot> upSlot(new Slot());
+            upSlot->connHandler = m_pNetEngine->NewConnection(pSlotConfig, this, false);
+            if (upSlot->connHandler.pHandler == nullptr)
+            {
+                LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create connection {}", m_strPoolName.c_str(), Wrap(i));
+                utilities::IConfig::Destroy(pSlotConfig);
+                return ErrorCode::kNoMemory;
+            }
+            upSlot->pConnection = static_cast<ConnectionImpl *>(upSlot->connHandler.pHandler);
+            upSlot->uBackoffMs = m_uReconnectMs;
+            m_vecSlot.push_back(std::move(upSlot));
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to init connection pool", m_strPoolName.c_str());
+        utilities::IConfig::Destroy(pSlotConfig);
+        return ErrorCode::kThrowException;
+    }
+    utilities::IConfig::Destroy(pSlotConfig);
+
+    for (auto &upSlot : m_vecSlot)
+    {
+        upSlot->pConnection->Connect(m_strRemoteIP.c_str(), m_uRemotePort);
+    }
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionPoolImpl::Exit()
+{
+    m_vecSlot.clear();
+    m_pCallback = nullptr;
+}
+
+void ConnectionPoolImpl::Maintain(uint64_t uNowMs)
+{
+    // 锁内只决定各连接要做的动作，解锁后再调用连接的接口，避免持锁期间进入连接和IO线程
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto &upSlot : m_vecSlot)
+        {
+            Slot *pSlot = upSlot.get();
+            pSlot->eAction = MaintainAction::kNone;
+            if (pSlot->uReconnectMs != 0)
+            {
+                if (uNowMs >= pSlot->uReconnectMs)
+                {
+                    pSlot->uReconnectMs = 0;
+                    pSlot->eAction = MaintainAction::kConnect;
+                }
+                continue;
+            }
+
+            // 心跳超时由连接自己关闭，这里用更短的时间提前剔除，避免业务继续选中已经失去响应的连接
+            uint64_t uLastRecvMs = pSlot->pConnection->GetLastRecvMs();
+            if (m_uUnhealthyMs > 0 && pSlot->bHealthy.load() && pSlot->pConnection->IsConnected()
+                && uNowMs > uLastRecvMs && uNowMs - uLastRecvMs >= m_uUnhealthyMs)
+            {
+                LOG_WARN(m_pLogger, ErrorCode::kNotConnected, "{} is unhealthy, nothing received for {} ms, reconnect it",
+                    pSlot->pConnection->GetName().c_str(), Wrap(uNowMs - uLastRecvMs));
+                pSlot->bHealthy.store(false);
+                pSlot->eAction = MaintainAction::kClose;
+            }
+        }
+    }
+
+    for (auto &upSlot : m_vecSlot)
+    {
+        Slot *pSlot = upSlot.get();
+        if (pSlot->eAction == MaintainAction::kConnect)
+        {
+            if (pSlot->pConnection->Connect(m_strRemoteIP.c_str(), m_uRemotePort) != ErrorCode::kSuccess)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                pSlot->uReconnectMs = uNowMs + pSlot->uBackoffMs;
+            }
+        }
+        else if (pSlot->eAction == MaintainAction::kClose)
+        {
+            pSlot->pConnection->Close();
+        }
+    }
+}
+
+ConnectionHandler ConnectionPoolImpl::Select()
+{
+    // 先比较未完成的调用数，再比较待发送字节数；从轮转的起点开始扫描，负载相同时请求分散到各连接
+    ConnectionHandler connHandler = {0, nullptr};
+    uint32_t uSize = static_cast<uint32_t>(m_vecSlot.size());
+    if (uSize == 0)
+    {
+        return connHandler;
+    }
+
+    uint32_t uStart = m_uNextSlot.fetch_add(1, std::memory_order_relaxed);
+    std::pair<uint32_t, uint64_t> bestLoad(UINT32_MAX, UINT64_MAX);
+    for (uint32_t i = 0; i < uSize; i++)
+    {
+        const Slot *pSlot = m_vecSlot[(uStart + i) % uSize].get();
+        if (!pSlot->bHealthy.load(std::memory_order_relaxed) || !pSlot->pConnection->IsConnected())
+        {
+            continue;
+        }
+
+        std::pair<uint32_t, uint64_t> load(pSlot->pConnection->GetPendingCalls(), pSlot->pConnection->GetSendQueuedBytes());
+        if (load < bestLoad)
+        {
+            bestLoad = load;
+            connHandler = pSlot->connHandler;
+            if (load.first == 0 && load.second == 0)
+            {
+                break;
+            }
+        }
+    }
+    return connHandler;
+}
+
+int32_t ConnectionPoolImpl::SendMessage(const uint8_t *pData, uint32_t uLength)
+{
+    ConnectionHandler connHandler = Select();
+    if (connHandler.pHandler == nullptr)
+    {
+        return ErrorCode::kNotConnected;
+    }
+    return connHandler.pHandler->SendMessage(pData, uLength);
+}
+
+int32_t ConnectionPoolImpl::Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse)
+{
+    ConnectionHandler connHandler = Select();
+    if (connHandler.pHandler == nullptr)
+    {
+        return ErrorCode::kNotConnected;
+    }
+    return connHandler.pHandler->Call(pRequest, uRequestLength, pResponse);
+}
+
+int32_t ConnectionPoolImpl::AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs)
+{
+    ConnectionHandler connHandler = Select();
+    if (connHandler.pHandler == nullptr)
+    {
+        return ErrorCode::kNotConnected;
+    }
+    return connHandler.pHandler->AsyncCall(pRequest, uRequestLength, pCallback, uTimeoutMs);
+}
+
+uint32_t ConnectionPoolImpl::GetAvailableCount() const
+{
+    uint32_t uCount = 0;
+    for (auto &upSlot : m_vecSlot)
+    {
+        if (upSlot->bHealthy.load(std::memory_order_relaxed) && upSlot->pConnection->IsConnected())
+        {
+            uCount++;
+        }
+    }
+    return uCount;
+}
+
+uint32_t ConnectionPoolImpl::OnMessageLength(ConnectionHandler *pConnHandler, const uint8_t *pData, uint32_t uLength)
+{
+    return m_pCallback->OnMessageLength(pConnHandler, pData, uLength);
+}
+
+int32_t ConnectionPoolImpl::OnMessage(ConnectionHandler *pConnHandler, const uint8_t *pData, uint32_t uLength)
+{
+    return m_pCallback->OnMessage(pConnHandler, pData, uLength);
+}
+
+void ConnectionPoolImpl::OnEvent(ConnectionHandler *pConnHandler, const char *pEventMsg)
+{
+    Slot *pSlot = FindSlot(pConnHandler);
+    if (pSlot != nullptr && (event::IsEvent(pEventMsg, event::kConnectFailed) || event::IsEvent(pEventMsg, event::kCreateSocketFailed)))
+    {
+        ScheduleReconnect(pSlot, true);
+    }
+    m_pCallback->OnEvent(pConnHandler, pEventMsg);
+}
+
+void ConnectionPoolImpl::OnConnected(ConnectionHandler *pConnHandler)
+{
+    Slot *pSlot = FindSlot(pConnHandler);
+    if (pSlot != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pSlot->uReconnectMs = 0;
+        pSlot->uBackoffMs = m_uReconnectMs;
+        pSlot->bHealthy.store(true);
+    }
+    m_pCallback->OnConnected(pConnHandler);
+}
+
+void ConnectionPoolImpl::OnDisconnected(ConnectionHandler *pConnHandler)
+{
+    Slot *pSlot = FindSlot(pConnHandler);
+    if (pSlot != nullptr)
+    {
+        pSlot->bHealthy.store(false);
+        ScheduleReconnect(pSlot, false);
+    }
+    m_pCallback->OnDisconnected(pConnHandler);
+}
+
+ConnectionPoolImpl::Slot *ConnectionPoolImpl::FindSlot(const ConnectionHandler *pConnHandler) const
+{
+    // 池中的连接数量很少，顺序查找即可
+    for (auto &upSlot : m_vecSlot)
+    {
+        if (upSlot->connHandler.uID == pConnHandler->uID)
+        {
+            return upSlot.get();
+        }
+    }
+    return nullptr;
+}
+
+void ConnectionPoolImpl::ScheduleReconnect(Slot *pSlot, bool bFailed)
+{
+    // 连接成功过的断开后按首次等待时间重连，连续连接失败时等待时间倍增
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!bFailed)
+    {
+        pSlot->uBackoffMs = m_uReconnectMs;
+    }
+    pSlot->uReconnectMs = Reactor::NowMs() + pSlot->uBackoffMs;
+    pSlot->uBackoffMs = std::min(pSlot->uBackoffMs * 2, m_uReconnectMs << kMaxBackoffShift);
+}
+
+}
+}
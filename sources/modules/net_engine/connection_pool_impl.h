@@ -0,0 +1,112 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_CONNECTION_POOL_H__
+#define __LITE_DRIVE_NET_ENGINE_CONNECTION_POOL_H__
+
+#include <net_engine.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "connection_impl.h"
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 到同一远程地址的一组连接，池作为各连接的回调跟踪连接状态后再转交业务回调
+ * @note 连接对象在池的整个生命周期内保持不变，断开后原地重连，因此选出的连接句柄不会失效；
+ *       重连和健康检查由网络引擎的管理线程周期性驱动
+ */
+class ConnectionPoolImpl : public IConnectionPool, public ICallback
+{
+public:
+    ConnectionPoolImpl(logger::ILogger *pLogger, NetEngineImpl *pNetEngine);
+    ~ConnectionPoolImpl() override;
+
+    /**
+     * @brief 初始化连接池并发起所有连接
+     * @param pConfig 配置
+     * @param pCallback 业务回调
+     * @return 0表示成功,否则失败
+     */
+    int32_t Init(utilities::IConfig *pConfig, ICallback *pCallback);
+
+    /**
+     * @brief 清理池自身的状态，池中的连接由网络引擎交给各自的IO线程释放
+     */
+    void Exit();
+
+    /**
+     * @brief 重连到期的连接并剔除长时间未收到数据的连接，在管理线程中周期调用
+     * @param uNowMs 单调时钟时间，单位: 毫秒
+     */
+    void Maintain(uint64_t uNowMs);
+
+    ConnectionHandler Select() override;
+    int32_t SendMessage(const uint8_t *pData, uint32_t uLength) override;
+    int32_t Call(const uint8_t *pRequest, uint32_t uRequestLength, IMessage *pResponse) override;
+    int32_t AsyncCall(const uint8_t *pRequest, uint32_t uRequestLength, ICallCallback *pCallback, uint32_t uTimeoutMs) override;
+    uint32_t GetSize() const override { return static_cast<uint32_t>(m_vecSlot.size()); }
+    uint32_t GetAvailableCount() const override;
+
+    uint32_t OnMessageLength(ConnectionHandler *pConnHandler, const uint8_t *pData, uint32_t uLength) override;
+    int32_t OnMessage(ConnectionHandler *pConnHandler, const uint8_t *pData, uint32_t uLength) override;
+    void OnEvent(ConnectionHandler *pConnHandler, const char *pEventMsg) override;
+    void OnConnected(ConnectionHandler *pConnHandler) override;
+    void OnDisconnected(ConnectionHandler *pConnHandler) override;
+
+    uint64_t GetConnectionID(uint32_t uIndex) const { return m_vecSlot[uIndex]->connHandler.uID; }
+    const std::string &GetName() const { return m_strPoolName; }
+
+private:
+    /**
+     * @brief 维护时对连接要做的动作
+     */
+    enum class MaintainAction : uint8_t
+    {
+        kNone,
+        kConnect, // 重连到期
+        kClose,   // 剔除不健康的连接
+    };
+
+    /**
+     * @brief 池中的一个连接
+     */
+    struct Slot
+    {
+        ConnectionHandler connHandler{0, nullptr};
+        ConnectionImpl *pConnection{nullptr};
+        std::atomic<bool> bHealthy{false}; // 已连接且未被判定为不健康，Select只选择健康的连接
+        MaintainAction eAction{MaintainAction::kNone}; // 本轮维护的动作，只由管理线程访问
+
+        // 以下字段由m_mutex保护
+        uint64_t uReconnectMs{0}; // 到期后重连，0表示未安排重连
+        uint32_t uBackoffMs{0};   // 下一次连接失败后的等待时间
+    };
+
+    Slot *FindSlot(const ConnectionHandler *pConnHandler) const;
+    void ScheduleReconnect(Slot *pSlot, bool bFailed);
+
+private:
+    static constexpr uint32_t kMaxBackoffShift = 5; // 重连等待时间最多倍增到首次的32倍
+
+    std::vector<std::unique_ptr<Slot>> m_vecSlot;
+    std::atomic<uint32_t> m_uNextSlot{0}; // 负载相同时轮流选择的起点
+
+    std::mutex m_mutex;
+    uint32_t m_uReconnectMs{default_value::kConnectionPoolReconnectMs};
+    uint32_t m_uUnhealthyMs{default_value::kConnectionPoolUnhealthyMs};
+    std::string m_strRemoteIP;
+    uint16_t m_uRemotePort{0};
+
+    ICallback *m_pCallback{nullptr};
+    NetEngineImpl *m_pNetEngine{nullptr};
+    std::string m_strPoolName;
+    logger::ILogger *m_pLogger{nullptr};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_CONNECTION_POOL_H__
@@ -0,0 +1,184 @@
+#include "connection_table.h"
+#include <error_code.h>
+#include <new>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+ConnectionTable::~ConnectionTable()
+{
+    Exit();
+}
+
+int32_t ConnectionTable::Init(uint32_t uCapacity)
+{
+    if (uCapacity == 0 || uCapacity == kNilIndex)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    m_pSlots = new(std::nothrow) Slot[uCapacity];
+    if (m_pSlots == nullptr)
+    {
+        return ErrorCode::kNoMemory;
+    }
+    m_uCapacity = uCapacity;
+
+    // 空闲栈按下标升序排列，低下标的槽位先被使用
+    for (uint32_t i = 0; i < uCapacity; i++)
+    {
+        m_pSlots[i].uNextFree.store(i + 1 < uCapacity ? i + 1 : kNilIndex, std::memory_order_relaxed);
+        m_pSlots[i].flushRequest.uIndex = i;
+    }
+    m_uFreeHead.store(0, std::memory_order_release);
+    return ErrorCode::kSuccess;
+}
+
+void ConnectionTable::Exit()
+{
+    delete[] m_pSlots;
+    m_pSlots = nullptr;
+    m_uCapacity = 0;
+    m_uFreeHead.store(kNilIndex, std::memory_order_relaxed);
+}
+
+uint64_t ConnectionTable::Insert(ConnectionImpl *pConnection, uint32_t uReactorIndex)
+{
+    uint32_t uIndex = 0;
+    if (!PopFree(uIndex))
+    {
+        return 0;
+    }
+
+    // 先写入内容再发布代数，查找方看到新代数时内容已可见
+    Slot &slot = m_pSlots[uIndex];
+    uint32_t uGeneration = slot.uGeneration.load(std::memory_order_relaxed) + 1;
+    slot.pConnection.store(pConnection, std::memory_order_relaxed);
+    slot.uReactorIndex.store(uReactorIndex, std::memory_order_relaxed);
+    slot.uGeneration.store(uGeneration, std::memory_order_release);
+    return (static_cast<uint64_t>(uGeneration) << 32) | uIndex;
+}
+
+void ConnectionTable::Remove(uint64_t uConnectionID)
+{
+    if (FindSlot(uConnectionID) == nullptr)
+    {
+        return;
+    }
+
+    Slot &slot = m_pSlots[GetIndex(uConnectionID)];
+    slot.uGeneration.store(GetGeneration(uConnectionID) + 1, std::memory_order_release);
+    slot.pConnection.store(nullptr, std::memory_order_relaxed);
+    PushFree(GetIndex(uConnectionID));
+}
+
+ConnectionImpl *ConnectionTable::Find(uint64_t uConnectionID) const
+{
+    const Slot *pSlot = FindSlot(uConnectionID);
+    if (pSlot == nullptr)
+    {
+        return nullptr;
+    }
+
+    // 读取期间槽位可能被释放并复用，代数不变才说明读到的是同一个连接
+    ConnectionImpl *pConnection = pSlot->pConnection.load(std::memory_order_acquire);
+    if (pSlot->uGeneration.load(std::memory_order_acquire) != GetGeneration(uConnectionID))
+    {
+        return nullptr;
+    }
+    return pConnection;
+}
+
+bool ConnectionTable::GetReactorIndex(uint64_t uConnectionID, uint32_t &uReactorIndex) const
+{
+    const Slot *pSlot = FindSlot(uConnectionID);
+    if (pSlot == nullptr)
+    {
+        return false;
+    }
+
+    uReactorIndex = pSlot->uReactorIndex.load(std::memory_order_acquire);
+    return pSlot->uGeneration.load(std::memory_order_acquire) == GetGeneration(uConnectionID);
+}
+
+void ConnectionTable::SetReactorIndex(uint64_t uConnectionID, uint32_t uReactorIndex)
+{
+    if (FindSlot(uConnectionID) == nullptr)
+    {
+        return;
+    }
+
+    // 与发送方入队后读取归属构成先写后读，两侧至少有一方看到对方的写入
+    m_pSlots[GetIndex(uConnectionID)].uReactorIndex.store(uReactorIndex, std::memory_order_seq_cst);
+}
+
+FlushRequest *ConnectionTable::GetFlushRequest(uint64_t uConnectionID)
+{
+    if (FindSlot(uConnectionID) == nullptr)
+    {
+        return nullptr;
+    }
+    return &m_pSlots[GetIndex(uConnectionID)].flushRequest;
+}
+
+uint64_t ConnectionTable::GetSlotID(uint32_t uIndex) const
+{
+    if (uIndex >= m_uCapacity)
+    {
+        return 0;
+    }
+
+    uint32_t uGeneration = m_pSlots[uIndex].uGeneration.load(std::memory_order_acquire);
+    return (uGeneration & 1) != 0 ? (static_cast<uint64_t>(uGeneration) << 32) | uIndex : 0;
+}
+
+const ConnectionTable::Slot *ConnectionTable::FindSlot(uint64_t uConnectionID) const
+{
+    uint32_t uIndex = GetIndex(uConnectionID);
+    uint32_t uGeneration = GetGeneration(uConnectionID);
+    if (uIndex >= m_uCapacity || (uGeneration & 1) == 0)
+    {
+        return nullptr;
+    }
+
+    const Slot *pSlot = &m_pSlots[uIndex];
+    return pSlot->uGeneration.load(std::memory_order_acquire) == uGeneration ? pSlot : nullptr;
+}
+
+bool ConnectionTable::PopFree(uint32_t &uIndex)
+{
+    uint64_t uHead = m_uFreeHead.load(std::memory_order_acquire);
+    while (true)
+    {
+        uint32_t uTop = static_cast<uint32_t>(uHead);
+        if (uTop == kNilIndex)
+        {
+            return false;
+        }
+
+        // 栈顶可能已被其他线程弹出，读到的后继无效时修改计数保证CAS失败
+        uint32_t uNext = m_pSlots[uTop].uNextFree.load(std::memory_order_relaxed);
+        uint64_t uNewHead = (((uHead >> 32) + 1) << 32) | uNext;
+        if (m_uFreeHead.compare_exchange_weak(uHead, uNewHead, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            uIndex = uTop;
+            return true;
+        }
+    }
+}
+
+void ConnectionTable::PushFree(uint32_t uIndex)
+{
+    uint64_t uHead = m_uFreeHead.load(std::memory_order_relaxed);
+    uint64_t uNewHead = 0;
+    do
+    {
+        m_pSlots[uIndex].uNextFree.store(static_cast<uint32_t>(uHead), std::memory_order_relaxed);
+        uNewHead = (((uHead >> 32) + 1) << 32) | uIndex;
+    } while (!m_uFreeHead.compare_exchange_weak(uHead, uNewHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+}
+}
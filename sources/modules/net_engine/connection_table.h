@@ -0,0 +1,129 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_CONNECTION_TABLE_H__
+#define __LITE_DRIVE_NET_ENGINE_CONNECTION_TABLE_H__
+
+#include <net_engine.h>
+#include <atomic>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+class ConnectionImpl;
+
+/**
+ * @brief 连接的刷新请求节点，位于句柄表槽位中，与句柄表同生命周期
+ * @note 连接释放或迁移后节点仍可能留在某个Reactor的就绪队列中，取出时按槽位当前的ID查找，不会访问已释放的连接
+ */
+struct FlushRequest
+{
+    FlushRequest *pNext{nullptr};     // 就绪队列中的下一个节点
+    std::atomic<bool> bQueued{false}; // 已在某个Reactor的就绪队列中，同一时刻最多在一个队列中
+    uint32_t uIndex{0};               // 所在槽位的下标
+};
+
+/**
+ * @brief 连接句柄表，固定容量的槽位数组，连接ID由槽位下标和代数组成
+ * @note 插入、查找、删除均无锁且为O(1)；槽位释放时代数加一，持有旧ID的句柄查找失败而不会访问已释放的连接。
+ *       查找返回的连接指针只能在其所属IO线程中解引用，其他线程只能读取所属Reactor下标
+ */
+class ConnectionTable
+{
+public:
+    ConnectionTable() = default;
+    ~ConnectionTable();
+
+    ConnectionTable(const ConnectionTable &) = delete;
+    ConnectionTable &operator=(const ConnectionTable &) = delete;
+
+    /**
+     * @brief 初始化句柄表
+     * @param uCapacity 最大连接数
+     * @return 0表示成功,否则失败
+     */
+    int32_t Init(uint32_t uCapacity);
+    void Exit();
+
+    /**
+     * @brief 为连接分配槽位，线程安全
+     * @param pConnection 连接
+     * @param uReactorIndex 连接所属Reactor下标
+     * @return 连接ID，槽位已满返回0
+     */
+    uint64_t Insert(ConnectionImpl *pConnection, uint32_t uReactorIndex);
+
+    /**
+     * @brief 释放连接的槽位，之后该ID的查找均失败，仅在连接所属IO线程中调用
+     * @param uConnectionID 连接ID
+     */
+    void Remove(uint64_t uConnectionID);
+
+    /**
+     * @brief 查找连接，线程安全
+     * @param uConnectionID 连接ID
+     * @return 连接指针，ID已失效返回NULL
+     */
+    ConnectionImpl *Find(uint64_t uConnectionID) const;
+
+    /**
+     * @brief 查找连接所属Reactor下标，线程安全
+     * @param uConnectionID 连接ID
+     * @param uReactorIndex 输出Reactor下标
+     * @return ID是否有效
+     */
+    bool GetReactorIndex(uint64_t uConnectionID, uint32_t &uReactorIndex) const;
+
+    /**
+     * @brief 改写连接所属Reactor下标，仅在连接所属IO线程中迁移连接时调用
+     * @param uConnectionID 连接ID
+     * @param uReactorIndex 新的Reactor下标
+     */
+    void SetReactorIndex(uint64_t uConnectionID, uint32_t uReactorIndex);
+
+    /**
+     * @brief 获取连接槽位中的刷新请求节点，线程安全
+     * @param uConnectionID 连接ID
+     * @return 节点，ID已失效返回NULL
+     */
+    FlushRequest *GetFlushRequest(uint64_t uConnectionID);
+
+    /**
+     * @brief 获取槽位中当前连接的ID，线程安全
+     * @param uIndex 槽位下标
+     * @return 连接ID，槽位空闲返回0
+     */
+    uint64_t GetSlotID(uint32_t uIndex) const;
+
+    uint32_t GetCapacity() const { return m_uCapacity; }
+
+private:
+    // 代数为奇数表示槽位正在使用，ID高32位为代数、低32位为下标，有效ID不为0
+    struct Slot
+    {
+        std::atomic<uint32_t> uGeneration{0};
+        std::atomic<uint32_t> uReactorIndex{0};
+        std::atomic<uint32_t> uNextFree{0};
+        std::atomic<ConnectionImpl *> pConnection{nullptr};
+        FlushRequest flushRequest;
+    };
+
+    static uint32_t GetIndex(uint64_t uConnectionID) { return static_cast<uint32_t>(uConnectionID); }
+    static uint32_t GetGeneration(uint64_t uConnectionID) { return static_cast<uint32_t>(uConnectionID >> 32); }
+
+    const Slot *FindSlot(uint64_t uConnectionID) const;
+    bool PopFree(uint32_t &uIndex);
+    void PushFree(uint32_t uIndex);
+
+private:
+    static constexpr uint32_t kNilIndex = UINT32_MAX;
+
+    Slot *m_pSlots{nullptr};
+    uint32_t m_uCapacity{0};
+
+    // 空闲槽位栈顶，高32位为修改计数防止ABA，低32位为槽位下标
+    std::atomic<uint64_t> m_uFreeHead{kNilIndex};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_CONNECTION_TABLE_H__
@@ -0,0 +1,228 @@
+#include "epoll_reactor.h"
+#include "connection_impl.h"
+#include "listener_impl.h"
+#include "shm_channel.h"
+#include "zero_copy.h"
+#include <common.h>
+#include <error_code.h>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint32_t kConnectionEvents = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+}
+
+EpollReactor::EpollReactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex)
+    : Reactor(pLogger, pNetEngine, uIndex)
+{
+}
+
+EpollReactor::~EpollReactor()
+{
+    Exit();
+}
+
+int32_t EpollReactor::Init()
+{
+    int32_t iRet = Reactor::Init();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    m_iEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_iEpollFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} failed to create epoll, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kEpollFailed;
+    }
+
+    // eventfd使用空指针标识，与IEventHandler区分
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(m_iEpollFd, EPOLL_CTL_ADD, m_iEventFd, &event) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} failed to add eventfd, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kEpollFailed;
+    }
+
+    return ErrorCode::kSuccess;
+}
+
+void EpollReactor::Exit()
+{
+    Reactor::Exit();
+
+    if (m_iEpollFd >= 0)
+    {
+        close(m_iEpollFd);
+        m_iEpollFd = -1;
+    }
+}
+
+uint32_t EpollReactor::Poll(int32_t iTimeoutMs)
+{
+    int32_t iCount = epoll_wait(m_iEpollFd, m_arrEvents, kMaxEvents, GetPollTimeout(iTimeoutMs));
+    m_stats.uPolls.Add();
+    m_stats.uSyscalls.Add();
+    if (unlikely(iCount < 0))
+    {
+        if (errno != EINTR)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} epoll_wait failed, errno: {}", Wrap(m_uIndex), Wrap(errno));
+            return 0;
+        }
+        iCount = 0;
+    }
+
+    UpdateLoopTime();
+    for (int32_t i = 0; i < iCount; i++)
+    {
+        auto pHandler = static_cast<IEventHandler *>(m_arrEvents[i].data.ptr);
+        if (pHandler == nullptr)
+        {
+            DrainWakeup();
+            continue;
+        }
+        pHandler->OnIOEvent(m_arrEvents[i].events);
+    }
+
+    RunTasks();
+    RunTimers();
+    FlushPending();
+    return static_cast<uint32_t>(iCount);
+}
+
+int32_t EpollReactor::WatchConnection(ConnectionImpl *pConnection)
+{
+    return AddFd(pConnection->GetFd(), kConnectionEvents, pConnection);
+}
+
+int32_t EpollReactor::StartConnect(ConnectionImpl *pConnection, const struct sockaddr_in &addr)
+{
+    int32_t iRet = connect(pConnection->GetFd(), reinterpret_cast<const struct sockaddr *>(&addr), sizeof(addr));
+    if (iRet != 0 && errno != EINPROGRESS)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kConnectFailed, "{} failed to connect, errno: {}", pConnection->GetName().c_str(), Wrap(errno));
+        return ErrorCode::kConnectFailed;
+    }
+
+    // 连接完成后由EPOLLOUT通知，连接在OnIOEvent中检查SO_ERROR
+    if (AddFd(pConnection->GetFd(), kConnectionEvents, pConnection) != ErrorCode::kSuccess)
+    {
+        return ErrorCode::kEpollFailed;
+    }
+
+    if (iRet == 0)
+    {
+        pConnection->OnConnectResult(0);
+    }
+    return ErrorCode::kSuccess;
+}
+
+void EpollReactor::UnwatchConnection(ConnectionImpl *pConnection)
+{
+    RemoveFd(pConnection->GetFd());
+}
+
+void EpollReactor::FlushConnection(ConnectionImpl *pConnection)
+{
+    pConnection->FlushSend();
+}
+
+int32_t EpollReactor::WatchAcceptor(Acceptor *pAcceptor)
+{
+    return AddFd(pAcceptor->iListenFd, EPOLLIN | EPOLLET, pAcceptor);
+}
+
+void EpollReactor::UnwatchAcceptor(Acceptor *pAcceptor)
+{
+    RemoveFd(pAcceptor->iListenFd);
+}
+
+int32_t EpollReactor::WatchDatagram(UdpSocket *pSocket)
+{
+    // 数据报读写都由套接字在就绪事件中批量完成，可写事件用于恢复因发送缓冲区满而暂停的连接
+    pSocket->SetBatch(&m_udpBatch);
+    return AddFd(pSocket->GetFd(), EPOLLIN | EPOLLOUT | EPOLLET, pSocket);
+}
+
+void EpollReactor::UnwatchDatagram(UdpSocket *pSocket)
+{
+    RemoveFd(pSocket->GetFd());
+}
+
+int32_t EpollReactor::WatchChannel(ShmChannel *pChannel)
+{
+    return AddFd(pChannel->GetFd(), EPOLLIN | EPOLLRDHUP | EPOLLET, pChannel);
+}
+
+int32_t EpollReactor::WatchDoorbell(ShmChannel *pChannel)
+{
+    // 注册时计数非零也会立即触发一次，握手前对端已写入的数据不会漏掉
+    return AddFd(pChannel->GetDoorbellFd(), EPOLLIN | EPOLLET, pChannel->GetDoorbellHandler());
+}
+
+void EpollReactor::UnwatchChannel(ShmChannel *pChannel)
+{
+    RemoveFd(pChannel->GetFd());
+    if (pChannel->GetDoorbellFd() >= 0)
+    {
+        RemoveFd(pChannel->GetDoorbellFd());
+    }
+}
+
+int32_t EpollReactor::WatchLinger(ZeroCopyLinger *pLinger)
+{
+    // 完成通知通过错误队列以EPOLLERR上报，EPOLLERR总会上报，不需要关注其他事件；注册时已有的通知会立即触发一次
+    return AddFd(pLinger->GetFd(), EPOLLET, pLinger);
+}
+
+void EpollReactor::UnwatchLinger(ZeroCopyLinger *pLinger)
+{
+    RemoveFd(pLinger->GetFd());
+}
+
+int32_t EpollReactor::AddFd(int32_t iFd, uint32_t uEvents, IEventHandler *pHandler)
+{
+    struct epoll_event event = {};
+    event.events = uEvents;
+    event.data.ptr = pHandler;
+    if (epoll_ctl(m_iEpollFd, EPOLL_CTL_ADD, iFd, &event) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} failed to add fd {}, errno: {}", Wrap(m_uIndex), Wrap(iFd), Wrap(errno));
+        return ErrorCode::kEpollFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t EpollReactor::ModifyFd(int32_t iFd, uint32_t uEvents, IEventHandler *pHandler)
+{
+    struct epoll_event event = {};
+    event.events = uEvents;
+    event.data.ptr = pHandler;
+    if (epoll_ctl(m_iEpollFd, EPOLL_CTL_MOD, iFd, &event) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} failed to modify fd {}, errno: {}", Wrap(m_uIndex), Wrap(iFd), Wrap(errno));
+        return ErrorCode::kEpollFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+void EpollReactor::RemoveFd(int32_t iFd)
+{
+    epoll_ctl(m_iEpollFd, EPOLL_CTL_DEL, iFd, nullptr);
+}
+
+}
+}
@@ -0,0 +1,74 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_EPOLL_REACTOR_H__
+#define __LITE_DRIVE_NET_ENGINE_EPOLL_REACTOR_H__
+
+#include "reactor.h"
+#include "udp_socket.h"
+#include <sys/epoll.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 基于边沿触发epoll的Reactor，套接字读写由连接自身在就绪事件中完成
+ */
+class EpollReactor : public Reactor
+{
+public:
+    EpollReactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex);
+    ~EpollReactor() override;
+
+    int32_t Init() override;
+    void Exit() override;
+    uint32_t Poll(int32_t iTimeoutMs) override;
+
+    int32_t WatchConnection(ConnectionImpl *pConnection) override;
+    int32_t StartConnect(ConnectionImpl *pConnection, const struct sockaddr_in &addr) override;
+    void UnwatchConnection(ConnectionImpl *pConnection) override;
+    void FlushConnection(ConnectionImpl *pConnection) override;
+    int32_t WatchAcceptor(Acceptor *pAcceptor) override;
+    void UnwatchAcceptor(Acceptor *pAcceptor) override;
+    int32_t WatchDatagram(UdpSocket *pSocket) override;
+    void UnwatchDatagram(UdpSocket *pSocket) override;
+    int32_t WatchChannel(ShmChannel *pChannel) override;
+    int32_t WatchDoorbell(ShmChannel *pChannel) override;
+    void UnwatchChannel(ShmChannel *pChannel) override;
+    int32_t WatchLinger(ZeroCopyLinger *pLinger) override;
+    void UnwatchLinger(ZeroCopyLinger *pLinger) override;
+
+    /**
+     * @brief 注册文件描述符
+     * @param iFd 文件描述符
+     * @param uEvents epoll事件掩码
+     * @param pHandler 事件处理器
+     * @return 0表示成功,否则失败
+     */
+    int32_t AddFd(int32_t iFd, uint32_t uEvents, IEventHandler *pHandler);
+
+    /**
+     * @brief 修改文件描述符监听的事件
+     * @param iFd 文件描述符
+     * @param uEvents epoll事件掩码
+     * @param pHandler 事件处理器
+     * @return 0表示成功,否则失败
+     */
+    int32_t ModifyFd(int32_t iFd, uint32_t uEvents, IEventHandler *pHandler);
+
+    /**
+     * @brief 注销文件描述符
+     * @param iFd 文件描述符
+     */
+    void RemoveFd(int32_t iFd);
+
+private:
+    static constexpr int32_t kMaxEvents = 256; // 单次epoll_wait最多返回的事件数
+
+    int32_t m_iEpollFd{-1};
+    struct epoll_event m_arrEvents[kMaxEvents];
+    UdpBatch m_udpBatch; // 本线程所有UDP套接字共用的批量收发缓冲区
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_EPOLL_REACTOR_H__
@@ -0,0 +1,360 @@
+#include "listener_impl.h"
+#include "net_engine_impl.h"
+#include "udp_socket.h"
+#include "shm_channel.h"
+#include <common.h>
+#include <error_code.h>
+#include <cerrno>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+void Acceptor::OnIOEvent(uint32_t uEvents)
+{
+    if (uEvents & EPOLLIN)
+    {
+        pListener->Accept(this);
+    }
+}
+
+ListenerImpl::ListenerImpl(logger::ILogger *pLogger, NetEngineImpl *pNetEngine)
+    : m_pNetEngine(pNetEngine), m_pLogger(pLogger)
+{
+}
+
+ListenerImpl::~ListenerImpl()
+{
+    Exit();
+}
+
+int32_t ListenerImpl::Init(utilities::IConfig *pConfig, ICallback *pCallback, uint32_t uAcceptorCount, NetEngineType eType)
+{
+    if (pConfig == nullptr || pCallback == nullptr || uAcceptorCount == 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return ErrorCode::kInvalidParam;
+    }
+
+    try
+    {
+        m_strListenerName = pConfig->GetStr(config::kSection, config::kListenerName, default_value::kListenerName);
+        m_strListenerIP = pConfig->GetStr(config::kSection, config::kListenerIP, default_value::kListenerIP);
+        m_uListenerPort = pConfig->GetInt32(config::kSection, config::kListenerPort, default_value::kListenerPort);
+        m_bReusePort = pConfig->GetBool(config::kSection, config::kListenerReusePort, default_value::kListenerReusePort);
+        m_options.Load(pConfig);
+
+        // Unix域套接字不支持多个套接字绑定同一地址
+        m_bLocal = eType == NetEngineType::kShm;
+        if (m_bLocal && m_bReusePort)
+        {
+            LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "{} reuse port is not supported by shm listener, ignore it", m_strListenerName.c_str());
+            m_bReusePort = false;
+        }
+        m_vecAcceptor.resize(m_bReusePort ? uAcceptorCount : 1);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "failed to init listener");
+        return ErrorCode::kThrowException;
+    }
+
+    m_bDatagram = eType == NetEngineType::kUdp;
+    for (auto &acceptor : m_vecAcceptor)
+    {
+        acceptor.pListener = this;
+        if (m_bDatagram)
+        {
+            acceptor.pDatagram = OpenDatagram();
+            if (acceptor.pDatagram == nullptr)
+            {
+                return ErrorCode::kListenFailed;
+            }
+            continue;
+        }
+
+        acceptor.iListenFd = m_bLocal ? OpenLocalSocket() : OpenSocket();
+        if (acceptor.iListenFd < 0)
+        {
+            return ErrorCode::kListenFailed;
+        }
+        acceptor.iReserveFd = OpenReserveFd();
+    }
+
+    m_pCallback = pCallback;
+    return ErrorCode::kSuccess;
+}
+
+void ListenerImpl::Exit()
+{
+    for (uint32_t i = 0; i < m_vecAcceptor.size(); i++)
+    {
+        CloseAcceptor(i);
+    }
+    m_vecAcceptor.clear();
+    m_pCallback = nullptr;
+}
+
+bool ListenerImpl::GetListenAddress(struct sockaddr_in &addr)
+{
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_uListenerPort);
+    if (inet_pton(AF_INET, m_strListenerIP.c_str(), &addr.sin_addr) != 1)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} invalid listener ip: {}", m_strListenerName.c_str(), m_strListenerIP.c_str());
+        return false;
+    }
+    return true;
+}
+
+int32_t ListenerImpl::OpenSocket()
+{
+    struct sockaddr_in addr = {};
+    if (!GetListenAddress(addr))
+    {
+        return -1;
+    }
+
+    int32_t iFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (iFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to create socket, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        return -1;
+    }
+
+    int32_t iValue = 1;
+    setsockopt(iFd, SOL_SOCKET, SO_REUSEADDR, &iValue, sizeof(iValue));
+
+    // 每个IO线程持有一个绑定相同地址的套接字，由内核在它们之间分发新连接
+    if (m_bReusePort && setsockopt(iFd, SOL_SOCKET, SO_REUSEPORT, &iValue, sizeof(iValue)) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to set SO_REUSEPORT, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        close(iFd);
+        return -1;
+    }
+
+    if (bind(iFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kBindFailed, "{} failed to bind {}:{}, errno: {}",
+            m_strListenerName.c_str(), m_strListenerIP.c_str(), Wrap(m_uListenerPort), Wrap(errno));
+        close(iFd);
+        return -1;
+    }
+
+    if (listen(iFd, SOMAXCONN) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kListenFailed, "{} failed to listen, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        close(iFd);
+        return -1;
+    }
+
+    return iFd;
+}
+
+int32_t ListenerImpl::OpenLocalSocket()
+{
+    int32_t iFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (iFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to create unix socket, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    socklen_t uLen = 0;
+    ShmChannel::GetLocalAddress(m_uListenerPort, addr, uLen);
+    if (bind(iFd, reinterpret_cast<struct sockaddr *>(&addr), uLen) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kBindFailed, "{} failed to bind local port {}, errno: {}",
+            m_strListenerName.c_str(), Wrap(m_uListenerPort), Wrap(errno));
+        close(iFd);
+        return -1;
+    }
+
+    if (listen(iFd, SOMAXCONN) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kListenFailed, "{} failed to listen, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        close(iFd);
+        return -1;
+    }
+
+    return iFd;
+}
+
+int32_t ListenerImpl::OpenReserveFd()
+{
+    int32_t iFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (iFd < 0)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kSocketFailed, "{} failed to open reserve fd, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+    }
+    return iFd;
+}
+
+UdpSocket *ListenerImpl::OpenDatagram()
+{
+    struct sockaddr_in addr = {};
+    if (!GetListenAddress(addr))
+    {
+        return nullptr;
+    }
+
+    UdpSocket *pSocket = new(std::nothrow) UdpSocket(m_pLogger, m_options, m_strListenerName);
+    if (pSocket == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create udp socket", m_strListenerName.c_str());
+        return nullptr;
+    }
+
+    if (pSocket->Open(addr, nullptr, m_bReusePort) != ErrorCode::kSuccess)
+    {
+        delete pSocket;
+        return nullptr;
+    }
+    pSocket->SetListener(this);
+    return pSocket;
+}
+
+int32_t ListenerImpl::Register(uint32_t uIndex, Reactor *pReactor)
+{
+    // 先记录所属Reactor，注册后IO线程可能立即开始接受连接
+    Acceptor &acceptor = m_vecAcceptor[uIndex];
+    acceptor.pReactor = pReactor;
+    int32_t iRet = acceptor.pDatagram != nullptr ? acceptor.pDatagram->Watch(pReactor) : pReactor->WatchAcceptor(&acceptor);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        acceptor.pReactor = nullptr;
+    }
+    return iRet;
+}
+
+void ListenerImpl::CloseAcceptor(uint32_t uIndex)
+{
+    Acceptor &acceptor = m_vecAcceptor[uIndex];
+    if (acceptor.pDatagram != nullptr)
+    {
+        // 同时关闭该套接字上的所有接入连接
+        acceptor.pDatagram->Close();
+        delete acceptor.pDatagram;
+        acceptor.pDatagram = nullptr;
+    }
+
+    if (acceptor.iListenFd >= 0)
+    {
+        if (acceptor.pReactor != nullptr)
+        {
+            acceptor.pReactor->UnwatchAcceptor(&acceptor);
+        }
+        close(acceptor.iListenFd);
+        acceptor.iListenFd = -1;
+    }
+
+    if (acceptor.iReserveFd >= 0)
+    {
+        close(acceptor.iReserveFd);
+        acceptor.iReserveFd = -1;
+    }
+    acceptor.pReactor = nullptr;
+}
+
+void ListenerImpl::OnAccepted(Acceptor *pAcceptor, int32_t iFd)
+{
+    // 丢弃积压连接后没能重新预留描述符时，成功接受连接说明描述符已有空余，再补上
+    if (unlikely(pAcceptor->iReserveFd < 0))
+    {
+        pAcceptor->iReserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    // reuse port模式下新连接直接归属接受它的IO线程，不跨线程传递
+    Reactor *pOwner = m_bReusePort ? pAcceptor->pReactor : nullptr;
+    m_pNetEngine->OnAccepted(iFd, m_options, m_pCallback, m_strListenerName, pOwner);
+}
+
+int32_t ListenerImpl::Accept(Acceptor *pAcceptor)
+{
+    int32_t iAccepted = 0;
+    while (true)
+    {
+        int32_t iFd = accept4(pAcceptor->iListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (iFd >= 0)
+        {
+            OnAccepted(pAcceptor, iFd);
+            iAccepted++;
+            continue;
+        }
+
+        if (errno == EINTR || errno == ECONNABORTED)
+        {
+            continue;
+        }
+
+        // 边沿触发下积压的连接不会再次通知，描述符耗尽时逐个丢弃，直到积压队列清空
+        if (errno == EMFILE || errno == ENFILE)
+        {
+            int32_t iError = errno;
+            if (ShedConnection(pAcceptor))
+            {
+                continue;
+            }
+            if (pAcceptor->iReserveFd < 0)
+            {
+                LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} accept failed without reserve fd, errno: {}", m_strListenerName.c_str(), Wrap(iError));
+            }
+            break;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} accept failed, errno: {}", m_strListenerName.c_str(), Wrap(errno));
+        }
+        break;
+    }
+    return iAccepted;
+}
+
+bool ListenerImpl::ShedConnection(Acceptor *pAcceptor)
+{
+    if (pAcceptor->iReserveFd < 0)
+    {
+        return false;
+    }
+
+    close(pAcceptor->iReserveFd);
+    int32_t iFd = -1;
+    do
+    {
+        iFd = accept4(pAcceptor->iListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    } while (iFd < 0 && (errno == EINTR || errno == ECONNABORTED));
+
+    if (iFd >= 0)
+    {
+        close(iFd);
+        LOG_WARN(m_pLogger, ErrorCode::kSocketFailed, "{} out of file descriptors, drop a pending connection", m_strListenerName.c_str());
+    }
+
+    // 释放的描述符可能已被其他线程占用，此时暂时没有预留，之后成功接受连接时再补上
+    pAcceptor->iReserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return iFd >= 0;
+}
+
+ConnectionImpl *ListenerImpl::OnDatagramPeer(UdpSocket *pSocket, const struct sockaddr_in &addr)
+{
+    return m_pNetEngine->OnAcceptedDatagram(pSocket, addr, m_options, m_pCallback, m_strListenerName);
+}
+
+const std::string &ListenerImpl::GetName() const
+{
+    return m_strListenerName;
+}
+
+}
+}
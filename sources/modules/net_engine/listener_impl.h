@@ -2,36 +2,119 @@
 #define __LITE_DRIVE_NET_ENGINE_LISTENER_H__
 
 #include <net_engine.h>
+#include <vector>
+#include "reactor.h"
+#include "connection_impl.h"
 
 namespace lite_drive
 {
 namespace net_engine
 {
 
+class ListenerImpl;
+class UdpSocket;
+
+/**
+ * @brief 单个监听套接字，注册在一个Reactor上
+ */
+struct Acceptor : public IEventHandler
+{
+    int32_t iListenFd{-1};
+    int32_t iReserveFd{-1};        // 预留的描述符，描述符耗尽时释放出来接受并关闭积压的连接
+    UdpSocket *pDatagram{nullptr}; // UDP模式下的数据报套接字，此时iListenFd无效
+    Reactor *pReactor{nullptr};
+    ListenerImpl *pListener{nullptr};
+
+    void OnIOEvent(uint32_t uEvents) override;
+};
+
 class ListenerImpl : public IListener
 {
 public:
-    ListenerImpl(logger::ILogger *pLogger);
-    ~ListenerImpl() override = default;
+    ListenerImpl(logger::ILogger *pLogger, NetEngineImpl *pNetEngine);
+    ~ListenerImpl() override;
 
-    int32_t Init(utilities::IConfig *pConfig, ICallback *pCallback);
+    /**
+     * @brief 初始化监听器
+     * @param pConfig 配置
+     * @param pCallback 回调
+     * @param uAcceptorCount 监听套接字数量，reuse port模式下每个IO线程一个，否则为1
+     * @param eType 网络引擎类型，决定监听TCP、UDP还是本机Unix域套接字
+     * @return 0表示成功,否则失败
+     */
+    int32_t Init(utilities::IConfig *pConfig, ICallback *pCallback, uint32_t uAcceptorCount, NetEngineType eType);
     void Exit();
 
-    int32_t Accept();
+    /**
+     * @brief 将监听套接字注册到Reactor
+     * @param uIndex 监听套接字下标
+     * @param pReactor Reactor
+     * @return 0表示成功,否则失败
+     */
+    int32_t Register(uint32_t uIndex, Reactor *pReactor);
+
+    /**
+     * @brief 注销并关闭监听套接字，仅在其所属IO线程中调用
+     * @param uIndex 监听套接字下标
+     */
+    void CloseAcceptor(uint32_t uIndex);
+
+    /**
+     * @brief 处理已接受的套接字，仅在监听套接字所属IO线程中调用
+     * @param pAcceptor 监听套接字
+     * @param iFd 已接受的套接字
+     */
+    void OnAccepted(Acceptor *pAcceptor, int32_t iFd);
 
-    std::string &GetName() const;
+    /**
+     * @brief 接受所有已就绪的连接，仅在监听套接字所属IO线程中调用，epoll后端使用
+     * @param pAcceptor 监听套接字
+     * @return 本次接受的连接数量
+     */
+    int32_t Accept(Acceptor *pAcceptor);
+
+    /**
+     * @brief 描述符耗尽时丢弃一个积压的连接，仅在监听套接字所属IO线程中调用
+     * @param pAcceptor 监听套接字
+     * @return true表示丢弃了一个连接，false表示没有预留描述符或没有积压的连接
+     * @note 释放预留的描述符接受一个连接并立即关闭，对端收到断开而不是一直停留在积压队列中，之后重新预留
+     */
+    bool ShedConnection(Acceptor *pAcceptor);
+
+    /**
+     * @brief 为新的远程地址创建接入连接，仅在套接字所属IO线程中调用
+     * @param pSocket 收到数据报的UDP套接字
+     * @param addr 远程地址
+     * @return 新连接，失败返回NULL
+     */
+    ConnectionImpl *OnDatagramPeer(UdpSocket *pSocket, const struct sockaddr_in &addr);
+
+    bool IsReusePort() const { return m_bReusePort; }
+    uint32_t GetAcceptorCount() const { return static_cast<uint32_t>(m_vecAcceptor.size()); }
+    Reactor *GetReactor(uint32_t uIndex) const { return m_vecAcceptor[uIndex].pReactor; }
+    const std::string &GetName() const;
 
 private:
-    int32_t m_iEpollFd{-1};
-    int32_t m_iListenFd{-1};
+    bool GetListenAddress(struct sockaddr_in &addr);
+    int32_t OpenSocket();
+    int32_t OpenLocalSocket();
+    UdpSocket *OpenDatagram();
+    int32_t OpenReserveFd();
+
+private:
+    bool m_bReusePort{false};
+    bool m_bDatagram{false};
+    bool m_bLocal{false}; // 共享内存引擎，在抽象命名空间的Unix域套接字上接受本机连接
+    std::vector<Acceptor> m_vecAcceptor;
     ICallback *m_pCallback{nullptr};
+    NetEngineImpl *m_pNetEngine{nullptr};
+    ConnectionOptions m_options;
 
     std::string m_strListenerName;
     std::string m_strListenerIP;
     uint16_t m_uListenerPort{0};
-    
+
     logger::ILogger *m_pLogger{nullptr};
-    utilities::IConfig *m_pConfig{nullptr};
 };
 
 }
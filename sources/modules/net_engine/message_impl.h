@@ -2,14 +2,87 @@
 #define __LITE_DRIVE_NET_ENGINE_MESSAGE_IMPL_H__
 
 #include <net_engine.h>
+#include <atomic>
 
 namespace lite_drive
 {
 namespace net_engine
 {
 
+class MessagePool;
+
+/**
+ * @brief 消息缓冲区，位于从IMemory分配的内存块头部，数据区紧随块头之后
+ * @note 引用计数，多个消息可以引用同一缓冲区的不同片段，最后一个消息释放时整块归还
+ */
+struct MessageBuffer
+{
+    std::atomic<uint32_t> uRefs{1}; // 引用该缓冲区的消息数
+    uint32_t uCapacity{0};          // 数据区容量，包括头部预留和尾部余量
+    MessagePool *pPool{nullptr};    // 所属的消息池
+};
+
 struct MessageImpl : public IMessage
 {
+    MessageBuffer *pBuffer{nullptr}; // 数据所在的缓冲区
+    uint8_t *pBegin{nullptr};        // 缓冲区数据区的起始位置
+    bool bEmbedded{false};           // 消息与缓冲区在同一内存块中，随缓冲区一起释放
+
+    /**
+     * @brief 获取数据前可用于扩展的字节数
+     * @return 字节数
+     */
+    uint32_t GetHeadroom() const { return static_cast<uint32_t>(pData - pBegin); }
+
+    /**
+     * @brief 获取数据后可用于扩展的字节数
+     * @return 字节数
+     */
+    uint32_t GetTailroom() const { return pBuffer->uCapacity - GetHeadroom() - uLength; }
+
+    /**
+     * @brief 缓冲区是否被多个消息引用，被引用时不能扩展，否则会改写其他消息的数据
+     * @return 是否共享
+     */
+    bool IsShared() const { return pBuffer->uRefs.load(std::memory_order_acquire) > 1; }
+
+    /**
+     * @brief 向前扩展数据，使用头部预留空间，不拷贝
+     * @param uBytes 扩展的字节数
+     * @return 扩展后的数据起始位置，空间不足或缓冲区被共享时返回NULL
+     */
+    uint8_t *Prepend(uint32_t uBytes)
+    {
+        if (IsShared() || GetHeadroom() < uBytes)
+        {
+            return nullptr;
+        }
+        pData -= uBytes;
+        uLength += uBytes;
+        return pData;
+    }
+
+    /**
+     * @brief 向后扩展数据，使用尾部余量，不拷贝
+     * @param uBytes 扩展的字节数
+     * @return 扩展部分的起始位置，空间不足或缓冲区被共享时返回NULL
+     */
+    uint8_t *Append(uint32_t uBytes)
+    {
+        if (IsShared() || GetTailroom() < uBytes)
+        {
+            return nullptr;
+        }
+        uint8_t *pTail = pData + uLength;
+        uLength += uBytes;
+        return pTail;
+    }
+
+    /**
+     * @brief 释放消息，缓冲区在最后一个引用释放时归还，线程安全
+     * @param pMessage 消息指针，必须由MessagePool创建
+     */
+    static void Destroy(IMessage *pMessage);
 };
 
 }
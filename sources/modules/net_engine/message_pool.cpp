@@ -0,0 +1,97 @@
+#include "message_pool.h"
+#include <new>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+static_assert(sizeof(MessageBuffer) + sizeof(MessageImpl) <= MessagePool::kBlockHeaderBytes, "message block header overflow");
+
+void MessageImpl::Destroy(IMessage *pMessage)
+{
+    if (pMessage != nullptr)
+    {
+        MessageImpl *pImpl = static_cast<MessageImpl *>(pMessage);
+        pImpl->pBuffer->pPool->Release(pImpl);
+    }
+}
+
+void MessagePool::Init(utilities::IMemory *pMemory)
+{
+    m_pMemory = pMemory;
+}
+
+void MessagePool::Exit()
+{
+    m_pMemory = nullptr;
+}
+
+MessageImpl *MessagePool::New(uint32_t uLength, uint32_t uHeadroom)
+{
+    uint64_t uBytes = static_cast<uint64_t>(kBlockHeaderBytes) + uHeadroom + uLength;
+    uBytes = (uBytes + kBlockAlignBytes - 1) / kBlockAlignBytes * kBlockAlignBytes;
+    if (m_pMemory == nullptr || uBytes > UINT32_MAX)
+    {
+        return nullptr;
+    }
+
+    uint8_t *pBlock = static_cast<uint8_t *>(m_pMemory->New(static_cast<uint32_t>(uBytes), utilities::MemoryTag::kNetEngine));
+    if (pBlock == nullptr)
+    {
+        return nullptr;
+    }
+
+    MessageBuffer *pBuffer = new(pBlock) MessageBuffer();
+    pBuffer->uCapacity = static_cast<uint32_t>(uBytes - kBlockHeaderBytes);
+    pBuffer->pPool = this;
+
+    MessageImpl *pMessage = new(pBlock + sizeof(MessageBuffer)) MessageImpl();
+    pMessage->pBuffer = pBuffer;
+    pMessage->pBegin = pBlock + kBlockHeaderBytes;
+    pMessage->bEmbedded = true;
+    pMessage->pData = pMessage->pBegin + uHeadroom;
+    pMessage->uLength = uLength;
+    return pMessage;
+}
+
+MessageImpl *MessagePool::Slice(const MessageImpl *pMessage, uint32_t uOffset, uint32_t uLength)
+{
+    if (pMessage == nullptr || uOffset > pMessage->uLength || uLength > pMessage->uLength - uOffset)
+    {
+        return nullptr;
+    }
+
+    void *pMem = m_pMemory->New(sizeof(MessageImpl), utilities::MemoryTag::kNetEngine);
+    if (pMem == nullptr)
+    {
+        return nullptr;
+    }
+
+    MessageImpl *pSlice = new(pMem) MessageImpl();
+    pSlice->pBuffer = pMessage->pBuffer;
+    pSlice->pBegin = pMessage->pBegin;
+    pSlice->pData = pMessage->pData + uOffset;
+    pSlice->uLength = uLength;
+    pSlice->pBuffer->uRefs.fetch_add(1, std::memory_order_relaxed);
+    return pSlice;
+}
+
+void MessagePool::Release(MessageImpl *pMessage)
+{
+    MessageBuffer *pBuffer = pMessage->pBuffer;
+    if (!pMessage->bEmbedded)
+    {
+        pMessage->~MessageImpl();
+        m_pMemory->Delete(pMessage);
+    }
+
+    // 内嵌的消息随缓冲区一起归还，其他消息可能仍在读取缓冲区，最后一个引用释放时才归还
+    if (pBuffer->uRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        m_pMemory->Delete(pBuffer);
+    }
+}
+
+}
+}
@@ -0,0 +1,69 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_MESSAGE_POOL_H__
+#define __LITE_DRIVE_NET_ENGINE_MESSAGE_POOL_H__
+
+#include "message_impl.h"
+#include <memory.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 消息池，消息缓冲区从IMemory分配，由其按线程缓存的大小级别复用
+ * @note 新建的消息与缓冲区在同一内存块中，一次分配；切片只分配消息本身并增加缓冲区的引用，
+ *       同一份数据可以同时发给多个连接而不拷贝。线程安全，消息可以在任意线程释放
+ */
+class MessagePool
+{
+public:
+    static constexpr uint32_t kBlockHeaderBytes = 64; // 内存块中缓冲区和内嵌消息占用的字节数，数据区从其后开始
+    static constexpr uint32_t kBlockAlignBytes = 64;  // 内存块大小的对齐粒度，多出的部分作为尾部余量
+
+    MessagePool() = default;
+    ~MessagePool() = default;
+
+    MessagePool(const MessagePool &) = delete;
+    MessagePool &operator=(const MessagePool &) = delete;
+
+    /**
+     * @brief 初始化消息池
+     * @param pMemory 内存对象，需在所有消息释放后才能退出
+     */
+    void Init(utilities::IMemory *pMemory);
+
+    /**
+     * @brief 退出消息池，调用前所有消息必须已释放
+     */
+    void Exit();
+
+    /**
+     * @brief 创建消息
+     * @param uLength 消息长度
+     * @param uHeadroom 数据前预留的字节数，用于之后不拷贝地写入头部
+     * @return 消息指针，失败返回NULL
+     */
+    MessageImpl *New(uint32_t uLength, uint32_t uHeadroom);
+
+    /**
+     * @brief 创建引用已有消息一段数据的新消息，不拷贝数据
+     * @param pMessage 已有消息
+     * @param uOffset 片段在已有消息数据中的偏移
+     * @param uLength 片段长度
+     * @return 消息指针，片段越界或内存不足返回NULL
+     */
+    MessageImpl *Slice(const MessageImpl *pMessage, uint32_t uOffset, uint32_t uLength);
+
+    /**
+     * @brief 释放消息，最后一个引用释放时归还缓冲区
+     * @param pMessage 消息指针
+     */
+    void Release(MessageImpl *pMessage);
+
+private:
+    utilities::IMemory *m_pMemory{nullptr};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_MESSAGE_POOL_H__
@@ -0,0 +1,87 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_MPSC_QUEUE_H__
+#define __LITE_DRIVE_NET_ENGINE_MPSC_QUEUE_H__
+
+#include <atomic>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 侵入式无锁多生产者单消费者队列，节点类型须有成员T *pNext
+ * @note 生产者只向头部压入，消费者一次取走全部节点，不存在ABA问题；
+ *       入队返回队列原先是否为空，生产者据此只在由空变为非空时通知消费者
+ */
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    /**
+     * @brief 追加一串节点，线程安全
+     * @param pFirst 第一个节点，节点间已用pNext按顺序链接
+     * @param pLast 最后一个节点
+     * @return 追加前队列是否为空
+     */
+    bool Push(T *pFirst, T *pLast)
+    {
+        // 队列内按入队的逆序链接，先把这串节点反转，出队时整体再反转回来
+        T *pPrev = nullptr;
+        T *pNode = pFirst;
+        while (pPrev != pLast)
+        {
+            T *pNext = pNode->pNext;
+            pNode->pNext = pPrev;
+            pPrev = pNode;
+            pNode = pNext;
+        }
+
+        T *pHead = m_pHead.load(std::memory_order_relaxed);
+        do
+        {
+            pFirst->pNext = pHead;
+        } while (!m_pHead.compare_exchange_weak(pHead, pLast, std::memory_order_release, std::memory_order_relaxed));
+        return pHead == nullptr;
+    }
+
+    /**
+     * @brief 追加一个节点，线程安全
+     * @param pNode 节点
+     * @return 追加前队列是否为空
+     */
+    bool Push(T *pNode)
+    {
+        return Push(pNode, pNode);
+    }
+
+    /**
+     * @brief 取出全部节点，仅消费者线程调用
+     * @return 按入队顺序用pNext链接的节点，队列为空返回NULL
+     */
+    T *PopAll()
+    {
+        T *pNode = m_pHead.exchange(nullptr, std::memory_order_acquire);
+        T *pPrev = nullptr;
+        while (pNode != nullptr)
+        {
+            T *pNext = pNode->pNext;
+            pNode->pNext = pPrev;
+            pPrev = pNode;
+            pNode = pNext;
+        }
+        return pPrev;
+    }
+
+    bool Empty() const { return m_pHead.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    std::atomic<T *> m_pHead{nullptr}; // 最近入队的节点
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_MPSC_QUEUE_H__
@@ -1,16 +1,76 @@
 #include "net_engine_impl.h"
+#include "epoll_reactor.h"
+#include "uring_reactor.h"
+#include "udp_socket.h"
 #include <new>
 #include <memory>
+#include <chrono>
+#include <cerrno>
 #include <error_code.h>
+#include <future>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <json/writer.h>
 
 namespace lite_drive
 {
 namespace net_engine
 {
 
-INetEngine* INetEngine::Create(logger::ILogger *pLogger)
+namespace
 {
-    return new(std::nothrow) NetEngineImpl(pLogger);
+
+bool ParseNetEngineType(const std::string &strType, NetEngineType &eType)
+{
+    if (strType == "tcp")
+    {
+        eType = NetEngineType::kTcp;
+        return true;
+    }
+    if (strType == "tcp_uring")
+    {
+        eType = NetEngineType::kTcpUring;
+        return true;
+    }
+    if (strType == "udp")
+    {
+        eType = NetEngineType::kUdp;
+        return true;
+    }
+    if (strType == "shm")
+    {
+        eType = NetEngineType::kShm;
+        return true;
+    }
+    return false;
+}
+
+const char *NetEngineTypeName(NetEngineType eType)
+{
+    switch (eType)
+    {
+    case NetEngineType::kTcpUring:
+        return "tcp_uring";
+    case NetEngineType::kUdp:
+        return "udp";
+    case NetEngineType::kShm:
+        return "shm";
+    default:
+        return "tcp";
+    }
+}
+
+uint64_t NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+INetEngine* INetEngine::Create(logger::ILogger *pLogger, utilities::IMemory *pMemory)
+{
+    return new(std::nothrow) NetEngineImpl(pLogger, pMemory);
 }
 
 void INetEngine::Destroy(INetEngine *pNetEngine)
@@ -21,7 +81,7 @@ void INetEngine::Destroy(INetEngine *pNetEngine)
     }
 }
 
-NetEngineImpl::NetEngineImpl(logger::ILogger *pLogger) : m_pLogger(pLogger)
+NetEngineImpl::NetEngineImpl(logger::ILogger *pLogger, utilities::IMemory *pMemory) : m_pLogger(pLogger), m_pExternalMemory(pMemory)
 {
 }
 
@@ -43,32 +103,179 @@ int32_t NetEngineImpl::Init(utilities::IConfig *pConfig, ICallback *pGlobalCallb
     if (m_pConfig == nullptr || m_pConfig->Copy(pConfig) != ErrorCode::kSuccess)
     {
         LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to copy config");
+        ReleaseConfig();
         return ErrorCode::kNoMemory;
     }
 
+    m_pMemory = m_pExternalMemory;
+    if (m_pMemory == nullptr)
+    {
+        m_pMemory = utilities::IMemory::Create();
+        if (m_pMemory == nullptr || m_pMemory->Init(m_pConfig) != ErrorCode::kSuccess)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create message memory");
+            ReleaseMemory();
+            ReleaseConfig();
+            return ErrorCode::kNoMemory;
+        }
+    }
+    m_messagePool.Init(m_pMemory);
+
+    // 之后任一步失败都释放自行创建的内存对象和配置副本，重新初始化时不会泄漏
+    int32_t iRet = InitComponents();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        m_messagePool.Exit();
+        ReleaseMemory();
+        ReleaseConfig();
+        return iRet;
+    }
+    m_pGlobalCallback = pGlobalCallback;
+    return ErrorCode::kSuccess;
+}
+
+int32_t NetEngineImpl::InitComponents()
+{
     try
     {
         m_strNetEngineName = m_pConfig->GetStr(config::kSection, config::kNetEngineName, default_value::kNetEngineName);
+        std::string strType = m_pConfig->GetStr(config::kSection, config::kNetEngineType, default_value::kNetEngineType);
+        if (!ParseNetEngineType(strType, m_eType))
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} unsupported net engine type: {}", m_strNetEngineName.c_str(), strType.c_str());
+            return ErrorCode::kInvalidParam;
+        }
+
+        int64_t iHighWatermark = m_pConfig->GetInt64(config::kSection, config::kEngineSendHighWatermarkBytes, default_value::kEngineSendHighWatermarkBytes);
+        int64_t iLowWatermark = m_pConfig->GetInt64(config::kSection, config::kEngineSendLowWatermarkBytes, default_value::kEngineSendLowWatermarkBytes);
+        m_uSendHighWatermarkBytes = static_cast<uint64_t>(std::max<int64_t>(iHighWatermark, 0));
+        m_uSendLowWatermarkBytes = static_cast<uint64_t>(std::max<int64_t>(iLowWatermark, 0));
+        if (m_uSendLowWatermarkBytes == 0 || m_uSendLowWatermarkBytes > m_uSendHighWatermarkBytes)
+        {
+            m_uSendLowWatermarkBytes = m_uSendHighWatermarkBytes / 2;
+        }
+
+        uint32_t uMaxConnections = m_pConfig->GetInt32(config::kSection, config::kMaxConnections, default_value::kMaxConnections);
+        if (m_connectionTable.Init(uMaxConnections) != ErrorCode::kSuccess)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create connection table, max connections: {}",
+                m_strNetEngineName.c_str(), Wrap(uMaxConnections));
+            return ErrorCode::kNoMemory;
+        }
+
+        UringOptions uringOptions;
+        uringOptions.Load(m_pConfig);
         uint32_t uIOThreadCount = m_pConfig->GetInt32(config::kSection, config::kIOThreadCount, default_value::kIOThreadCount);
         uIOThreadCount = std::max(uIOThreadCount, 1u);
+        std::vector<ThreadPlacement> vecIOPlacement(uIOThreadCount);
+        if (LoadPlacement(vecIOPlacement) != ErrorCode::kSuccess)
+        {
+            return ErrorCode::kInvalidParam;
+        }
+        m_uBusyPollUs = m_pConfig->GetInt32(config::kSection, config::kBusyPollUs, default_value::kBusyPollUs);
+        m_uRebalanceIntervalMs = m_pConfig->GetInt32(config::kSection, config::kRebalanceIntervalMs, default_value::kRebalanceIntervalMs);
+        m_uRebalanceThresholdPercent = m_pConfig->GetInt32(config::kSection, config::kRebalanceThresholdPercent, default_value::kRebalanceThresholdPercent);
+
+        m_iManagerEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_iManagerEventFd < 0)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "{} failed to create manager eventfd, errno: {}", m_strNetEngineName.c_str(), Wrap(errno));
+            return ErrorCode::kEpollFailed;
+        }
+
         m_vecThIO.resize(uIOThreadCount);
-        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} io thread count: {}", m_strNetEngineName.c_str(), Wrap(uIOThreadCount));
+        m_vecReactor.reserve(uIOThreadCount);
+        for (uint32_t i = 0; i < uIOThreadCount; i++)
+        {
+            std::unique_ptr<Reactor> upReactor(NewReactor(i, uringOptions, vecIOPlacement[i]));
+            if (upReactor == nullptr && i == 0 && m_eType == NetEngineType::kTcpUring)
+            {
+                // 内核不支持io_uring或所需特性时退回epoll，接口行为不变
+                LOG_WARN(m_pLogger, ErrorCode::kUringFailed, "{} io_uring is unavailable, fall back to epoll", m_strNetEngineName.c_str());
+                m_eType = NetEngineType::kTcp;
+                upReactor.reset(NewReactor(i, uringOptions, vecIOPlacement[i]));
+            }
+
+            if (upReactor == nullptr)
+            {
+                LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create reactor {}", m_strNetEngineName.c_str(), Wrap(i));
+                return ErrorCode::kNoMemory;
+            }
+            m_vecReactor.push_back(upReactor.release());
+        }
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} type: {}, io thread count: {}", m_strNetEngineName.c_str(),
+            NetEngineTypeName(m_eType), Wrap(uIOThreadCount));
     }
     catch(const std::exception& e)
     {
         LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "falied to init net engine");
         return ErrorCode::kThrowException;
     }
-    m_pGlobalCallback = pGlobalCallback;
     return ErrorCode::kSuccess;
 }
 
 void NetEngineImpl::Exit()
 {
+    // 管理线程已停止，剩余的控制命令可能还要向IO线程投递任务，先于Reactor执行
+    RunManagerCommands();
+    if (m_iManagerEventFd >= 0)
+    {
+        close(m_iManagerEventFd);
+        m_iManagerEventFd = -1;
+    }
+
+    // IO线程已停止，由当前线程执行剩余任务并释放各Reactor持有的连接，
+    // 剩余任务中可能有监听套接字的注册，需在释放监听器之前执行
+    for (auto pReactor : m_vecReactor)
+    {
+        pReactor->Exit();
+    }
+
+    for (auto &item : m_umapListener)
+    {
+        item.second->Exit();
+        delete item.second;
+    }
+    m_umapListener.clear();
+
+    // 池中的连接已随Reactor释放，不会再有回调
+    for (auto &item : m_umapPool)
+    {
+        item.second->Exit();
+        delete item.second;
+    }
+    m_umapPool.clear();
+
+    for (auto pReactor : m_vecReactor)
+    {
+        delete pReactor;
+    }
+    m_vecReactor.clear();
+    m_connectionTable.Exit();
+
+    // 发送队列中的消息已随连接释放，使用方持有的消息需在退出前释放
+    m_messagePool.Exit();
+    ReleaseMemory();
+
     m_pLogger = nullptr;
     m_pGlobalCallback = nullptr;
     m_strNetEngineName.clear();
     m_vecThIO.clear();
+    ReleaseConfig();
+}
+
+void NetEngineImpl::ReleaseMemory()
+{
+    if (m_pMemory != nullptr && m_pMemory != m_pExternalMemory)
+    {
+        m_pMemory->Exit();
+        utilities::IMemory::Destroy(m_pMemory);
+    }
+    m_pMemory = nullptr;
+}
+
+void NetEngineImpl::ReleaseConfig()
+{
     if (m_pConfig != nullptr)
     {
         utilities::IConfig::Destroy(m_pConfig);
@@ -89,14 +296,16 @@ int32_t NetEngineImpl::Start()
     try
     {
         m_bRunning = true;
+        m_bManagerRunning = true;
         m_thManager = std::thread(&NetEngineImpl::ManagerWorker, this);
-        for (auto &thIO : m_vecThIO)
+        for (size_t i = 0; i < m_vecThIO.size(); i++)
         {
-            thIO = std::thread(&NetEngineImpl::IOWorker, this);
+            m_vecThIO[i] = std::thread(&NetEngineImpl::IOWorker, this, m_vecReactor[i]);
         }
     }
     catch(const std::exception& e)
     {
+        m_bManagerRunning = m_thManager.joinable();
         LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "falied to start net engine");
         return ErrorCode::kThrowException;
     }
@@ -115,10 +324,22 @@ void NetEngineImpl::Stop()
     LOG_EVENT(m_pLogger, ErrorCode::kEvent, "stop net engine: {}", m_strNetEngineName.c_str());
 
     m_bRunning = false;
-    m_thManager.join();
+    WakeupManager();
+    for (auto pReactor : m_vecReactor)
+    {
+        pReactor->Wakeup();
+    }
+
+    if (m_thManager.joinable())
+    {
+        m_thManager.join();
+    }
     for (auto &thIO : m_vecThIO)
     {
-        thIO.join();
+        if (thIO.joinable())
+        {
+            thIO.join();
+        }
     }
 }
 
@@ -131,8 +352,8 @@ ListenerHandler NetEngineImpl::CreateListener(utilities::IConfig *pConfig, ICall
         return listenerHandler;
     }
 
-    std::unique_ptr<ListenerImpl> upListener(new(std::nothrow) ListenerImpl(m_pLogger));
-    if (upListener == nullptr || upListener->Init(pConfig, pCallback) != ErrorCode::kSuccess)
+    std::unique_ptr<ListenerImpl> upListener(new(std::nothrow) ListenerImpl(m_pLogger, this));
+    if (upListener == nullptr || upListener->Init(pConfig, pCallback, static_cast<uint32_t>(m_vecReactor.size()), m_eType) != ErrorCode::kSuccess)
     {
         LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create listener");
         return listenerHandler;
@@ -141,12 +362,40 @@ ListenerHandler NetEngineImpl::CreateListener(utilities::IConfig *pConfig, ICall
     try
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        m_umapListener[listenerHandler.uID] = upListener.get();
         listenerHandler.uID = m_uNextListenerID++;
+        m_umapListener[listenerHandler.uID] = upListener.get();
     }
     catch(const std::exception& e)
     {
         LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "Failed to create listener");
+        listenerHandler.uID = 0;
+        return listenerHandler;
+    }
+
+    // 向IO线程注册由管理线程执行，与注销、连接迁移等控制操作串行，调用线程等待注册结果；
+    // reuse port模式下每个IO线程各自监听，否则只注册到一个IO线程
+    ListenerImpl *pListener = upListener.get();
+    int32_t iRet = CallManager([this, pListener]() {
+        for (uint32_t i = 0; i < pListener->GetAcceptorCount(); i++)
+        {
+            Reactor *pReactor = pListener->IsReusePort() ? m_vecReactor[i] : SelectReactor();
+            int32_t iResult = pListener->Register(i, pReactor);
+            if (iResult != ErrorCode::kSuccess)
+            {
+                return iResult;
+            }
+        }
+        return static_cast<int32_t>(ErrorCode::kSuccess);
+    });
+    if (iRet != ErrorCode::kSuccess)
+    {
+        LOG_ERROR(m_pLogger, iRet, "Failed to register listener");
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_umapListener.erase(listenerHandler.uID);
+        }
+        listenerHandler.uID = 0;
+        ReleaseListener(upListener.release());
         return listenerHandler;
     }
 
@@ -165,28 +414,36 @@ void NetEngineImpl::DestroyListener(ListenerHandler *pListenerHandler)
         return;
     }
 
-    auto it = m_umapListener.end();
+    ListenerImpl *pListener = nullptr;
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        it = m_umapListener.find(pListenerHandler->uID);
+        auto it = m_umapListener.find(pListenerHandler->uID);
         if (it == m_umapListener.end())
         {
             LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Listener not found");
             return;
         }
+        pListener = it->second;
         m_umapListener.erase(it);
     }
 
-    ListenerImpl *pListener = it->second;
-
     LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Destroy listener name: {}, id: {}", 
         pListener->GetName().c_str(), Wrap(pListenerHandler->uID));
 
-    pListener->Exit();
+    // 注销交给管理线程，调用线程不等待IO线程关闭监听套接字
+    if (!PostManager([this, pListener]() { ReleaseListener(pListener); }))
+    {
+        ReleaseListener(pListener);
+    }
     pListenerHandler->uID = 0;
     pListenerHandler->pHandler = nullptr;
 }
 ConnectionHandler NetEngineImpl::CreateConnection(utilities::IConfig *pConfig, ICallback *pCallback)
+{
+    return NewConnection(pConfig, pCallback, true);
+}
+
+ConnectionHandler NetEngineImpl::NewConnection(utilities::IConfig *pConfig, ICallback *pCallback, bool bConnect)
 {
     ConnectionHandler connectionHandler = {0, nullptr};
     if (pConfig == nullptr || pCallback == nullptr)
@@ -202,22 +459,26 @@ ConnectionHandler NetEngineImpl::CreateConnection(utilities::IConfig *pConfig, I
         return connectionHandler;
     }
 
-    try
+    Reactor *pReactor = SelectReactor();
+    connectionHandler.uID = m_connectionTable.Insert(upConnection.get(), pReactor->GetIndex());
+    if (connectionHandler.uID == 0)
     {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_umapConnection[connectionHandler.uID] = upConnection.get();
-        connectionHandler.uID = m_uNextConnectionID++;
-    }
-    catch(const std::exception& e)
-    {
-        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "Failed to create connection");
+        LOG_ERROR(m_pLogger, ErrorCode::kTooManyConnections, "Failed to create connection, max connections: {}", Wrap(m_connectionTable.GetCapacity()));
         return connectionHandler;
     }
 
     LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Create connection name: {}, id: {}", 
         upConnection->GetName().c_str(), Wrap(connectionHandler.uID));
 
-    connectionHandler.pHandler = upConnection.release();
+    ConnectionImpl *pConnection = upConnection.release();
+    pConnection->Bind(connectionHandler.uID, pReactor);
+    pReactor->Attach(pConnection);
+    if (bConnect)
+    {
+        pConnection->Connect(pConnection->GetRemoteIP(), pConnection->GetRemotePort());
+    }
+
+    connectionHandler.pHandler = pConnection;
     return connectionHandler;
 }
 
@@ -229,50 +490,670 @@ void NetEngineImpl::DestroyConnection(ConnectionHandler *pConnHandler)
         return;
     }
 
-    auto it = m_umapConnection.end();
+    Reactor *pReactor = GetReactor(pConnHandler->uID);
+    if (pReactor == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Connection not found");
+        return;
+    }
+
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Destroy connection id: {}", Wrap(pConnHandler->uID));
+
+    // 句柄可能就是回调传入的连接内部句柄，先清空再交给IO线程释放，之后不能再访问句柄
+    uint64_t uID = pConnHandler->uID;
+    pConnHandler->uID = 0;
+    pConnHandler->pHandler = nullptr;
+
+    // 连接归属的IO线程负责查找、关闭和释放，不能解引用句柄指针
+    pReactor->Detach(uID);
+}
+
+ConnectionPoolHandler NetEngineImpl::CreateConnectionPool(utilities::IConfig *pConfig, ICallback *pCallback)
+{
+    ConnectionPoolHandler poolHandler = {0, nullptr};
+    if (pConfig == nullptr || pCallback == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid parameters");
+        return poolHandler;
+    }
+
+    ConnectionPoolImpl *pPool = new(std::nothrow) ConnectionPoolImpl(m_pLogger, this);
+    if (pPool == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create connection pool");
+        return poolHandler;
+    }
+
+    // 初始化失败时已创建的连接同样交给IO线程释放
+    if (pPool->Init(pConfig, pCallback) != ErrorCode::kSuccess)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create connection pool");
+        ReleaseConnectionPool(pPool);
+        return poolHandler;
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        poolHandler.uID = m_uNextPoolID++;
+        m_umapPool[poolHandler.uID] = pPool;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "Failed to create connection pool");
+        ReleaseConnectionPool(pPool);
+        poolHandler.uID = 0;
+        return poolHandler;
+    }
+
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Create connection pool name: {}, id: {}, size: {}",
+        pPool->GetName().c_str(), Wrap(poolHandler.uID), Wrap(pPool->GetSize()));
+    PostManager([this]() { ScheduleMaintain(); });
+    poolHandler.pHandler = pPool;
+    return poolHandler;
+}
+
+void NetEngineImpl::DestroyConnectionPool(ConnectionPoolHandler *pPoolHandler)
+{
+    if (pPoolHandler == nullptr || pPoolHandler->pHandler == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Invalid connection pool handler");
+        return;
+    }
+
+    // 从表中移除后管理线程不会再维护该连接池，之后才能释放其连接
+    ConnectionPoolImpl *pPool = nullptr;
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        it = m_umapConnection.find(pConnHandler->uID);
-        if (it == m_umapConnection.end())
+        auto it = m_umapPool.find(pPoolHandler->uID);
+        if (it == m_umapPool.end())
         {
-            LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Connection not found");
+            LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "Connection pool not found");
             return;
         }
-        m_umapConnection.erase(it);
+        pPool = it->second;
+        m_umapPool.erase(it);
     }
 
-    ConnectionImpl *pConnection = it->second;
-
-    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Destroy connection name: {}, id: {}", 
-        pConnection->GetName().c_str(), Wrap(pConnHandler->uID));
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Destroy connection pool name: {}, id: {}",
+        pPool->GetName().c_str(), Wrap(pPoolHandler->uID));
 
-    pConnection->Exit();
-    pConnHandler->uID = 0;
-    pConnHandler->pHandler = nullptr;
+    // 管理线程可能正在锁外维护该连接池，等本轮维护结束后再释放
+    {
+        std::lock_guard<std::mutex> maintainLock(m_maintainMutex);
+    }
+    ReleaseConnectionPool(pPool);
+    pPoolHandler->uID = 0;
+    pPoolHandler->pHandler = nullptr;
 }
 
 int32_t NetEngineImpl::GetStats(std::string &strStats) const
 {
     strStats.clear();
+    try
+    {
+        // 各IO线程的计数器只由自己写入，这里逐个无锁读取后汇总，不阻塞IO线程
+        Json::Value jsonStats(Json::objectValue);
+        jsonStats["name"] = m_strNetEngineName;
+        jsonStats["type"] = NetEngineTypeName(m_eType);
+        jsonStats["io_thread_count"] = Json::UInt(m_vecReactor.size());
+        jsonStats["send_queued_bytes"] = Json::UInt64(m_uSendQueuedBytes.load(std::memory_order_relaxed));
+
+        Json::Value jsonTotal(Json::objectValue);
+        Json::Value jsonReactors(Json::arrayValue);
+        uint64_t arrCallCount[LatencyHistogram::kBucketCount] = {};
+        uint64_t arrHandlerCount[LatencyHistogram::kBucketCount] = {};
+        uint64_t uCallSum = 0;
+        uint64_t uCallMax = 0;
+        uint64_t uHandlerSum = 0;
+        uint64_t uHandlerMax = 0;
+        for (const Reactor *pReactor : m_vecReactor)
+        {
+            const ReactorStats &stats = pReactor->GetStats();
+            Json::Value jsonReactor(Json::objectValue);
+            jsonReactor["index"] = pReactor->GetIndex();
+            jsonReactor["cpu"] = pReactor->GetPlacement().GetCpu();
+            jsonReactor["numa_node"] = pReactor->GetPlacement().GetNumaNode();
+            stats.RenderCounters(jsonReactor["counters"]);
+            for (const auto &strKey : jsonReactor["counters"].getMemberNames())
+            {
+                jsonTotal[strKey] = Json::UInt64(jsonTotal[strKey].asUInt64() + jsonReactor["counters"][strKey].asUInt64());
+            }
+            stats.callLatency.Accumulate(arrCallCount, uCallSum, uCallMax);
+            stats.handlerLatency.Accumulate(arrHandlerCount, uHandlerSum, uHandlerMax);
+            jsonReactors.append(jsonReactor);
+        }
+
+        jsonStats["total"] = jsonTotal;
+        LatencyHistogram::Render(arrCallCount, uCallSum, uCallMax, jsonStats["call_latency_ns"]);
+        LatencyHistogram::Render(arrHandlerCount, uHandlerSum, uHandlerMax, jsonStats["handler_latency_ns"]);
+        jsonStats["reactors"] = jsonReactors;
+
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        strStats = Json::writeString(builder, jsonStats);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to render stats", m_strNetEngineName.c_str());
+        strStats.clear();
+        return ErrorCode::kThrowException;
+    }
+    return ErrorCode::kSuccess;
+}
+
+void NetEngineImpl::OnAccepted(int32_t iFd, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName, Reactor *pOwner)
+{
+    std::unique_ptr<ConnectionImpl> upConnection(new(std::nothrow) ConnectionImpl(m_pLogger));
+    if (upConnection == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create accepted connection");
+        close(iFd);
+        return;
+    }
+
+    if (upConnection->InitAccepted(iFd, options, pCallback, strName) != ErrorCode::kSuccess)
+    {
+        return;
+    }
+
+    Reactor *pReactor = pOwner != nullptr ? pOwner : SelectReactor();
+    uint64_t uID = m_connectionTable.Insert(upConnection.get(), pReactor->GetIndex());
+    if (uID == 0)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kTooManyConnections, "{} reject connection, max connections: {}", strName.c_str(), Wrap(m_connectionTable.GetCapacity()));
+        return;
+    }
+
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Accept connection name: {}, id: {}, remote: {}:{}",
+        strName.c_str(), Wrap(uID), upConnection->GetRemoteIP(), Wrap(upConnection->GetRemotePort()));
+
+    ConnectionImpl *pConnection = upConnection.release();
+    pConnection->Bind(uID, pReactor);
+    if (pOwner != nullptr)
+    {
+        pReactor->AttachInLoop(pConnection);
+    }
+    else
+    {
+        pReactor->Attach(pConnection);
+    }
+}
+
+ConnectionImpl *NetEngineImpl::OnAcceptedDatagram(UdpSocket *pSocket, const struct sockaddr_in &addr, const ConnectionOptions &options,
+    ICallback *pCallback, const std::string &strName)
+{
+    std::unique_ptr<ConnectionImpl> upConnection(new(std::nothrow) ConnectionImpl(m_pLogger));
+    if (upConnection == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "Failed to create accepted connection");
+        return nullptr;
+    }
+
+    if (upConnection->InitDatagram(pSocket, addr, options, pCallback, strName) != ErrorCode::kSuccess)
+    {
+        return nullptr;
+    }
+
+    // 连接与套接字属于同一个IO线程，数据报直接分发不跨线程
+    Reactor *pReactor = pSocket->GetReactor();
+    uint64_t uID = m_connectionTable.Insert(upConnection.get(), pReactor->GetIndex());
+    if (uID == 0)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kTooManyConnections, "{} reject udp peer, max connections: {}", strName.c_str(), Wrap(m_connectionTable.GetCapacity()));
+        return nullptr;
+    }
+
+    LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Accept connection name: {}, id: {}, remote: {}:{}",
+        strName.c_str(), Wrap(uID), upConnection->GetRemoteIP(), Wrap(upConnection->GetRemotePort()));
+
+    ConnectionImpl *pConnection = upConnection.release();
+    pConnection->Bind(uID, pReactor);
+    pReactor->AttachInLoop(pConnection);
+
+    // 挂载失败时连接已被回收或关闭
+    pConnection = pReactor->FindConnection(uID);
+    return pConnection != nullptr && pConnection->IsConnected() ? pConnection : nullptr;
+}
+
+void NetEngineImpl::ReleaseListener(ListenerImpl *pListener)
+{
+    // 监听套接字可能正在IO线程中处理事件，交由各自的IO线程注销，最后一个完成的线程负责释放
+    uint32_t uCount = pListener->GetAcceptorCount();
+    std::vector<Reactor *> vecReactor(uCount, nullptr);
+    for (uint32_t i = 0; i < uCount; i++)
+    {
+        vecReactor[i] = pListener->GetReactor(i);
+    }
+
+    auto spPending = std::make_shared<std::atomic<uint32_t>>(uCount);
+    for (uint32_t i = 0; i < uCount; i++)
+    {
+        auto release = [pListener, i, spPending]() {
+            pListener->CloseAcceptor(i);
+            if (--*spPending == 0)
+            {
+                delete pListener;
+            }
+        };
+
+        if (vecReactor[i] == nullptr)
+        {
+            release();
+        }
+        else
+        {
+            vecReactor[i]->Post(release);
+        }
+    }
+}
+
+int32_t NetEngineImpl::LoadPlacement(std::vector<ThreadPlacement> &vecIOPlacement)
+{
+    std::string strCpus = m_pConfig->GetStr(config::kSection, config::kIOThreadCpus, default_value::kIOThreadCpus);
+    std::vector<int32_t> vecCpu;
+    if (!ThreadPlacement::ParseCpuList(strCpus, vecCpu))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} invalid io thread cpus: {}", m_strNetEngineName.c_str(), strCpus.c_str());
+        return ErrorCode::kInvalidParam;
+    }
+
+    bool bNumaLocal = m_pConfig->GetBool(config::kSection, config::kNumaLocalAlloc, default_value::kNumaLocalAlloc);
+    for (size_t i = 0; i < vecIOPlacement.size() && !vecCpu.empty(); i++)
+    {
+        vecIOPlacement[i].Set(vecCpu[i % vecCpu.size()], bNumaLocal);
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} io thread {} bind to cpu {}, numa node {}", m_strNetEngineName.c_str(),
+            Wrap(static_cast<uint32_t>(i)), Wrap(vecIOPlacement[i].GetCpu()), Wrap(vecIOPlacement[i].GetNumaNode()));
+    }
+
+    strCpus = m_pConfig->GetStr(config::kSection, config::kManagerThreadCpu, default_value::kManagerThreadCpu);
+    if (!ThreadPlacement::ParseCpuList(strCpus, vecCpu))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kInvalidParam, "{} invalid manager thread cpu: {}", m_strNetEngineName.c_str(), strCpus.c_str());
+        return ErrorCode::kInvalidParam;
+    }
+    m_managerPlacement.Set(vecCpu.empty() ? -1 : vecCpu.front(), bNumaLocal);
     return ErrorCode::kSuccess;
 }
 
+Reactor *NetEngineImpl::NewReactor(uint32_t uIndex, const UringOptions &uringOptions, const ThreadPlacement &placement)
+{
+    std::unique_ptr<Reactor> upReactor;
+    if (m_eType == NetEngineType::kTcpUring)
+    {
+        upReactor.reset(new(std::nothrow) UringReactor(m_pLogger, this, uIndex, uringOptions));
+    }
+    else
+    {
+        upReactor.reset(new(std::nothrow) EpollReactor(m_pLogger, this, uIndex));
+    }
+
+    if (upReactor == nullptr)
+    {
+        return nullptr;
+    }
+
+    upReactor->SetPlacement(placement);
+    if (upReactor->Init() != ErrorCode::kSuccess)
+    {
+        return nullptr;
+    }
+    return upReactor.release();
+}
+
+bool NetEngineImpl::ReserveSend(uint64_t uBytes)
+{
+    if (m_uSendHighWatermarkBytes == 0)
+    {
+        return true;
+    }
+
+    // 与连接的水位相同，先设置标志再复查，释放方先扣减再检查标志
+    if (m_uSendQueuedBytes.load() >= m_uSendHighWatermarkBytes)
+    {
+        m_bSendBlocked.store(true);
+        if (m_uSendQueuedBytes.load() > m_uSendLowWatermarkBytes)
+        {
+            return false;
+        }
+    }
+    m_uSendQueuedBytes.fetch_add(uBytes);
+    return true;
+}
+
+void NetEngineImpl::ChargeSend(uint64_t uBytes)
+{
+    if (m_uSendHighWatermarkBytes == 0)
+    {
+        return;
+    }
+    m_uSendQueuedBytes.fetch_add(uBytes);
+}
+
+void NetEngineImpl::ReleaseSend(uint64_t uBytes)
+{
+    if (m_uSendHighWatermarkBytes == 0)
+    {
+        return;
+    }
+
+    uint64_t uQueued = m_uSendQueuedBytes.fetch_sub(uBytes) - uBytes;
+    if (uQueued > m_uSendLowWatermarkBytes || !m_bSendBlocked.load() || !m_bSendBlocked.exchange(false) || !m_bRunning)
+    {
+        return;
+    }
+
+    // 被拒绝的连接可能没有待发送数据，不会再有发送完成触发检查，由各IO线程遍历自己的连接
+    for (auto pReactor : m_vecReactor)
+    {
+        try
+        {
+            pReactor->Post([pReactor]() { pReactor->NotifySendDrained(); });
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to post send drained notification", m_strNetEngineName.c_str());
+        }
+    }
+}
+
+void NetEngineImpl::ReleaseConnectionPool(ConnectionPoolImpl *pPool)
+{
+    // 连接关闭时仍会回调连接池，每个连接在其当前所属的IO线程中释放后计数，连接可能已被迁移，
+    // 最后一个完成的连接负责删除连接池
+    uint32_t uCount = pPool->GetSize();
+    if (uCount == 0)
+    {
+        delete pPool;
+        return;
+    }
+
+    auto spPending = std::make_shared<std::atomic<uint32_t>>(uCount);
+    for (uint32_t i = 0; i < uCount; i++)
+    {
+        auto release = [pPool, spPending]() {
+            if (--*spPending == 0)
+            {
+                delete pPool;
+            }
+        };
+
+        uint64_t uConnectionID = pPool->GetConnectionID(i);
+        Reactor *pReactor = GetReactor(uConnectionID);
+        if (pReactor == nullptr)
+        {
+            release();
+            continue;
+        }
+        pReactor->Detach(uConnectionID, release);
+    }
+}
+
+bool NetEngineImpl::MaintainConnectionPools()
+{
+    // 只在锁内取出连接池列表，维护时不持有m_mutex，不阻塞创建、销毁监听器和连接池。
+    // 销毁连接池时要先获取m_maintainMutex才释放，本轮维护中的连接池不会被删除
+    std::lock_guard<std::mutex> maintainLock(m_maintainMutex);
+    std::vector<ConnectionPoolImpl *> vecPool;
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        vecPool.reserve(m_umapPool.size());
+        for (auto &item : m_umapPool)
+        {
+            vecPool.push_back(item.second);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to collect connection pools: {}",
+            m_strNetEngineName.c_str(), e.what());
+        return true;
+    }
+
+    uint64_t uNowMs = Reactor::NowMs();
+    for (auto pPool : vecPool)
+    {
+        pPool->Maintain(uNowMs);
+    }
+    return !vecPool.empty();
+}
+
+void NetEngineImpl::ScheduleMaintain()
+{
+    if (m_uNextMaintainMs == 0)
+    {
+        m_uNextMaintainMs = Reactor::NowMs() + kManagerIntervalMs;
+    }
+}
+
+void NetEngineImpl::RebalanceReactors()
+{
+    // 只读取各IO线程的单写者计数器，取上个周期负载最高和最低的线程
+    Reactor *pHottest = nullptr;
+    Reactor *pColdest = nullptr;
+    uint64_t uHottestLoad = 0;
+    uint64_t uColdestLoad = UINT64_MAX;
+    uint64_t uTotalLoad = 0;
+    for (size_t i = 0; i < m_vecReactor.size(); i++)
+    {
+        uint64_t uLoad = m_vecReactor[i]->GetLoad();
+        uint64_t uDelta = uLoad - m_vecReactorLoad[i];
+        m_vecReactorLoad[i] = uLoad;
+        uTotalLoad += uDelta;
+        if (pHottest == nullptr || uDelta > uHottestLoad)
+        {
+            pHottest = m_vecReactor[i];
+            uHottestLoad = uDelta;
+        }
+        if (pColdest == nullptr || uDelta < uColdestLoad)
+        {
+            pColdest = m_vecReactor[i];
+            uColdestLoad = uDelta;
+        }
+    }
+
+    // 负载按纳秒计，最忙的线程不够忙或没有明显高于平均值时不迁移
+    uint64_t uAverageLoad = uTotalLoad / m_vecReactor.size();
+    uint64_t uMinBusyLoad = static_cast<uint64_t>(m_uRebalanceIntervalMs) * 1000000 * kRebalanceMinBusyPercent / 100;
+    if (pHottest == pColdest || uHottestLoad < uMinBusyLoad
+        || uHottestLoad * 100 <= uAverageLoad * (100 + static_cast<uint64_t>(m_uRebalanceThresholdPercent)))
+    {
+        return;
+    }
+
+    // 每个周期最多迁移一个连接，其负载不超过两个线程差值的一半，避免目标线程成为新的热点；
+    // 由热点线程在两次事件处理之间选出并迁移，不在回调中进行
+    uint64_t uBudget = (uHottestLoad - uColdestLoad) / 2;
+    try
+    {
+        pHottest->Post([pHottest, pColdest, uHottestLoad, uBudget]() {
+            pHottest->MigrateHottest(pColdest, uHottestLoad, uBudget);
+        });
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to post rebalance task", m_strNetEngineName.c_str());
+    }
+}
+
+int32_t NetEngineImpl::GetManagerTimeout() const
+{
+    uint64_t uDeadlineMs = UINT64_MAX;
+    if (m_uNextMaintainMs != 0)
+    {
+        uDeadlineMs = m_uNextMaintainMs;
+    }
+    if (m_uNextRebalanceMs != 0)
+    {
+        uDeadlineMs = std::min(uDeadlineMs, m_uNextRebalanceMs);
+    }
+    if (uDeadlineMs == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    uint64_t uNowMs = Reactor::NowMs();
+    return uNowMs >= uDeadlineMs ? 0 : static_cast<int32_t>(std::min<uint64_t>(uDeadlineMs - uNowMs, INT32_MAX));
+}
+
+bool NetEngineImpl::PostManager(std::function<void()> func)
+{
+    ManagerCommand *pCommand = new(std::nothrow) ManagerCommand();
+    if (pCommand == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to post manager command", m_strNetEngineName.c_str());
+        return false;
+    }
+    pCommand->func = std::move(func);
+    bool bWasEmpty = m_managerInbox.Push(pCommand);
+
+    // 与管理线程退出时先清除运行标志再取命令配对，两者至少有一方会看到这个命令
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!m_bManagerRunning.load())
+    {
+        RunManagerCommands();
+    }
+    else if (bWasEmpty)
+    {
+        WakeupManager();
+    }
+    return true;
+}
+
+int32_t NetEngineImpl::CallManager(const std::function<int32_t()> &func)
+{
+    std::future<int32_t> future;
+    std::shared_ptr<std::promise<int32_t>> spPromise;
+    try
+    {
+        spPromise = std::make_shared<std::promise<int32_t>>();
+        future = spPromise->get_future();
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to call manager", m_strNetEngineName.c_str());
+        return ErrorCode::kThrowException;
+    }
+
+    if (!PostManager([func, spPromise]() { spPromise->set_value(func()); }))
+    {
+        return ErrorCode::kNoMemory;
+    }
+    return future.get();
+}
+
+void NetEngineImpl::WakeupManager()
+{
+    uint64_t uValue = 1;
+    ssize_t iRet = write(m_iManagerEventFd, &uValue, sizeof(uValue));
+    (void)iRet;
+}
+
+void NetEngineImpl::WaitManager(int32_t iTimeoutMs)
+{
+    struct pollfd pollFd = {};
+    pollFd.fd = m_iManagerEventFd;
+    pollFd.events = POLLIN;
+    if (poll(&pollFd, 1, iTimeoutMs) > 0)
+    {
+        uint64_t uValue = 0;
+        while (read(m_iManagerEventFd, &uValue, sizeof(uValue)) > 0)
+        {
+        }
+    }
+}
+
+void NetEngineImpl::RunManagerCommands()
+{
+    ManagerCommand *pCommand = m_managerInbox.PopAll();
+    while (pCommand != nullptr)
+    {
+        ManagerCommand *pNext = pCommand->pNext;
+        pCommand->func();
+        delete pCommand;
+        pCommand = pNext;
+    }
+}
+
+Reactor *NetEngineImpl::SelectReactor()
+{
+    return m_vecReactor[m_uNextReactor++ % m_vecReactor.size()];
+}
+
+Reactor *NetEngineImpl::GetReactor(uint64_t uConnectionID) const
+{
+    // 句柄表记录连接所属IO线程，已销毁的连接ID代数不匹配，不会路由到复用该槽位的新连接
+    uint32_t uIndex = 0;
+    if (!m_connectionTable.GetReactorIndex(uConnectionID, uIndex) || uIndex >= m_vecReactor.size())
+    {
+        return nullptr;
+    }
+    return m_vecReactor[uIndex];
+}
+
 void NetEngineImpl::ManagerWorker()
 {
+    if (m_managerPlacement.Apply() != ErrorCode::kSuccess)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "{} failed to bind manager thread to cpu {}, errno: {}",
+            m_strNetEngineName.c_str(), Wrap(m_managerPlacement.GetCpu()), Wrap(errno));
+    }
+
+    // 只有epoll后端的TCP连接可以迁移，单个IO线程时无需均衡
+    m_vecReactorLoad.assign(m_vecReactor.size(), 0);
+    for (size_t i = 0; i < m_vecReactor.size(); i++)
+    {
+        m_vecReactorLoad[i] = m_vecReactor[i]->GetLoad();
+    }
+    if (m_uRebalanceIntervalMs > 0 && m_vecReactor.size() > 1 && m_eType == NetEngineType::kTcp)
+    {
+        m_uNextRebalanceMs = Reactor::NowMs() + m_uRebalanceIntervalMs;
+    }
+
+    // 管理线程在eventfd上休眠，只在有控制命令、到了维护连接池或检查负载的时间才唤醒，
+    // 没有连接池且不均衡负载时无限期休眠
     while (m_bRunning)
     {
-        // 1. 处理网络事件
-        // 2. 发送网络事件
+        WaitManager(GetManagerTimeout());
+        RunManagerCommands();
+
+        uint64_t uNowMs = Reactor::NowMs();
+        if (m_uNextMaintainMs != 0 && uNowMs >= m_uNextMaintainMs)
+        {
+            m_uNextMaintainMs = MaintainConnectionPools() ? uNowMs + kManagerIntervalMs : 0;
+        }
+        if (m_uNextRebalanceMs != 0 && uNowMs >= m_uNextRebalanceMs)
+        {
+            RebalanceReactors();
+            m_uNextRebalanceMs = uNowMs + m_uRebalanceIntervalMs;
+        }
     }
+
+    // 退出后投递的命令由投递线程或Exit执行
+    m_bManagerRunning = false;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    RunManagerCommands();
 }
 
-void NetEngineImpl::IOWorker()
+void NetEngineImpl::IOWorker(Reactor *pReactor)
 {
+    const ThreadPlacement &placement = pReactor->GetPlacement();
+    if (placement.Apply() != ErrorCode::kSuccess)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "{} failed to bind io thread {} to cpu {}, errno: {}",
+            m_strNetEngineName.c_str(), Wrap(pReactor->GetIndex()), Wrap(placement.GetCpu()), Wrap(errno));
+    }
+
+    // 忙轮询时处理完事件后不立即阻塞，在期限内以零超时继续轮询，紧随其后到达的数据不需要经过内核唤醒
+    uint64_t uSpinDeadlineUs = 0;
     while (m_bRunning)
     {
-        // 1. 接受网络事件
-        // 2. 处理网络事件
-        // 3. 发送网络事件
+        bool bSpin = m_uBusyPollUs > 0 && NowUs() < uSpinDeadlineUs;
+        if (pReactor->Poll(bSpin ? 0 : kPollTimeoutMs) > 0 && m_uBusyPollUs > 0)
+        {
+            uSpinDeadlineUs = NowUs() + m_uBusyPollUs;
+        }
     }
 }
 
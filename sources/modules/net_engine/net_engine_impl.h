@@ -6,9 +6,16 @@
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <functional>
 #include <unordered_map>
+#include "reactor.h"
+#include "mpsc_queue.h"
+#include "uring_reactor.h"
 #include "listener_impl.h"
 #include "connection_impl.h"
+#include "connection_pool_impl.h"
+#include "connection_table.h"
+#include "message_pool.h"
 
 namespace lite_drive
 {
@@ -18,7 +25,7 @@ namespace net_engine
 class NetEngineImpl : public INetEngine
 {
 public:
-    NetEngineImpl(logger::ILogger *pLogger);
+    NetEngineImpl(logger::ILogger *pLogger, utilities::IMemory *pMemory);
     ~NetEngineImpl() override;
 
     int32_t Init(utilities::IConfig *pConfig, ICallback *pGlobalCallback) override;
@@ -29,25 +36,164 @@ public:
     void DestroyListener(ListenerHandler *pListenerHandler) override;
     ConnectionHandler CreateConnection(utilities::IConfig *pConfig, ICallback *pCallback) override;
     void DestroyConnection(ConnectionHandler *pConnHandler) override;
+    ConnectionPoolHandler CreateConnectionPool(utilities::IConfig *pConfig, ICallback *pCallback) override;
+    void DestroyConnectionPool(ConnectionPoolHandler *pPoolHandler) override;
     int32_t GetStats(std::string &strStats) const override;
 
+    /**
+     * @brief 创建主动连接并分配给IO线程
+     * @param pConfig 配置
+     * @param pCallback 回调
+     * @param bConnect 是否立即发起连接，连接池先创建全部连接再统一发起
+     * @return 连接句柄,失败返回NULL
+     */
+    ConnectionHandler NewConnection(utilities::IConfig *pConfig, ICallback *pCallback, bool bConnect);
+
+    /**
+     * @brief 监听器接受新连接后在IO线程中调用，创建连接并分配给IO线程
+     * @param iFd 已接受的套接字
+     * @param options 连接选项
+     * @param pCallback 回调
+     * @param strName 连接名称
+     * @param pOwner 当前IO线程的Reactor，非空时连接直接归属该线程，否则轮询分配
+     */
+    void OnAccepted(int32_t iFd, const ConnectionOptions &options, ICallback *pCallback, const std::string &strName, Reactor *pOwner);
+
+    /**
+     * @brief 为UDP监听套接字上的新远程地址创建接入连接，仅在套接字所属IO线程中调用
+     * @param pSocket UDP监听套接字，连接归属其IO线程
+     * @param addr 远程地址
+     * @param options 连接选项
+     * @param pCallback 回调
+     * @param strName 连接名称
+     * @return 已挂载的连接，失败返回NULL
+     */
+    ConnectionImpl *OnAcceptedDatagram(UdpSocket *pSocket, const struct sockaddr_in &addr, const ConnectionOptions &options,
+        ICallback *pCallback, const std::string &strName);
+
+    NetEngineType GetType() const { return m_eType; }
+
+    ConnectionTable *GetConnectionTable() { return &m_connectionTable; }
+
+    MessagePool *GetMessagePool() { return &m_messagePool; }
+
+    /**
+     * @brief 预占网络引擎待发送字节数，线程安全
+     * @param uBytes 字节数
+     * @return 是否成功，超过全局高水位返回false
+     */
+    bool ReserveSend(uint64_t uBytes);
+
+    /**
+     * @brief 计入网络引擎待发送字节数，不检查水位，用于不能被拒绝的内部消息，线程安全
+     * @param uBytes 字节数
+     */
+    void ChargeSend(uint64_t uBytes);
+
+    /**
+     * @brief 释放网络引擎待发送字节数，降到全局低水位以下时通知所有IO线程检查被拒绝过的连接，线程安全
+     * @param uBytes 字节数
+     */
+    void ReleaseSend(uint64_t uBytes);
+
+    /**
+     * @brief 是否有发送因超过全局高水位被拒绝且尚未降到低水位以下
+     */
+    bool IsSendBlocked() const { return m_bSendBlocked.load(); }
+
+    /**
+     * @brief 查找连接当前所属的Reactor，线程安全
+     * @param uConnectionID 连接ID
+     * @return Reactor，连接已释放返回NULL
+     */
+    Reactor *GetReactor(uint64_t uConnectionID) const;
+
 private:
-    void IOWorker();
+    /**
+     * @brief 管理线程的控制命令，由任意线程投递，管理线程按投递顺序执行
+     */
+    struct ManagerCommand
+    {
+        std::function<void()> func;
+        ManagerCommand *pNext{nullptr};
+    };
+
+    int32_t InitComponents();
+    void ReleaseMemory();
+    void ReleaseConfig();
+    void IOWorker(Reactor *pReactor);
     void ManagerWorker();
 
+    /**
+     * @brief 投递控制命令，线程安全，不阻塞调用线程；管理线程未运行时在调用线程中直接执行
+     * @param func 命令
+     * @return 是否成功
+     */
+    bool PostManager(std::function<void()> func);
+
+    /**
+     * @brief 投递控制命令并等待执行结果，不能在管理线程中调用
+     * @param func 命令
+     * @return 命令的返回值，投递失败返回错误码
+     */
+    int32_t CallManager(const std::function<int32_t()> &func);
+
+    void WakeupManager();
+    void WaitManager(int32_t iTimeoutMs);
+    void RunManagerCommands();
+    Reactor *NewReactor(uint32_t uIndex, const UringOptions &uringOptions, const ThreadPlacement &placement);
+    int32_t LoadPlacement(std::vector<ThreadPlacement> &vecIOPlacement);
+    Reactor *SelectReactor();
+    void ReleaseListener(ListenerImpl *pListener);
+    void ReleaseConnectionPool(ConnectionPoolImpl *pPool);
+    bool MaintainConnectionPools();
+    void ScheduleMaintain();
+    void RebalanceReactors();
+    int32_t GetManagerTimeout() const;
+
 private:
-    volatile bool m_bRunning{false};
+    static constexpr int32_t kPollTimeoutMs = 1000; // IO线程无事件时的最长阻塞时间
+    static constexpr int32_t kManagerIntervalMs = 100; // 管理线程维护连接池的周期，没有连接池时不定时唤醒
+    static constexpr uint64_t kRebalanceMinBusyPercent = 10; // 最忙的IO线程在周期内的负载不足该比例时不迁移连接
+
+    NetEngineType m_eType{NetEngineType::kTcp};
+    std::atomic<bool> m_bRunning{false};
     std::thread m_thManager;
     std::vector<std::thread> m_vecThIO;
+    std::vector<Reactor *> m_vecReactor;
+    std::atomic<uint32_t> m_uNextReactor{0};
+    ConnectionTable m_connectionTable;
+    ThreadPlacement m_managerPlacement;
+    uint32_t m_uBusyPollUs{0}; // IO线程处理完事件后继续非阻塞轮询的时间，0表示直接阻塞等待
+    uint32_t m_uRebalanceIntervalMs{0};
+    uint32_t m_uRebalanceThresholdPercent{0};
+
+    // 所有连接已入队未交给内核的字节数，全局高水位为0时不统计
+    uint64_t m_uSendHighWatermarkBytes{0};
+    uint64_t m_uSendLowWatermarkBytes{0};
+    std::atomic<uint64_t> m_uSendQueuedBytes{0};
+    std::atomic<bool> m_bSendBlocked{false};
+
+    // 管理线程在eventfd上休眠，命令队列由空变为非空时才写eventfd唤醒
+    std::atomic<bool> m_bManagerRunning{false};
+    int32_t m_iManagerEventFd{-1};
+    MpscQueue<ManagerCommand> m_managerInbox;
+    uint64_t m_uNextMaintainMs{0}; // 下次维护连接池的时间，0表示没有连接池，只由管理线程访问
+    uint64_t m_uNextRebalanceMs{0}; // 下次检查IO线程负载的时间，0表示不迁移连接，只由管理线程访问
+    std::vector<uint64_t> m_vecReactorLoad; // 上次检查时各IO线程的累计负载，只由管理线程访问
 
+    std::mutex m_maintainMutex; // 管理线程维护连接池期间持有，销毁连接池前获取一次以等待维护结束
     std::mutex m_mutex;
     std::atomic<uint64_t> m_uNextListenerID{1};
     std::unordered_map<uint64_t, ListenerImpl *> m_umapListener;
-    std::atomic<uint64_t> m_uNextConnectionID{1};
-    std::unordered_map<uint64_t, ConnectionImpl *> m_umapConnection;
+    std::atomic<uint64_t> m_uNextPoolID{1};
+    std::unordered_map<uint64_t, ConnectionPoolImpl *> m_umapPool;
 
     logger::ILogger *m_pLogger{nullptr};
     utilities::IConfig *m_pConfig{nullptr};
+    utilities::IMemory *m_pExternalMemory{nullptr}; // 创建时传入的内存对象，不归网络引擎所有
+    utilities::IMemory *m_pMemory{nullptr};         // 消息池使用的内存对象，未传入时由网络引擎创建
+    MessagePool m_messagePool;
     ICallback *m_pGlobalCallback{nullptr};
     std::string m_strNetEngineName;
 };
@@ -0,0 +1,116 @@
+#include "net_stats.h"
+#include <algorithm>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+void LatencyHistogram::Record(uint64_t uValue)
+{
+    m_arrCount[GetBucket(uValue)].Add();
+    m_uSum.Add(uValue);
+    if (uValue > m_uMax.Get())
+    {
+        m_uMax.Set(uValue);
+    }
+}
+
+void LatencyHistogram::Accumulate(uint64_t (&arrCount)[kBucketCount], uint64_t &uSum, uint64_t &uMax) const
+{
+    for (uint32_t i = 0; i < kBucketCount; i++)
+    {
+        arrCount[i] += m_arrCount[i].Get();
+    }
+    uSum += m_uSum.Get();
+    uMax = std::max(uMax, m_uMax.Get());
+}
+
+void LatencyHistogram::Render(const uint64_t (&arrCount)[kBucketCount], uint64_t uSum, uint64_t uMax, Json::Value &jsonValue)
+{
+    uint64_t uCount = 0;
+    for (uint32_t i = 0; i < kBucketCount; i++)
+    {
+        uCount += arrCount[i];
+    }
+
+    jsonValue["count"] = Json::UInt64(uCount);
+    jsonValue["mean"] = Json::UInt64(uCount > 0 ? uSum / uCount : 0);
+    jsonValue["max"] = Json::UInt64(uMax);
+
+    // 分位数取所在桶的上界，不超过实际的最大值
+    static const struct
+    {
+        const char *pName;
+        uint32_t uPerMillion;
+    } arrPercentile[] = {{"p50", 500000}, {"p90", 900000}, {"p99", 990000}, {"p999", 999000}};
+    for (const auto &percentile : arrPercentile)
+    {
+        uint64_t uValue = 0;
+        if (uCount > 0)
+        {
+            uint64_t uRank = (uCount * percentile.uPerMillion + 999999) / 1000000;
+            uint64_t uSeen = 0;
+            for (uint32_t i = 0; i < kBucketCount; i++)
+            {
+                uSeen += arrCount[i];
+                if (uSeen >= uRank)
+                {
+                    uValue = std::min(GetBucketUpperBound(i), uMax);
+                    break;
+                }
+            }
+        }
+        jsonValue[percentile.pName] = Json::UInt64(uValue);
+    }
+}
+
+uint32_t LatencyHistogram::GetBucket(uint64_t uValue)
+{
+    // 小于子桶数的值精确计数，之后每个2的幂区间按最高位之后的kSubBucketBits位分桶
+    if (uValue < kSubBucketCount)
+    {
+        return static_cast<uint32_t>(uValue);
+    }
+
+    uint32_t uHighBit = 63 - static_cast<uint32_t>(__builtin_clzll(uValue));
+    if (uHighBit >= kMaxValueBits)
+    {
+        return kBucketCount - 1;
+    }
+
+    uint32_t uShift = uHighBit - kSubBucketBits;
+    return (uShift + 1) * kSubBucketCount + static_cast<uint32_t>((uValue >> uShift) & (kSubBucketCount - 1));
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(uint32_t uBucket)
+{
+    if (uBucket < kSubBucketCount)
+    {
+        return uBucket;
+    }
+
+    uint32_t uShift = uBucket / kSubBucketCount - 1;
+    uint64_t uLower = static_cast<uint64_t>(kSubBucketCount + uBucket % kSubBucketCount) << uShift;
+    return uLower + (1ull << uShift) - 1;
+}
+
+void ReactorStats::RenderCounters(Json::Value &jsonValue) const
+{
+    jsonValue["bytes_in"] = Json::UInt64(uBytesIn.Get());
+    jsonValue["bytes_out"] = Json::UInt64(uBytesOut.Get());
+    jsonValue["messages_in"] = Json::UInt64(uMessagesIn.Get());
+    jsonValue["messages_out"] = Json::UInt64(uMessagesOut.Get());
+    jsonValue["syscalls"] = Json::UInt64(uSyscalls.Get());
+    jsonValue["eagains"] = Json::UInt64(uEagains.Get());
+    jsonValue["accepts"] = Json::UInt64(uAccepts.Get());
+    jsonValue["disconnects"] = Json::UInt64(uDisconnects.Get());
+    jsonValue["polls"] = Json::UInt64(uPolls.Get());
+    jsonValue["call_timeouts"] = Json::UInt64(uCallTimeouts.Get());
+    jsonValue["migrations"] = Json::UInt64(uMigrations.Get());
+    jsonValue["connections"] = Json::UInt64(uConnections.Get());
+    jsonValue["pending_tasks"] = Json::UInt64(uPendingTasks.Get());
+}
+
+}
+}
@@ -0,0 +1,96 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_NET_STATS_H__
+#define __LITE_DRIVE_NET_ENGINE_NET_STATS_H__
+
+#include "stat_counter.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <json/value.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+constexpr size_t kCacheLineBytes = 64;
+
+/**
+ * @brief 对数线性分桶的延迟直方图，与HDR直方图相同，每个2的幂区间等分为若干子桶，相对误差不超过12.5%
+ * @note 单写者，读取时各桶分别读取，结果不是严格的快照，但每个桶的计数不会丢失
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t kSubBucketBits = 3;
+    static constexpr uint32_t kSubBucketCount = 1u << kSubBucketBits;
+    static constexpr uint32_t kMaxValueBits = 40; // 超过2^40纳秒(约18分钟)的值计入最后一个桶
+    static constexpr uint32_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+    /**
+     * @brief 记录一个值，仅在所属IO线程中调用
+     * @param uValue 值，单位: 纳秒
+     */
+    void Record(uint64_t uValue);
+
+    /**
+     * @brief 把本直方图的计数累加到汇总结果中，线程安全
+     * @param arrCount 各桶计数
+     * @param uSum 值的总和
+     * @param uMax 最大值
+     */
+    void Accumulate(uint64_t (&arrCount)[kBucketCount], uint64_t &uSum, uint64_t &uMax) const;
+
+    /**
+     * @brief 将汇总的直方图输出为计数、均值、最大值和常用分位数
+     * @param arrCount 各桶计数
+     * @param uSum 值的总和
+     * @param uMax 最大值
+     * @param jsonValue 输出
+     */
+    static void Render(const uint64_t (&arrCount)[kBucketCount], uint64_t uSum, uint64_t uMax, Json::Value &jsonValue);
+
+    uint64_t GetSum() const { return m_uSum.Get(); }
+
+private:
+    static uint32_t GetBucket(uint64_t uValue);
+    static uint64_t GetBucketUpperBound(uint32_t uBucket);
+
+private:
+    StatCounter m_arrCount[kBucketCount];
+    StatCounter m_uSum;
+    StatCounter m_uMax;
+};
+
+/**
+ * @brief 一个IO线程的统计，按缓存行对齐，各IO线程写入时互不干扰
+ */
+struct alignas(kCacheLineBytes) ReactorStats
+{
+    StatCounter uBytesIn;      // 接收的字节数
+    StatCounter uBytesOut;     // 交给内核发送的字节数
+    StatCounter uMessagesIn;   // 投递给回调的消息数，不含心跳和调用响应
+    StatCounter uMessagesOut;  // 发送完成的消息数
+    StatCounter uSyscalls;     // 收发数据和等待事件的系统调用次数
+    StatCounter uEagains;      // 收发返回EAGAIN的次数
+    StatCounter uAccepts;      // 接入的连接数
+    StatCounter uDisconnects;  // 断开的连接数
+    StatCounter uPolls;        // 事件循环轮数
+    StatCounter uCallTimeouts; // 超时的调用数
+    StatCounter uMigrations;   // 迁出到其他IO线程的连接数
+
+    StatCounter uConnections;  // 当前管理的连接数
+    StatCounter uPendingTasks; // 当前待执行的任务数，由投递方在Reactor的锁内更新
+
+    LatencyHistogram callLatency;    // 调用从发出到收到响应的时间
+    LatencyHistogram handlerLatency; // OnMessage回调的执行时间
+
+    /**
+     * @brief 输出计数器
+     * @param jsonValue 输出
+     */
+    void RenderCounters(Json::Value &jsonValue) const;
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_NET_STATS_H__
@@ -0,0 +1,456 @@
+#include "reactor.h"
+#include "connection_impl.h"
+#include "net_engine_impl.h"
+#include "zero_copy.h"
+#include <error_code.h>
+#include <chrono>
+#include <new>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+Reactor::Reactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex)
+    : m_uIndex(uIndex), m_pLogger(pLogger), m_pConnectionTable(pNetEngine->GetConnectionTable()), m_pNetEngine(pNetEngine)
+{
+}
+
+int32_t Reactor::Init()
+{
+    m_iEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_iEventFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kEpollFailed, "reactor {} failed to create eventfd, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kEpollFailed;
+    }
+
+    UpdateLoopTime();
+    m_timerWheel.Start(m_uLoopTimeMs);
+    return ErrorCode::kSuccess;
+}
+
+void Reactor::Exit()
+{
+    // IO线程已停止，执行剩余的注册和释放任务，避免监听器和连接泄漏
+    bool bHasTask = true;
+    while (bHasTask)
+    {
+        RunTasks();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bHasTask = !m_vecTask.empty();
+    }
+
+    for (auto pConnection : m_vecConnection)
+    {
+        m_pConnectionTable->Remove(pConnection->GetID());
+        pConnection->DoClose(false);
+        ReleaseConnection(pConnection);
+    }
+    m_vecConnection.clear();
+    m_stats.uConnections.Set(0);
+
+    // IO线程已停止，不再等待零拷贝完成通知，中止连接后释放
+    for (auto pLinger : m_vecLinger)
+    {
+        delete pLinger;
+    }
+    m_vecLinger.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_vecTask.clear();
+        m_stats.uPendingTasks.Set(0);
+    }
+
+    // 句柄表仍然有效，清除标志后节点可以再次入队
+    FlushRequest *pRequest = m_flushQueue.PopAll();
+    while (pRequest != nullptr)
+    {
+        FlushRequest *pNext = pRequest->pNext;
+        pRequest->bQueued.store(false);
+        pRequest = pNext;
+    }
+
+    if (m_iEventFd >= 0)
+    {
+        close(m_iEventFd);
+        m_iEventFd = -1;
+    }
+}
+
+void Reactor::LingerZeroCopy(int32_t iFd, ZeroCopyTracker &tracker, const std::string &strName)
+{
+    ZeroCopyLinger *pLinger = new(std::nothrow) ZeroCopyLinger(m_pLogger, this, strName, iFd, tracker);
+    if (pLinger == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create zero copy linger, abort the connection", strName.c_str());
+        AbortSocket(iFd);
+        tracker.Release();
+        return;
+    }
+
+    // 无法等待完成通知时由析构中止连接后释放
+    try
+    {
+        m_vecLinger.push_back(pLinger);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to track zero copy linger, abort the connection", strName.c_str());
+        delete pLinger;
+        return;
+    }
+
+    if (pLinger->Start() != ErrorCode::kSuccess)
+    {
+        ReleaseLinger(pLinger);
+    }
+}
+
+void Reactor::ReleaseLinger(ZeroCopyLinger *pLinger)
+{
+    for (size_t i = 0; i < m_vecLinger.size(); i++)
+    {
+        if (m_vecLinger[i] == pLinger)
+        {
+            m_vecLinger[i] = m_vecLinger.back();
+            m_vecLinger.pop_back();
+            break;
+        }
+    }
+    delete pLinger;
+}
+
+void Reactor::Wakeup()
+{
+    uint64_t uValue = 1;
+    ssize_t iRet = write(m_iEventFd, &uValue, sizeof(uValue));
+    (void)iRet;
+}
+
+void Reactor::Post(std::function<void()> task)
+{
+    bool bNeedWakeup = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bNeedWakeup = m_vecTask.empty();
+        m_vecTask.emplace_back(std::move(task));
+        m_stats.uPendingTasks.Set(m_vecTask.size());
+    }
+
+    if (bNeedWakeup)
+    {
+        Wakeup();
+    }
+}
+
+void Reactor::RequestFlush(uint64_t uConnectionID)
+{
+    // 每个连接只有一个节点，已在某个就绪队列中时由取出它的IO线程负责刷新
+    FlushRequest *pRequest = m_pConnectionTable->GetFlushRequest(uConnectionID);
+    if (pRequest == nullptr || pRequest->bQueued.exchange(true))
+    {
+        return;
+    }
+
+    if (m_flushQueue.Push(pRequest))
+    {
+        Wakeup();
+    }
+}
+
+void Reactor::Attach(ConnectionImpl *pConnection)
+{
+    Post([this, pConnection]() {
+        AttachInLoop(pConnection);
+    });
+}
+
+void Reactor::AttachInLoop(ConnectionImpl *pConnection)
+{
+    if (!LinkConnection(pConnection))
+    {
+        m_pConnectionTable->Remove(pConnection->GetID());
+        ReleaseConnection(pConnection);
+        return;
+    }
+    pConnection->OnAttached();
+}
+
+void Reactor::Detach(uint64_t uConnectionID, std::function<void()> onDetached)
+{
+    PostToConnection(uConnectionID, [this, uConnectionID, onDetached](ConnectionImpl *pConnection) {
+        if (pConnection == nullptr)
+        {
+            LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "reactor {} connection {} not found", Wrap(m_uIndex), Wrap(uConnectionID));
+        }
+        else
+        {
+            // 连接可能已迁移，由当前所属的Reactor释放
+            Reactor *pOwner = pConnection->GetReactor();
+            pOwner->RemoveConnection(pConnection);
+            LOG_EVENT(m_pLogger, ErrorCode::kEvent, "Release connection name: {}, id: {}", pConnection->GetName().c_str(), Wrap(uConnectionID));
+            pConnection->DoClose(true);
+            pOwner->ReleaseConnection(pConnection);
+        }
+
+        if (onDetached)
+        {
+            onDetached();
+        }
+    });
+}
+
+void Reactor::PostToConnection(uint64_t uConnectionID, std::function<void(ConnectionImpl *)> task)
+{
+    Post([this, uConnectionID, task]() { RunConnectionTask(uConnectionID, task); });
+}
+
+void Reactor::RunConnectionTask(uint64_t uConnectionID, const std::function<void(ConnectionImpl *)> &task)
+{
+    ConnectionImpl *pConnection = FindConnection(uConnectionID);
+    if (pConnection != nullptr)
+    {
+        task(pConnection);
+        return;
+    }
+
+    // 句柄表记录的归属不是本线程时转交；是本线程但尚未挂载时迁入任务已经投递，重新排队等它执行
+    Reactor *pOwner = m_pNetEngine->GetReactor(uConnectionID);
+    if (pOwner == nullptr)
+    {
+        task(nullptr);
+        return;
+    }
+    pOwner->PostToConnection(uConnectionID, task);
+}
+
+void Reactor::Migrate(ConnectionImpl *pConnection, Reactor *pTarget)
+{
+    uint64_t uConnectionID = pConnection->GetID();
+    pConnection->OnMigrateOut();
+    UnlinkConnection(pConnection);
+
+    // 先改写归属再投递迁入任务，之后读到新归属的线程投递的任务都排在迁入任务之后
+    m_pConnectionTable->SetReactorIndex(uConnectionID, pTarget->GetIndex());
+    try
+    {
+        pTarget->Post([pTarget, pConnection]() { pTarget->AttachMigrated(pConnection); });
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "reactor {} failed to migrate connection {} to reactor {}",
+            Wrap(m_uIndex), Wrap(uConnectionID), Wrap(pTarget->GetIndex()));
+        m_pConnectionTable->SetReactorIndex(uConnectionID, m_uIndex);
+        AttachMigrated(pConnection);
+        return;
+    }
+    m_stats.uMigrations.Add();
+}
+
+void Reactor::MigrateHottest(Reactor *pTarget, uint64_t uLoad, uint64_t uBudget)
+{
+    // 各连接的负载按其在本线程连接总负载中的占比折算到上个周期，选出可迁移且不超过预算的最大者，之后重新采样；
+    // 负载不到预算四分之一的连接迁走也改善不了多少，不值得迁移
+    uint64_t uTotal = 0;
+    for (auto pConnection : m_vecConnection)
+    {
+        uTotal += pConnection->GetLoad();
+    }
+
+    ConnectionImpl *pHottest = nullptr;
+    uint64_t uHottestLoad = 0;
+    for (auto pConnection : m_vecConnection)
+    {
+        uint64_t uConnectionLoad = uTotal > 0 ? static_cast<uint64_t>(static_cast<double>(uLoad) * pConnection->GetLoad() / uTotal) : 0;
+        pConnection->ResetLoad();
+        if (uConnectionLoad > uHottestLoad && uConnectionLoad <= uBudget && uConnectionLoad >= uBudget / 4 && pConnection->IsMigratable())
+        {
+            pHottest = pConnection;
+            uHottestLoad = uConnectionLoad;
+        }
+    }
+
+    if (pHottest != nullptr)
+    {
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} migrate from reactor {} to reactor {}, id: {}, load: {}", pHottest->GetName().c_str(),
+            Wrap(m_uIndex), Wrap(pTarget->GetIndex()), Wrap(pHottest->GetID()), Wrap(uHottestLoad));
+        Migrate(pHottest, pTarget);
+    }
+}
+
+uint64_t Reactor::GetLoad() const
+{
+    return m_stats.uBytesIn.Get() + m_stats.uBytesOut.Get() + m_stats.handlerLatency.GetSum();
+}
+
+void Reactor::AttachMigrated(ConnectionImpl *pConnection)
+{
+    if (!LinkConnection(pConnection))
+    {
+        // 无法挂载时重新绑定到本线程再关闭，回调和统计都在本线程中进行
+        m_pConnectionTable->Remove(pConnection->GetID());
+        pConnection->Bind(pConnection->GetID(), this);
+        pConnection->DoClose(true);
+        ReleaseConnection(pConnection);
+        return;
+    }
+    pConnection->OnMigrateIn(this);
+}
+
+ConnectionImpl *Reactor::FindConnection(uint64_t uConnectionID)
+{
+    // 只有所属IO线程会释放连接，归属本线程的连接在本线程内可以安全解引用；
+    // 新建和迁入的连接在挂载前已登记为本线程所有，不在连接列表中的视为尚未挂载
+    uint32_t uReactorIndex = 0;
+    if (!m_pConnectionTable->GetReactorIndex(uConnectionID, uReactorIndex) || uReactorIndex != m_uIndex)
+    {
+        return nullptr;
+    }
+
+    ConnectionImpl *pConnection = m_pConnectionTable->Find(uConnectionID);
+    if (pConnection == nullptr)
+    {
+        return nullptr;
+    }
+    uint32_t uPosition = pConnection->GetReactorPosition();
+    return uPosition < m_vecConnection.size() && m_vecConnection[uPosition] == pConnection ? pConnection : nullptr;
+}
+
+bool Reactor::LinkConnection(ConnectionImpl *pConnection)
+{
+    try
+    {
+        m_vecConnection.push_back(pConnection);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "reactor {} failed to attach connection {}", Wrap(m_uIndex), Wrap(pConnection->GetID()));
+        return false;
+    }
+    pConnection->SetReactorPosition(static_cast<uint32_t>(m_vecConnection.size() - 1));
+    m_stats.uConnections.Add();
+    return true;
+}
+
+void Reactor::UnlinkConnection(ConnectionImpl *pConnection)
+{
+    // 与末尾元素交换后删除，被移动的连接更新自己的下标
+    uint32_t uPosition = pConnection->GetReactorPosition();
+    ConnectionImpl *pLast = m_vecConnection.back();
+    m_vecConnection[uPosition] = pLast;
+    pLast->SetReactorPosition(uPosition);
+    m_vecConnection.pop_back();
+    m_stats.uConnections.Sub();
+}
+
+void Reactor::RemoveConnection(ConnectionImpl *pConnection)
+{
+    UnlinkConnection(pConnection);
+
+    // 先使ID失效再释放，持有旧句柄的调用方之后查找失败
+    m_pConnectionTable->Remove(pConnection->GetID());
+}
+
+void Reactor::ReleaseConnection(ConnectionImpl *pConnection)
+{
+    pConnection->Exit();
+    delete pConnection;
+}
+
+void Reactor::DrainWakeup()
+{
+    uint64_t uValue = 0;
+    while (read(m_iEventFd, &uValue, sizeof(uValue)) > 0)
+    {
+    }
+}
+
+void Reactor::RunTasks()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_vecTask.empty())
+        {
+            return;
+        }
+        m_vecRunningTask.swap(m_vecTask);
+        m_stats.uPendingTasks.Set(0);
+    }
+
+    for (auto &task : m_vecRunningTask)
+    {
+        task();
+    }
+    m_vecRunningTask.clear();
+}
+
+void Reactor::NotifySendDrained()
+{
+    // 回调中可能关闭连接，按下标遍历并每次检查长度
+    for (size_t i = 0; i < m_vecConnection.size(); i++)
+    {
+        m_vecConnection[i]->CheckSendDrained();
+    }
+}
+
+void Reactor::FlushPending()
+{
+    FlushRequest *pRequest = m_flushQueue.PopAll();
+    while (pRequest != nullptr)
+    {
+        // 先取后继再清除标志，清除后节点可能立即被发送方重新入队；之后入队的数据由下一次请求刷新
+        FlushRequest *pNext = pRequest->pNext;
+        pRequest->bQueued.exchange(false);
+
+        // 节点按槽位当前的ID查找，槽位已被新连接复用时多刷新一次也无妨
+        uint64_t uConnectionID = m_pConnectionTable->GetSlotID(pRequest->uIndex);
+        ConnectionImpl *pConnection = uConnectionID != 0 ? FindConnection(uConnectionID) : nullptr;
+        if (pConnection != nullptr)
+        {
+            pConnection->MarkSendActive(m_uLoopTimeMs);
+            FlushConnection(pConnection);
+        }
+        else if (uConnectionID != 0)
+        {
+            // 连接已迁往其他IO线程时转交；迁入本线程尚未完成时由OnMigrateIn统一刷新
+            Reactor *pOwner = m_pNetEngine->GetReactor(uConnectionID);
+            if (pOwner != nullptr && pOwner != this)
+            {
+                pOwner->RequestFlush(uConnectionID);
+            }
+        }
+        pRequest = pNext;
+    }
+}
+uint64_t Reactor::NowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Reactor::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Reactor::UpdateLoopTime()
+{
+    m_uLoopTimeMs = NowMs();
+}
+
+void Reactor::RunTimers()
+{
+    m_timerWheel.Advance(m_uLoopTimeMs);
+}
+
+int32_t Reactor::GetPollTimeout(int32_t iTimeoutMs) const
+{
+    return m_timerWheel.GetTimeoutMs(NowMs(), iTimeoutMs);
+}
+
+}
+}
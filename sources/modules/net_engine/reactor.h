@@ -0,0 +1,338 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_REACTOR_H__
+#define __LITE_DRIVE_NET_ENGINE_REACTOR_H__
+
+#include <net_engine.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+#include "timer_wheel.h"
+#include "thread_placement.h"
+#include "net_stats.h"
+#include "mpsc_queue.h"
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+class NetEngineImpl;
+class ConnectionImpl;
+class ConnectionTable;
+struct FlushRequest;
+class UdpSocket;
+class ShmChannel;
+class ZeroCopyTracker;
+class ZeroCopyLinger;
+struct Acceptor;
+
+class IEventHandler
+{
+protected:
+    virtual ~IEventHandler() = default;
+
+public:
+    /**
+     * @brief 处理IO事件，仅在所属IO线程中调用，epoll后端使用
+     * @param uEvents epoll事件掩码
+     */
+    virtual void OnIOEvent(uint32_t uEvents) = 0;
+};
+
+/**
+ * @brief 每个IO线程独占一个Reactor，持有自己的IO多路复用实例和连接分片
+ * @note 除Post/PostToConnection/RequestFlush/Attach/Detach/Wakeup/GetLoad外，其余接口只能在所属IO线程中调用
+ */
+class Reactor
+{
+public:
+    Reactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex);
+    virtual ~Reactor() = default;
+
+    virtual int32_t Init();
+    virtual void Exit();
+
+    /**
+     * @brief 执行一轮事件循环：等待IO事件、执行投递的任务、刷新待发送的连接
+     * @param iTimeoutMs 等待超时时间，单位: 毫秒，0表示不阻塞
+     * @return 本轮处理的IO事件数，忙轮询据此判断是否空闲
+     */
+    virtual uint32_t Poll(int32_t iTimeoutMs) = 0;
+
+    /**
+     * @brief 开始接收已连接套接字上的数据
+     * @param pConnection 连接
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchConnection(ConnectionImpl *pConnection) = 0;
+
+    /**
+     * @brief 发起非阻塞连接，完成后回调ConnectionImpl::OnConnectResult
+     * @param pConnection 连接
+     * @param addr 远程地址
+     * @return 0表示已发起,否则失败
+     */
+    virtual int32_t StartConnect(ConnectionImpl *pConnection, const struct sockaddr_in &addr) = 0;
+
+    /**
+     * @brief 停止监听连接上的IO，在关闭套接字之前调用
+     * @param pConnection 连接
+     */
+    virtual void UnwatchConnection(ConnectionImpl *pConnection) = 0;
+
+    /**
+     * @brief 将连接发送缓冲区中的数据写入套接字
+     * @param pConnection 连接
+     */
+    virtual void FlushConnection(ConnectionImpl *pConnection) = 0;
+
+    /**
+     * @brief 开始在监听套接字上接受连接
+     * @param pAcceptor 监听套接字
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchAcceptor(Acceptor *pAcceptor) = 0;
+
+    /**
+     * @brief 停止在监听套接字上接受连接，在关闭套接字之前调用
+     * @param pAcceptor 监听套接字
+     */
+    virtual void UnwatchAcceptor(Acceptor *pAcceptor) = 0;
+
+    /**
+     * @brief 开始在UDP套接字上收发数据报
+     * @param pSocket UDP套接字
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchDatagram(UdpSocket *pSocket) = 0;
+
+    /**
+     * @brief 停止在UDP套接字上收发数据报，在关闭套接字之前调用
+     * @param pSocket UDP套接字
+     */
+    virtual void UnwatchDatagram(UdpSocket *pSocket) = 0;
+
+    /**
+     * @brief 开始监听共享内存通道的Unix域套接字，用于握手和发现对端退出
+     * @param pChannel 共享内存通道
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchChannel(ShmChannel *pChannel) = 0;
+
+    /**
+     * @brief 开始监听共享内存通道的本端门铃，握手取得门铃后调用
+     * @param pChannel 共享内存通道
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchDoorbell(ShmChannel *pChannel) = 0;
+
+    /**
+     * @brief 停止监听共享内存通道的套接字和门铃，在关闭它们之前调用
+     * @param pChannel 共享内存通道
+     */
+    virtual void UnwatchChannel(ShmChannel *pChannel) = 0;
+
+    /**
+     * @brief 开始读取关闭连接的套接字上的零拷贝完成通知
+     * @param pLinger 等待完成通知的套接字
+     * @return 0表示成功,否则失败
+     */
+    virtual int32_t WatchLinger(ZeroCopyLinger *pLinger) = 0;
+
+    /**
+     * @brief 停止读取零拷贝完成通知，在关闭套接字之前调用
+     * @param pLinger 等待完成通知的套接字
+     */
+    virtual void UnwatchLinger(ZeroCopyLinger *pLinger) = 0;
+
+    /**
+     * @brief 接管关闭连接时仍被内核引用的零拷贝消息，收到全部完成通知或超时后关闭套接字并释放消息，仅在IO线程中调用
+     * @param iFd 已注销的套接字，所有权转移给Reactor
+     * @param tracker 等待完成通知的消息，调用后为空
+     * @param strName 连接名称
+     * @note 无法等待完成通知时以RST中止连接后立即释放
+     */
+    void LingerZeroCopy(int32_t iFd, ZeroCopyTracker &tracker, const std::string &strName);
+
+    /**
+     * @brief 关闭并释放等待完成通知的套接字，仍有消息未完成时以RST中止连接，仅在IO线程中调用
+     * @param pLinger 等待完成通知的套接字
+     */
+    void ReleaseLinger(ZeroCopyLinger *pLinger);
+
+    /**
+     * @brief 唤醒阻塞等待IO事件的IO线程，线程安全
+     */
+    void Wakeup();
+
+    /**
+     * @brief 投递任务到IO线程执行，线程安全
+     * @param task 任务
+     */
+    void Post(std::function<void()> task);
+
+    /**
+     * @brief 投递针对某个连接的任务，在连接当前所属的IO线程中执行，线程安全
+     * @note 连接迁移期间任务可能投递到旧的IO线程，或先于迁入任务到达新的IO线程，按句柄表记录的归属转交或重试
+     * @param uConnectionID 连接ID
+     * @param task 任务，参数为连接，连接已释放时为NULL
+     */
+    void PostToConnection(uint64_t uConnectionID, std::function<void(ConnectionImpl *)> task);
+
+    /**
+     * @brief 请求IO线程在本轮循环末尾刷新连接的发送缓冲区，线程安全
+     * @param uConnectionID 连接ID
+     * @note 无锁也不分配内存，连接的请求节点已在就绪队列中时直接返回，队列由空变为非空时才唤醒IO线程
+     */
+    void RequestFlush(uint64_t uConnectionID);
+
+    /**
+     * @brief 将连接交给本Reactor管理，线程安全
+     * @param pConnection 连接指针，所有权转移给Reactor
+     */
+    void Attach(ConnectionImpl *pConnection);
+
+    /**
+     * @brief 将连接交给本Reactor管理，仅在IO线程中调用
+     * @param pConnection 连接指针，所有权转移给Reactor
+     */
+    void AttachInLoop(ConnectionImpl *pConnection);
+
+    /**
+     * @brief 关闭并释放本Reactor管理的连接，连接已迁移时由其当前所属的IO线程释放，线程安全
+     * @param uConnectionID 连接ID
+     * @param onDetached 连接释放或确认不存在后在IO线程中执行，可以为空
+     */
+    void Detach(uint64_t uConnectionID, std::function<void()> onDetached = nullptr);
+
+    /**
+     * @brief 把连接迁移到另一个IO线程，仅在IO线程中调用，不能在连接的回调中调用
+     * @note 迁出前注销套接字和定时器，先在句柄表中改写归属再投递迁入任务，之后投递到本线程的针对该连接的任务都会转交
+     * @param pConnection 本Reactor管理的连接
+     * @param pTarget 目标Reactor
+     */
+    void Migrate(ConnectionImpl *pConnection, Reactor *pTarget);
+
+    /**
+     * @brief 按上次采样以来各连接的负载选出一个迁移到另一个IO线程，仅在IO线程中调用
+     * @param pTarget 目标Reactor
+     * @param uLoad 本线程在上个周期内的负载
+     * @param uBudget 迁移的连接在一个周期内的负载上限，超过时迁移只会让目标线程成为新的热点
+     */
+    void MigrateHottest(Reactor *pTarget, uint64_t uLoad, uint64_t uBudget);
+
+    /**
+     * @brief 获取本IO线程的累计负载，按回调耗时加收发字节数估算，每字节约计1纳秒的拷贝和协议栈开销，线程安全
+     * @return 累计负载
+     */
+    uint64_t GetLoad() const;
+
+    /**
+     * @brief 查找本Reactor管理的连接，仅在IO线程中调用
+     * @param uConnectionID 连接ID
+     * @return 连接指针，不存在返回NULL
+     */
+    ConnectionImpl *FindConnection(uint64_t uConnectionID);
+
+    /**
+     * @brief 网络引擎待发送数据降到全局低水位以下，检查本Reactor中发送被拒绝过的连接，仅在IO线程中调用
+     */
+    void NotifySendDrained();
+
+    /**
+     * @brief 获取单调时钟时间
+     * @return 单调时钟时间，单位: 毫秒
+     */
+    static uint64_t NowMs();
+
+    /**
+     * @brief 获取单调时钟时间，用于统计耗时
+     * @return 单调时钟时间，单位: 纳秒
+     */
+    static uint64_t NowNs();
+
+    /**
+     * @brief 获取本Reactor的时间轮，仅在IO线程中调用
+     * @return 时间轮
+     */
+    TimerWheel &GetTimerWheel() { return m_timerWheel; }
+
+    /**
+     * @brief 获取本轮循环开始时缓存的单调时钟时间，避免每次IO都读取时钟，仅在IO线程中调用
+     * @return 单调时钟时间，单位: 毫秒
+     */
+    uint64_t GetLoopTimeMs() const { return m_uLoopTimeMs; }
+
+    /**
+     * @brief 设置IO线程的CPU和NUMA放置，须在Init之前调用，后端据此把预先分配的缓冲区放到IO线程所在节点
+     * @param placement 放置位置
+     */
+    void SetPlacement(const ThreadPlacement &placement) { m_placement = placement; }
+    const ThreadPlacement &GetPlacement() const { return m_placement; }
+
+    /**
+     * @brief 获取本IO线程的统计，只能在IO线程中修改，任意线程可以读取
+     * @return 统计
+     */
+    ReactorStats &GetStats() { return m_stats; }
+    const ReactorStats &GetStats() const { return m_stats; }
+
+    uint32_t GetIndex() const { return m_uIndex; }
+    NetEngineImpl *GetNetEngine() const { return m_pNetEngine; }
+
+protected:
+    void RunTasks();
+    void FlushPending();
+    void DrainWakeup();
+    void UpdateLoopTime();
+    void RunTimers();
+
+    /**
+     * @brief 计算本轮等待IO事件的超时时间
+     * @param iTimeoutMs 调用方期望的超时时间，单位: 毫秒
+     * @return 实际使用的超时时间，不超过时间轮中下一个定时器的到期时间
+     */
+    int32_t GetPollTimeout(int32_t iTimeoutMs) const;
+
+    /**
+     * @brief 释放已从连接表移除的连接，后端可在IO操作全部完成前保留其资源
+     * @param pConnection 连接
+     */
+    virtual void ReleaseConnection(ConnectionImpl *pConnection);
+
+private:
+    void RemoveConnection(ConnectionImpl *pConnection);
+    void UnlinkConnection(ConnectionImpl *pConnection);
+    bool LinkConnection(ConnectionImpl *pConnection);
+    void AttachMigrated(ConnectionImpl *pConnection);
+    void RunConnectionTask(uint64_t uConnectionID, const std::function<void(ConnectionImpl *)> &task);
+
+protected:
+    int32_t m_iEventFd{-1};
+    uint32_t m_uIndex{0};
+    ThreadPlacement m_placement;
+    ReactorStats m_stats;
+    logger::ILogger *m_pLogger{nullptr};
+
+private:
+    TimerWheel m_timerWheel;   // 仅IO线程访问
+    uint64_t m_uLoopTimeMs{0};
+
+    std::mutex m_mutex;
+    std::vector<std::function<void()>> m_vecTask;
+    std::vector<std::function<void()>> m_vecRunningTask;
+    MpscQueue<FlushRequest> m_flushQueue; // 待刷新连接的就绪队列，节点位于句柄表槽位中
+
+    // 本Reactor管理的连接，连接记录自己的下标，增删均为O(1)，仅IO线程访问
+    std::vector<ConnectionImpl *> m_vecConnection;
+    ConnectionTable *m_pConnectionTable{nullptr};
+    NetEngineImpl *m_pNetEngine{nullptr};
+
+    std::vector<ZeroCopyLinger *> m_vecLinger; // 等待零拷贝完成通知的已关闭套接字，仅IO线程访问
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_REACTOR_H__
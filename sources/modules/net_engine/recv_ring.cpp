@@ -0,0 +1,139 @@
+#include "recv_ring.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+uint32_t RoundUpPowerOfTwo(uint64_t uValue)
+{
+    uint64_t uResult = 1;
+    while (uResult < uValue)
+    {
+        uResult <<= 1;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(uResult, 1ull << 31));
+}
+
+}
+
+bool RecvRing::Init(uint32_t uCapacity)
+{
+    try
+    {
+        m_vecBuffer.resize(RoundUpPowerOfTwo(std::max<uint32_t>(uCapacity, 1)));
+    }
+    catch(const std::exception& e)
+    {
+        return false;
+    }
+    Clear();
+    return true;
+}
+
+void RecvRing::Release()
+{
+    std::vector<uint8_t>().swap(m_vecBuffer);
+    Clear();
+}
+
+bool RecvRing::Reserve(uint32_t uFreeBytes)
+{
+    uint32_t uSize = Size();
+    if (Capacity() - uSize >= uFreeBytes)
+    {
+        return true;
+    }
+
+    uint64_t uRequired = static_cast<uint64_t>(uSize) + uFreeBytes;
+    uint32_t uCapacity = RoundUpPowerOfTwo(std::max<uint64_t>(uRequired, static_cast<uint64_t>(Capacity()) * 2));
+    if (uCapacity < uRequired)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> vecBuffer;
+    try
+    {
+        vecBuffer.resize(uCapacity);
+    }
+    catch(const std::exception& e)
+    {
+        return false;
+    }
+
+    CopyOut(0, vecBuffer.data(), uSize);
+    m_vecBuffer.swap(vecBuffer);
+    m_uHead = 0;
+    m_uTail = uSize;
+    return true;
+}
+
+uint32_t RecvRing::GetFreeSpace(struct iovec (&arrIovec)[2])
+{
+    uint32_t uFree = Capacity() - Size();
+    if (uFree == 0)
+    {
+        return 0;
+    }
+
+    uint32_t uTailIndex = m_uTail & Mask();
+    uint32_t uFirst = std::min(uFree, Capacity() - uTailIndex);
+    arrIovec[0].iov_base = m_vecBuffer.data() + uTailIndex;
+    arrIovec[0].iov_len = uFirst;
+    if (uFirst == uFree)
+    {
+        return 1;
+    }
+
+    arrIovec[1].iov_base = m_vecBuffer.data();
+    arrIovec[1].iov_len = uFree - uFirst;
+    return 2;
+}
+
+void RecvRing::Append(const uint8_t *pData, uint32_t uLength)
+{
+    uint32_t uTailIndex = m_uTail & Mask();
+    uint32_t uFirst = std::min(uLength, Capacity() - uTailIndex);
+    memcpy(m_vecBuffer.data() + uTailIndex, pData, uFirst);
+    memcpy(m_vecBuffer.data(), pData + uFirst, uLength - uFirst);
+    m_uTail += uLength;
+}
+
+const uint8_t *RecvRing::Peek(uint32_t &uLength) const
+{
+    uint32_t uHeadIndex = m_uHead & Mask();
+    uLength = std::min(Size(), Capacity() - uHeadIndex);
+    return m_vecBuffer.data() + uHeadIndex;
+}
+
+void RecvRing::CopyOut(uint32_t uOffset, uint8_t *pDest, uint32_t uLength) const
+{
+    if (uLength == 0)
+    {
+        return;
+    }
+
+    uint32_t uIndex = (m_uHead + uOffset) & Mask();
+    uint32_t uFirst = std::min(uLength, Capacity() - uIndex);
+    memcpy(pDest, m_vecBuffer.data() + uIndex, uFirst);
+    memcpy(pDest + uFirst, m_vecBuffer.data(), uLength - uFirst);
+}
+
+void RecvRing::Consume(uint32_t uBytes)
+{
+    m_uHead += uBytes;
+    if (m_uHead == m_uTail)
+    {
+        Clear();
+    }
+}
+
+}
+}
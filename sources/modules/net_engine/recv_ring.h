@@ -0,0 +1,100 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_RECV_RING_H__
+#define __LITE_DRIVE_NET_ENGINE_RECV_RING_H__
+
+#include <cstdint>
+#include <vector>
+#include <sys/uio.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 连接的接收环形缓冲区，容量为2的幂，空间不足时按倍数扩容
+ * @note 读写位置单调递增，取模得到下标；缓冲区读空时读写位置归零，使后续数据尽量连续
+ */
+class RecvRing
+{
+public:
+    /**
+     * @brief 分配缓冲区
+     * @param uCapacity 初始容量，向上取整为2的幂
+     * @return 是否成功
+     */
+    bool Init(uint32_t uCapacity);
+
+    /**
+     * @brief 释放缓冲区
+     */
+    void Release();
+
+    /**
+     * @brief 清空数据，保留缓冲区
+     */
+    void Clear() { m_uHead = 0; m_uTail = 0; }
+
+    /**
+     * @brief 保证至少有指定大小的空闲空间，不足时扩容并把数据移到开头
+     * @param uFreeBytes 需要的空闲字节数
+     * @return 是否成功
+     */
+    bool Reserve(uint32_t uFreeBytes);
+
+    /**
+     * @brief 获取空闲空间，环绕时分为两段，供readv直接写入
+     * @param arrIovec 输出空闲分段
+     * @return 分段数，0表示没有空闲空间
+     */
+    uint32_t GetFreeSpace(struct iovec (&arrIovec)[2]);
+
+    /**
+     * @brief 提交已写入空闲空间的数据
+     * @param uBytes 写入的字节数
+     */
+    void Commit(uint32_t uBytes) { m_uTail += uBytes; }
+
+    /**
+     * @brief 追加数据，调用前需要Reserve足够的空间
+     * @param pData 数据
+     * @param uLength 数据长度
+     */
+    void Append(const uint8_t *pData, uint32_t uLength);
+
+    /**
+     * @brief 获取从读位置开始的连续数据
+     * @param uLength 输出连续数据的长度，数据环绕时小于Size()
+     * @return 数据指针
+     */
+    const uint8_t *Peek(uint32_t &uLength) const;
+
+    /**
+     * @brief 从读位置之后的偏移处拷贝数据，处理环绕
+     * @param uOffset 相对读位置的偏移
+     * @param pDest 目标缓冲区
+     * @param uLength 拷贝长度，不超过Size() - uOffset
+     */
+    void CopyOut(uint32_t uOffset, uint8_t *pDest, uint32_t uLength) const;
+
+    /**
+     * @brief 丢弃已处理的数据
+     * @param uBytes 字节数
+     */
+    void Consume(uint32_t uBytes);
+
+    uint32_t Size() const { return m_uTail - m_uHead; }
+    bool Empty() const { return m_uTail == m_uHead; }
+    uint32_t Capacity() const { return static_cast<uint32_t>(m_vecBuffer.size()); }
+
+private:
+    uint32_t Mask() const { return Capacity() - 1; }
+
+private:
+    std::vector<uint8_t> m_vecBuffer;
+    uint32_t m_uHead{0}; // 读位置
+    uint32_t m_uTail{0}; // 写位置
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_RECV_RING_H__
@@ -0,0 +1,602 @@
+#include "shm_channel.h"
+#include "connection_impl.h"
+#include <error_code.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint64_t kPageBytes = 4096;
+constexpr uint32_t kHandshakeFds = 3; // 共享内存、服务端门铃、客户端门铃
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory ring requires lock free 64-bit atomics");
+
+/**
+ * @brief 客户端连接后发送的握手消息，随消息以SCM_RIGHTS传递kHandshakeFds个文件描述符
+ */
+struct ShmHello
+{
+    uint32_t uMagic;
+    uint32_t uVersion;
+    uint32_t uRingBytes;
+};
+
+/**
+ * @brief 服务端映射共享内存后回复的握手结果
+ */
+struct ShmAck
+{
+    uint32_t uMagic;
+    int32_t iResult;
+};
+
+void CloseFd(int32_t &iFd)
+{
+    if (iFd >= 0)
+    {
+        close(iFd);
+        iFd = -1;
+    }
+}
+
+}
+
+void ShmChannel::Doorbell::OnIOEvent(uint32_t)
+{
+    pChannel->HandleDoorbell();
+}
+
+ShmChannel::ShmChannel(logger::ILogger *pLogger, const std::string &strName)
+    : m_strName(strName), m_pLogger(pLogger)
+{
+    m_doorbell.pChannel = this;
+}
+
+ShmChannel::~ShmChannel()
+{
+    Close();
+}
+
+void ShmChannel::GetLocalAddress(uint16_t uPort, struct sockaddr_un &addr, socklen_t &uLen)
+{
+    // 抽象命名空间不在文件系统中留下套接字文件，进程退出后自动释放
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    int32_t iLength = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "lite_drive.shm.%u", static_cast<uint32_t>(uPort));
+    uLen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + iLength);
+}
+
+uint64_t ShmChannel::GetHeaderBytes()
+{
+    return (sizeof(ShmRegionHeader) + kPageBytes - 1) / kPageBytes * kPageBytes;
+}
+
+int32_t ShmChannel::Connect(uint16_t uPort, uint32_t uRingBytes)
+{
+    m_bClient = true;
+    m_iFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_iFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to create unix socket, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kSocketFailed;
+    }
+
+    // Unix域套接字的connect不会返回EINPROGRESS，服务端未监听或积压队列已满时直接失败
+    struct sockaddr_un addr;
+    socklen_t uLen = 0;
+    GetLocalAddress(uPort, addr, uLen);
+    if (connect(m_iFd, reinterpret_cast<struct sockaddr *>(&addr), uLen) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kConnectFailed, "{} failed to connect local port {}, errno: {}", m_strName.c_str(), Wrap(uPort), Wrap(errno));
+        return ErrorCode::kConnectFailed;
+    }
+
+    // 抽象命名空间的地址任何本地用户都能抢先绑定，只把共享内存交给同一用户的服务端
+    if (!CheckPeerCredential(m_iFd))
+    {
+        return ErrorCode::kConnectFailed;
+    }
+
+    // 封住大小，服务端映射后客户端不能再缩小文件使对端访问越界
+    int32_t iMemFd = memfd_create("lite_drive_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (iMemFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to create memfd, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kShmFailed;
+    }
+
+    uint64_t uRegionBytes = GetHeaderBytes() + 2 * static_cast<uint64_t>(uRingBytes);
+    if (ftruncate(iMemFd, static_cast<off_t>(uRegionBytes)) != 0
+        || fcntl(iMemFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to size memfd, errno: {}", m_strName.c_str(), Wrap(errno));
+        close(iMemFd);
+        return ErrorCode::kShmFailed;
+    }
+
+    int32_t iRet = MapRegion(iMemFd, uRingBytes);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        close(iMemFd);
+        return iRet;
+    }
+
+    ShmRegionHeader *pHeader = new(m_pRegion) ShmRegionHeader();
+    pHeader->uMagic = kMagic;
+    pHeader->uVersion = kVersion;
+    pHeader->uRingBytes = uRingBytes;
+    SetupRings(true, uRingBytes);
+
+    int32_t iServerDoorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_iLocalDoorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_iPeerDoorbell = iServerDoorbell;
+    if (m_iLocalDoorbell < 0 || m_iPeerDoorbell < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to create doorbell, errno: {}", m_strName.c_str(), Wrap(errno));
+        close(iMemFd);
+        return ErrorCode::kShmFailed;
+    }
+
+    ShmHello hello = {kMagic, kVersion, uRingBytes};
+    struct iovec iovec = {&hello, sizeof(hello)};
+    union
+    {
+        char szBuffer[CMSG_SPACE(sizeof(int32_t) * kHandshakeFds)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iovec;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.szBuffer;
+    msg.msg_controllen = sizeof(control.szBuffer);
+    struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg);
+    pCmsg->cmsg_level = SOL_SOCKET;
+    pCmsg->cmsg_type = SCM_RIGHTS;
+    pCmsg->cmsg_len = CMSG_LEN(sizeof(int32_t) * kHandshakeFds);
+    int32_t arrFd[kHandshakeFds] = {iMemFd, m_iPeerDoorbell, m_iLocalDoorbell};
+    memcpy(CMSG_DATA(pCmsg), arrFd, sizeof(arrFd));
+
+    // 刚建立的套接字发送缓冲区为空，握手消息一次发完
+    ssize_t iSent = sendmsg(m_iFd, &msg, MSG_NOSIGNAL);
+    close(iMemFd);
+    if (iSent != static_cast<ssize_t>(sizeof(hello)))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kConnectFailed, "{} failed to send shm handshake, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kConnectFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t ShmChannel::Accept(int32_t iFd)
+{
+    m_bClient = false;
+    m_iFd = iFd;
+    if (m_iFd < 0)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+
+    // 抽象命名空间的地址没有文件权限控制，拒绝其他用户的进程映射共享内存
+    return CheckPeerCredential(m_iFd) ? ErrorCode::kSuccess : ErrorCode::kShmFailed;
+}
+
+bool ShmChannel::CheckPeerCredential(int32_t iFd)
+{
+    struct ucred cred = {};
+    socklen_t uLen = sizeof(cred);
+    if (getsockopt(iFd, SOL_SOCKET, SO_PEERCRED, &cred, &uLen) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to get peer credential, errno: {}", m_strName.c_str(), Wrap(errno));
+        return false;
+    }
+
+    if (cred.uid != geteuid())
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} reject shm peer, pid: {}, uid: {}", m_strName.c_str(), Wrap(cred.pid), Wrap(cred.uid));
+        return false;
+    }
+    return true;
+}
+
+int32_t ShmChannel::Watch(Reactor *pReactor, uint64_t uConnectionID)
+{
+    // 先记录所属Reactor，注册后IO线程可能立即开始处理事件
+    m_pReactor = pReactor;
+    m_uConnectionID = uConnectionID;
+    int32_t iRet = pReactor->WatchChannel(this);
+    if (iRet == ErrorCode::kSuccess && m_iLocalDoorbell >= 0)
+    {
+        iRet = pReactor->WatchDoorbell(this);
+    }
+
+    if (iRet != ErrorCode::kSuccess)
+    {
+        pReactor->UnwatchChannel(this);
+        m_pReactor = nullptr;
+    }
+    return iRet;
+}
+
+void ShmChannel::Close()
+{
+    if (m_pReactor != nullptr && m_iFd >= 0)
+    {
+        m_pReactor->UnwatchChannel(this);
+    }
+    CloseFd(m_iFd);
+    CloseFd(m_iLocalDoorbell);
+    CloseFd(m_iPeerDoorbell);
+
+    if (m_pRegion != nullptr)
+    {
+        munmap(m_pRegion, m_uRegionBytes);
+        m_pRegion = nullptr;
+        m_uRegionBytes = 0;
+    }
+    m_txRing = Ring();
+    m_rxRing = Ring();
+    m_bReady = false;
+    m_bTxBlocked = false;
+    m_pReactor = nullptr;
+}
+
+int32_t ShmChannel::Write(const uint8_t *pData, uint32_t uLength, uint32_t &uWritten)
+{
+    uWritten = 0;
+    if (!m_bReady)
+    {
+        return ErrorCode::kNotConnected;
+    }
+
+    // 只有本端写uHead，对端可能篡改共享内存，读到的已用空间超过环大小说明通道已损坏
+    ShmRingHeader *pHeader = m_txRing.pHeader;
+    uint64_t uHead = pHeader->uHead.load(std::memory_order_relaxed);
+    uint64_t uUsed = uHead - pHeader->uTail.load();
+    if (uUsed > m_txRing.uBytes)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} shm send ring is corrupted", m_strName.c_str());
+        return ErrorCode::kShmFailed;
+    }
+
+    // 先登记等待再复查，对端先推进uTail再检查登记，两边至少有一方看到对方的修改
+    if (uUsed == m_txRing.uBytes)
+    {
+        pHeader->uProducerWaiting.store(1);
+        uUsed = uHead - pHeader->uTail.load();
+        if (uUsed == m_txRing.uBytes)
+        {
+            m_bTxBlocked = true;
+            return ErrorCode::kWouldBlock;
+        }
+    }
+
+    uint32_t uCopy = std::min(uLength, m_txRing.uBytes - static_cast<uint32_t>(uUsed));
+    uint32_t uOffset = static_cast<uint32_t>(uHead & (m_txRing.uBytes - 1));
+    uint32_t uFirst = std::min(uCopy, m_txRing.uBytes - uOffset);
+    memcpy(m_txRing.pData + uOffset, pData, uFirst);
+    memcpy(m_txRing.pData, pData + uFirst, uCopy - uFirst);
+    pHeader->uHead.store(uHead + uCopy);
+    uWritten = uCopy;
+    return ErrorCode::kSuccess;
+}
+
+void ShmChannel::Notify()
+{
+    if (m_bReady && m_txRing.pHeader->uConsumerWaiting.load() != 0 && m_txRing.pHeader->uConsumerWaiting.exchange(0) != 0)
+    {
+        RingDoorbell(m_iPeerDoorbell);
+    }
+}
+
+void ShmChannel::OnIOEvent(uint32_t uEvents)
+{
+    if (!m_bReady && (uEvents & EPOLLIN))
+    {
+        if (m_bClient)
+        {
+            HandleAck();
+        }
+        else
+        {
+            HandleHello();
+        }
+    }
+
+    // 握手之后套接字上不再有数据，对端关闭或进程退出时断开连接
+    if (IsOpen() && (uEvents & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+    {
+        LOG_EVENT(m_pLogger, ErrorCode::kEvent, "{} shm peer closed", m_strName.c_str());
+        Fail(ECONNRESET);
+    }
+}
+
+int32_t ShmChannel::MapRegion(int32_t iMemFd, uint32_t uRingBytes)
+{
+    uint64_t uRegionBytes = GetHeaderBytes() + 2 * static_cast<uint64_t>(uRingBytes);
+    void *pRegion = mmap(nullptr, uRegionBytes, PROT_READ | PROT_WRITE, MAP_SHARED, iMemFd, 0);
+    if (pRegion == MAP_FAILED)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to map shm region, bytes: {}, errno: {}", m_strName.c_str(), Wrap(uRegionBytes), Wrap(errno));
+        return ErrorCode::kShmFailed;
+    }
+    m_pRegion = pRegion;
+    m_uRegionBytes = uRegionBytes;
+    return ErrorCode::kSuccess;
+}
+
+void ShmChannel::SetupRings(bool bClient, uint32_t uRingBytes)
+{
+    // 环0由客户端写服务端读，环1相反；对端可以随时改写共享内存，环大小只用本端校验过的值
+    ShmRegionHeader *pHeader = static_cast<ShmRegionHeader *>(m_pRegion);
+    uint8_t *pData = static_cast<uint8_t *>(m_pRegion) + GetHeaderBytes();
+    uint32_t uTx = bClient ? 0 : 1;
+    uint32_t uRx = 1 - uTx;
+
+    m_txRing.pHeader = &pHeader->arrRing[uTx];
+    m_txRing.pData = pData + static_cast<uint64_t>(uTx) * uRingBytes;
+    m_txRing.uBytes = uRingBytes;
+    m_rxRing.pHeader = &pHeader->arrRing[uRx];
+    m_rxRing.pData = pData + static_cast<uint64_t>(uRx) * uRingBytes;
+    m_rxRing.uBytes = uRingBytes;
+}
+
+void ShmChannel::HandleHello()
+{
+    ShmHello hello = {};
+    struct iovec iovec = {&hello, sizeof(hello)};
+    union
+    {
+        char szBuffer[CMSG_SPACE(sizeof(int32_t) * kHandshakeFds)];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg = {};
+    msg.msg_iov = &iovec;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.szBuffer;
+    msg.msg_controllen = sizeof(control.szBuffer);
+
+    ssize_t iRecv = 0;
+    do
+    {
+        iRecv = recvmsg(m_iFd, &msg, MSG_CMSG_CLOEXEC);
+    } while (iRecv < 0 && errno == EINTR);
+
+    if (iRecv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return;
+    }
+
+    // 先收下所有传来的描述符，校验失败时一并关闭
+    int32_t arrFd[kHandshakeFds] = {-1, -1, -1};
+    uint32_t uFdCount = 0;
+    for (struct cmsghdr *pCmsg = iRecv > 0 ? CMSG_FIRSTHDR(&msg) : nullptr; pCmsg != nullptr; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+    {
+        if (pCmsg->cmsg_level != SOL_SOCKET || pCmsg->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+
+        uint32_t uCount = static_cast<uint32_t>((pCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int32_t));
+        for (uint32_t i = 0; i < uCount; i++)
+        {
+            int32_t iFd = -1;
+            memcpy(&iFd, CMSG_DATA(pCmsg) + i * sizeof(int32_t), sizeof(iFd));
+            if (uFdCount < kHandshakeFds)
+            {
+                arrFd[uFdCount++] = iFd;
+            }
+            else
+            {
+                close(iFd);
+            }
+        }
+    }
+
+    int32_t iMemFd = arrFd[0];
+    int32_t iRet = ErrorCode::kShmFailed;
+    struct stat st = {};
+    uint32_t uRingBytes = hello.uRingBytes;
+    if (iRecv != static_cast<ssize_t>(sizeof(hello)) || (msg.msg_flags & MSG_CTRUNC) || uFdCount != kHandshakeFds
+        || hello.uMagic != kMagic || hello.uVersion != kVersion)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} received invalid shm handshake", m_strName.c_str());
+    }
+    else if (uRingBytes == 0 || (uRingBytes & (uRingBytes - 1)) != 0 || fstat(iMemFd, &st) != 0
+        || static_cast<uint64_t>(st.st_size) < GetHeaderBytes() + 2 * static_cast<uint64_t>(uRingBytes)
+        || (fcntl(iMemFd, F_GET_SEALS) & F_SEAL_SHRINK) == 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} received invalid shm region, ring bytes: {}", m_strName.c_str(), Wrap(uRingBytes));
+    }
+    else
+    {
+        iRet = MapRegion(iMemFd, uRingBytes);
+    }
+    CloseFd(arrFd[0]);
+
+    ShmRegionHeader *pHeader = static_cast<ShmRegionHeader *>(m_pRegion);
+    if (iRet == ErrorCode::kSuccess && (pHeader->uMagic != kMagic || pHeader->uRingBytes != uRingBytes))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} shm region header mismatch", m_strName.c_str());
+        iRet = ErrorCode::kShmFailed;
+    }
+
+    if (iRet != ErrorCode::kSuccess)
+    {
+        CloseFd(arrFd[1]);
+        CloseFd(arrFd[2]);
+        Fail(EPROTO);
+        return;
+    }
+
+    m_iLocalDoorbell = arrFd[1];
+    m_iPeerDoorbell = arrFd[2];
+    SetupRings(false, uRingBytes);
+
+    // 先注册门铃再回复，客户端收到回复后写入的数据不会丢失通知
+    ShmAck ack = {kMagic, ErrorCode::kSuccess};
+    if (m_pReactor->WatchDoorbell(this) != ErrorCode::kSuccess || send(m_iFd, &ack, sizeof(ack), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(ack)))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} failed to complete shm handshake, errno: {}", m_strName.c_str(), Wrap(errno));
+        Fail(EPROTO);
+        return;
+    }
+
+    m_bReady = true;
+    ConnectionImpl *pConnection = m_pReactor->FindConnection(m_uConnectionID);
+    if (pConnection != nullptr)
+    {
+        pConnection->OnConnectResult(0);
+    }
+}
+
+void ShmChannel::HandleAck()
+{
+    ShmAck ack = {};
+    ssize_t iRecv = 0;
+    do
+    {
+        iRecv = recv(m_iFd, &ack, sizeof(ack), 0);
+    } while (iRecv < 0 && errno == EINTR);
+
+    if (iRecv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return;
+    }
+
+    if (iRecv != static_cast<ssize_t>(sizeof(ack)) || ack.uMagic != kMagic || ack.iResult != ErrorCode::kSuccess)
+    {
+        Fail(iRecv == 0 ? ECONNREFUSED : EPROTO);
+        return;
+    }
+
+    m_bReady = true;
+    ConnectionImpl *pConnection = m_pReactor->FindConnection(m_uConnectionID);
+    if (pConnection != nullptr)
+    {
+        pConnection->OnConnectResult(0);
+    }
+}
+
+void ShmChannel::HandleDoorbell()
+{
+    uint64_t uValue = 0;
+    while (read(m_iLocalDoorbell, &uValue, sizeof(uValue)) < 0 && errno == EINTR)
+    {
+    }
+
+    ConnectionImpl *pConnection = m_bReady ? m_pReactor->FindConnection(m_uConnectionID) : nullptr;
+    if (pConnection == nullptr)
+    {
+        return;
+    }
+
+    // 完整的消息直接在共享内存上回调，单次事件最多处理一个环的数据，之后敲响自己的门铃让出IO线程
+    ShmRingHeader *pHeader = m_rxRing.pHeader;
+    uint64_t uBudget = m_rxRing.uBytes;
+    while (true)
+    {
+        uint64_t uTail = pHeader->uTail.load(std::memory_order_relaxed);
+        uint64_t uUsed = pHeader->uHead.load() - uTail;
+        if (uUsed == 0)
+        {
+            pHeader->uConsumerWaiting.store(1);
+            if (pHeader->uHead.load() == uTail)
+            {
+                break;
+            }
+            pHeader->uConsumerWaiting.store(0);
+            continue;
+        }
+
+        if (uUsed > m_rxRing.uBytes)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kShmFailed, "{} shm recv ring is corrupted", m_strName.c_str());
+            pConnection->HandleClose();
+            return;
+        }
+
+        if (uBudget == 0)
+        {
+            RingDoorbell(m_iLocalDoorbell);
+            break;
+        }
+
+        uint32_t uOffset = static_cast<uint32_t>(uTail & (m_rxRing.uBytes - 1));
+        uint32_t uLength = static_cast<uint32_t>(std::min(std::min<uint64_t>(uUsed, m_rxRing.uBytes - uOffset), uBudget));
+        if (!pConnection->OnReceived(m_rxRing.pData + uOffset, uLength))
+        {
+            pConnection->HandleClose();
+            return;
+        }
+
+        if (!m_bReady)
+        {
+            return;
+        }
+
+        // 不完整的尾部已拷贝到连接的接收缓冲区，整段都可以归还
+        pHeader->uTail.store(uTail + uLength);
+        uBudget -= uLength;
+        if (pHeader->uProducerWaiting.load() != 0 && pHeader->uProducerWaiting.exchange(0) != 0)
+        {
+            RingDoorbell(m_iPeerDoorbell);
+        }
+    }
+
+    // 门铃也可能表示对端腾出了发送环的空间
+    if (m_bTxBlocked)
+    {
+        m_bTxBlocked = false;
+        pConnection->FlushSend();
+    }
+}
+
+void ShmChannel::Fail(int32_t iError)
+{
+    ConnectionImpl *pConnection = m_pReactor != nullptr ? m_pReactor->FindConnection(m_uConnectionID) : nullptr;
+    if (pConnection == nullptr)
+    {
+        Close();
+        return;
+    }
+
+    // 主动连接在握手完成前失败按连接失败处理，其余情况断开连接，通道随连接关闭
+    if (m_bClient && !m_bReady)
+    {
+        pConnection->OnConnectResult(iError);
+    }
+    else
+    {
+        pConnection->HandleClose();
+    }
+}
+
+void ShmChannel::RingDoorbell(int32_t iFd)
+{
+    uint64_t uValue = 1;
+    while (write(iFd, &uValue, sizeof(uValue)) < 0 && errno == EINTR)
+    {
+    }
+}
+
+}
+}
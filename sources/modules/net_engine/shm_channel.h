@@ -0,0 +1,165 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_SHM_CHANNEL_H__
+#define __LITE_DRIVE_NET_ENGINE_SHM_CHANNEL_H__
+
+#include <net_engine.h>
+#include <atomic>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "reactor.h"
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 共享内存中单个方向的环形缓冲区头部，读写位置单调递增，对环大小取模得到偏移
+ * @note 生产者只写uHead，消费者只写uTail，分处不同缓存行避免伪共享
+ */
+struct ShmRingHeader
+{
+    alignas(64) std::atomic<uint64_t> uHead{0};
+    alignas(64) std::atomic<uint64_t> uTail{0};
+    alignas(64) std::atomic<uint32_t> uConsumerWaiting{1}; // 消费者已读空，生产者写入后需要敲对端门铃
+    std::atomic<uint32_t> uProducerWaiting{0};             // 生产者遇到环满，消费者腾出空间后需要敲对端门铃
+};
+
+/**
+ * @brief 共享内存区域头部，之后按页对齐依次存放客户端到服务端、服务端到客户端两个环的数据
+ */
+struct ShmRegionHeader
+{
+    uint32_t uMagic{0};
+    uint32_t uVersion{0};
+    uint32_t uRingBytes{0};
+    ShmRingHeader arrRing[2];
+};
+
+/**
+ * @brief 同一主机上的共享内存通道，用memfd承载一对单生产者单消费者环形缓冲区，eventfd作为门铃
+ * @note 客户端通过抽象命名空间的Unix域套接字连接服务端，创建共享内存和门铃后以SCM_RIGHTS传给服务端，
+ *       之后数据只经过共享内存，Unix域套接字仅用于发现对端退出。除Connect和Accept外只能在所属IO线程中调用
+ */
+class ShmChannel : public IEventHandler
+{
+public:
+    ShmChannel(logger::ILogger *pLogger, const std::string &strName);
+    ~ShmChannel() override;
+
+    ShmChannel(const ShmChannel &) = delete;
+    ShmChannel &operator=(const ShmChannel &) = delete;
+
+    /**
+     * @brief 根据端口生成监听地址，同一主机上端口唯一标识一个服务端，IP不参与
+     * @param uPort 端口
+     * @param addr 输出地址
+     * @param uLen 输出地址长度
+     */
+    static void GetLocalAddress(uint16_t uPort, struct sockaddr_un &addr, socklen_t &uLen);
+
+    /**
+     * @brief 客户端连接本机服务端，创建共享内存和门铃并发送给服务端
+     * @param uPort 服务端端口
+     * @param uRingBytes 单个方向环形缓冲区字节大小，必须为2的幂
+     * @return 0表示成功,否则失败
+     */
+    int32_t Connect(uint16_t uPort, uint32_t uRingBytes);
+
+    /**
+     * @brief 服务端接管已接受的Unix域套接字，等待客户端发送共享内存
+     * @param iFd 已接受的套接字，无论成功与否所有权都转移给通道
+     * @return 0表示成功，对端不是本进程的有效用户时返回kShmFailed
+     */
+    int32_t Accept(int32_t iFd);
+
+    /**
+     * @brief 注册到Reactor，握手完成后通过FindConnection通知所属连接
+     * @param pReactor Reactor
+     * @param uConnectionID 所属连接ID
+     * @return 0表示成功,否则失败
+     */
+    int32_t Watch(Reactor *pReactor, uint64_t uConnectionID);
+
+    /**
+     * @brief 注销并关闭套接字、门铃和共享内存，可以在通道自身的事件处理中调用，对象由连接稍后释放
+     */
+    void Close();
+
+    /**
+     * @brief 写入发送环，环满时登记等待，对端腾出空间后敲响本端门铃
+     * @param pData 数据
+     * @param uLength 数据长度
+     * @param uWritten 输出写入的字节数，可能小于uLength
+     * @return 0表示成功，kWouldBlock表示环已满，否则通道已损坏
+     */
+    int32_t Write(const uint8_t *pData, uint32_t uLength, uint32_t &uWritten);
+
+    /**
+     * @brief 一轮写入结束后调用，对端已读空等待时敲响对端门铃
+     */
+    void Notify();
+
+    void OnIOEvent(uint32_t uEvents) override;
+
+    bool IsOpen() const { return m_iFd >= 0; }
+    int32_t GetFd() const { return m_iFd; }
+    int32_t GetDoorbellFd() const { return m_iLocalDoorbell; }
+    IEventHandler *GetDoorbellHandler() { return &m_doorbell; }
+
+private:
+    /**
+     * @brief 本端对一个环的视图
+     */
+    struct Ring
+    {
+        ShmRingHeader *pHeader{nullptr};
+        uint8_t *pData{nullptr};
+        uint32_t uBytes{0};
+    };
+
+    /**
+     * @brief 门铃事件转交给通道处理
+     */
+    struct Doorbell : public IEventHandler
+    {
+        ShmChannel *pChannel{nullptr};
+        void OnIOEvent(uint32_t uEvents) override;
+    };
+
+    static uint64_t GetHeaderBytes();
+    int32_t MapRegion(int32_t iMemFd, uint32_t uRingBytes);
+    void SetupRings(bool bClient, uint32_t uRingBytes);
+    bool CheckPeerCredential(int32_t iFd);
+    void HandleHello();
+    void HandleAck();
+    void HandleDoorbell();
+    void Fail(int32_t iError);
+    static void RingDoorbell(int32_t iFd);
+
+private:
+    static constexpr uint32_t kMagic = 0x4c445348; // "LDSH"
+    static constexpr uint32_t kVersion = 1;
+
+    int32_t m_iFd{-1};            // Unix域套接字
+    int32_t m_iLocalDoorbell{-1}; // 对端向本端写入数据或腾出空间时敲响
+    int32_t m_iPeerDoorbell{-1};  // 本端向对端写入数据或腾出空间时敲响
+    void *m_pRegion{nullptr};
+    uint64_t m_uRegionBytes{0};
+    Ring m_txRing;
+    Ring m_rxRing;
+    Doorbell m_doorbell;
+
+    bool m_bClient{false};
+    bool m_bReady{false};      // 握手已完成
+    bool m_bTxBlocked{false};  // 发送环曾满，门铃响后重新刷新发送队列，仅IO线程访问
+    Reactor *m_pReactor{nullptr};
+    uint64_t m_uConnectionID{0};
+
+    std::string m_strName;
+    logger::ILogger *m_pLogger{nullptr};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_SHM_CHANNEL_H__
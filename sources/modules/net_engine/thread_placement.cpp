@@ -0,0 +1,178 @@
+#include "thread_placement.h"
+#include <error_code.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint32_t kMaxNumaNodes = 1024;
+constexpr uint32_t kNodeMaskWords = kMaxNumaNodes / (8 * sizeof(unsigned long));
+
+bool ParseCpu(const std::string &strValue, int32_t &iCpu)
+{
+    if (strValue.empty() || strValue.find_first_not_of("0123456789") != std::string::npos)
+    {
+        return false;
+    }
+    long lValue = strtol(strValue.c_str(), nullptr, 10);
+    if (lValue >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    iCpu = static_cast<int32_t>(lValue);
+    return true;
+}
+
+std::string Trim(const std::string &strValue)
+{
+    size_t uBegin = strValue.find_first_not_of(" \t");
+    if (uBegin == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t uEnd = strValue.find_last_not_of(" \t");
+    return strValue.substr(uBegin, uEnd - uBegin + 1);
+}
+
+bool MakeNodeMask(int32_t iNode, unsigned long (&arrMask)[kNodeMaskWords])
+{
+    if (iNode < 0 || static_cast<uint32_t>(iNode) >= kMaxNumaNodes)
+    {
+        return false;
+    }
+    memset(arrMask, 0, sizeof(arrMask));
+    arrMask[iNode / (8 * sizeof(unsigned long))] |= 1ul << (iNode % (8 * sizeof(unsigned long)));
+    return true;
+}
+
+}
+
+bool ThreadPlacement::ParseCpuList(const std::string &strCpus, std::vector<int32_t> &vecCpu)
+{
+    vecCpu.clear();
+    size_t uBegin = 0;
+    while (uBegin <= strCpus.size())
+    {
+        size_t uEnd = strCpus.find(',', uBegin);
+        if (uEnd == std::string::npos)
+        {
+            uEnd = strCpus.size();
+        }
+        std::string strItem = Trim(strCpus.substr(uBegin, uEnd - uBegin));
+        uBegin = uEnd + 1;
+        if (strItem.empty())
+        {
+            continue;
+        }
+
+        size_t uDash = strItem.find('-');
+        int32_t iFirst = 0;
+        int32_t iLast = 0;
+        if (uDash == std::string::npos)
+        {
+            if (!ParseCpu(strItem, iFirst))
+            {
+                return false;
+            }
+            iLast = iFirst;
+        }
+        else if (!ParseCpu(Trim(strItem.substr(0, uDash)), iFirst) || !ParseCpu(Trim(strItem.substr(uDash + 1)), iLast) || iFirst > iLast)
+        {
+            return false;
+        }
+
+        for (int32_t iCpu = iFirst; iCpu <= iLast; iCpu++)
+        {
+            vecCpu.push_back(iCpu);
+        }
+    }
+    return true;
+}
+
+int32_t ThreadPlacement::GetNumaNode(int32_t iCpu)
+{
+    // cpuN目录下的nodeK链接指向所在节点，未启用NUMA的内核没有该链接
+    std::string strPath = "/sys/devices/system/cpu/cpu" + std::to_string(iCpu);
+    DIR *pDir = opendir(strPath.c_str());
+    if (pDir == nullptr)
+    {
+        return -1;
+    }
+
+    int32_t iNode = -1;
+    struct dirent *pEntry = nullptr;
+    while ((pEntry = readdir(pDir)) != nullptr)
+    {
+        int32_t iValue = 0;
+        if (strncmp(pEntry->d_name, "node", 4) == 0 && ParseCpu(pEntry->d_name + 4, iValue))
+        {
+            iNode = iValue;
+            break;
+        }
+    }
+    closedir(pDir);
+    return iNode;
+}
+
+void ThreadPlacement::Set(int32_t iCpu, bool bNumaLocal)
+{
+    m_iCpu = iCpu;
+    m_iNumaNode = (iCpu >= 0 && bNumaLocal) ? GetNumaNode(iCpu) : -1;
+}
+
+int32_t ThreadPlacement::Apply() const
+{
+    if (m_iCpu < 0)
+    {
+        return ErrorCode::kSuccess;
+    }
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(m_iCpu, &cpuSet);
+    int32_t iRet = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+    if (iRet != 0)
+    {
+        errno = iRet;
+        return ErrorCode::kInvalidParam;
+    }
+
+    // 优先而不是强制使用本地节点，本地内存耗尽时仍可从其他节点分配
+    unsigned long arrMask[kNodeMaskWords];
+    if (MakeNodeMask(m_iNumaNode, arrMask) && syscall(SYS_set_mempolicy, MPOL_PREFERRED, arrMask, kMaxNumaNodes + 1) != 0)
+    {
+        return ErrorCode::kInvalidCall;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t ThreadPlacement::BindMemory(void *pAddr, size_t uBytes) const
+{
+    unsigned long arrMask[kNodeMaskWords];
+    if (pAddr == nullptr || uBytes == 0 || !MakeNodeMask(m_iNumaNode, arrMask))
+    {
+        return ErrorCode::kSuccess;
+    }
+
+    if (syscall(SYS_mbind, pAddr, uBytes, MPOL_PREFERRED, arrMask, kMaxNumaNodes + 1, 0) != 0)
+    {
+        return ErrorCode::kInvalidCall;
+    }
+    return ErrorCode::kSuccess;
+}
+
+}
+}
@@ -0,0 +1,67 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_THREAD_PLACEMENT_H__
+#define __LITE_DRIVE_NET_ENGINE_THREAD_PLACEMENT_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 线程的CPU和NUMA节点放置
+ * @note 不依赖libnuma，NUMA拓扑从sysfs读取，内存策略直接使用系统调用，单节点或不支持NUMA的内核上退化为只绑定CPU
+ */
+class ThreadPlacement
+{
+public:
+    /**
+     * @brief 解析CPU列表，格式与taskset一致，如"0-3,8,10-11"
+     * @param strCpus CPU列表
+     * @param vecCpu 输出CPU编号，保持配置顺序
+     * @return 是否成功，空列表返回true且输出为空
+     */
+    static bool ParseCpuList(const std::string &strCpus, std::vector<int32_t> &vecCpu);
+
+    /**
+     * @brief 查询CPU所在的NUMA节点
+     * @param iCpu CPU编号
+     * @return NUMA节点编号，未知返回-1
+     */
+    static int32_t GetNumaNode(int32_t iCpu);
+
+    /**
+     * @brief 设置放置位置
+     * @param iCpu 绑定的CPU，-1表示不绑定
+     * @param bNumaLocal 是否优先从CPU所在NUMA节点分配内存
+     */
+    void Set(int32_t iCpu, bool bNumaLocal);
+
+    /**
+     * @brief 将调用线程绑定到CPU，并把之后的内存分配优先放到所在NUMA节点
+     * @return 0表示成功,否则失败
+     */
+    int32_t Apply() const;
+
+    /**
+     * @brief 将已映射但尚未访问的内存绑定到本放置的NUMA节点，用于在其他线程中预先分配的缓冲区
+     * @param pAddr 页对齐的起始地址
+     * @param uBytes 字节数
+     * @return 0表示成功或无需绑定,否则失败
+     */
+    int32_t BindMemory(void *pAddr, size_t uBytes) const;
+
+    int32_t GetCpu() const { return m_iCpu; }
+    int32_t GetNumaNode() const { return m_iNumaNode; }
+
+private:
+    int32_t m_iCpu{-1};
+    int32_t m_iNumaNode{-1}; // 不启用NUMA本地分配时为-1
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_THREAD_PLACEMENT_H__
@@ -0,0 +1,193 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+TimerWheel::TimerWheel()
+{
+    for (auto &head : m_arrSlots)
+    {
+        head.pPrev = &head;
+        head.pNext = &head;
+    }
+}
+
+TimerWheel::~TimerWheel()
+{
+    // 定时器由使用方持有，这里只解除链接，避免使用方析构时访问已释放的哨兵
+    for (auto &head : m_arrSlots)
+    {
+        while (head.pNext != &head)
+        {
+            Unlink(head.pNext);
+        }
+    }
+}
+
+void TimerWheel::Start(uint64_t uNowMs)
+{
+    m_uCurrentTick = uNowMs / kTickMs;
+}
+
+void TimerWheel::Schedule(Timer *pTimer, uint64_t uExpireMs)
+{
+    Cancel(pTimer);
+    pTimer->uExpireTick = (uExpireMs + kTickMs - 1) / kTickMs;
+    Link(pTimer, m_uCurrentTick + 1);
+    m_uTimerCount++;
+}
+
+void TimerWheel::Cancel(Timer *pTimer)
+{
+    if (pTimer->IsActive())
+    {
+        Unlink(pTimer);
+        m_uTimerCount--;
+    }
+}
+
+void TimerWheel::Advance(uint64_t uNowMs)
+{
+    uint64_t uTargetTick = uNowMs / kTickMs;
+    if (m_uTimerCount == 0)
+    {
+        m_uCurrentTick = std::max(m_uCurrentTick, uTargetTick);
+        return;
+    }
+
+    while (m_uCurrentTick < uTargetTick)
+    {
+        m_uCurrentTick++;
+
+        // 第0层转完一圈时从上层下放一个槽位，上层同样转完一圈时继续向上
+        if ((m_uCurrentTick & (kLevel0Slots - 1)) == 0)
+        {
+            for (uint32_t uLevel = 1; uLevel < kLevelCount; uLevel++)
+            {
+                Cascade(uLevel);
+                uint32_t uShift = kLevel0Bits + (uLevel - 1) * kLevelBits;
+                if (((m_uCurrentTick >> uShift) & (kLevelSlots - 1)) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        Expire(&m_arrSlots[m_uCurrentTick & (kLevel0Slots - 1)]);
+    }
+}
+
+int32_t TimerWheel::GetTimeoutMs(uint64_t uNowMs, int32_t iMaxMs) const
+{
+    if (m_uTimerCount == 0)
+    {
+        return iMaxMs;
+    }
+
+    // 第0层找到最近的非空槽位；全空时下一个事件是上层槽位下放
+    uint64_t uNextTick = ((m_uCurrentTick >> kLevel0Bits) + 1) << kLevel0Bits;
+    for (uint64_t uTick = m_uCurrentTick + 1; uTick < m_uCurrentTick + kLevel0Slots; uTick++)
+    {
+        const Timer &head = m_arrSlots[uTick & (kLevel0Slots - 1)];
+        if (head.pNext != &head)
+        {
+            uNextTick = uTick;
+            break;
+        }
+    }
+
+    uint64_t uNextMs = uNextTick * kTickMs;
+    uint64_t uWaitMs = uNextMs > uNowMs ? uNextMs - uNowMs : 0;
+    if (iMaxMs >= 0 && uWaitMs > static_cast<uint64_t>(iMaxMs))
+    {
+        return iMaxMs;
+    }
+    return static_cast<int32_t>(uWaitMs);
+}
+
+void TimerWheel::Link(Timer *pTimer, uint64_t uMinTick)
+{
+    // 新调度的已过期定时器在下一个刻度执行；下放的定时器可能恰好在当前刻度到期
+    uint64_t uExpireTick = std::max(pTimer->uExpireTick, uMinTick);
+    uint64_t uDelta = uExpireTick - m_uCurrentTick;
+
+    Timer *pHead = nullptr;
+    if (uDelta < kLevel0Slots)
+    {
+        pHead = &m_arrSlots[uExpireTick & (kLevel0Slots - 1)];
+    }
+    else
+    {
+        uint32_t uLevel = 1;
+        uint32_t uShift = kLevel0Bits;
+        while (uLevel < kLevelCount - 1 && uDelta >= (1ull << (uShift + kLevelBits)))
+        {
+            uLevel++;
+            uShift += kLevelBits;
+        }
+
+        // 超出最高层跨度的定时器放在最高层的最远槽位，下放时再重新计算
+        if (uDelta >= (1ull << (uShift + kLevelBits)))
+        {
+            uExpireTick = m_uCurrentTick + (1ull << (uShift + kLevelBits)) - 1;
+        }
+        pHead = &m_arrSlots[kLevel0Slots + (uLevel - 1) * kLevelSlots + ((uExpireTick >> uShift) & (kLevelSlots - 1))];
+    }
+
+    pTimer->pPrev = pHead->pPrev;
+    pTimer->pNext = pHead;
+    pHead->pPrev->pNext = pTimer;
+    pHead->pPrev = pTimer;
+}
+
+void TimerWheel::Unlink(Timer *pTimer)
+{
+    pTimer->pPrev->pNext = pTimer->pNext;
+    pTimer->pNext->pPrev = pTimer->pPrev;
+    pTimer->pPrev = nullptr;
+    pTimer->pNext = nullptr;
+}
+
+void TimerWheel::Cascade(uint32_t uLevel)
+{
+    uint32_t uShift = kLevel0Bits + (uLevel - 1) * kLevelBits;
+    Timer &head = m_arrSlots[kLevel0Slots + (uLevel - 1) * kLevelSlots + ((m_uCurrentTick >> uShift) & (kLevelSlots - 1))];
+
+    // 先摘下整条链表，重新挂载时不会回到同一个槽位
+    Timer list;
+    if (head.pNext == &head)
+    {
+        return;
+    }
+    list.pNext = head.pNext;
+    list.pPrev = head.pPrev;
+    list.pNext->pPrev = &list;
+    list.pPrev->pNext = &list;
+    head.pPrev = &head;
+    head.pNext = &head;
+
+    while (list.pNext != &list)
+    {
+        Timer *pTimer = list.pNext;
+        Unlink(pTimer);
+        Link(pTimer, m_uCurrentTick);
+    }
+}
+
+void TimerWheel::Expire(Timer *pHead)
+{
+    // 逐个摘下再回调，回调中取消其他定时器或重新调度自己都是安全的
+    while (pHead->pNext != pHead)
+    {
+        Timer *pTimer = pHead->pNext;
+        Unlink(pTimer);
+        m_uTimerCount--;
+        pTimer->callback();
+    }
+}
+
+}
+}
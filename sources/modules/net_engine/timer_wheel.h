@@ -0,0 +1,96 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_TIMER_WHEEL_H__
+#define __LITE_DRIVE_NET_ENGINE_TIMER_WHEEL_H__
+
+#include <cstdint>
+#include <functional>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 定时器节点，由使用方持有，通过双向链表挂在时间轮的槽位上，调度和取消不分配内存
+ */
+struct Timer
+{
+    Timer *pPrev{nullptr};
+    Timer *pNext{nullptr};
+    uint64_t uExpireTick{0};
+    std::function<void()> callback; // 到期回调，在IO线程中执行，可以在回调中重新调度自己
+
+    bool IsActive() const { return pPrev != nullptr; }
+};
+
+/**
+ * @brief 分层时间轮，每个IO线程一个，只能在所属IO线程中使用
+ * @note 第0层256个槽位，每个槽位一个刻度；其余3层各64个槽位，每层跨度是下一层的整圈。
+ *       调度和取消为O(1)，推进时间时上层槽位到期后整体下放到下一层
+ */
+class TimerWheel
+{
+public:
+    TimerWheel();
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * @brief 设置时间轮的起始时间
+     * @param uNowMs 当前单调时钟时间，单位: 毫秒
+     */
+    void Start(uint64_t uNowMs);
+
+    /**
+     * @brief 调度定时器，已调度的定时器先取消
+     * @param pTimer 定时器
+     * @param uExpireMs 到期时间，单调时钟，单位: 毫秒，按刻度向上取整
+     */
+    void Schedule(Timer *pTimer, uint64_t uExpireMs);
+
+    /**
+     * @brief 取消定时器，未调度时不做任何事
+     * @param pTimer 定时器
+     */
+    void Cancel(Timer *pTimer);
+
+    /**
+     * @brief 推进时间并执行到期的定时器
+     * @param uNowMs 当前单调时钟时间，单位: 毫秒
+     */
+    void Advance(uint64_t uNowMs);
+
+    /**
+     * @brief 计算距离下一个可能到期的刻度的时间
+     * @param uNowMs 当前单调时钟时间，单位: 毫秒
+     * @param iMaxMs 最长等待时间，单位: 毫秒，负数表示无限
+     * @return 等待时间，单位: 毫秒，不超过iMaxMs
+     */
+    int32_t GetTimeoutMs(uint64_t uNowMs, int32_t iMaxMs) const;
+
+    uint64_t GetTimerCount() const { return m_uTimerCount; }
+
+private:
+    void Link(Timer *pTimer, uint64_t uMinTick);
+    static void Unlink(Timer *pTimer);
+    void Cascade(uint32_t uLevel);
+    void Expire(Timer *pHead);
+
+private:
+    static constexpr uint64_t kTickMs = 10;      // 刻度，单位: 毫秒
+    static constexpr uint32_t kLevel0Bits = 8;
+    static constexpr uint32_t kLevelBits = 6;
+    static constexpr uint32_t kLevelCount = 4;
+    static constexpr uint32_t kLevel0Slots = 1u << kLevel0Bits;
+    static constexpr uint32_t kLevelSlots = 1u << kLevelBits;
+    static constexpr uint32_t kSlotCount = kLevel0Slots + (kLevelCount - 1) * kLevelSlots;
+
+    Timer m_arrSlots[kSlotCount]; // 各层槽位的循环链表哨兵，第0层在前
+    uint64_t m_uCurrentTick{0}; // 已处理到的刻度
+    uint64_t m_uTimerCount{0};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_TIMER_WHEEL_H__
@@ -0,0 +1,460 @@
+#include "udp_socket.h"
+#include "listener_impl.h"
+#include <error_code.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+bool UdpBatch::Reserve(uint32_t uBatchSize)
+{
+    if (vecMsg.size() >= uBatchSize)
+    {
+        return true;
+    }
+
+    try
+    {
+        vecMsg.resize(uBatchSize);
+        vecIovec.resize(static_cast<size_t>(uBatchSize) * kMaxSegments);
+        vecAddr.resize(uBatchSize);
+        vecControl.resize(static_cast<size_t>(uBatchSize) * kControlBytes);
+        vecRecvBuffer.resize(static_cast<size_t>(uBatchSize) * kRecvBufferBytes);
+        vecItemCount.resize(uBatchSize);
+    }
+    catch(const std::exception& e)
+    {
+        vecMsg.clear();
+        return false;
+    }
+    return true;
+}
+
+UdpSocket::UdpSocket(logger::ILogger *pLogger, const ConnectionOptions &options, const std::string &strName)
+    : m_options(options), m_strName(strName), m_pLogger(pLogger)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+    Close();
+}
+
+int32_t UdpSocket::Open(const struct sockaddr_in &localAddr, const struct sockaddr_in *pRemoteAddr, bool bReusePort)
+{
+    m_iFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_iFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to create udp socket, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kSocketFailed;
+    }
+
+    int32_t iValue = 1;
+    setsockopt(m_iFd, SOL_SOCKET, SO_REUSEADDR, &iValue, sizeof(iValue));
+    if (bReusePort && setsockopt(m_iFd, SOL_SOCKET, SO_REUSEPORT, &iValue, sizeof(iValue)) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} failed to set SO_REUSEPORT, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kSocketFailed;
+    }
+
+    if (m_options.uSocketBufferBytes > 0)
+    {
+        iValue = static_cast<int32_t>(m_options.uSocketBufferBytes);
+        setsockopt(m_iFd, SOL_SOCKET, SO_SNDBUF, &iValue, sizeof(iValue));
+        setsockopt(m_iFd, SOL_SOCKET, SO_RCVBUF, &iValue, sizeof(iValue));
+    }
+    SetBusyPoll(m_iFd, m_options);
+
+    if (bind(m_iFd, reinterpret_cast<const struct sockaddr *>(&localAddr), sizeof(localAddr)) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kBindFailed, "{} failed to bind udp socket, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kBindFailed;
+    }
+
+    if (pRemoteAddr != nullptr && connect(m_iFd, reinterpret_cast<const struct sockaddr *>(pRemoteAddr), sizeof(*pRemoteAddr)) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kConnectFailed, "{} failed to connect udp socket, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kConnectFailed;
+    }
+
+    // 能读取UDP_SEGMENT说明内核支持GSO，UDP_GRO设置成功后收到的数据报可能由多个等长分段合并而成
+    if (m_options.bUdpOffload)
+    {
+        int32_t iSegment = 0;
+        socklen_t uLen = sizeof(iSegment);
+        m_bGso = getsockopt(m_iFd, SOL_UDP, UDP_SEGMENT, &iSegment, &uLen) == 0;
+        iValue = 1;
+        m_bGro = setsockopt(m_iFd, SOL_UDP, UDP_GRO, &iValue, sizeof(iValue)) == 0;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t UdpSocket::Watch(Reactor *pReactor)
+{
+    // 先记录所属Reactor，注册后IO线程可能立即开始接收
+    m_pReactor = pReactor;
+    int32_t iRet = pReactor->WatchDatagram(this);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        m_pReactor = nullptr;
+    }
+    return iRet;
+}
+
+void UdpSocket::Close()
+{
+    if (m_iFd >= 0)
+    {
+        if (m_pReactor != nullptr)
+        {
+            m_pReactor->UnwatchDatagram(this);
+        }
+        close(m_iFd);
+        m_iFd = -1;
+    }
+
+    // 接入连接依赖本套接字收发，一并关闭
+    std::vector<uint64_t> vecPeer;
+    try
+    {
+        vecPeer.reserve(m_umapPeer.size());
+        for (auto &item : m_umapPeer)
+        {
+            vecPeer.push_back(item.second);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to collect udp peers", m_strName.c_str());
+    }
+    m_umapPeer.clear();
+
+    for (auto uConnectionID : vecPeer)
+    {
+        ConnectionImpl *pConnection = m_pReactor != nullptr ? m_pReactor->FindConnection(uConnectionID) : nullptr;
+        if (pConnection != nullptr)
+        {
+            pConnection->HandleClose();
+        }
+    }
+    m_vecBlocked.clear();
+    m_pReactor = nullptr;
+}
+
+bool UdpSocket::AddPeer(const struct sockaddr_in &addr, uint64_t uConnectionID)
+{
+    try
+    {
+        m_umapPeer[PeerKey(addr)] = uConnectionID;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to add udp peer", m_strName.c_str());
+        return false;
+    }
+    return true;
+}
+
+void UdpSocket::RemovePeer(const struct sockaddr_in &addr)
+{
+    m_umapPeer.erase(PeerKey(addr));
+}
+
+int32_t UdpSocket::Send(const struct sockaddr_in *pAddr, const std::deque<SendItem> &dequeItems, uint32_t &uItems, uint64_t &uBytes)
+{
+    uItems = 0;
+    uBytes = 0;
+    if (!m_pBatch->Reserve(m_options.uUdpBatchSize))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate udp batch", m_strName.c_str());
+        return ErrorCode::kNoMemory;
+    }
+
+    uint32_t uMsgCount = 0;
+    size_t uIndex = 0;
+    while (uIndex < dequeItems.size() && uMsgCount < m_options.uUdpBatchSize)
+    {
+        // 连续等长的小消息合并为一次GSO发送，由内核按分段大小切成多个数据报，最后一段可以较短
+        uint32_t uSegment = dequeItems[uIndex].pMessage->uLength;
+        uint32_t uTotal = uSegment;
+        uint32_t uCount = 1;
+        while (m_bGso && uSegment <= kGsoMaxSegmentBytes && uIndex + uCount < dequeItems.size() && uCount < UdpBatch::kMaxSegments)
+        {
+            uint32_t uLength = dequeItems[uIndex + uCount].pMessage->uLength;
+            if (uLength > uSegment || uTotal + uLength > UdpBatch::kMaxDatagramBytes)
+            {
+                break;
+            }
+            uTotal += uLength;
+            uCount++;
+            if (uLength < uSegment)
+            {
+                break;
+            }
+        }
+
+        struct iovec *pIovec = &m_pBatch->vecIovec[static_cast<size_t>(uMsgCount) * UdpBatch::kMaxSegments];
+        for (uint32_t i = 0; i < uCount; i++)
+        {
+            const MessageImpl *pMessage = dequeItems[uIndex + i].pMessage;
+            pIovec[i].iov_base = pMessage->pData;
+            pIovec[i].iov_len = pMessage->uLength;
+        }
+
+        struct msghdr &msg = m_pBatch->vecMsg[uMsgCount].msg_hdr;
+        msg = {};
+        msg.msg_name = const_cast<struct sockaddr_in *>(pAddr);
+        msg.msg_namelen = pAddr != nullptr ? sizeof(*pAddr) : 0;
+        msg.msg_iov = pIovec;
+        msg.msg_iovlen = uCount;
+        if (uCount > 1)
+        {
+            uint8_t *pControl = &m_pBatch->vecControl[static_cast<size_t>(uMsgCount) * UdpBatch::kControlBytes];
+            msg.msg_control = pControl;
+            msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg);
+            pCmsg->cmsg_level = SOL_UDP;
+            pCmsg->cmsg_type = UDP_SEGMENT;
+            pCmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t uSegmentBytes = static_cast<uint16_t>(uSegment);
+            memcpy(CMSG_DATA(pCmsg), &uSegmentBytes, sizeof(uSegmentBytes));
+        }
+        m_pBatch->vecItemCount[uMsgCount] = uCount;
+        uIndex += uCount;
+        uMsgCount++;
+    }
+
+    int32_t iSent = 0;
+    do
+    {
+        iSent = sendmmsg(m_iFd, m_pBatch->vecMsg.data(), uMsgCount, MSG_NOSIGNAL);
+        m_pReactor->GetStats().uSyscalls.Add();
+    } while (iSent < 0 && errno == EINTR);
+
+    if (iSent < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            m_pReactor->GetStats().uEagains.Add();
+            return ErrorCode::kWouldBlock;
+        }
+
+        // 网卡不支持校验和卸载时GSO发送失败，之后逐个发送，本次调用方重试
+        if (m_bGso && (errno == EIO || errno == EINVAL))
+        {
+            LOG_WARN(m_pLogger, ErrorCode::kSocketFailed, "{} udp segmentation offload failed, errno: {}, disable it", m_strName.c_str(), Wrap(errno));
+            m_bGso = false;
+            return ErrorCode::kSuccess;
+        }
+
+        LOG_WARN(m_pLogger, ErrorCode::kSocketFailed, "{} udp send failed, errno: {}", m_strName.c_str(), Wrap(errno));
+        return ErrorCode::kSocketFailed;
+    }
+
+    for (int32_t i = 0; i < iSent; i++)
+    {
+        uItems += m_pBatch->vecItemCount[i];
+        uBytes += m_pBatch->vecMsg[i].msg_len;
+    }
+    return ErrorCode::kSuccess;
+}
+
+void UdpSocket::WaitWritable(uint64_t uConnectionID)
+{
+    try
+    {
+        m_vecBlocked.push_back(uConnectionID);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to wait udp socket writable", m_strName.c_str());
+    }
+}
+
+void UdpSocket::OnIOEvent(uint32_t uEvents)
+{
+    if (uEvents & (EPOLLIN | EPOLLERR))
+    {
+        HandleRead();
+    }
+
+    if ((uEvents & EPOLLOUT) && m_iFd >= 0)
+    {
+        HandleWrite();
+    }
+}
+
+uint64_t UdpSocket::PeerKey(const struct sockaddr_in &addr)
+{
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+void UdpSocket::HandleRead()
+{
+    if (!m_pBatch->Reserve(m_options.uUdpBatchSize))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to allocate udp batch", m_strName.c_str());
+        return;
+    }
+
+    // 边沿触发，读到EAGAIN或不满一批为止
+    uint32_t uBatchSize = m_options.uUdpBatchSize;
+    while (m_iFd >= 0)
+    {
+        for (uint32_t i = 0; i < uBatchSize; i++)
+        {
+            struct iovec &iovec = m_pBatch->vecIovec[i];
+            iovec.iov_base = &m_pBatch->vecRecvBuffer[static_cast<size_t>(i) * UdpBatch::kRecvBufferBytes];
+            iovec.iov_len = UdpBatch::kRecvBufferBytes;
+
+            struct msghdr &msg = m_pBatch->vecMsg[i].msg_hdr;
+            msg = {};
+            msg.msg_name = &m_pBatch->vecAddr[i];
+            msg.msg_namelen = sizeof(struct sockaddr_in);
+            msg.msg_iov = &iovec;
+            msg.msg_iovlen = 1;
+            msg.msg_control = &m_pBatch->vecControl[static_cast<size_t>(i) * UdpBatch::kControlBytes];
+            msg.msg_controllen = UdpBatch::kControlBytes;
+        }
+
+        int32_t iCount = recvmmsg(m_iFd, m_pBatch->vecMsg.data(), uBatchSize, MSG_DONTWAIT, nullptr);
+        m_pReactor->GetStats().uSyscalls.Add();
+        if (iCount < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // 已connect的套接字收到ICMP端口不可达，远程没有在监听
+            if (errno == ECONNREFUSED && m_uOwnerID != 0)
+            {
+                ConnectionImpl *pConnection = m_pReactor->FindConnection(m_uOwnerID);
+                if (pConnection != nullptr)
+                {
+                    pConnection->HandleClose();
+                }
+                return;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                LOG_WARN(m_pLogger, ErrorCode::kSocketFailed, "{} udp recv failed, errno: {}", m_strName.c_str(), Wrap(errno));
+                return;
+            }
+            m_pReactor->GetStats().uEagains.Add();
+            return;
+        }
+
+        for (int32_t i = 0; i < iCount && m_iFd >= 0; i++)
+        {
+            struct msghdr &msg = m_pBatch->vecMsg[i].msg_hdr;
+            if (msg.msg_flags & MSG_TRUNC)
+            {
+                LOG_WARN(m_pLogger, ErrorCode::kInvalidParam, "{} drop truncated udp datagram", m_strName.c_str());
+                continue;
+            }
+
+            uint32_t uSegmentBytes = 0;
+            for (struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg); m_bGro && pCmsg != nullptr; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+            {
+                if (pCmsg->cmsg_level == SOL_UDP && pCmsg->cmsg_type == UDP_GRO)
+                {
+                    int32_t iSegment = 0;
+                    memcpy(&iSegment, CMSG_DATA(pCmsg), sizeof(iSegment));
+                    uSegmentBytes = static_cast<uint32_t>(iSegment);
+                }
+            }
+
+            const uint8_t *pData = static_cast<const uint8_t *>(m_pBatch->vecIovec[i].iov_base);
+            Dispatch(m_pBatch->vecAddr[i], pData, m_pBatch->vecMsg[i].msg_len, uSegmentBytes);
+        }
+
+        if (static_cast<uint32_t>(iCount) < uBatchSize)
+        {
+            return;
+        }
+    }
+}
+
+void UdpSocket::HandleWrite()
+{
+    if (m_vecBlocked.empty())
+    {
+        return;
+    }
+
+    // 刷新过程中可能再次阻塞并重新登记，先换出当前列表
+    m_vecRunningBlocked.swap(m_vecBlocked);
+    for (auto uConnectionID : m_vecRunningBlocked)
+    {
+        // 独占套接字的连接关闭时套接字随之关闭
+        if (m_iFd < 0)
+        {
+            break;
+        }
+
+        ConnectionImpl *pConnection = m_pReactor->FindConnection(uConnectionID);
+        if (pConnection != nullptr)
+        {
+            pConnection->FlushSend();
+        }
+    }
+    m_vecRunningBlocked.clear();
+}
+
+ConnectionImpl *UdpSocket::FindPeer(const struct sockaddr_in &addr)
+{
+    if (m_uOwnerID != 0)
+    {
+        return m_pReactor->FindConnection(m_uOwnerID);
+    }
+
+    auto it = m_umapPeer.find(PeerKey(addr));
+    if (it != m_umapPeer.end())
+    {
+        ConnectionImpl *pConnection = m_pReactor->FindConnection(it->second);
+        if (pConnection != nullptr)
+        {
+            return pConnection;
+        }
+        m_umapPeer.erase(it);
+    }
+
+    // 新的远程地址，由监听器创建接入连接，创建时登记到本套接字
+    return m_pListener != nullptr ? m_pListener->OnDatagramPeer(this, addr) : nullptr;
+}
+
+void UdpSocket::Dispatch(const struct sockaddr_in &addr, const uint8_t *pData, uint32_t uLength, uint32_t uSegmentBytes)
+{
+    ConnectionImpl *pConnection = FindPeer(addr);
+    if (pConnection == nullptr)
+    {
+        return;
+    }
+
+    // GRO合并的数据报按分段大小还原为发送方的各个数据报
+    if (uSegmentBytes == 0 || uSegmentBytes >= uLength)
+    {
+        uSegmentBytes = uLength;
+    }
+
+    for (uint32_t uOffset = 0; uOffset < uLength; uOffset += uSegmentBytes)
+    {
+        if (!pConnection->OnDatagram(pData + uOffset, std::min(uSegmentBytes, uLength - uOffset)))
+        {
+            pConnection->HandleClose();
+            return;
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,160 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_UDP_SOCKET_H__
+#define __LITE_DRIVE_NET_ENGINE_UDP_SOCKET_H__
+
+#include <net_engine.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "reactor.h"
+#include "connection_impl.h"
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+class ListenerImpl;
+
+/**
+ * @brief 同一IO线程内所有UDP套接字共用的批量收发缓冲区，仅IO线程访问
+ */
+struct UdpBatch
+{
+    static constexpr uint32_t kMaxDatagramBytes = 65507;   // IPv4下单个UDP数据报的最大载荷
+    static constexpr uint32_t kRecvBufferBytes = 64 * 1024; // 单个接收缓冲区大小，GRO合并后的数据报不超过64KB
+    static constexpr uint32_t kMaxSegments = 64;            // 单次GSO发送的最大分段数，与较早内核的UDP_MAX_SEGMENTS一致
+    static constexpr uint32_t kControlBytes = 64;           // 单个数据报的控制消息缓冲区大小
+
+    std::vector<struct mmsghdr> vecMsg;
+    std::vector<struct iovec> vecIovec;      // 接收时每个数据报一段，发送时每个数据报最多kMaxSegments段
+    std::vector<struct sockaddr_in> vecAddr;
+    std::vector<uint8_t> vecControl;
+    std::vector<uint8_t> vecRecvBuffer;
+    std::vector<uint32_t> vecItemCount;      // 发送时每个数据报包含的消息数
+
+    /**
+     * @brief 保证能容纳指定数量的数据报，只增不减
+     * @param uBatchSize 数据报数量
+     * @return 是否成功
+     */
+    bool Reserve(uint32_t uBatchSize);
+};
+
+/**
+ * @brief UDP套接字，用recvmmsg/sendmmsg批量收发，按远程地址把数据报分发给对应的连接
+ * @note 监听器的套接字为每个新的远程地址创建一个接入连接，连接与套接字属于同一个IO线程；
+ *       主动创建的连接独占一个connect到远程地址的套接字。除Open和Watch外只能在所属IO线程中调用
+ */
+class UdpSocket : public IEventHandler
+{
+public:
+    UdpSocket(logger::ILogger *pLogger, const ConnectionOptions &options, const std::string &strName);
+    ~UdpSocket() override;
+
+    UdpSocket(const UdpSocket &) = delete;
+    UdpSocket &operator=(const UdpSocket &) = delete;
+
+    /**
+     * @brief 创建并绑定套接字，内核支持时启用UDP_SEGMENT/UDP_GRO
+     * @param localAddr 本地地址
+     * @param pRemoteAddr 远程地址，非空时connect到该地址，只收发该地址的数据报
+     * @param bReusePort 是否设置SO_REUSEPORT
+     * @return 0表示成功,否则失败
+     */
+    int32_t Open(const struct sockaddr_in &localAddr, const struct sockaddr_in *pRemoteAddr, bool bReusePort);
+
+    /**
+     * @brief 注册到Reactor，之后由其IO线程处理收发
+     * @param pReactor Reactor
+     * @return 0表示成功,否则失败
+     */
+    int32_t Watch(Reactor *pReactor);
+
+    /**
+     * @brief 注销并关闭套接字，监听器的套接字同时关闭所有接入连接
+     */
+    void Close();
+
+    /**
+     * @brief 由Reactor在注册时设置共用的批量收发缓冲区
+     */
+    void SetBatch(UdpBatch *pBatch) { m_pBatch = pBatch; }
+
+    /**
+     * @brief 设置所属监听器，收到未知远程地址的数据报时由监听器创建连接
+     */
+    void SetListener(ListenerImpl *pListener) { m_pListener = pListener; }
+
+    /**
+     * @brief 设置独占该套接字的连接
+     */
+    void SetOwner(uint64_t uConnectionID) { m_uOwnerID = uConnectionID; }
+
+    /**
+     * @brief 登记远程地址对应的连接
+     * @param addr 远程地址
+     * @param uConnectionID 连接ID
+     * @return 是否成功
+     */
+    bool AddPeer(const struct sockaddr_in &addr, uint64_t uConnectionID);
+
+    /**
+     * @brief 注销远程地址，连接关闭时调用
+     * @param addr 远程地址
+     */
+    void RemovePeer(const struct sockaddr_in &addr);
+
+    /**
+     * @brief 从队首开始批量发送消息，每条消息一个数据报，连续等长的消息合并为一次GSO发送
+     * @param pAddr 目标地址，已connect的套接字传NULL
+     * @param dequeItems 发送队列
+     * @param uItems 输出已发送的消息数
+     * @param uBytes 输出已发送的字节数
+     * @return 0表示成功，kWouldBlock表示套接字发送缓冲区已满，否则失败
+     */
+    int32_t Send(const struct sockaddr_in *pAddr, const std::deque<SendItem> &dequeItems, uint32_t &uItems, uint64_t &uBytes);
+
+    /**
+     * @brief 套接字可写后刷新该连接的发送队列
+     * @param uConnectionID 连接ID
+     */
+    void WaitWritable(uint64_t uConnectionID);
+
+    void OnIOEvent(uint32_t uEvents) override;
+
+    int32_t GetFd() const { return m_iFd; }
+    Reactor *GetReactor() const { return m_pReactor; }
+
+private:
+    static uint64_t PeerKey(const struct sockaddr_in &addr);
+    void HandleRead();
+    void HandleWrite();
+    ConnectionImpl *FindPeer(const struct sockaddr_in &addr);
+    void Dispatch(const struct sockaddr_in &addr, const uint8_t *pData, uint32_t uLength, uint32_t uSegmentBytes);
+
+private:
+    static constexpr uint32_t kGsoMaxSegmentBytes = 1472; // 以太网MTU下不分片的最大载荷，更大的消息逐个发送
+
+    int32_t m_iFd{-1};
+    bool m_bGso{false};
+    bool m_bGro{false};
+    Reactor *m_pReactor{nullptr};
+    UdpBatch *m_pBatch{nullptr};
+    ListenerImpl *m_pListener{nullptr};
+    uint64_t m_uOwnerID{0};
+    ConnectionOptions m_options;
+
+    std::unordered_map<uint64_t, uint64_t> m_umapPeer; // 远程地址到连接ID
+    std::vector<uint64_t> m_vecBlocked;                 // 等待套接字可写的连接
+    std::vector<uint64_t> m_vecRunningBlocked;
+
+    std::string m_strName;
+    logger::ILogger *m_pLogger{nullptr};
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_UDP_SOCKET_H__
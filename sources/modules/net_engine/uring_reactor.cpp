@@ -0,0 +1,1097 @@
+#include "uring_reactor.h"
+#include "connection_impl.h"
+#include "listener_impl.h"
+#include <common.h>
+#include <error_code.h>
+#include <new>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint32_t kMaxBufferCount = 32768; // provided buffer ring最大条目数
+
+int32_t UringSetup(uint32_t uEntries, struct io_uring_params *pParams)
+{
+    return static_cast<int32_t>(syscall(__NR_io_uring_setup, uEntries, pParams));
+}
+
+int32_t UringEnter(int32_t iRingFd, uint32_t uToSubmit, uint32_t uMinComplete, uint32_t uFlags, const void *pArg, size_t uArgBytes)
+{
+    return static_cast<int32_t>(syscall(__NR_io_uring_enter, iRingFd, uToSubmit, uMinComplete, uFlags, pArg, uArgBytes));
+}
+
+int32_t UringRegister(int32_t iRingFd, uint32_t uOpcode, const void *pArg, uint32_t uArgCount)
+{
+    return static_cast<int32_t>(syscall(__NR_io_uring_register, iRingFd, uOpcode, pArg, uArgCount));
+}
+
+template<typename T>
+T LoadAcquire(const T *pValue)
+{
+    return __atomic_load_n(pValue, __ATOMIC_ACQUIRE);
+}
+
+template<typename T>
+void StoreRelease(T *pValue, T value)
+{
+    __atomic_store_n(pValue, value, __ATOMIC_RELEASE);
+}
+
+uint32_t RoundUpPowerOfTwo(uint32_t uValue)
+{
+    uint32_t uResult = 1;
+    while (uResult < uValue)
+    {
+        uResult <<= 1;
+    }
+    return uResult;
+}
+
+}
+
+void UringOptions::Load(utilities::IConfig *pConfig)
+{
+    uQueueDepth = pConfig->GetInt32(config::kSection, config::kUringQueueDepth, default_value::kUringQueueDepth);
+    uBufferCount = pConfig->GetInt32(config::kSection, config::kUringBufferCount, default_value::kUringBufferCount);
+    uBufferBytes = pConfig->GetInt32(config::kSection, config::kUringBufferBytes, default_value::kUringBufferBytes);
+}
+
+UringReactor::UringReactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex, const UringOptions &options)
+    : Reactor(pLogger, pNetEngine, uIndex), m_options(options)
+{
+}
+
+UringReactor::~UringReactor()
+{
+    Exit();
+}
+
+int32_t UringReactor::Init()
+{
+    int32_t iRet = Reactor::Init();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    iRet = SetupRing();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    iRet = SetupBufferRing();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    iRet = ProbeRecvMultishot();
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+
+    ArmWakeup();
+    return ErrorCode::kSuccess;
+}
+
+int32_t UringReactor::SetupRing()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = std::max(m_options.uQueueDepth, 1u) * 4;
+    m_iRingFd = UringSetup(std::max(m_options.uQueueDepth, 1u), &params);
+    if (m_iRingFd < 0 && errno == EINVAL)
+    {
+        // COOP_TASKRUN需要5.19及以上内核，不支持时退回默认的任务执行方式
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+        params.cq_entries = std::max(m_options.uQueueDepth, 1u) * 4;
+        m_iRingFd = UringSetup(std::max(m_options.uQueueDepth, 1u), &params);
+    }
+
+    if (m_iRingFd < 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} failed to setup io_uring, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kUringFailed;
+    }
+
+    uint32_t uRequired = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & uRequired) != uRequired)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} io_uring features {} not supported", Wrap(m_uIndex), Wrap(params.features));
+        return ErrorCode::kUringFailed;
+    }
+
+    m_uRingBytes = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    void *pRing = mmap(nullptr, m_uRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_iRingFd, IORING_OFF_SQ_RING);
+    if (pRing == MAP_FAILED)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} failed to map io_uring, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kUringFailed;
+    }
+    m_pRing = pRing;
+
+    m_uSqesBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *pSqes = mmap(nullptr, m_uSqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_iRingFd, IORING_OFF_SQES);
+    if (pSqes == MAP_FAILED)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} failed to map io_uring sqes, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kUringFailed;
+    }
+    m_pSqes = static_cast<struct io_uring_sqe *>(pSqes);
+
+    uint8_t *pBase = static_cast<uint8_t *>(m_pRing);
+    m_pSqHead = reinterpret_cast<uint32_t *>(pBase + params.sq_off.head);
+    m_pSqTail = reinterpret_cast<uint32_t *>(pBase + params.sq_off.tail);
+    m_uSqMask = *reinterpret_cast<uint32_t *>(pBase + params.sq_off.ring_mask);
+    m_uSqEntries = params.sq_entries;
+    m_pCqHead = reinterpret_cast<uint32_t *>(pBase + params.cq_off.head);
+    m_pCqTail = reinterpret_cast<uint32_t *>(pBase + params.cq_off.tail);
+    m_uCqMask = *reinterpret_cast<uint32_t *>(pBase + params.cq_off.ring_mask);
+    m_pCqes = reinterpret_cast<struct io_uring_cqe *>(pBase + params.cq_off.cqes);
+
+    // SQE下标与提交数组一一对应，之后只需推进尾指针
+    uint32_t *pArray = reinterpret_cast<uint32_t *>(pBase + params.sq_off.array);
+    for (uint32_t i = 0; i < m_uSqEntries; i++)
+    {
+        pArray[i] = i;
+    }
+    m_uSqLocalTail = *m_pSqTail;
+    return ErrorCode::kSuccess;
+}
+
+int32_t UringReactor::SetupBufferRing()
+{
+    m_uBufferCount = RoundUpPowerOfTwo(std::min(std::max(m_options.uBufferCount, 1u), kMaxBufferCount));
+    m_uBufferBytes = std::max(m_options.uBufferBytes, 1u);
+
+    m_uBufRingBytes = m_uBufferCount * sizeof(struct io_uring_buf);
+    void *pBufRing = mmap(nullptr, m_uBufRingBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pBufRing == MAP_FAILED)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "reactor {} failed to map buffer ring, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kNoMemory;
+    }
+    m_pBufRing = static_cast<struct io_uring_buf *>(pBufRing);
+
+    void *pBuffer = mmap(nullptr, static_cast<size_t>(m_uBufferCount) * m_uBufferBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pBuffer == MAP_FAILED)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "reactor {} failed to map recv buffers, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kNoMemory;
+    }
+    m_pBufferBase = static_cast<uint8_t *>(pBuffer);
+
+    // 缓冲区在启动线程中映射，首次写入发生在IO线程之前，先绑定到IO线程所在节点
+    if (m_placement.BindMemory(pBufRing, m_uBufRingBytes) != ErrorCode::kSuccess
+        || m_placement.BindMemory(pBuffer, static_cast<size_t>(m_uBufferCount) * m_uBufferBytes) != ErrorCode::kSuccess)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kInvalidCall, "reactor {} failed to bind recv buffers to numa node {}, errno: {}",
+            Wrap(m_uIndex), Wrap(m_placement.GetNumaNode()), Wrap(errno));
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(m_pBufRing);
+    reg.ring_entries = m_uBufferCount;
+    reg.bgid = kBufferGroup;
+    if (UringRegister(m_iRingFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} failed to register buffer ring, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kUringFailed;
+    }
+
+    m_uBufMask = static_cast<uint16_t>(m_uBufferCount - 1);
+    for (uint32_t i = 0; i < m_uBufferCount; i++)
+    {
+        RecycleBuffer(static_cast<uint16_t>(i));
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t UringReactor::ProbeRecvMultishot()
+{
+    // provided buffer ring在5.19就已支持，multishot recv到6.0才加入，旧内核上每次接收都会以-EINVAL失败。
+    // 在一对本地套接字上实际提交一次：写入数据并关闭写端后，支持时先返回带F_MORE的数据，再以0结束
+    int32_t arrFd[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, arrFd) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "reactor {} failed to create probe socket, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        return ErrorCode::kSocketFailed;
+    }
+
+    const char cProbe = 0;
+    if (write(arrFd[1], &cProbe, 1) != 1 || shutdown(arrFd[1], SHUT_WR) != 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "reactor {} failed to write probe socket, errno: {}", Wrap(m_uIndex), Wrap(errno));
+        close(arrFd[0]);
+        close(arrFd[1]);
+        return ErrorCode::kSocketFailed;
+    }
+
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        close(arrFd[0]);
+        close(arrFd[1]);
+        return ErrorCode::kUringFailed;
+    }
+    pSqe->opcode = IORING_OP_RECV;
+    pSqe->fd = arrFd[0];
+    pSqe->ioprio = IORING_RECV_MULTISHOT;
+    pSqe->flags = IOSQE_BUFFER_SELECT;
+    pSqe->buf_group = kBufferGroup;
+    pSqe->user_data = TokenUserData(kOpRecv, 0);
+
+    // 此时还没有其他请求，完成队列中只有探测请求的结果
+    bool bSupported = false;
+    bool bFirst = true;
+    bool bDone = false;
+    for (uint32_t i = 0; i < kProbeRounds && !bDone; i++)
+    {
+        Enter(1, 100);
+        uint32_t uHead = *m_pCqHead;
+        uint32_t uTail = LoadAcquire(m_pCqTail);
+        while (uHead != uTail && !bDone)
+        {
+            const struct io_uring_cqe &cqe = m_pCqes[uHead & m_uCqMask];
+            if (cqe.flags & IORING_CQE_F_BUFFER)
+            {
+                RecycleBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+            if (bFirst)
+            {
+                bSupported = cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE) != 0;
+                bFirst = false;
+            }
+            bDone = (cqe.flags & IORING_CQE_F_MORE) == 0;
+            uHead++;
+        }
+        StoreRelease(m_pCqHead, uHead);
+    }
+    close(arrFd[0]);
+    close(arrFd[1]);
+
+    if (!bDone)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} io_uring recv probe did not complete", Wrap(m_uIndex));
+        return ErrorCode::kUringFailed;
+    }
+
+    if (!bSupported)
+    {
+        LOG_WARN(m_pLogger, ErrorCode::kUringFailed, "reactor {} io_uring multishot recv is not supported by kernel", Wrap(m_uIndex));
+        return ErrorCode::kUringFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+void UringReactor::Exit()
+{
+    Reactor::Exit();
+
+    if (m_iRingFd >= 0 && m_pRing != nullptr && m_pSqes != nullptr)
+    {
+        // 发送缓冲区和接收缓冲区可能仍被内核引用，取消全部请求并等待完成后才能释放
+        m_bExiting = true;
+        ClearAcceptors();
+        struct io_uring_sqe *pSqe = GetSqe();
+        if (pSqe != nullptr)
+        {
+            pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+            pSqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+            pSqe->user_data = TokenUserData(kOpCancel, 0);
+        }
+
+        for (uint32_t i = 0; i < kExitDrainRounds && m_uClosingStates > 0; i++)
+        {
+            Enter(1, 10);
+            ReapCompletions();
+        }
+
+        if (m_uClosingStates > 0)
+        {
+            LOG_WARN(m_pLogger, ErrorCode::kUringFailed, "reactor {} {} connections still have pending requests", Wrap(m_uIndex), Wrap(m_uClosingStates));
+        }
+    }
+
+    if (m_pSqes != nullptr)
+    {
+        munmap(m_pSqes, m_uSqesBytes);
+        m_pSqes = nullptr;
+    }
+    if (m_pRing != nullptr)
+    {
+        munmap(m_pRing, m_uRingBytes);
+        m_pRing = nullptr;
+    }
+    if (m_iRingFd >= 0)
+    {
+        close(m_iRingFd);
+        m_iRingFd = -1;
+    }
+    if (m_pBufRing != nullptr)
+    {
+        munmap(m_pBufRing, m_uBufRingBytes);
+        m_pBufRing = nullptr;
+    }
+    if (m_pBufferBase != nullptr)
+    {
+        munmap(m_pBufferBase, static_cast<size_t>(m_uBufferCount) * m_uBufferBytes);
+        m_pBufferBase = nullptr;
+    }
+    ClearAcceptors();
+}
+
+uint32_t UringReactor::Poll(int32_t iTimeoutMs)
+{
+    // 上一轮产生的接收重试、发送等请求在这里一次提交，完成队列非空时不阻塞
+    bool bHasCompletion = LoadAcquire(m_pCqTail) != *m_pCqHead;
+    Enter(bHasCompletion ? 0 : 1, GetPollTimeout(iTimeoutMs));
+    m_stats.uPolls.Add();
+    UpdateLoopTime();
+    uint32_t uCount = ReapCompletions();
+
+    RunTasks();
+    RunTimers();
+    FlushPending();
+    return uCount;
+}
+
+int32_t UringReactor::WatchConnection(ConnectionImpl *pConnection)
+{
+    ConnState *pState = NewState(pConnection);
+    if (pState == nullptr || !ArmRecv(pState))
+    {
+        return ErrorCode::kUringFailed;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t UringReactor::StartConnect(ConnectionImpl *pConnection, const struct sockaddr_in &addr)
+{
+    ConnState *pState = NewState(pConnection);
+    if (pState == nullptr)
+    {
+        return ErrorCode::kNoMemory;
+    }
+
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return ErrorCode::kUringFailed;
+    }
+
+    pState->addr = addr;
+    pSqe->opcode = IORING_OP_CONNECT;
+    pSqe->fd = pState->iFd;
+    pSqe->addr = reinterpret_cast<uint64_t>(&pState->addr);
+    pSqe->off = sizeof(pState->addr);
+    pSqe->user_data = StateUserData(kOpConnect, pState);
+    pState->uPendingOps++;
+    return ErrorCode::kSuccess;
+}
+
+void UringReactor::UnwatchConnection(ConnectionImpl *pConnection)
+{
+    auto it = m_umapState.find(pConnection->GetID());
+    if (it == m_umapState.end())
+    {
+        return;
+    }
+
+    ConnState *pState = it->second;
+    m_umapState.erase(it);
+    pState->bClosed = true;
+    m_uClosingStates++;
+    if (pState->uPendingOps > 0)
+    {
+        CancelFd(pState->iFd);
+    }
+    TryReleaseState(pState);
+}
+
+void UringReactor::FlushConnection(ConnectionImpl *pConnection)
+{
+    ConnState *pState = FindState(pConnection->GetID());
+    if (pState == nullptr || pState->bSending || !pConnection->IsConnected())
+    {
+        return;
+    }
+
+    // 同一连接同时只有一个发送请求，期间追加的数据在完成后作为下一批
+    if (!pConnection->TakeSendItems(pState->dequeSending))
+    {
+        return;
+    }
+    if (!SubmitSend(pState, pConnection))
+    {
+        pConnection->HandleClose();
+    }
+}
+
+int32_t UringReactor::WatchAcceptor(Acceptor *pAcceptor)
+{
+    // 监听器在业务线程中注册，提交队列只能由IO线程操作
+    Post([this, pAcceptor]() {
+        uint64_t uToken = m_uNextAcceptToken++;
+        try
+        {
+            m_umapAcceptor[uToken].pAcceptor = pAcceptor;
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "reactor {} failed to watch acceptor", Wrap(m_uIndex));
+            return;
+        }
+        ArmAccept(uToken, pAcceptor);
+    });
+    return ErrorCode::kSuccess;
+}
+
+void UringReactor::UnwatchAcceptor(Acceptor *pAcceptor)
+{
+    for (auto it = m_umapAcceptor.begin(); it != m_umapAcceptor.end(); ++it)
+    {
+        if (it->second.pAcceptor == pAcceptor)
+        {
+            GetTimerWheel().Cancel(&it->second.backoffTimer);
+            m_umapAcceptor.erase(it);
+            CancelFd(pAcceptor->iListenFd);
+            return;
+        }
+    }
+}
+
+int32_t UringReactor::WatchDatagram(UdpSocket *)
+{
+    // UDP引擎固定使用epoll后端
+    LOG_ERROR(m_pLogger, ErrorCode::kInvalidCall, "reactor {} does not support udp socket", Wrap(m_uIndex));
+    return ErrorCode::kInvalidCall;
+}
+
+void UringReactor::UnwatchDatagram(UdpSocket *)
+{
+}
+
+int32_t UringReactor::WatchChannel(ShmChannel *)
+{
+    // 共享内存引擎固定使用epoll后端
+    LOG_ERROR(m_pLogger, ErrorCode::kInvalidCall, "reactor {} does not support shm channel", Wrap(m_uIndex));
+    return ErrorCode::kInvalidCall;
+}
+
+int32_t UringReactor::WatchDoorbell(ShmChannel *)
+{
+    return ErrorCode::kInvalidCall;
+}
+
+void UringReactor::UnwatchChannel(ShmChannel *)
+{
+}
+
+int32_t UringReactor::WatchLinger(ZeroCopyLinger *)
+{
+    // 零拷贝发送由IORING_OP_SEND_ZC完成，连接状态在全部通知到达前不释放，不需要保留套接字
+    return ErrorCode::kInvalidCall;
+}
+
+void UringReactor::UnwatchLinger(ZeroCopyLinger *)
+{
+}
+
+struct io_uring_sqe *UringReactor::GetSqe()
+{
+    if (unlikely(m_pSqes == nullptr))
+    {
+        return nullptr;
+    }
+
+    if (m_uSqLocalTail - LoadAcquire(m_pSqHead) >= m_uSqEntries)
+    {
+        // 提交队列已满，先把已有请求交给内核
+        Enter(0, 0);
+        if (m_uSqLocalTail - LoadAcquire(m_pSqHead) >= m_uSqEntries)
+        {
+            LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} io_uring submission queue is full", Wrap(m_uIndex));
+            return nullptr;
+        }
+    }
+
+    struct io_uring_sqe *pSqe = &m_pSqes[m_uSqLocalTail & m_uSqMask];
+    memset(pSqe, 0, sizeof(*pSqe));
+    m_uSqLocalTail++;
+    return pSqe;
+}
+
+int32_t UringReactor::Enter(uint32_t uMinComplete, int32_t iTimeoutMs)
+{
+    StoreRelease(m_pSqTail, m_uSqLocalTail);
+    uint32_t uToSubmit = m_uSqLocalTail - LoadAcquire(m_pSqHead);
+    if (uToSubmit == 0 && uMinComplete == 0)
+    {
+        return 0;
+    }
+
+    uint32_t uFlags = IORING_ENTER_GETEVENTS;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    const void *pArg = nullptr;
+    size_t uArgBytes = 0;
+    if (uMinComplete > 0 && iTimeoutMs >= 0)
+    {
+        ts.tv_sec = iTimeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(iTimeoutMs % 1000) * 1000000;
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        uFlags |= IORING_ENTER_EXT_ARG;
+        pArg = &arg;
+        uArgBytes = sizeof(arg);
+    }
+
+    int32_t iRet = UringEnter(m_iRingFd, uToSubmit, uMinComplete, uFlags, pArg, uArgBytes);
+    m_stats.uSyscalls.Add();
+    if (unlikely(iRet < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN))
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kUringFailed, "reactor {} io_uring_enter failed, errno: {}", Wrap(m_uIndex), Wrap(errno));
+    }
+    return iRet;
+}
+
+uint32_t UringReactor::ReapCompletions()
+{
+    uint32_t uHead = *m_pCqHead;
+    uint32_t uTail = LoadAcquire(m_pCqTail);
+    uint32_t uCount = uTail - uHead;
+    while (uHead != uTail)
+    {
+        const struct io_uring_cqe &cqe = m_pCqes[uHead & m_uCqMask];
+        uint64_t uUserData = cqe.user_data;
+        int32_t iRes = cqe.res;
+        uint32_t uFlags = cqe.flags;
+        uHead++;
+        StoreRelease(m_pCqHead, uHead);
+        HandleCompletion(uUserData, iRes, uFlags);
+    }
+    return uCount;
+}
+
+void UringReactor::HandleCompletion(uint64_t uUserData, int32_t iRes, uint32_t uFlags)
+{
+    ConnState *pState = reinterpret_cast<ConnState *>(uUserData & ~static_cast<uint64_t>(7));
+    switch (static_cast<OpType>(uUserData & 7))
+    {
+    case kOpWakeup:
+        DrainWakeup();
+        if ((uFlags & IORING_CQE_F_MORE) == 0 && !m_bExiting)
+        {
+            ArmWakeup();
+        }
+        break;
+    case kOpAccept:
+        OnAcceptComplete(uUserData >> 3, iRes, uFlags);
+        break;
+    case kOpConnect:
+        OnConnectComplete(pState, iRes);
+        break;
+    case kOpRecv:
+        OnRecvComplete(pState, iRes, uFlags);
+        break;
+    case kOpSend:
+        OnSendComplete(pState, iRes, false);
+        break;
+    case kOpSendZc:
+    {
+        ZeroCopySend *pZeroCopy = reinterpret_cast<ZeroCopySend *>(pState);
+        if (uFlags & IORING_CQE_F_NOTIF)
+        {
+            OnZeroCopyNotify(pZeroCopy, iRes);
+            break;
+        }
+
+        // F_MORE表示之后还有一个通知，到达前消息页面仍被内核引用
+        if (uFlags & IORING_CQE_F_MORE)
+        {
+            pZeroCopy->uNotifyPending++;
+            pZeroCopy->pState->uPendingOps++;
+        }
+        OnSendComplete(pZeroCopy->pState, iRes, true);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void UringReactor::ArmWakeup()
+{
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return;
+    }
+    pSqe->opcode = IORING_OP_POLL_ADD;
+    pSqe->fd = m_iEventFd;
+    pSqe->poll32_events = POLLIN;
+    pSqe->len = IORING_POLL_ADD_MULTI;
+    pSqe->user_data = TokenUserData(kOpWakeup, 0);
+}
+
+void UringReactor::ArmAccept(uint64_t uToken, Acceptor *pAcceptor)
+{
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return;
+    }
+    pSqe->opcode = IORING_OP_ACCEPT;
+    pSqe->fd = pAcceptor->iListenFd;
+    pSqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    pSqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    pSqe->user_data = TokenUserData(kOpAccept, uToken);
+}
+
+void UringReactor::BackoffAccept(uint64_t uToken, AcceptState &state, int32_t iError)
+{
+    // 描述符耗尽时立即重新提交只会再次失败，形成空转；先丢弃积压的连接让对端尽快得到结果，再等待一段时间
+    Acceptor *pAcceptor = state.pAcceptor;
+    uint32_t uShed = 0;
+    if (iError == EMFILE || iError == ENFILE)
+    {
+        while (pAcceptor->pListener->ShedConnection(pAcceptor))
+        {
+            uShed++;
+        }
+    }
+
+    // 只在开始退避时记录日志，退避期间的重复失败不再记录
+    if (state.uBackoffMs == 0)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kSocketFailed, "{} accept failed, errno: {}, dropped {} pending connections, back off",
+            pAcceptor->pListener->GetName().c_str(), Wrap(iError), Wrap(uShed));
+    }
+    if (state.uBackoffMs == 0)
+    {
+        state.uBackoffMs = kAcceptBackoffMinMs;
+    }
+    else if (state.uBackoffMs < kAcceptBackoffMaxMs)
+    {
+        state.uBackoffMs = state.uBackoffMs * 2 < kAcceptBackoffMaxMs ? state.uBackoffMs * 2 : kAcceptBackoffMaxMs;
+    }
+    state.backoffTimer.callback = [this, uToken]() {
+        auto it = m_umapAcceptor.find(uToken);
+        if (it != m_umapAcceptor.end() && !m_bExiting)
+        {
+            ArmAccept(uToken, it->second.pAcceptor);
+        }
+    };
+    GetTimerWheel().Schedule(&state.backoffTimer, GetLoopTimeMs() + state.uBackoffMs);
+}
+
+void UringReactor::ClearAcceptors()
+{
+    for (auto &pair : m_umapAcceptor)
+    {
+        GetTimerWheel().Cancel(&pair.second.backoffTimer);
+    }
+    m_umapAcceptor.clear();
+}
+
+bool UringReactor::ArmRecv(ConnState *pState)
+{
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return false;
+    }
+    pSqe->opcode = IORING_OP_RECV;
+    pSqe->fd = pState->iFd;
+    pSqe->ioprio = IORING_RECV_MULTISHOT;
+    pSqe->flags = IOSQE_BUFFER_SELECT;
+    pSqe->buf_group = kBufferGroup;
+    pSqe->user_data = StateUserData(kOpRecv, pState);
+    pState->bRecvArmed = true;
+    pState->uPendingOps++;
+    return true;
+}
+
+bool UringReactor::SubmitSend(ConnState *pState, ConnectionImpl *pConnection)
+{
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return false;
+    }
+
+    SendItem &item = pState->dequeSending.front();
+    bool bZeroCopy = item.bZeroCopy && pConnection->IsZeroCopyEnabled();
+    if (bZeroCopy && pState->pZeroCopy == nullptr)
+    {
+        pState->pZeroCopy = new(std::nothrow) ZeroCopySend();
+        if (pState->pZeroCopy == nullptr)
+        {
+            bZeroCopy = false;
+        }
+        else
+        {
+            pState->pZeroCopy->pState = pState;
+            pState->pZeroCopy->pMessage = item.pMessage;
+        }
+    }
+
+    pSqe->fd = pState->iFd;
+    pSqe->msg_flags = MSG_NOSIGNAL;
+    if (bZeroCopy)
+    {
+        pSqe->opcode = IORING_OP_SEND_ZC;
+        pSqe->addr = reinterpret_cast<uint64_t>(item.pMessage->pData + item.uOffset);
+        pSqe->len = item.pMessage->uLength - item.uOffset;
+        pSqe->ioprio = IORING_SEND_ZC_REPORT_USAGE;
+        pSqe->user_data = ZeroCopyUserData(pState->pZeroCopy);
+    }
+    else
+    {
+        // 队首之后拷贝发送的数据合并为一次sendmsg，只有一段时使用更轻量的send
+        uint32_t uBytes = 0;
+        uint32_t uCount = pConnection->GatherSend(pState->dequeSending, false, pState->vecIovec.data(), uBytes);
+        if (uCount == 1)
+        {
+            pSqe->opcode = IORING_OP_SEND;
+            pSqe->addr = reinterpret_cast<uint64_t>(pState->vecIovec[0].iov_base);
+            pSqe->len = uBytes;
+        }
+        else
+        {
+            pState->msg = {};
+            pState->msg.msg_iov = pState->vecIovec.data();
+            pState->msg.msg_iovlen = uCount;
+            pSqe->opcode = IORING_OP_SENDMSG;
+            pSqe->addr = reinterpret_cast<uint64_t>(&pState->msg);
+            pSqe->len = 1;
+        }
+        pSqe->user_data = StateUserData(kOpSend, pState);
+    }
+    pState->bSending = true;
+    pState->uPendingOps++;
+    return true;
+}
+
+void UringReactor::CompleteSendItem(ConnState *pState)
+{
+    m_stats.uMessagesOut.Add();
+    SendItem &item = pState->dequeSending.front();
+    ZeroCopySend *pZeroCopy = pState->pZeroCopy;
+    if (pZeroCopy == nullptr)
+    {
+        MessageImpl::Destroy(item.pMessage);
+    }
+    else if (pZeroCopy->uNotifyPending == 0)
+    {
+        MessageImpl::Destroy(item.pMessage);
+        delete pZeroCopy;
+    }
+    else
+    {
+        // 由最后一个完成通知释放
+        pZeroCopy->bSent = true;
+    }
+    pState->pZeroCopy = nullptr;
+    pState->dequeSending.pop_front();
+}
+
+UringReactor::ConnState *UringReactor::NewState(ConnectionImpl *pConnection)
+{
+    ConnState *pState = new(std::nothrow) ConnState();
+    if (pState == nullptr)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kNoMemory, "{} failed to create io_uring state", pConnection->GetName().c_str());
+        return nullptr;
+    }
+
+    pState->uID = pConnection->GetID();
+    pState->iFd = pConnection->GetFd();
+    try
+    {
+        pState->vecIovec.resize(pConnection->GetSendMaxIovecs());
+        m_umapState[pState->uID] = pState;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR(m_pLogger, ErrorCode::kThrowException, "{} failed to create io_uring state", pConnection->GetName().c_str());
+        delete pState;
+        return nullptr;
+    }
+    return pState;
+}
+
+UringReactor::ConnState *UringReactor::FindState(uint64_t uConnectionID)
+{
+    auto it = m_umapState.find(uConnectionID);
+    return it == m_umapState.end() ? nullptr : it->second;
+}
+
+void UringReactor::CancelFd(int32_t iFd)
+{
+    struct io_uring_sqe *pSqe = GetSqe();
+    if (pSqe == nullptr)
+    {
+        return;
+    }
+    pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+    pSqe->fd = iFd;
+    pSqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    pSqe->user_data = TokenUserData(kOpCancel, 0);
+
+    // 按文件描述符取消，必须在调用方关闭套接字之前提交，避免文件描述符被复用后误取消
+    Enter(0, 0);
+}
+
+void UringReactor::TryReleaseState(ConnState *pState)
+{
+    if (pState->bClosed && pState->uPendingOps == 0)
+    {
+        DeleteState(pState);
+        m_uClosingStates--;
+    }
+}
+
+void UringReactor::DeleteState(ConnState *pState)
+{
+    // 所有请求均已完成，队列中剩余的消息不再被内核引用
+    for (auto &item : pState->dequeSending)
+    {
+        MessageImpl::Destroy(item.pMessage);
+    }
+    delete pState->pZeroCopy;
+    delete pState;
+}
+
+void UringReactor::RecycleBuffer(uint16_t uBufferID)
+{
+    struct io_uring_buf *pBuf = &m_pBufRing[m_uBufTail & m_uBufMask];
+    pBuf->addr = reinterpret_cast<uint64_t>(m_pBufferBase + static_cast<size_t>(uBufferID) * m_uBufferBytes);
+    pBuf->len = m_uBufferBytes;
+    pBuf->bid = uBufferID;
+    m_uBufTail++;
+
+    // 尾指针与第一个条目的resv字段共用同一位置
+    StoreRelease(&m_pBufRing[0].resv, m_uBufTail);
+}
+
+void UringReactor::OnAcceptComplete(uint64_t uToken, int32_t iRes, uint32_t uFlags)
+{
+    auto it = m_umapAcceptor.find(uToken);
+    if (it == m_umapAcceptor.end())
+    {
+        if (iRes >= 0)
+        {
+            close(iRes);
+        }
+        return;
+    }
+
+    Acceptor *pAcceptor = it->second.pAcceptor;
+    if (iRes >= 0)
+    {
+        it->second.uBackoffMs = 0;
+        pAcceptor->pListener->OnAccepted(pAcceptor, iRes);
+    }
+
+    // multishot accept出错后被内核终止，监听套接字已关闭时不再提交，其他错误退避后重新提交
+    if ((uFlags & IORING_CQE_F_MORE) != 0 || m_bExiting || iRes == -ECANCELED || iRes == -EINVAL || iRes == -EBADF)
+    {
+        return;
+    }
+
+    // 回调中可能注销了监听套接字
+    it = m_umapAcceptor.find(uToken);
+    if (it == m_umapAcceptor.end())
+    {
+        return;
+    }
+
+    if (iRes < 0)
+    {
+        BackoffAccept(uToken, it->second, -iRes);
+        return;
+    }
+    ArmAccept(uToken, pAcceptor);
+}
+
+void UringReactor::OnConnectComplete(ConnState *pState, int32_t iRes)
+{
+    pState->uPendingOps--;
+    if (pState->bClosed)
+    {
+        TryReleaseState(pState);
+        return;
+    }
+
+    ConnectionImpl *pConnection = FindConnection(pState->uID);
+    if (pConnection == nullptr)
+    {
+        return;
+    }
+
+    if (iRes == 0 && !ArmRecv(pState))
+    {
+        iRes = -ENOMEM;
+    }
+    pConnection->OnConnectResult(-iRes);
+}
+
+void UringReactor::OnRecvComplete(ConnState *pState, int32_t iRes, uint32_t uFlags)
+{
+    bool bMore = (uFlags & IORING_CQE_F_MORE) != 0;
+    if (!bMore)
+    {
+        pState->bRecvArmed = false;
+        pState->uPendingOps--;
+    }
+
+    ConnectionImpl *pConnection = pState->bClosed ? nullptr : FindConnection(pState->uID);
+    bool bClose = false;
+    if (uFlags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t uBufferID = static_cast<uint16_t>(uFlags >> IORING_CQE_BUFFER_SHIFT);
+        if (pConnection != nullptr && iRes > 0 && pConnection->IsConnected())
+        {
+            bClose = !pConnection->OnReceived(m_pBufferBase + static_cast<size_t>(uBufferID) * m_uBufferBytes, static_cast<uint32_t>(iRes));
+        }
+        RecycleBuffer(uBufferID);
+    }
+
+    // 对端关闭或出错时关闭连接，缓冲区耗尽或被内核终止时重新提交接收
+    if (iRes == 0 || (iRes < 0 && iRes != -ENOBUFS && iRes != -ECANCELED))
+    {
+        bClose = true;
+    }
+
+    if (pConnection == nullptr)
+    {
+        TryReleaseState(pState);
+        return;
+    }
+
+    if (!bClose && !bMore && pConnection->IsConnected() && !ArmRecv(pState))
+    {
+        bClose = true;
+    }
+
+    if (bClose && pConnection->IsConnected())
+    {
+        pConnection->HandleClose();
+    }
+}
+
+void UringReactor::OnSendComplete(ConnState *pState, int32_t iRes, bool bZeroCopy)
+{
+    pState->uPendingOps--;
+    pState->bSending = false;
+    if (pState->bClosed)
+    {
+        TryReleaseState(pState);
+        return;
+    }
+
+    ConnectionImpl *pConnection = FindConnection(pState->uID);
+    if (pConnection == nullptr)
+    {
+        return;
+    }
+
+    if (iRes < 0)
+    {
+        // 套接字不支持零拷贝时改为普通发送重试
+        if (bZeroCopy && (iRes == -EOPNOTSUPP || iRes == -EINVAL))
+        {
+            pConnection->DisableZeroCopy();
+            if (!SubmitSend(pState, pConnection))
+            {
+                pConnection->HandleClose();
+            }
+            return;
+        }
+
+        LOG_WARN(m_pLogger, ErrorCode::kNotConnected, "{} send failed, errno: {}", pConnection->GetName().c_str(), Wrap(-iRes));
+        pConnection->HandleClose();
+        return;
+    }
+
+    // 合并发送的结果依次计入各条数据
+    uint32_t uSent = static_cast<uint32_t>(iRes);
+    pConnection->ReleaseSend(uSent);
+    while (uSent > 0)
+    {
+        SendItem &item = pState->dequeSending.front();
+        uint32_t uLength = std::min(uSent, item.pMessage->uLength - item.uOffset);
+        item.uOffset += uLength;
+        uSent -= uLength;
+        if (item.uOffset == item.pMessage->uLength)
+        {
+            CompleteSendItem(pState);
+        }
+    }
+
+    // 回调中追加的数据随下一批发出
+    pConnection->CheckSendDrained();
+    if (pState->dequeSending.empty() && !pConnection->TakeSendItems(pState->dequeSending))
+    {
+        return;
+    }
+
+    if (!SubmitSend(pState, pConnection))
+    {
+        pConnection->HandleClose();
+    }
+}
+
+void UringReactor::OnZeroCopyNotify(ZeroCopySend *pZeroCopy, int32_t iRes)
+{
+    ConnState *pState = pZeroCopy->pState;
+    pZeroCopy->uNotifyPending--;
+    pState->uPendingOps--;
+
+    // 内核以拷贝方式完成（如回环地址），零拷贝没有收益
+    if (static_cast<uint32_t>(iRes) & IORING_NOTIF_USAGE_ZC_COPIED)
+    {
+        ConnectionImpl *pConnection = pState->bClosed ? nullptr : FindConnection(pState->uID);
+        if (pConnection != nullptr)
+        {
+            pConnection->DisableZeroCopy();
+        }
+    }
+
+    if (pZeroCopy->bSent && pZeroCopy->uNotifyPending == 0)
+    {
+        MessageImpl::Destroy(pZeroCopy->pMessage);
+        delete pZeroCopy;
+    }
+
+    if (pState->bClosed)
+    {
+        TryReleaseState(pState);
+    }
+}
+
+}
+}
@@ -0,0 +1,187 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_URING_REACTOR_H__
+#define __LITE_DRIVE_NET_ENGINE_URING_REACTOR_H__
+
+#include "reactor.h"
+#include "connection_impl.h"
+#include <deque>
+#include <linux/io_uring.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief io_uring选项，网络引擎初始化时解析一次
+ */
+struct UringOptions
+{
+    uint32_t uQueueDepth{default_value::kUringQueueDepth};
+    uint32_t uBufferCount{default_value::kUringBufferCount};
+    uint32_t uBufferBytes{default_value::kUringBufferBytes};
+
+    void Load(utilities::IConfig *pConfig);
+};
+
+/**
+ * @brief 基于io_uring的Reactor
+ * @note 监听套接字使用multishot accept，连接使用multishot recv从共享的provided buffer ring取缓冲区，
+ *       初始化时探测内核是否支持multishot recv(6.0及以上)，不支持时初始化失败，由网络引擎退回epoll，
+ *       每轮循环产生的发送请求在下一次io_uring_enter中一次性提交，同一连接排队的小消息合并为一个IORING_OP_SENDMSG，
+ *       大消息使用IORING_OP_SEND_ZC零拷贝发送
+ */
+class UringReactor : public Reactor
+{
+public:
+    UringReactor(logger::ILogger *pLogger, NetEngineImpl *pNetEngine, uint32_t uIndex, const UringOptions &options);
+    ~UringReactor() override;
+
+    int32_t Init() override;
+    void Exit() override;
+    uint32_t Poll(int32_t iTimeoutMs) override;
+
+    int32_t WatchConnection(ConnectionImpl *pConnection) override;
+    int32_t StartConnect(ConnectionImpl *pConnection, const struct sockaddr_in &addr) override;
+    void UnwatchConnection(ConnectionImpl *pConnection) override;
+    void FlushConnection(ConnectionImpl *pConnection) override;
+    int32_t WatchAcceptor(Acceptor *pAcceptor) override;
+    void UnwatchAcceptor(Acceptor *pAcceptor) override;
+    int32_t WatchDatagram(UdpSocket *pSocket) override;
+    void UnwatchDatagram(UdpSocket *pSocket) override;
+    int32_t WatchChannel(ShmChannel *pChannel) override;
+    int32_t WatchDoorbell(ShmChannel *pChannel) override;
+    void UnwatchChannel(ShmChannel *pChannel) override;
+    int32_t WatchLinger(ZeroCopyLinger *pLinger) override;
+    void UnwatchLinger(ZeroCopyLinger *pLinger) override;
+
+private:
+    enum OpType : uint64_t
+    {
+        kOpWakeup = 1,
+        kOpAccept = 2,
+        kOpConnect = 3,
+        kOpRecv = 4,
+        kOpSend = 5,
+        kOpCancel = 6,
+        kOpSendZc = 7,
+    };
+
+    struct ConnState;
+
+    /**
+     * @brief 监听套接字在io_uring中的状态，资源不足导致accept失败时退避一段时间再重新提交
+     */
+    struct AcceptState
+    {
+        Acceptor *pAcceptor{nullptr};
+        uint32_t uBackoffMs{0}; // 当前退避时间，0表示未退避
+        Timer backoffTimer;
+    };
+
+    /**
+     * @brief 一条零拷贝发送的消息，内核通知不再引用其页面后才释放
+     */
+    struct ZeroCopySend
+    {
+        ConnState *pState{nullptr};
+        MessageImpl *pMessage{nullptr};
+        uint32_t uNotifyPending{0}; // 尚未收到的完成通知数
+        bool bSent{false};          // 消息是否已全部发送
+    };
+
+    /**
+     * @brief 连接在io_uring中的状态，生命周期独立于连接，直到所有已提交的请求完成才释放，
+     *        保证内核访问的地址和发送缓冲区始终有效
+     */
+    struct ConnState
+    {
+        uint64_t uID{0};
+        int32_t iFd{-1};
+        uint32_t uPendingOps{0};  // 已提交未完成的请求数
+        bool bClosed{false};
+        bool bRecvArmed{false};
+        bool bSending{false};
+        std::deque<SendItem> dequeSending; // 从连接取出的发送队列，队首正在由内核发送
+        ZeroCopySend *pZeroCopy{nullptr};  // 队首消息的零拷贝发送记录
+        std::vector<struct iovec> vecIovec; // 合并发送的分段，内核处理期间保持有效
+        struct msghdr msg;
+        struct sockaddr_in addr;
+    };
+
+    // user_data低3位为请求类型，高位为连接状态指针(8字节对齐)或监听套接字令牌
+    static uint64_t StateUserData(OpType eType, const ConnState *pState) { return reinterpret_cast<uint64_t>(pState) | eType; }
+    static uint64_t TokenUserData(OpType eType, uint64_t uToken) { return (uToken << 3) | eType; }
+    static uint64_t ZeroCopyUserData(const ZeroCopySend *pZeroCopy) { return reinterpret_cast<uint64_t>(pZeroCopy) | kOpSendZc; }
+
+    int32_t SetupRing();
+    int32_t SetupBufferRing();
+    int32_t ProbeRecvMultishot();
+    struct io_uring_sqe *GetSqe();
+    int32_t Enter(uint32_t uMinComplete, int32_t iTimeoutMs);
+    uint32_t ReapCompletions();
+    void HandleCompletion(uint64_t uUserData, int32_t iRes, uint32_t uFlags);
+
+    void ArmWakeup();
+    void ArmAccept(uint64_t uToken, Acceptor *pAcceptor);
+    void BackoffAccept(uint64_t uToken, AcceptState &state, int32_t iError);
+    void ClearAcceptors();
+    bool ArmRecv(ConnState *pState);
+    bool SubmitSend(ConnState *pState, ConnectionImpl *pConnection);
+    void CompleteSendItem(ConnState *pState);
+    ConnState *NewState(ConnectionImpl *pConnection);
+    ConnState *FindState(uint64_t uConnectionID);
+    void CancelFd(int32_t iFd);
+    void TryReleaseState(ConnState *pState);
+    void DeleteState(ConnState *pState);
+    void RecycleBuffer(uint16_t uBufferID);
+
+    void OnAcceptComplete(uint64_t uToken, int32_t iRes, uint32_t uFlags);
+    void OnConnectComplete(ConnState *pState, int32_t iRes);
+    void OnRecvComplete(ConnState *pState, int32_t iRes, uint32_t uFlags);
+    void OnSendComplete(ConnState *pState, int32_t iRes, bool bZeroCopy);
+    void OnZeroCopyNotify(ZeroCopySend *pZeroCopy, int32_t iRes);
+
+private:
+    static constexpr uint16_t kBufferGroup = 0; // provided buffer ring的组号
+    static constexpr uint32_t kExitDrainRounds = 100; // 退出时等待已提交请求完成的最大轮数
+    static constexpr uint32_t kProbeRounds = 10;      // 初始化时等待探测请求完成的最大轮数
+    static constexpr uint32_t kAcceptBackoffMinMs = 10;   // accept退避的初始时间，单位: 毫秒
+    static constexpr uint32_t kAcceptBackoffMaxMs = 1000; // accept退避的最长时间，单位: 毫秒
+
+    UringOptions m_options;
+    bool m_bExiting{false};
+    int32_t m_iRingFd{-1};
+
+    // 提交队列和完成队列共用一次mmap
+    void *m_pRing{nullptr};
+    size_t m_uRingBytes{0};
+    struct io_uring_sqe *m_pSqes{nullptr};
+    size_t m_uSqesBytes{0};
+    uint32_t *m_pSqHead{nullptr};
+    uint32_t *m_pSqTail{nullptr};
+    uint32_t m_uSqMask{0};
+    uint32_t m_uSqEntries{0};
+    uint32_t m_uSqLocalTail{0};
+    uint32_t *m_pCqHead{nullptr};
+    uint32_t *m_pCqTail{nullptr};
+    uint32_t m_uCqMask{0};
+    struct io_uring_cqe *m_pCqes{nullptr};
+
+    // provided buffer ring
+    struct io_uring_buf *m_pBufRing{nullptr};
+    size_t m_uBufRingBytes{0};
+    uint8_t *m_pBufferBase{nullptr};
+    uint32_t m_uBufferCount{0};
+    uint32_t m_uBufferBytes{0};
+    uint16_t m_uBufTail{0};
+    uint16_t m_uBufMask{0};
+
+    uint64_t m_uNextAcceptToken{1};
+    std::unordered_map<uint64_t, AcceptState> m_umapAcceptor;
+    std::unordered_map<uint64_t, ConnState *> m_umapState; // 未关闭的连接状态
+    uint32_t m_uClosingStates{0}; // 已关闭但仍有请求未完成的连接状态数
+};
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_URING_REACTOR_H__
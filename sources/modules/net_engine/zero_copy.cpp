@@ -0,0 +1,204 @@
+#include "zero_copy.h"
+#include <error_code.h>
+#include <cerrno>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+namespace
+{
+
+constexpr uint32_t kLingerTimeoutMs = 10000; // 等待完成通知的最长时间，单位: 毫秒
+
+}
+
+bool ZeroCopyTracker::Track(MessageImpl *pMessage, uint32_t uSeq)
+{
+    try
+    {
+        m_dequeMessage.emplace_back(uSeq, pMessage);
+    }
+    catch(const std::exception& e)
+    {
+        return false;
+    }
+    return true;
+}
+
+int32_t ZeroCopyTracker::Reap(int32_t iFd, bool &bCopied)
+{
+    int32_t iRet = ErrorCode::kSuccess;
+    bCopied = false;
+    while (true)
+    {
+        char szControl[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+        struct msghdr msg = {};
+        msg.msg_control = szControl;
+        msg.msg_controllen = sizeof(szControl);
+        if (recvmsg(iFd, &msg, MSG_ERRQUEUE) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return iRet;
+        }
+
+        for (struct cmsghdr *pCmsg = CMSG_FIRSTHDR(&msg); pCmsg != nullptr; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+        {
+            if (pCmsg->cmsg_level != SOL_IP || pCmsg->cmsg_type != IP_RECVERR)
+            {
+                continue;
+            }
+
+            const struct sock_extended_err *pError = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(pCmsg));
+            if (pError->ee_errno != 0 || pError->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            {
+                continue;
+            }
+
+            if (pError->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                bCopied = true;
+            }
+            if (!Complete(pError->ee_info, pError->ee_data))
+            {
+                iRet = ErrorCode::kNoMemory;
+            }
+        }
+    }
+}
+
+bool ZeroCopyTracker::Complete(uint32_t uFirst, uint32_t uLast)
+{
+    if (uFirst != m_uDone)
+    {
+        try
+        {
+            m_vecRange.emplace_back(uFirst, uLast);
+        }
+        catch(const std::exception& e)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    m_uDone = uLast + 1;
+    for (size_t i = 0; i < m_vecRange.size();)
+    {
+        if (m_vecRange[i].first == m_uDone)
+        {
+            m_uDone = m_vecRange[i].second + 1;
+            m_vecRange.erase(m_vecRange.begin() + i);
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    // 序号可能回绕，按差值比较
+    while (!m_dequeMessage.empty() && static_cast<int32_t>(m_dequeMessage.front().first - m_uDone) < 0)
+    {
+        MessageImpl::Destroy(m_dequeMessage.front().second);
+        m_dequeMessage.pop_front();
+    }
+    return true;
+}
+
+void ZeroCopyTracker::Release()
+{
+    for (auto &pair : m_dequeMessage)
+    {
+        MessageImpl::Destroy(pair.second);
+    }
+    m_dequeMessage.clear();
+    m_vecRange.clear();
+    m_uSeq = 0;
+    m_uDone = 0;
+}
+
+void ZeroCopyTracker::Swap(ZeroCopyTracker &other)
+{
+    std::swap(m_uSeq, other.m_uSeq);
+    std::swap(m_uDone, other.m_uDone);
+    m_dequeMessage.swap(other.m_dequeMessage);
+    m_vecRange.swap(other.m_vecRange);
+}
+
+ZeroCopyLinger::ZeroCopyLinger(logger::ILogger *pLogger, Reactor *pReactor, const std::string &strName, int32_t iFd, ZeroCopyTracker &tracker)
+    : m_iFd(iFd), m_pReactor(pReactor), m_strName(strName), m_pLogger(pLogger)
+{
+    m_tracker.Swap(tracker);
+}
+
+ZeroCopyLinger::~ZeroCopyLinger()
+{
+    m_pReactor->GetTimerWheel().Cancel(&m_timer);
+    if (m_bWatched)
+    {
+        m_pReactor->UnwatchLinger(this);
+    }
+
+    // 中止连接后内核立即丢弃发送队列，不再发送消息页面中的数据
+    if (!m_tracker.Empty())
+    {
+        AbortSocket(m_iFd);
+    }
+    else
+    {
+        close(m_iFd);
+    }
+    m_tracker.Release();
+}
+
+int32_t ZeroCopyLinger::Start()
+{
+    int32_t iRet = m_pReactor->WatchLinger(this);
+    if (iRet != ErrorCode::kSuccess)
+    {
+        return iRet;
+    }
+    m_bWatched = true;
+
+    m_timer.callback = [this]() {
+        OnTimeout();
+    };
+    m_pReactor->GetTimerWheel().Schedule(&m_timer, m_pReactor->GetLoopTimeMs() + kLingerTimeoutMs);
+    return ErrorCode::kSuccess;
+}
+
+void ZeroCopyLinger::OnIOEvent(uint32_t)
+{
+    bool bCopied = false;
+    m_tracker.Reap(m_iFd, bCopied);
+    if (m_tracker.Empty())
+    {
+        m_pReactor->ReleaseLinger(this);
+    }
+}
+
+void ZeroCopyLinger::OnTimeout()
+{
+    LOG_WARN(m_pLogger, ErrorCode::kNotConnected, "{} zero copy completions not received in {} ms, abort the connection",
+        m_strName.c_str(), Wrap(kLingerTimeoutMs));
+    m_pReactor->ReleaseLinger(this);
+}
+
+void AbortSocket(int32_t iFd)
+{
+    struct linger lingerOption = {};
+    lingerOption.l_onoff = 1;
+    lingerOption.l_linger = 0;
+    setsockopt(iFd, SOL_SOCKET, SO_LINGER, &lingerOption, sizeof(lingerOption));
+    close(iFd);
+}
+
+}
+}
@@ -0,0 +1,134 @@
+#ifndef __LITE_DRIVE_NET_ENGINE_ZERO_COPY_H__
+#define __LITE_DRIVE_NET_ENGINE_ZERO_COPY_H__
+
+#include <logger.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "reactor.h"
+#include "message_impl.h"
+
+namespace lite_drive
+{
+namespace net_engine
+{
+
+/**
+ * @brief 以MSG_ZEROCOPY发出的消息，内核按发送序号通知不再引用其页面后才释放，仅IO线程访问
+ * @note 每次成功的零拷贝发送占用一个序号，与内核的计数一致，同一次发送涉及的消息共用序号
+ */
+class ZeroCopyTracker
+{
+public:
+    ZeroCopyTracker() = default;
+    ~ZeroCopyTracker() = default;
+
+    ZeroCopyTracker(const ZeroCopyTracker &) = delete;
+    ZeroCopyTracker &operator=(const ZeroCopyTracker &) = delete;
+
+    /**
+     * @brief 分配下一次零拷贝发送的序号
+     * @return 序号
+     */
+    uint32_t NextSeq() { return m_uSeq++; }
+
+    /**
+     * @brief 记录已全部交给内核的消息，等待完成通知
+     * @param pMessage 消息
+     * @param uSeq 消息最后一次零拷贝发送的序号
+     * @return 是否成功，失败时消息仍由调用方处理
+     */
+    bool Track(MessageImpl *pMessage, uint32_t uSeq);
+
+    /**
+     * @brief 读取套接字错误队列中的全部完成通知，释放内核不再引用的消息
+     * @param iFd 套接字
+     * @param bCopied 输出内核是否以拷贝方式完成了发送（如回环地址）
+     * @return 0表示成功，kNoMemory表示乱序的完成区间无法记录，对应的消息要等到关闭时才释放
+     */
+    int32_t Reap(int32_t iFd, bool &bCopied);
+
+    /**
+     * @brief 是否还有等待完成通知的消息
+     */
+    bool Empty() const { return m_dequeMessage.empty(); }
+
+    /**
+     * @brief 释放全部消息并重置序号，调用方保证内核不再引用这些消息
+     */
+    void Release();
+
+    /**
+     * @brief 交换两个记录的内容
+     * @param other 另一个记录
+     */
+    void Swap(ZeroCopyTracker &other);
+
+private:
+    bool Complete(uint32_t uFirst, uint32_t uLast);
+
+private:
+    uint32_t m_uSeq{0};  // 下一次零拷贝发送的序号
+    uint32_t m_uDone{0}; // 该序号之前的零拷贝发送均已完成
+    std::deque<std::pair<uint32_t, MessageImpl *>> m_dequeMessage; // 按序号排列的消息
+    std::vector<std::pair<uint32_t, uint32_t>> m_vecRange;         // 乱序到达的完成区间
+};
+
+/**
+ * @brief 连接关闭时仍被内核引用的零拷贝消息及其套接字
+ * @note 关闭套接字后无法再读取完成通知，而释放消息后内存池可能复用这些页面，内核却仍可能把它们发送出去。
+ *       因此套接字保持打开直到收到全部完成通知；对端长时间不确认时以RST中止连接，内核丢弃尚未发送的数据后再释放。
+ *       只用于epoll后端，由Reactor持有，仅在IO线程中访问
+ */
+class ZeroCopyLinger : public IEventHandler
+{
+public:
+    /**
+     * @brief 构造
+     * @param pLogger 日志
+     * @param pReactor 所属Reactor
+     * @param strName 连接名称
+     * @param iFd 已从Reactor注销的套接字，所有权转移给本对象
+     * @param tracker 等待完成通知的消息，交换后为空
+     */
+    ZeroCopyLinger(logger::ILogger *pLogger, Reactor *pReactor, const std::string &strName, int32_t iFd, ZeroCopyTracker &tracker);
+
+    /**
+     * @brief 注销套接字，仍有消息未完成时以RST中止连接，之后关闭套接字并释放全部消息
+     */
+    ~ZeroCopyLinger() override;
+
+    /**
+     * @brief 注册套接字等待完成通知，并开始计时
+     * @return 0表示成功,否则失败
+     */
+    int32_t Start();
+
+    void OnIOEvent(uint32_t uEvents) override;
+
+    int32_t GetFd() const { return m_iFd; }
+
+private:
+    void OnTimeout();
+
+private:
+    int32_t m_iFd{-1};
+    bool m_bWatched{false};
+    ZeroCopyTracker m_tracker;
+    Timer m_timer;
+    Reactor *m_pReactor{nullptr};
+    std::string m_strName;
+    logger::ILogger *m_pLogger{nullptr};
+};
+
+/**
+ * @brief 设置SO_LINGER{1,0}后关闭套接字，内核发送RST并立即丢弃发送队列，不再进入TIME_WAIT
+ * @param iFd 套接字
+ */
+void AbortSocket(int32_t iFd);
+
+}
+}
+#endif // __LITE_DRIVE_NET_ENGINE_ZERO_COPY_H__
@@ -0,0 +1,108 @@
+#include <arena.h>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+namespace
+{
+
+constexpr uint32_t kMinChunkBytes = 1024;
+
+}
+
+Arena::Arena(IMemory *pMemory, uint32_t uChunkBytes)
+    : m_pMemory(pMemory), m_uChunkBytes(uChunkBytes < kMinChunkBytes ? kMinChunkBytes : uChunkBytes)
+{
+}
+
+Arena::~Arena()
+{
+    FreeChunks(m_pLarge);
+    FreeChunks(m_pChunk);
+}
+
+void Arena::Reset()
+{
+    FreeChunks(m_pLarge);
+    m_pLarge = nullptr;
+    m_uUsedBytes = 0;
+    if (m_pChunk == nullptr)
+    {
+        return;
+    }
+
+    // 只保留当前块，下一个请求从头复用
+    FreeChunks(m_pChunk->pNext);
+    m_pChunk->pNext = nullptr;
+    m_pCursor = reinterpret_cast<char *>(m_pChunk) + kChunkHeaderBytes;
+    m_pEnd = reinterpret_cast<char *>(m_pChunk) + m_pChunk->uBytes;
+}
+
+void *Arena::AllocateSlow(size_t uBytes, size_t uAlign)
+{
+    if (uBytes > UINT32_MAX || uAlign > UINT32_MAX)
+    {
+        return nullptr;
+    }
+
+    // 大请求单独申请一块，不打断当前块的分配，避免浪费当前块的剩余空间
+    if (uBytes + uAlign > (m_uChunkBytes - kChunkHeaderBytes) / 4)
+    {
+        uint64_t uChunkBytes = kChunkHeaderBytes + uBytes + (uAlign > kDefaultAlign ? uAlign : 0);
+        Chunk *pChunk = NewChunk(uChunkBytes);
+        if (pChunk == nullptr)
+        {
+            return nullptr;
+        }
+        pChunk->pNext = m_pLarge;
+        m_pLarge = pChunk;
+        m_uUsedBytes += uBytes;
+        uintptr_t uBegin = reinterpret_cast<uintptr_t>(pChunk) + kChunkHeaderBytes;
+        uBegin = (uBegin + uAlign - 1) & ~static_cast<uintptr_t>(uAlign - 1);
+        return reinterpret_cast<void *>(uBegin);
+    }
+
+    Chunk *pChunk = NewChunk(m_uChunkBytes);
+    if (pChunk == nullptr)
+    {
+        return nullptr;
+    }
+    pChunk->pNext = m_pChunk;
+    m_pChunk = pChunk;
+    m_pCursor = reinterpret_cast<char *>(pChunk) + kChunkHeaderBytes;
+    m_pEnd = reinterpret_cast<char *>(pChunk) + m_uChunkBytes;
+    return Allocate(uBytes, uAlign);
+}
+
+Arena::Chunk *Arena::NewChunk(uint64_t uBytes)
+{
+    if (m_pMemory == nullptr || uBytes > UINT32_MAX)
+    {
+        return nullptr;
+    }
+    Chunk *pChunk = static_cast<Chunk *>(m_pMemory->New(static_cast<uint32_t>(uBytes), MemoryTag::kArena));
+    if (pChunk == nullptr)
+    {
+        return nullptr;
+    }
+    pChunk->pNext = nullptr;
+    pChunk->uBytes = uBytes;
+    m_uReservedBytes += uBytes;
+    return pChunk;
+}
+
+void Arena::FreeChunks(Chunk *pChunk)
+{
+    while (pChunk != nullptr)
+    {
+        Chunk *pNext = pChunk->pNext;
+        m_uReservedBytes -= pChunk->uBytes;
+        m_pMemory->Delete(pChunk);
+        pChunk = pNext;
+    }
+}
+
+}
+}
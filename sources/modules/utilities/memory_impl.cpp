@@ -1,12 +1,75 @@
 #include "memory_impl.h"
+#include "thread_cache.h"
 #include <error_code.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <new>
+#include <json/writer.h>
 
 namespace lite_drive
 {
 namespace utilities
 {
 
+namespace
+{
+
+bool ParseHugePageMode(const std::string &strMode, SlabAllocator::HugePageMode &eMode)
+{
+    if (strMode == "none")
+    {
+        eMode = SlabAllocator::HugePageMode::kNone;
+        return true;
+    }
+    if (strMode == "thp")
+    {
+        eMode = SlabAllocator::HugePageMode::kTransparent;
+        return true;
+    }
+    if (strMode == "hugetlb")
+    {
+        eMode = SlabAllocator::HugePageMode::kHugeTlb;
+        return true;
+    }
+    return false;
+}
+
+const char *HugePageModeName(SlabAllocator::HugePageMode eMode)
+{
+    switch (eMode)
+    {
+    case SlabAllocator::HugePageMode::kTransparent:
+        return "thp";
+    case SlabAllocator::HugePageMode::kHugeTlb:
+        return "hugetlb";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * @brief 读取进程当前由透明大页映射的匿名内存字节数
+ * @return 字节数，内核不支持smaps_rollup时返回0
+ */
+uint64_t ReadAnonHugeBytes()
+{
+    // 首行是汇总的地址范围，之后每行为"名称: 数值 kB"
+    std::ifstream ifs("/proc/self/smaps_rollup");
+    const std::string strKey = "AnonHugePages:";
+    std::string strLine;
+    while (std::getline(ifs, strLine))
+    {
+        if (strLine.compare(0, strKey.size(), strKey) == 0)
+        {
+            return std::strtoull(strLine.c_str() + strKey.size(), nullptr, 10) * 1024;
+        }
+    }
+    return 0;
+}
+
+}
+
 IMemory* IMemory::Create()
 {
     return new(std::nothrow) MemoryImpl();
@@ -20,6 +83,11 @@ void IMemory::Destroy(IMemory *pMemory)
     }
 }
 
+MemoryImpl::~MemoryImpl()
+{
+    Exit();
+}
+
 int32_t MemoryImpl::Init(IConfig *pConfig)
 {
     if (pConfig == nullptr)
@@ -27,33 +95,157 @@ int32_t MemoryImpl::Init(IConfig *pConfig)
         return ErrorCode::kInvalidParam;
     }
     
-    m_uMaxMemorySize = pConfig->GetInt64(config::kSection, config::kMaxMemoryMB, 0);
-    m_uUsedMemorySize = 0;
+    int64_t iMaxMemoryMB = pConfig->GetInt64(config::kSection, config::kMaxMemoryMB, 0);
+    m_uMaxMemorySize = iMaxMemoryMB > 0 ? static_cast<uint64_t>(iMaxMemoryMB) << 20 : 0;
+    std::string strHugePages = pConfig->GetStr(config::kSection, config::kHugePages, default_value::kHugePages);
+    if (!ParseHugePageMode(strHugePages, m_eHugePageMode))
+    {
+        return ErrorCode::kInvalidParam;
+    }
+    int64_t iSampleRate = pConfig->GetInt64(config::kSection, config::kProfileSampleRate, default_value::kProfileSampleRate);
+    if (iSampleRate < 0 || iSampleRate > UINT32_MAX)
+    {
+        return ErrorCode::kInvalidParam;
+    }
+    m_slabAllocator.SetLimit(m_uMaxMemorySize);
+    m_slabAllocator.SetHugePageMode(m_eHugePageMode);
+    m_memoryStats.Init(static_cast<uint32_t>(iSampleRate));
+    m_uOwner = ThreadCache::NewOwner();
     return ErrorCode::kSuccess;
 }
 
 void MemoryImpl::Exit()
 {
+    // 先作废各线程的缓存，缓存中的块随区域一起释放
+    if (m_uOwner != 0)
+    {
+        ThreadCache::Detach(m_uOwner);
+        m_uOwner = 0;
+    }
+    m_slabAllocator.Exit();
+    m_memoryStats.Exit();
     m_uMaxMemorySize = 0;
-    m_uUsedMemorySize = 0;
 }
 
-void *MemoryImpl::New(uint32_t uSize)
+void *MemoryImpl::New(uint32_t uSize, MemoryTag eTag)
 {
-    return new(std::nothrow) uint8_t[uSize];
+    uint32_t uTag = static_cast<uint32_t>(eTag) < kTagCount ? static_cast<uint32_t>(eTag) : 0;
+    if (uSize <= SlabAllocator::kMaxSmallBytes)
+    {
+        ThreadCache *pCache = ThreadCache::Get(&m_slabAllocator, &m_memoryStats, m_uOwner);
+        if (pCache != nullptr)
+        {
+            uint32_t uClass = SlabAllocator::GetSizeClass(uSize);
+            void *pMem = pCache->Allocate(uClass);
+            if (pMem != nullptr)
+            {
+                SlabAllocator::SetBlockTag(pMem, static_cast<uint8_t>(uTag));
+                m_memoryStats.RecordAlloc(pCache->GetCounters(), uClass, uTag, SlabAllocator::GetClassSize(uClass), pMem);
+            }
+            return pMem;
+        }
+    }
+
+    void *pMem = m_slabAllocator.Allocate(uSize);
+    if (pMem != nullptr)
+    {
+        SlabAllocator::SetBlockTag(pMem, static_cast<uint8_t>(uTag));
+        uint32_t uClass = SlabAllocator::GetBlockClass(pMem);
+        uint32_t uSlot = uClass == SlabAllocator::kLargeClass ? AllocCounters::kLargeSlot : uClass;
+        m_memoryStats.RecordSharedAlloc(uSlot, uTag, SlabAllocator::GetBlockBytes(pMem), pMem);
+    }
+    return pMem;
 }
 
 void MemoryImpl::Delete(void *pMem)
 {
-    if (pMem != nullptr)
+    if (pMem == nullptr)
+    {
+        return;
+    }
+
+    // 先记录再归还，归还后块可能立即被其他线程分配并采样；标签取分配时记录的值，分配和释放总是计入同一标签
+    uint32_t uTag = SlabAllocator::GetBlockTag(pMem);
+    uint32_t uClass = SlabAllocator::GetBlockClass(pMem);
+    if (uClass != SlabAllocator::kLargeClass)
     {
-        delete[] static_cast<uint8_t *>(pMem);
+        // 小块不论在哪个线程分配，都放进释放线程的缓存
+        ThreadCache *pCache = ThreadCache::Get(&m_slabAllocator, &m_memoryStats, m_uOwner);
+        if (pCache != nullptr)
+        {
+            m_memoryStats.RecordFree(pCache->GetCounters(), uClass, uTag, SlabAllocator::GetClassSize(uClass), pMem);
+            pCache->Free(uClass, pMem);
+            return;
+        }
     }
+
+    uint32_t uSlot = uClass == SlabAllocator::kLargeClass ? AllocCounters::kLargeSlot : uClass;
+    m_memoryStats.RecordSharedFree(uSlot, uTag, SlabAllocator::GetBlockBytes(pMem), pMem);
+    m_slabAllocator.Free(pMem);
 }
 
 int32_t MemoryImpl::GetStats(std::string &strStats) const
 {
     strStats.clear();
+    try
+    {
+        Json::Value jsonStats(Json::objectValue);
+        jsonStats["max_bytes"] = Json::UInt64(m_uMaxMemorySize);
+        jsonStats["used_bytes"] = Json::UInt64(m_slabAllocator.GetUsedBytes());
+
+        // 透明大页的实际覆盖只能从内核读取进程整体的数值，以建议过的字节数为上限估算本分配器的部分
+        SlabAllocator::HugePageStats hugeStats;
+        m_slabAllocator.GetHugePageStats(hugeStats);
+        uint64_t uThpBytes = std::min(ReadAnonHugeBytes(), hugeStats.uAdvisedBytes);
+        uint64_t uHugeBytes = hugeStats.uHugeTlbBytes + uThpBytes;
+        Json::Value &jsonHuge = jsonStats["huge_pages"];
+        jsonHuge["mode"] = HugePageModeName(m_eHugePageMode);
+        jsonHuge["mapped_bytes"] = Json::UInt64(hugeStats.uMappedBytes);
+        jsonHuge["hugetlb_bytes"] = Json::UInt64(hugeStats.uHugeTlbBytes);
+        jsonHuge["thp_advised_bytes"] = Json::UInt64(hugeStats.uAdvisedBytes);
+        jsonHuge["thp_bytes"] = Json::UInt64(uThpBytes);
+        jsonHuge["hugetlb_fallbacks"] = Json::UInt64(hugeStats.uFallbacks);
+        jsonHuge["coverage_percent"] = hugeStats.uMappedBytes > 0 ? static_cast<double>(uHugeBytes) * 100 / hugeStats.uMappedBytes : 0.0;
+
+        // 各线程的计数在线程缓存中，已退出线程的计数由统计对象保存
+        AllocTotals totals;
+        ThreadCache::Accumulate(m_uOwner, totals);
+        m_memoryStats.Render(m_slabAllocator, totals, jsonStats);
+
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        strStats = Json::writeString(builder, jsonStats);
+    }
+    catch(const std::exception& e)
+    {
+        strStats.clear();
+        return ErrorCode::kThrowException;
+    }
+    return ErrorCode::kSuccess;
+}
+
+int32_t MemoryImpl::DumpHeapProfile(std::string &strProfile) const
+{
+    strProfile.clear();
+    if (m_memoryStats.GetSampleRate() == 0)
+    {
+        return ErrorCode::kInvalidCall;
+    }
+
+    try
+    {
+        Json::Value jsonProfile(Json::objectValue);
+        m_memoryStats.RenderProfile(jsonProfile);
+
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        strProfile = Json::writeString(builder, jsonProfile);
+    }
+    catch(const std::exception& e)
+    {
+        strProfile.clear();
+        return ErrorCode::kThrowException;
+    }
     return ErrorCode::kSuccess;
 }
 
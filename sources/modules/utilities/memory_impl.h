@@ -2,6 +2,8 @@
 #define __LITE_DRIVE_MEMORY_IMPL_H__
 
 #include <memory.h>
+#include "slab_allocator.h"
+#include "memory_stats.h"
 
 namespace lite_drive
 {
@@ -11,17 +13,21 @@ class MemoryImpl : public IMemory
 {
 public:
     MemoryImpl() = default;
-    ~MemoryImpl() override = default;
+    ~MemoryImpl() override;
 
     int32_t Init(IConfig *pConfig) override;
     void Exit() override;
-    void *New(uint32_t uSize) override;
+    void *New(uint32_t uSize, MemoryTag eTag) override;
     void Delete(void *pMem) override;
     int32_t GetStats(std::string &strStats) const override;
+    int32_t DumpHeapProfile(std::string &strProfile) const override;
 
 private:
-    uint64_t m_uMaxMemorySize{0};
-    uint64_t m_uUsedMemorySize{0};
+    SlabAllocator m_slabAllocator;
+    MemoryStats m_memoryStats;
+    uint64_t m_uOwner{0};         // 线程缓存使用的实例标识，每次初始化重新生成，0表示未初始化
+    uint64_t m_uMaxMemorySize{0}; // 内存上限，字节，0表示不限制，由分配器按交出的块计算
+    SlabAllocator::HugePageMode m_eHugePageMode{SlabAllocator::HugePageMode::kNone};
 };
 
 }
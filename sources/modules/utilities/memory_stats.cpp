@@ -0,0 +1,403 @@
+#include "memory_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <execinfo.h>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+namespace
+{
+
+const char *kTagNames[kTagCount] = {"general", "net_engine", "arena", "storage", "user_manager", "logger"};
+
+uint64_t NowMs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t Live(uint64_t uAllocated, uint64_t uFreed)
+{
+    // 释放按块上记录的标签计入，同一块的分配和释放总在同一标签下成对出现；
+    // 只是各线程的计数读取时刻不同，释放可能先于对应的分配被读到
+    return uAllocated > uFreed ? uAllocated - uFreed : 0;
+}
+
+double Rate(uint64_t uCurrent, uint64_t uLast, double dSeconds)
+{
+    return dSeconds > 0 && uCurrent > uLast ? static_cast<double>(uCurrent - uLast) / dSeconds : 0.0;
+}
+
+void UpdatePeak(std::atomic<int64_t> &iPeak, int64_t iValue)
+{
+    int64_t iLast = iPeak.load(std::memory_order_relaxed);
+    while (iValue > iLast && !iPeak.compare_exchange_weak(iLast, iValue, std::memory_order_relaxed))
+    {
+    }
+}
+
+}
+
+void AllocCounters::Reset()
+{
+    for (uint32_t i = 0; i < kSlotCount; i++)
+    {
+        arrAllocs[i].Set(0);
+        arrFrees[i].Set(0);
+        arrSlotDrift[i] = 0;
+    }
+    uLargeAllocBytes.Set(0);
+    uLargeFreeBytes.Set(0);
+    for (uint32_t i = 0; i < kTagCount; i++)
+    {
+        arrTagAllocs[i].Set(0);
+        arrTagFrees[i].Set(0);
+        arrTagAllocBytes[i].Set(0);
+        arrTagFreeBytes[i].Set(0);
+        arrTagDrift[i] = 0;
+    }
+    iTotalDrift = 0;
+    uSampleCountdown = 0;
+}
+
+void AllocTotals::Add(const AllocCounters &counters)
+{
+    for (uint32_t i = 0; i < AllocCounters::kSlotCount; i++)
+    {
+        arrAllocs[i] += counters.arrAllocs[i].Get();
+        arrFrees[i] += counters.arrFrees[i].Get();
+    }
+    uLargeAllocBytes += counters.uLargeAllocBytes.Get();
+    uLargeFreeBytes += counters.uLargeFreeBytes.Get();
+    for (uint32_t i = 0; i < kTagCount; i++)
+    {
+        arrTagAllocs[i] += counters.arrTagAllocs[i].Get();
+        arrTagFrees[i] += counters.arrTagFrees[i].Get();
+        arrTagAllocBytes[i] += counters.arrTagAllocBytes[i].Get();
+        arrTagFreeBytes[i] += counters.arrTagFreeBytes[i].Get();
+    }
+}
+
+void AllocTotals::Add(const AllocTotals &totals)
+{
+    for (uint32_t i = 0; i < AllocCounters::kSlotCount; i++)
+    {
+        arrAllocs[i] += totals.arrAllocs[i];
+        arrFrees[i] += totals.arrFrees[i];
+    }
+    uLargeAllocBytes += totals.uLargeAllocBytes;
+    uLargeFreeBytes += totals.uLargeFreeBytes;
+    for (uint32_t i = 0; i < kTagCount; i++)
+    {
+        arrTagAllocs[i] += totals.arrTagAllocs[i];
+        arrTagFrees[i] += totals.arrTagFrees[i];
+        arrTagAllocBytes[i] += totals.arrTagAllocBytes[i];
+        arrTagFreeBytes[i] += totals.arrTagFreeBytes[i];
+    }
+}
+
+void MemoryStats::PeakGauge::Add(int64_t iBytes)
+{
+    UpdatePeak(iPeak, iLive.fetch_add(iBytes, std::memory_order_relaxed) + iBytes);
+}
+
+uint64_t MemoryStats::PeakGauge::GetPeak(uint64_t uLive) const
+{
+    UpdatePeak(iPeak, static_cast<int64_t>(uLive));
+    return static_cast<uint64_t>(std::max<int64_t>(iPeak.load(std::memory_order_relaxed), 0));
+}
+
+void MemoryStats::PeakGauge::Reset()
+{
+    iLive.store(0, std::memory_order_relaxed);
+    iPeak.store(0, std::memory_order_relaxed);
+}
+
+void MemoryStats::Init(uint32_t uSampleRate)
+{
+    Exit();
+    m_uSampleRate = uSampleRate;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_uLastTimeMs = NowMs();
+}
+
+void MemoryStats::Exit()
+{
+    m_uSampleRate = 0;
+    for (PeakGauge &gauge : m_arrSlotGauge)
+    {
+        gauge.Reset();
+    }
+    for (PeakGauge &gauge : m_arrTagGauge)
+    {
+        gauge.Reset();
+    }
+    m_totalGauge.Reset();
+
+    {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        m_sharedCounters.Reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_retiredTotals = AllocTotals();
+        m_lastTotals = AllocTotals();
+        m_uLastTimeMs = NowMs();
+    }
+
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    m_umapSample.clear();
+    for (auto &filter : m_arrFilter)
+    {
+        filter.store(0, std::memory_order_relaxed);
+    }
+}
+
+void MemoryStats::RecordSharedAlloc(uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem)
+{
+    std::lock_guard<std::mutex> lock(m_sharedMutex);
+    RecordAlloc(m_sharedCounters, uSlot, uTag, uBytes, pMem);
+}
+
+void MemoryStats::RecordSharedFree(uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem)
+{
+    std::lock_guard<std::mutex> lock(m_sharedMutex);
+    RecordFree(m_sharedCounters, uSlot, uTag, uBytes, pMem);
+}
+
+void MemoryStats::Retire(AllocCounters &counters)
+{
+    // 未合入的变化一并合入，峰值计量与汇总的在用字节数保持一致
+    for (uint32_t i = 0; i < AllocCounters::kSlotCount; i++)
+    {
+        m_arrSlotGauge[i].Add(counters.arrSlotDrift[i]);
+        counters.arrSlotDrift[i] = 0;
+    }
+    for (uint32_t i = 0; i < kTagCount; i++)
+    {
+        m_arrTagGauge[i].Add(counters.arrTagDrift[i]);
+        counters.arrTagDrift[i] = 0;
+    }
+    m_totalGauge.Add(counters.iTotalDrift);
+    counters.iTotalDrift = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_retiredTotals.Add(counters);
+}
+
+void MemoryStats::Render(const SlabAllocator &allocator, const AllocTotals &threadTotals, Json::Value &jsonStats) const
+{
+    AllocTotals totals = threadTotals;
+    totals.Add(m_sharedCounters);
+
+    AllocTotals lastTotals;
+    double dSeconds = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        totals.Add(m_retiredTotals);
+        uint64_t uNowMs = NowMs();
+        dSeconds = static_cast<double>(uNowMs - m_uLastTimeMs) / 1000;
+        lastTotals = m_lastTotals;
+        m_lastTotals = totals;
+        m_uLastTimeMs = uNowMs;
+    }
+
+    // 碎片率为slab中没有交给使用方的比例，包括级别取整的余量、线程缓存和slab中的空闲块
+    uint64_t uLiveTotal = 0;
+    Json::Value &jsonClasses = jsonStats["classes"];
+    jsonClasses = Json::Value(Json::arrayValue);
+    for (uint32_t i = 0; i < SlabAllocator::kClassCount; i++)
+    {
+        uint32_t uSlabs = allocator.GetSlabCount(i);
+        if (totals.arrAllocs[i] == 0 && uSlabs == 0)
+        {
+            continue;
+        }
+
+        uint64_t uClassSize = SlabAllocator::GetClassSize(i);
+        uint64_t uLiveBlocks = Live(totals.arrAllocs[i], totals.arrFrees[i]);
+        uint64_t uLiveBytes = uLiveBlocks * uClassSize;
+        uint64_t uSlabBytes = static_cast<uint64_t>(uSlabs) * SlabAllocator::kSlabBytes;
+        uLiveTotal += uLiveBytes;
+
+        Json::Value jsonClass(Json::objectValue);
+        jsonClass["size"] = Json::UInt64(uClassSize);
+        jsonClass["slabs"] = uSlabs;
+        jsonClass["live_blocks"] = Json::UInt64(uLiveBlocks);
+        jsonClass["live_bytes"] = Json::UInt64(uLiveBytes);
+        jsonClass["peak_bytes"] = Json::UInt64(m_arrSlotGauge[i].GetPeak(uLiveBytes));
+        jsonClass["allocs"] = Json::UInt64(totals.arrAllocs[i]);
+        jsonClass["frees"] = Json::UInt64(totals.arrFrees[i]);
+        jsonClass["alloc_rate"] = Rate(totals.arrAllocs[i], lastTotals.arrAllocs[i], dSeconds);
+        jsonClass["free_rate"] = Rate(totals.arrFrees[i], lastTotals.arrFrees[i], dSeconds);
+        jsonClass["fragmentation_percent"] = uSlabBytes > uLiveBytes ? static_cast<double>(uSlabBytes - uLiveBytes) * 100 / uSlabBytes : 0.0;
+        jsonClasses.append(jsonClass);
+    }
+
+    const uint32_t uLarge = AllocCounters::kLargeSlot;
+    uint64_t uLargeBytes = Live(totals.uLargeAllocBytes, totals.uLargeFreeBytes);
+    uLiveTotal += uLargeBytes;
+    Json::Value &jsonLarge = jsonStats["large"];
+    jsonLarge["live_blocks"] = Json::UInt64(Live(totals.arrAllocs[uLarge], totals.arrFrees[uLarge]));
+    jsonLarge["live_bytes"] = Json::UInt64(uLargeBytes);
+    jsonLarge["peak_bytes"] = Json::UInt64(m_arrSlotGauge[uLarge].GetPeak(uLargeBytes));
+    jsonLarge["allocs"] = Json::UInt64(totals.arrAllocs[uLarge]);
+    jsonLarge["frees"] = Json::UInt64(totals.arrFrees[uLarge]);
+    jsonLarge["alloc_rate"] = Rate(totals.arrAllocs[uLarge], lastTotals.arrAllocs[uLarge], dSeconds);
+    jsonLarge["free_rate"] = Rate(totals.arrFrees[uLarge], lastTotals.arrFrees[uLarge], dSeconds);
+
+    Json::Value &jsonModules = jsonStats["modules"];
+    jsonModules = Json::Value(Json::objectValue);
+    for (uint32_t i = 0; i < kTagCount; i++)
+    {
+        if (totals.arrTagAllocs[i] == 0)
+        {
+            continue;
+        }
+
+        uint64_t uLiveBytes = Live(totals.arrTagAllocBytes[i], totals.arrTagFreeBytes[i]);
+        Json::Value &jsonModule = jsonModules[kTagNames[i]];
+        jsonModule["live_blocks"] = Json::UInt64(Live(totals.arrTagAllocs[i], totals.arrTagFrees[i]));
+        jsonModule["live_bytes"] = Json::UInt64(uLiveBytes);
+        jsonModule["peak_bytes"] = Json::UInt64(m_arrTagGauge[i].GetPeak(uLiveBytes));
+        jsonModule["allocs"] = Json::UInt64(totals.arrTagAllocs[i]);
+        jsonModule["frees"] = Json::UInt64(totals.arrTagFrees[i]);
+        jsonModule["alloc_rate"] = Rate(totals.arrTagAllocs[i], lastTotals.arrTagAllocs[i], dSeconds);
+        jsonModule["free_rate"] = Rate(totals.arrTagFrees[i], lastTotals.arrTagFrees[i], dSeconds);
+    }
+
+    jsonStats["live_bytes"] = Json::UInt64(uLiveTotal);
+    jsonStats["peak_bytes"] = Json::UInt64(m_totalGauge.GetPeak(uLiveTotal));
+
+    Json::Value &jsonProfiler = jsonStats["profiler"];
+    jsonProfiler["sample_rate"] = m_uSampleRate;
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    jsonProfiler["live_samples"] = Json::UInt64(m_umapSample.size());
+}
+
+void MemoryStats::RenderProfile(Json::Value &jsonProfile) const
+{
+    struct StackTotal
+    {
+        uint64_t uCount{0};
+        uint64_t uBytes{0};
+        uint64_t uOldestMs{UINT64_MAX};
+        const SampleRecord *pRecord{nullptr};
+    };
+
+    jsonProfile["sample_rate"] = m_uSampleRate;
+    Json::Value &jsonStacks = jsonProfile["stacks"];
+    jsonStacks = Json::Value(Json::arrayValue);
+
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    jsonProfile["live_samples"] = Json::UInt64(m_umapSample.size());
+
+    // 同一标签、同一调用栈的采样合并
+    std::map<std::vector<void *>, StackTotal> mapStack;
+    for (const auto &item : m_umapSample)
+    {
+        const SampleRecord &record = item.second;
+        std::vector<void *> vecKey(record.arrFrames, record.arrFrames + record.uDepth);
+        vecKey.push_back(reinterpret_cast<void *>(static_cast<uintptr_t>(record.uTag)));
+        StackTotal &total = mapStack[vecKey];
+        total.uCount++;
+        total.uBytes += record.uBytes;
+        total.uOldestMs = std::min(total.uOldestMs, record.uTimeMs);
+        total.pRecord = &record;
+    }
+
+    std::vector<const StackTotal *> vecTotal;
+    vecTotal.reserve(mapStack.size());
+    for (const auto &item : mapStack)
+    {
+        vecTotal.push_back(&item.second);
+    }
+    std::sort(vecTotal.begin(), vecTotal.end(), [](const StackTotal *pLeft, const StackTotal *pRight) {
+        return pLeft->uBytes > pRight->uBytes;
+    });
+
+    uint64_t uNowMs = NowMs();
+    for (const StackTotal *pTotal : vecTotal)
+    {
+        const SampleRecord &record = *pTotal->pRecord;
+        Json::Value jsonStack(Json::objectValue);
+        jsonStack["module"] = kTagNames[record.uTag];
+        jsonStack["samples"] = Json::UInt64(pTotal->uCount);
+        jsonStack["sampled_bytes"] = Json::UInt64(pTotal->uBytes);
+        jsonStack["estimated_bytes"] = Json::UInt64(pTotal->uBytes * m_uSampleRate);
+        jsonStack["oldest_age_ms"] = Json::UInt64(uNowMs > pTotal->uOldestMs ? uNowMs - pTotal->uOldestMs : 0);
+
+        Json::Value &jsonFrames = jsonStack["frames"];
+        jsonFrames = Json::Value(Json::arrayValue);
+        char **ppSymbols = backtrace_symbols(record.arrFrames, static_cast<int>(record.uDepth));
+        for (uint32_t i = 0; i < record.uDepth; i++)
+        {
+            jsonFrames.append(ppSymbols != nullptr ? Json::Value(ppSymbols[i]) : Json::Value(Json::UInt64(reinterpret_cast<uintptr_t>(record.arrFrames[i]))));
+        }
+        free(ppSymbols);
+        jsonStacks.append(jsonStack);
+    }
+}
+
+void MemoryStats::Sample(AllocCounters &counters, uint32_t uTag, uint64_t uBytes, void *pMem)
+{
+    // 间隔在[1, 2N-1]内均匀取值，平均为N，避免与周期性的分配模式同步
+    if (counters.uRandom == 0)
+    {
+        counters.uRandom = reinterpret_cast<uintptr_t>(&counters) | 1;
+    }
+    counters.uRandom ^= counters.uRandom << 13;
+    counters.uRandom ^= counters.uRandom >> 7;
+    counters.uRandom ^= counters.uRandom << 17;
+    uint64_t uRange = static_cast<uint64_t>(m_uSampleRate) * 2 - 1;
+    counters.uSampleCountdown = static_cast<uint32_t>(1 + counters.uRandom % uRange);
+
+    SampleRecord record;
+    record.uBytes = uBytes;
+    record.uTimeMs = NowMs();
+    record.uTag = uTag;
+    // 跳过本函数所在的栈帧
+    void *arrFrames[kMaxFrames + 1];
+    int iDepth = backtrace(arrFrames, kMaxFrames + 1);
+    record.uDepth = iDepth > 1 ? static_cast<uint32_t>(iDepth - 1) : 0;
+    std::copy(arrFrames + 1, arrFrames + 1 + record.uDepth, record.arrFrames);
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_sampleMutex);
+        auto result = m_umapSample.emplace(pMem, record);
+        if (result.second)
+        {
+            m_arrFilter[GetFilterIndex(pMem)].fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            result.first->second = record;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        // 采样记录失败只影响分析结果，不影响分配
+    }
+}
+
+void MemoryStats::Unsample(void *pMem)
+{
+    std::lock_guard<std::mutex> lock(m_sampleMutex);
+    auto it = m_umapSample.find(pMem);
+    if (it != m_umapSample.end())
+    {
+        m_umapSample.erase(it);
+        m_arrFilter[GetFilterIndex(pMem)].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+}
+}
@@ -0,0 +1,280 @@
+#ifndef __LITE_DRIVE_MEMORY_STATS_H__
+#define __LITE_DRIVE_MEMORY_STATS_H__
+
+#include "slab_allocator.h"
+#include "stat_counter.h"
+#include <memory.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <json/value.h>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+constexpr uint32_t kTagCount = static_cast<uint32_t>(MemoryTag::kMax);
+
+/**
+ * @brief 一个线程在一个内存对象上的分配计数
+ * @note 位于线程缓存中，只由所属线程修改。在其他线程释放的块计入释放线程，各线程的计数相加后才有意义。
+ *       在用字节数的变化先在本线程累积，超过MemoryStats::kDriftBytes才合入全局的峰值计量，快路径上没有原子的读改写
+ */
+struct AllocCounters
+{
+    static constexpr uint32_t kSlotCount = SlabAllocator::kClassCount + 1; // 各大小级别，最后一个为大块内存
+    static constexpr uint32_t kLargeSlot = SlabAllocator::kClassCount;
+
+    StatCounter arrAllocs[kSlotCount];
+    StatCounter arrFrees[kSlotCount];
+    StatCounter uLargeAllocBytes; // 大块内存大小不一，单独累计字节数
+    StatCounter uLargeFreeBytes;
+    StatCounter arrTagAllocs[kTagCount];
+    StatCounter arrTagFrees[kTagCount];
+    StatCounter arrTagAllocBytes[kTagCount];
+    StatCounter arrTagFreeBytes[kTagCount];
+
+    int64_t arrSlotDrift[kSlotCount]{}; // 尚未合入峰值计量的在用字节数变化
+    int64_t arrTagDrift[kTagCount]{};
+    int64_t iTotalDrift{0};
+    uint32_t uSampleCountdown{0};       // 距离下一次采样的分配次数
+    uint64_t uRandom{0};                // 采样间隔的随机数状态
+
+    /**
+     * @brief 清零计数，调用方保证没有并发修改
+     */
+    void Reset();
+};
+
+/**
+ * @brief 各线程计数的汇总
+ */
+struct AllocTotals
+{
+    uint64_t arrAllocs[AllocCounters::kSlotCount]{};
+    uint64_t arrFrees[AllocCounters::kSlotCount]{};
+    uint64_t uLargeAllocBytes{0};
+    uint64_t uLargeFreeBytes{0};
+    uint64_t arrTagAllocs[kTagCount]{};
+    uint64_t arrTagFrees[kTagCount]{};
+    uint64_t arrTagAllocBytes[kTagCount]{};
+    uint64_t arrTagFreeBytes[kTagCount]{};
+
+    /**
+     * @brief 累加一个线程的计数
+     * @param counters 线程的计数
+     */
+    void Add(const AllocCounters &counters);
+
+    /**
+     * @brief 累加另一份汇总
+     * @param totals 汇总
+     */
+    void Add(const AllocTotals &totals);
+};
+
+/**
+ * @brief 内存对象的分配统计和采样堆分析
+ * @note 计数按线程记录在AllocCounters中，统计时汇总；峰值由各线程按批合入的全局计量得到，
+ *       误差不超过线程数乘以kDriftBytes。
+ *       开启采样时平均每N次分配记录一次调用栈，释放时按地址的过滤表判断是否可能被采样，
+ *       只有命中过滤表的释放才加锁查找，未采样的分配和释放不加锁
+ */
+class MemoryStats
+{
+public:
+    static constexpr int64_t kDriftBytes = 256 * 1024; // 线程累积的在用字节数变化超过该值时合入峰值计量
+    static constexpr uint32_t kMaxFrames = 24;         // 采样记录的最大栈深度
+
+    MemoryStats() = default;
+    ~MemoryStats() = default;
+
+    MemoryStats(const MemoryStats &) = delete;
+    MemoryStats &operator=(const MemoryStats &) = delete;
+
+    /**
+     * @brief 初始化
+     * @param uSampleRate 采样间隔，平均每uSampleRate次分配采样一次，0表示不采样
+     */
+    void Init(uint32_t uSampleRate);
+
+    /**
+     * @brief 清空全部统计和采样记录
+     */
+    void Exit();
+
+    /**
+     * @brief 获取采样间隔
+     * @return 采样间隔，0表示不采样
+     */
+    uint32_t GetSampleRate() const { return m_uSampleRate; }
+
+    /**
+     * @brief 记录一次分配，仅由计数所属的线程调用
+     * @param counters 线程的计数
+     * @param uSlot 大小级别，大块内存为AllocCounters::kLargeSlot
+     * @param uTag 使用方标签
+     * @param uBytes 块实际占用的字节数
+     * @param pMem 内存指针
+     */
+    void RecordAlloc(AllocCounters &counters, uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem)
+    {
+        counters.arrAllocs[uSlot].Add();
+        counters.arrTagAllocs[uTag].Add();
+        counters.arrTagAllocBytes[uTag].Add(uBytes);
+        if (uSlot == AllocCounters::kLargeSlot)
+        {
+            counters.uLargeAllocBytes.Add(uBytes);
+        }
+        Drift(counters, uSlot, uTag, static_cast<int64_t>(uBytes));
+        if (m_uSampleRate != 0 && counters.uSampleCountdown-- <= 1)
+        {
+            Sample(counters, uTag, uBytes, pMem);
+        }
+    }
+
+    /**
+     * @brief 记录一次释放，在内存归还之前调用，仅由计数所属的线程调用
+     * @param counters 线程的计数
+     * @param uSlot 大小级别，大块内存为AllocCounters::kLargeSlot
+     * @param uTag 分配时的使用方标签
+     * @param uBytes 块实际占用的字节数
+     * @param pMem 内存指针
+     */
+    void RecordFree(AllocCounters &counters, uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem)
+    {
+        counters.arrFrees[uSlot].Add();
+        counters.arrTagFrees[uTag].Add();
+        counters.arrTagFreeBytes[uTag].Add(uBytes);
+        if (uSlot == AllocCounters::kLargeSlot)
+        {
+            counters.uLargeFreeBytes.Add(uBytes);
+        }
+        Drift(counters, uSlot, uTag, -static_cast<int64_t>(uBytes));
+        if (m_uSampleRate != 0 && m_arrFilter[GetFilterIndex(pMem)].load(std::memory_order_relaxed) != 0)
+        {
+            Unsample(pMem);
+        }
+    }
+
+    /**
+     * @brief 记录一次不经过线程缓存的分配，包括大块内存，线程安全
+     * @param uSlot 大小级别，大块内存为AllocCounters::kLargeSlot
+     * @param uTag 使用方标签
+     * @param uBytes 块实际占用的字节数
+     * @param pMem 内存指针
+     */
+    void RecordSharedAlloc(uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem);
+
+    /**
+     * @brief 记录一次不经过线程缓存的释放，包括大块内存，线程安全
+     * @param uSlot 大小级别，大块内存为AllocCounters::kLargeSlot
+     * @param uTag 使用方标签
+     * @param uBytes 块实际占用的字节数
+     * @param pMem 内存指针
+     */
+    void RecordSharedFree(uint32_t uSlot, uint32_t uTag, uint64_t uBytes, void *pMem);
+
+    /**
+     * @brief 线程退出时合入其计数，之后该计数不再被汇总
+     * @param counters 线程的计数
+     */
+    void Retire(AllocCounters &counters);
+
+    /**
+     * @brief 输出各大小级别、大块内存、各标签的统计和采样概况
+     * @param allocator 分配器，读取各级别的slab数
+     * @param threadTotals 仍在运行的线程的计数汇总
+     * @param jsonStats 输出
+     * @note 速率按与上一次调用之间的变化计算，首次调用从初始化开始计算
+     */
+    void Render(const SlabAllocator &allocator, const AllocTotals &threadTotals, Json::Value &jsonStats) const;
+
+    /**
+     * @brief 按使用方标签和调用栈汇总仍未释放的采样分配
+     * @param jsonProfile 输出，按字节数从大到小排列
+     */
+    void RenderProfile(Json::Value &jsonProfile) const;
+
+private:
+    // 全局的在用字节数和峰值，由各线程按批合入
+    struct PeakGauge
+    {
+        std::atomic<int64_t> iLive{0};
+        mutable std::atomic<int64_t> iPeak{0};
+
+        void Add(int64_t iBytes);
+
+        /**
+         * @brief 获取峰值，统计时汇总出的在用字节数也计入峰值，多次输出的峰值不会变小
+         * @param uLive 汇总出的在用字节数
+         * @return 峰值
+         */
+        uint64_t GetPeak(uint64_t uLive) const;
+        void Reset();
+    };
+
+    struct SampleRecord
+    {
+        uint64_t uBytes{0};
+        uint64_t uTimeMs{0}; // 采样时刻，单调时钟
+        uint32_t uTag{0};
+        uint32_t uDepth{0};
+        void *arrFrames[kMaxFrames];
+    };
+
+    static constexpr uint32_t kFilterBits = 12;
+
+    void Drift(AllocCounters &counters, uint32_t uSlot, uint32_t uTag, int64_t iBytes)
+    {
+        FlushDrift(counters.arrSlotDrift[uSlot], iBytes, m_arrSlotGauge[uSlot]);
+        FlushDrift(counters.arrTagDrift[uTag], iBytes, m_arrTagGauge[uTag]);
+        FlushDrift(counters.iTotalDrift, iBytes, m_totalGauge);
+    }
+
+    static void FlushDrift(int64_t &iDrift, int64_t iBytes, PeakGauge &gauge)
+    {
+        iDrift += iBytes;
+        if (iDrift >= kDriftBytes || iDrift <= -kDriftBytes)
+        {
+            gauge.Add(iDrift);
+            iDrift = 0;
+        }
+    }
+
+    static uint32_t GetFilterIndex(const void *pMem)
+    {
+        return static_cast<uint32_t>(((reinterpret_cast<uintptr_t>(pMem) >> 4) * 0x9e3779b97f4a7c15ull) >> (64 - kFilterBits));
+    }
+
+    void Sample(AllocCounters &counters, uint32_t uTag, uint64_t uBytes, void *pMem);
+    void Unsample(void *pMem);
+
+private:
+    uint32_t m_uSampleRate{0};
+
+    PeakGauge m_arrSlotGauge[AllocCounters::kSlotCount];
+    PeakGauge m_arrTagGauge[kTagCount];
+    PeakGauge m_totalGauge;
+
+    // 没有线程缓存时的分配和大块内存，加锁后按单写者记录
+    std::mutex m_sharedMutex;
+    AllocCounters m_sharedCounters;
+
+    // 已退出线程的计数和上一次输出时的汇总，用于计算速率
+    mutable std::mutex m_mutex;
+    AllocTotals m_retiredTotals;
+    mutable AllocTotals m_lastTotals;
+    mutable uint64_t m_uLastTimeMs{0};
+
+    // 采样记录，按地址查找；过滤表记录每个散列位置上的采样数，释放时先查过滤表
+    mutable std::mutex m_sampleMutex;
+    std::unordered_map<void *, SampleRecord> m_umapSample;
+    std::atomic<uint32_t> m_arrFilter[1u << kFilterBits]{};
+};
+
+}
+}
+#endif // __LITE_DRIVE_MEMORY_STATS_H__
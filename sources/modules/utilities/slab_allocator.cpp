@@ -0,0 +1,571 @@
+#include "slab_allocator.h"
+#include <new>
+#include <sys/mman.h>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+SlabAllocator::SlabAllocator()
+{
+    static_assert(sizeof(Slab) <= kHeaderBytes, "slab header overflow");
+    for (uint32_t i = 0; i < kClassCount; i++)
+    {
+        // 每块另占一个字节的标签，预留标签区补齐对齐的余量，最小级别的块区偏移也不超过uint16_t
+        SizeClass &sizeClass = m_arrClass[i];
+        sizeClass.uSize = GetClassSize(i);
+        sizeClass.uCapacity = (kSlabBytes - kHeaderBytes - kBlockAlignBytes) / (sizeClass.uSize + 1);
+        sizeClass.uBlockOffset = kHeaderBytes + (sizeClass.uCapacity + kBlockAlignBytes - 1) / kBlockAlignBytes * kBlockAlignBytes;
+    }
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    Exit();
+}
+
+void SlabAllocator::Exit()
+{
+    // 分配时先锁级别再锁区域，这里分开加锁，不反向嵌套
+    for (auto &sizeClass : m_arrClass)
+    {
+        std::lock_guard<std::mutex> lock(sizeClass.mutex);
+        sizeClass.pPartial = nullptr;
+        sizeClass.uSlabs.store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(m_regionMutex);
+    for (const Region &region : m_vecRegion)
+    {
+        Unmap(region.pBase, kRegionBytes, region.uMapFlags);
+    }
+    m_vecRegion.clear();
+    m_pRegionCursor = nullptr;
+    m_pRegionEnd = nullptr;
+    m_pFreeSlab = nullptr;
+
+    // 大块内存仍由使用方持有，之后释放时还要扣减，只清除slab交出的字节数
+    m_uUsedBytes = m_uLargeBytes.load(std::memory_order_relaxed);
+}
+
+void SlabAllocator::SetLimit(uint64_t uMaxBytes)
+{
+    m_uMaxBytes = uMaxBytes;
+}
+
+uint64_t SlabAllocator::GetUsedBytes() const
+{
+    return m_uUsedBytes.load(std::memory_order_relaxed);
+}
+
+void SlabAllocator::SetHugePageMode(HugePageMode eMode)
+{
+    m_eHugePageMode = eMode;
+}
+
+void SlabAllocator::GetHugePageStats(HugePageStats &stats) const
+{
+    stats.uMappedBytes = m_uMappedBytes.load(std::memory_order_relaxed);
+    stats.uHugeTlbBytes = m_uHugeTlbBytes.load(std::memory_order_relaxed);
+    stats.uAdvisedBytes = m_uAdvisedBytes.load(std::memory_order_relaxed);
+    stats.uFallbacks = m_uHugeTlbFallbacks.load(std::memory_order_relaxed);
+}
+
+void *SlabAllocator::Allocate(uint32_t uSize)
+{
+    if (uSize > kMaxSmallBytes)
+    {
+        return AllocateLarge(uSize);
+    }
+
+    uint32_t uClass = GetSizeClass(uSize);
+    if (!Reserve(m_arrClass[uClass].uSize))
+    {
+        return nullptr;
+    }
+
+    void *pMem = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_arrClass[uClass].mutex);
+        pMem = PopBlock(uClass);
+    }
+
+    if (pMem == nullptr)
+    {
+        Unreserve(m_arrClass[uClass].uSize);
+    }
+    return pMem;
+}
+
+void SlabAllocator::Free(void *pMem)
+{
+    if (pMem == nullptr)
+    {
+        return;
+    }
+
+    Slab *pSlab = GetSlab(pMem);
+    if (pSlab->uMagic != kMagic)
+    {
+        return;
+    }
+
+    if (pSlab->uClass == kLargeClass)
+    {
+        m_uLargeBytes.fetch_sub(pSlab->uMapBytes, std::memory_order_relaxed);
+        Unreserve(pSlab->uMapBytes);
+        Unmap(pSlab, pSlab->uMapBytes, pSlab->uMapFlags);
+        return;
+    }
+
+    uint32_t uClass = pSlab->uClass;
+    Slab *pEmpty = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_arrClass[uClass].mutex);
+        pEmpty = PushBlock(uClass, pMem);
+    }
+
+    Unreserve(m_arrClass[uClass].uSize);
+    if (pEmpty != nullptr)
+    {
+        ReleaseSlab(pEmpty);
+    }
+}
+
+uint32_t SlabAllocator::AllocateBatch(uint32_t uClass, uint32_t uCount, void *&pHead)
+{
+    // 额度不够整批时退化为只取一块，尽量不让缓存把上限附近的分配挡掉
+    pHead = nullptr;
+    uint64_t uSize = m_arrClass[uClass].uSize;
+    if (!Reserve(uSize * uCount))
+    {
+        if (uCount == 1 || !Reserve(uSize))
+        {
+            return 0;
+        }
+        uCount = 1;
+    }
+
+    uint32_t uAllocated = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_arrClass[uClass].mutex);
+        while (uAllocated < uCount)
+        {
+            void *pMem = PopBlock(uClass);
+            if (pMem == nullptr)
+            {
+                break;
+            }
+            *static_cast<void **>(pMem) = pHead;
+            pHead = pMem;
+            uAllocated++;
+        }
+    }
+
+    if (uAllocated < uCount)
+    {
+        Unreserve(uSize * (uCount - uAllocated));
+    }
+    return uAllocated;
+}
+
+void SlabAllocator::FreeBatch(uint32_t uClass, void *pHead, uint32_t uCount)
+{
+    // 空闲的slab先串起来，出锁后再归还
+    Slab *pEmptyList = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_arrClass[uClass].mutex);
+        while (pHead != nullptr)
+        {
+            void *pMem = pHead;
+            pHead = *static_cast<void **>(pMem);
+            Slab *pEmpty = PushBlock(uClass, pMem);
+            if (pEmpty != nullptr)
+            {
+                pEmpty->pNext = pEmptyList;
+                pEmptyList = pEmpty;
+            }
+        }
+    }
+
+    Unreserve(static_cast<uint64_t>(m_arrClass[uClass].uSize) * uCount);
+    while (pEmptyList != nullptr)
+    {
+        Slab *pSlab = pEmptyList;
+        pEmptyList = pSlab->pNext;
+        ReleaseSlab(pSlab);
+    }
+}
+
+uint64_t SlabAllocator::GetBlockBytes(const void *pMem)
+{
+    if (pMem == nullptr)
+    {
+        return 0;
+    }
+
+    const Slab *pSlab = GetSlab(pMem);
+    if (pSlab->uMagic != kMagic)
+    {
+        return 0;
+    }
+    return pSlab->uClass == kLargeClass ? pSlab->uMapBytes : GetClassSize(pSlab->uClass);
+}
+
+void SlabAllocator::SetBlockTag(void *pMem, uint8_t uTag)
+{
+    Slab *pSlab = GetSlab(pMem);
+    if (pSlab->uMagic != kMagic)
+    {
+        return;
+    }
+
+    if (pSlab->uClass == kLargeClass)
+    {
+        pSlab->uTag = uTag;
+        return;
+    }
+    *GetTagSlot(pSlab, pMem) = uTag;
+}
+
+uint8_t SlabAllocator::GetBlockTag(const void *pMem)
+{
+    const Slab *pSlab = GetSlab(pMem);
+    if (pSlab->uMagic != kMagic)
+    {
+        return 0;
+    }
+    return pSlab->uClass == kLargeClass ? pSlab->uTag : *GetTagSlot(pSlab, pMem);
+}
+
+uint32_t SlabAllocator::GetSlabCount(uint32_t uClass) const
+{
+    return uClass < kClassCount ? m_arrClass[uClass].uSlabs.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t SlabAllocator::GetBlockClass(const void *pMem)
+{
+    const Slab *pSlab = GetSlab(pMem);
+    return pSlab->uMagic == kMagic ? pSlab->uClass : kLargeClass;
+}
+
+uint32_t SlabAllocator::GetSizeClass(uint32_t uSize)
+{
+    if (uSize <= 64)
+    {
+        return uSize == 0 ? 0 : (uSize - 1) / 16;
+    }
+
+    // (2^k, 2^(k+1)]区间等分为4级，每级2^(k-2)字节
+    uint32_t uHighBit = 31 - static_cast<uint32_t>(__builtin_clz(uSize - 1));
+    return 4 + (uHighBit - 6) * 4 + (((uSize - 1) >> (uHighBit - 2)) & 3);
+}
+
+uint32_t SlabAllocator::GetClassSize(uint32_t uClass)
+{
+    if (uClass < 4)
+    {
+        return (uClass + 1) * 16;
+    }
+
+    uint32_t uHighBit = 6 + (uClass - 4) / 4;
+    return (1u << uHighBit) + ((uClass - 4) % 4 + 1) * (1u << (uHighBit - 2));
+}
+
+uint64_t SlabAllocator::GetLargeBytes(uint32_t uSize) const
+{
+    // 预留大页只能整页映射，不足一个大页的请求仍用普通页，避免浪费
+    uint64_t uBytes = static_cast<uint64_t>(uSize) + kHeaderBytes;
+    uint64_t uGranularity = m_eHugePageMode == HugePageMode::kHugeTlb && uBytes >= kHugePageBytes ? kHugePageBytes : kPageBytes;
+    return (uBytes + uGranularity - 1) / uGranularity * uGranularity;
+}
+
+SlabAllocator::Slab *SlabAllocator::GetSlab(const void *pMem)
+{
+    return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(pMem) & ~static_cast<uintptr_t>(kSlabBytes - 1));
+}
+
+uint8_t *SlabAllocator::GetTagSlot(const Slab *pSlab, const void *pMem)
+{
+    uintptr_t uBase = reinterpret_cast<uintptr_t>(pSlab);
+    uintptr_t uIndex = (reinterpret_cast<uintptr_t>(pMem) - uBase - pSlab->uBlockOffset) / GetClassSize(pSlab->uClass);
+    return reinterpret_cast<uint8_t *>(uBase + kHeaderBytes + uIndex);
+}
+
+void *SlabAllocator::MapAligned(uint64_t uBytes, uint64_t uAlign)
+{
+    // 多映射一个对齐粒度，再把首尾多余的部分归还
+    uint64_t uMapBytes = uBytes + uAlign;
+    void *pMap = mmap(nullptr, uMapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (pMap == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    uintptr_t uStart = reinterpret_cast<uintptr_t>(pMap);
+    uintptr_t uAligned = (uStart + uAlign - 1) & ~static_cast<uintptr_t>(uAlign - 1);
+    if (uAligned > uStart)
+    {
+        munmap(pMap, uAligned - uStart);
+    }
+    uintptr_t uEnd = uStart + uMapBytes;
+    if (uEnd > uAligned + uBytes)
+    {
+        munmap(reinterpret_cast<void *>(uAligned + uBytes), uEnd - uAligned - uBytes);
+    }
+    return reinterpret_cast<void *>(uAligned);
+}
+
+void *SlabAllocator::Map(uint64_t uBytes, uint32_t &uMapFlags)
+{
+    uMapFlags = 0;
+    if (m_eHugePageMode == HugePageMode::kNone || uBytes < kHugePageBytes)
+    {
+        void *pMap = MapAligned(uBytes, kSlabBytes);
+        if (pMap != nullptr)
+        {
+            m_uMappedBytes.fetch_add(uBytes, std::memory_order_relaxed);
+        }
+        return pMap;
+    }
+
+    // 预留大页的映射天然按大页对齐；预留池耗尽或未配置时退化为透明大页
+    if (m_eHugePageMode == HugePageMode::kHugeTlb && uBytes % kHugePageBytes == 0)
+    {
+        void *pMap = mmap(nullptr, uBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pMap != MAP_FAILED)
+        {
+            uMapFlags = kMapFlagHugeTlb;
+            m_uMappedBytes.fetch_add(uBytes, std::memory_order_relaxed);
+            m_uHugeTlbBytes.fetch_add(uBytes, std::memory_order_relaxed);
+            return pMap;
+        }
+        m_uHugeTlbFallbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void *pMap = MapAligned(uBytes, kHugePageBytes);
+    if (pMap == nullptr)
+    {
+        return nullptr;
+    }
+
+    // 内核未开启透明大页时madvise失败，映射照常使用
+    if (madvise(pMap, uBytes, MADV_HUGEPAGE) == 0)
+    {
+        uMapFlags = kMapFlagAdvised;
+        m_uAdvisedBytes.fetch_add(uBytes, std::memory_order_relaxed);
+    }
+    m_uMappedBytes.fetch_add(uBytes, std::memory_order_relaxed);
+    return pMap;
+}
+
+void SlabAllocator::Unmap(void *pMap, uint64_t uBytes, uint32_t uMapFlags)
+{
+    munmap(pMap, uBytes);
+    m_uMappedBytes.fetch_sub(uBytes, std::memory_order_relaxed);
+    if ((uMapFlags & kMapFlagHugeTlb) != 0)
+    {
+        m_uHugeTlbBytes.fetch_sub(uBytes, std::memory_order_relaxed);
+    }
+    if ((uMapFlags & kMapFlagAdvised) != 0)
+    {
+        m_uAdvisedBytes.fetch_sub(uBytes, std::memory_order_relaxed);
+    }
+}
+
+bool SlabAllocator::Reserve(uint64_t uBytes)
+{
+    uint64_t uUsed = m_uUsedBytes.fetch_add(uBytes, std::memory_order_relaxed) + uBytes;
+    if (m_uMaxBytes > 0 && uUsed > m_uMaxBytes)
+    {
+        m_uUsedBytes.fetch_sub(uBytes, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void SlabAllocator::Unreserve(uint64_t uBytes)
+{
+    m_uUsedBytes.fetch_sub(uBytes, std::memory_order_relaxed);
+}
+
+void *SlabAllocator::AllocateLarge(uint32_t uSize)
+{
+    uint64_t uMapBytes = GetLargeBytes(uSize);
+    if (!Reserve(uMapBytes))
+    {
+        return nullptr;
+    }
+
+    uint32_t uMapFlags = 0;
+    void *pMap = Map(uMapBytes, uMapFlags);
+    if (pMap == nullptr)
+    {
+        Unreserve(uMapBytes);
+        return nullptr;
+    }
+
+    Slab *pSlab = new(pMap) Slab();
+    pSlab->uMagic = kMagic;
+    pSlab->uClass = kLargeClass;
+    pSlab->uMapBytes = uMapBytes;
+    pSlab->uMapFlags = uMapFlags;
+    m_uLargeBytes.fetch_add(uMapBytes, std::memory_order_relaxed);
+    return static_cast<char *>(pMap) + kHeaderBytes;
+}
+
+void *SlabAllocator::PopBlock(uint32_t uClass)
+{
+    SizeClass &sizeClass = m_arrClass[uClass];
+    Slab *pSlab = sizeClass.pPartial;
+    if (pSlab == nullptr)
+    {
+        pSlab = NewSlab(uClass);
+        if (pSlab == nullptr)
+        {
+            return nullptr;
+        }
+        LinkPartial(sizeClass, pSlab);
+    }
+
+    void *pMem = pSlab->pFreeList;
+    if (pMem != nullptr)
+    {
+        pSlab->pFreeList = *static_cast<void **>(pMem);
+    }
+    else
+    {
+        pMem = pSlab->pUncarved;
+        pSlab->pUncarved += sizeClass.uSize;
+    }
+
+    if (++pSlab->uUsed == pSlab->uCapacity)
+    {
+        UnlinkPartial(sizeClass, pSlab);
+    }
+    return pMem;
+}
+
+SlabAllocator::Slab *SlabAllocator::PushBlock(uint32_t uClass, void *pMem)
+{
+    SizeClass &sizeClass = m_arrClass[uClass];
+    Slab *pSlab = GetSlab(pMem);
+    *static_cast<void **>(pMem) = pSlab->pFreeList;
+    pSlab->pFreeList = pMem;
+    if (pSlab->uUsed-- == pSlab->uCapacity)
+    {
+        LinkPartial(sizeClass, pSlab);
+    }
+
+    // 完全空闲且该级别还有其他可分配的slab时归还，每级保留一个，避免在临界点反复申请和归还
+    if (pSlab->uUsed == 0 && (sizeClass.pPartial != pSlab || pSlab->pNext != nullptr))
+    {
+        UnlinkPartial(sizeClass, pSlab);
+        return pSlab;
+    }
+    return nullptr;
+}
+
+SlabAllocator::Slab *SlabAllocator::NewSlab(uint32_t uClass)
+{
+    char *pBase = nullptr;
+    uint32_t uMapFlags = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_regionMutex);
+        if (m_pFreeSlab != nullptr)
+        {
+            pBase = reinterpret_cast<char *>(m_pFreeSlab);
+            uMapFlags = m_pFreeSlab->uMapFlags;
+            m_pFreeSlab = m_pFreeSlab->pNext;
+        }
+        else
+        {
+            if (m_pRegionCursor == m_pRegionEnd)
+            {
+                Region region;
+                region.pBase = static_cast<char *>(Map(kRegionBytes, region.uMapFlags));
+                if (region.pBase == nullptr)
+                {
+                    return nullptr;
+                }
+
+                try
+                {
+                    m_vecRegion.push_back(region);
+                }
+                catch(const std::exception& e)
+                {
+                    Unmap(region.pBase, kRegionBytes, region.uMapFlags);
+                    return nullptr;
+                }
+                m_pRegionCursor = region.pBase;
+                m_pRegionEnd = region.pBase + kRegionBytes;
+                m_uRegionMapFlags = region.uMapFlags;
+            }
+            pBase = m_pRegionCursor;
+            uMapFlags = m_uRegionMapFlags;
+            m_pRegionCursor += kSlabBytes;
+        }
+    }
+
+    Slab *pSlab = new(pBase) Slab();
+    pSlab->uMagic = kMagic;
+    pSlab->uClass = uClass;
+    pSlab->pUncarved = pBase + m_arrClass[uClass].uBlockOffset;
+    pSlab->uCapacity = m_arrClass[uClass].uCapacity;
+    pSlab->uMapFlags = uMapFlags;
+    pSlab->uBlockOffset = static_cast<uint16_t>(m_arrClass[uClass].uBlockOffset);
+    m_arrClass[uClass].uSlabs.fetch_add(1, std::memory_order_relaxed);
+    return pSlab;
+}
+
+void SlabAllocator::ReleaseSlab(Slab *pSlab)
+{
+    // 物理页归还内核，地址空间留给之后的slab复用；透明大页会被拆分，预留大页不能按slab归还，留给之后复用
+    uint32_t uMapFlags = pSlab->uMapFlags;
+    m_arrClass[pSlab->uClass].uSlabs.fetch_sub(1, std::memory_order_relaxed);
+    if ((uMapFlags & kMapFlagHugeTlb) == 0)
+    {
+        madvise(pSlab, kSlabBytes, MADV_DONTNEED);
+    }
+
+    std::lock_guard<std::mutex> lock(m_regionMutex);
+    pSlab->uMagic = 0;
+    pSlab->uMapFlags = uMapFlags;
+    pSlab->pNext = m_pFreeSlab;
+    m_pFreeSlab = pSlab;
+}
+
+void SlabAllocator::LinkPartial(SizeClass &sizeClass, Slab *pSlab)
+{
+    pSlab->pPrev = nullptr;
+    pSlab->pNext = sizeClass.pPartial;
+    if (sizeClass.pPartial != nullptr)
+    {
+        sizeClass.pPartial->pPrev = pSlab;
+    }
+    sizeClass.pPartial = pSlab;
+}
+
+void SlabAllocator::UnlinkPartial(SizeClass &sizeClass, Slab *pSlab)
+{
+    if (pSlab->pPrev != nullptr)
+    {
+        pSlab->pPrev->pNext = pSlab->pNext;
+    }
+    else
+    {
+        sizeClass.pPartial = pSlab->pNext;
+    }
+
+    if (pSlab->pNext != nullptr)
+    {
+        pSlab->pNext->pPrev = pSlab->pPrev;
+    }
+    pSlab->pPrev = nullptr;
+    pSlab->pNext = nullptr;
+}
+
+}
+}
@@ -0,0 +1,250 @@
+#ifndef __LITE_DRIVE_SLAB_ALLOCATOR_H__
+#define __LITE_DRIVE_SLAB_ALLOCATOR_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+/**
+ * @brief 按大小分级的slab分配器
+ * @note 不超过kMaxSmallBytes的请求按大小级别从slab中分配，每个2的幂区间等分为4级，内部碎片不超过25%；
+ *       slab从大块mmap区域中切出，完全空闲后归还内核的物理页并供其他级别复用。
+ *       更大的请求直接mmap。slab和大块内存的起始地址都按kSlabBytes对齐，头部记录级别，释放时按地址对齐找到头部。
+ *       slab头部之后是每块一个字节的使用方标签，块区从其后开始；大块内存的标签记录在头部中。
+ *       已用字节数按交出的块计算，包括线程缓存中持有的块，超过上限时分配失败。
+ *       可选用大页映射区域和不小于kHugePageBytes的大块内存，减少TLB缺失
+ */
+class SlabAllocator
+{
+public:
+    enum class HugePageMode
+    {
+        kNone,        // 只使用普通页
+        kTransparent, // madvise(MADV_HUGEPAGE)，由内核透明大页按需合并
+        kHugeTlb,     // MAP_HUGETLB从预留的大页池映射，失败时退化为透明大页
+    };
+
+    struct HugePageStats
+    {
+        uint64_t uMappedBytes{0};  // 区域和大块内存映射的总字节数
+        uint64_t uHugeTlbBytes{0}; // 其中由预留大页映射的字节数
+        uint64_t uAdvisedBytes{0}; // 其中建议透明大页的字节数
+        uint64_t uFallbacks{0};    // 预留大页不足退化为透明大页的次数
+    };
+
+    static constexpr uint32_t kSlabBytes = 1u << 20;         // slab大小，也是头部的对齐粒度
+    static constexpr uint32_t kMaxSmallBytes = 64 * 1024;    // 从slab分配的最大请求
+    static constexpr uint64_t kRegionBytes = 64ull << 20;    // 每次向内核申请的区域大小，从中切分slab
+    static constexpr uint32_t kClassCount = 44;              // 16~64字节每16字节一级，之后每个2的幂区间4级，直到kMaxSmallBytes
+    static constexpr uint32_t kLargeClass = UINT32_MAX;      // 大块内存的级别
+    static constexpr uint64_t kHugePageBytes = 2ull << 20;   // 大页大小，区域按其对齐
+
+    SlabAllocator();
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    /**
+     * @brief 释放全部区域，之后未释放的内存不可再访问，大块内存仍由使用方释放
+     * @note 已用字节数只保留尚未释放的大块内存
+     */
+    void Exit();
+
+    /**
+     * @brief 设置内存上限
+     * @param uMaxBytes 上限字节数，0表示不限制
+     */
+    void SetLimit(uint64_t uMaxBytes);
+
+    /**
+     * @brief 获取已交出的字节数
+     * @return 字节数
+     */
+    uint64_t GetUsedBytes() const;
+
+    /**
+     * @brief 设置大页模式，只影响之后映射的区域和大块内存
+     * @param eMode 大页模式
+     */
+    void SetHugePageMode(HugePageMode eMode);
+
+    /**
+     * @brief 获取大页映射的统计
+     * @param stats 统计结果
+     */
+    void GetHugePageStats(HugePageStats &stats) const;
+
+    /**
+     * @brief 分配内存，线程安全
+     * @param uSize 内存大小
+     * @return 内存指针，按16字节对齐，失败返回NULL
+     */
+    void *Allocate(uint32_t uSize);
+
+    /**
+     * @brief 释放内存，线程安全
+     * @param pMem 由Allocate分配的内存指针
+     */
+    void Free(void *pMem);
+
+    /**
+     * @brief 从一个级别批量分配，一次加锁，线程安全
+     * @param uClass 大小级别
+     * @param uCount 期望的块数
+     * @param pHead 返回的块链表，块的前8字节链接下一个
+     * @return 实际分配的块数，内存不足或超过上限时可能少于期望
+     */
+    uint32_t AllocateBatch(uint32_t uClass, uint32_t uCount, void *&pHead);
+
+    /**
+     * @brief 把同一级别的块链表批量归还，一次加锁，线程安全
+     * @param uClass 大小级别
+     * @param pHead 块链表，块的前8字节链接下一个
+     * @param uCount 块数
+     */
+    void FreeBatch(uint32_t uClass, void *pHead, uint32_t uCount);
+
+    /**
+     * @brief 计算请求所在的大小级别
+     * @param uSize 请求大小，不超过kMaxSmallBytes
+     * @return 级别
+     */
+    static uint32_t GetSizeClass(uint32_t uSize);
+
+    /**
+     * @brief 获取级别的块大小
+     * @param uClass 级别
+     * @return 块大小
+     */
+    static uint32_t GetClassSize(uint32_t uClass);
+
+    /**
+     * @brief 获取已分配内存所在的级别
+     * @param pMem 由Allocate分配的内存指针
+     * @return 级别，大块内存或不是本分配器分配的内存返回kLargeClass
+     */
+    static uint32_t GetBlockClass(const void *pMem);
+
+    /**
+     * @brief 记录块的使用方标签，由分配方在交出块之前调用
+     * @param pMem 由Allocate分配的内存指针
+     * @param uTag 标签
+     * @note 每块的标签占独立的字节，不同线程同时记录不同的块互不影响
+     */
+    static void SetBlockTag(void *pMem, uint8_t uTag);
+
+    /**
+     * @brief 获取分配时记录的使用方标签
+     * @param pMem 由Allocate分配的内存指针
+     * @return 标签，不是本分配器分配的内存返回0
+     */
+    static uint8_t GetBlockTag(const void *pMem);
+
+    /**
+     * @brief 获取已分配内存实际占用的字节数
+     * @param pMem 由Allocate分配的内存指针
+     * @return 字节数，不是本分配器分配的内存返回0
+     */
+    static uint64_t GetBlockBytes(const void *pMem);
+
+    /**
+     * @brief 获取级别正在使用的slab数，包括有空闲块的slab
+     * @param uClass 级别
+     * @return slab数
+     */
+    uint32_t GetSlabCount(uint32_t uClass) const;
+
+private:
+    // slab和大块内存的头部，位于按kSlabBytes对齐的起始地址
+    struct Slab
+    {
+        uint32_t uMagic{0};
+        uint32_t uClass{0};       // 大小级别，大块内存为kLargeClass
+        uint64_t uMapBytes{0};    // 大块内存映射的字节数
+        void *pFreeList{nullptr}; // 已释放的块，块的前8字节链接下一个
+        char *pUncarved{nullptr}; // 尚未切分过的起始位置，块按需切分，未用到的页不占用物理内存
+        uint32_t uUsed{0};
+        uint32_t uCapacity{0};
+        Slab *pPrev{nullptr};     // 所在级别的可分配链表
+        Slab *pNext{nullptr};
+        uint32_t uMapFlags{0};    // 所在映射的kMapFlag标志
+        uint16_t uBlockOffset{0}; // 块区相对slab起始的偏移，头部与块区之间是各块的标签
+        uint8_t uTag{0};          // 大块内存的使用方标签
+    };
+
+    // 从内核申请的区域
+    struct Region
+    {
+        char *pBase{nullptr};
+        uint32_t uMapFlags{0};
+    };
+
+    // 一个大小级别，有空闲块的slab挂在可分配链表上，已满的slab不在链表中
+    struct SizeClass
+    {
+        std::mutex mutex;
+        uint32_t uSize{0};
+        uint32_t uCapacity{0};    // 每个slab的块数
+        uint32_t uBlockOffset{0}; // 块区相对slab起始的偏移
+        Slab *pPartial{nullptr};
+        std::atomic<uint32_t> uSlabs{0}; // 正在使用的slab数，供统计读取
+    };
+
+    static constexpr uint32_t kMagic = 0x534c4142; // "SLAB"
+    static constexpr uint32_t kHeaderBytes = 64;   // 头部占用的字节数，块从其后开始
+    static constexpr uint32_t kPageBytes = 4096;
+    static constexpr uint32_t kBlockAlignBytes = 16;   // 块区起始的对齐，标签区按其补齐
+    static constexpr uint32_t kMapFlagHugeTlb = 1u << 0; // 由预留大页映射，不能按slab归还物理页
+    static constexpr uint32_t kMapFlagAdvised = 1u << 1; // 已建议透明大页
+
+    static Slab *GetSlab(const void *pMem);
+    static uint8_t *GetTagSlot(const Slab *pSlab, const void *pMem);
+    static void *MapAligned(uint64_t uBytes, uint64_t uAlign);
+
+    uint64_t GetLargeBytes(uint32_t uSize) const;
+    void *Map(uint64_t uBytes, uint32_t &uMapFlags);
+    void Unmap(void *pMap, uint64_t uBytes, uint32_t uMapFlags);
+
+    bool Reserve(uint64_t uBytes);
+    void Unreserve(uint64_t uBytes);
+    void *AllocateLarge(uint32_t uSize);
+    void *PopBlock(uint32_t uClass);
+    Slab *PushBlock(uint32_t uClass, void *pMem);
+    Slab *NewSlab(uint32_t uClass);
+    void ReleaseSlab(Slab *pSlab);
+    static void LinkPartial(SizeClass &sizeClass, Slab *pSlab);
+    static void UnlinkPartial(SizeClass &sizeClass, Slab *pSlab);
+
+private:
+    SizeClass m_arrClass[kClassCount];
+
+    // 区域和空闲slab，申请和归还slab时加锁
+    std::mutex m_regionMutex;
+    std::vector<Region> m_vecRegion;
+    uint32_t m_uRegionMapFlags{0};  // 当前区域的映射标志
+    char *m_pRegionCursor{nullptr}; // 当前区域中尚未切出slab的起始位置
+    char *m_pRegionEnd{nullptr};
+    Slab *m_pFreeSlab{nullptr};     // 完全空闲的slab，物理页已归还内核
+
+    uint64_t m_uMaxBytes{0};                // 内存上限，0表示不限制
+    std::atomic<uint64_t> m_uUsedBytes{0};  // 已交出的字节数
+    std::atomic<uint64_t> m_uLargeBytes{0}; // 其中大块内存的字节数，Exit后仍由使用方释放
+
+    HugePageMode m_eHugePageMode{HugePageMode::kNone};
+    std::atomic<uint64_t> m_uMappedBytes{0};
+    std::atomic<uint64_t> m_uHugeTlbBytes{0};
+    std::atomic<uint64_t> m_uAdvisedBytes{0};
+    std::atomic<uint64_t> m_uHugeTlbFallbacks{0};
+};
+
+}
+}
+#endif // __LITE_DRIVE_SLAB_ALLOCATOR_H__
@@ -0,0 +1,195 @@
+#include "thread_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+namespace
+{
+
+// 所有仍有效的缓存，分配器退出和线程退出时加锁，分配和释放的快路径不涉及
+std::mutex g_registryMutex;
+std::vector<ThreadCache *> g_vecRegistry;
+std::atomic<uint64_t> g_uNextOwner{1};
+
+}
+
+struct ThreadCache::ThreadSet
+{
+    std::vector<ThreadCache *> vecCache;
+
+    ~ThreadSet()
+    {
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        for (ThreadCache *pCache : vecCache)
+        {
+            if (!pCache->m_bOrphaned)
+            {
+                pCache->Flush();
+                pCache->m_pStats->Retire(pCache->m_counters);
+                g_vecRegistry.erase(std::remove(g_vecRegistry.begin(), g_vecRegistry.end(), pCache), g_vecRegistry.end());
+            }
+            delete pCache;
+        }
+        vecCache.clear();
+        s_pCurrent = nullptr;
+    }
+};
+
+thread_local ThreadCache *ThreadCache::s_pCurrent = nullptr;
+thread_local ThreadCache::ThreadSet ThreadCache::s_threadSet;
+
+ThreadCache::ThreadCache(SlabAllocator *pAllocator, MemoryStats *pStats, uint64_t uOwner)
+    : m_pAllocator(pAllocator)
+    , m_pStats(pStats)
+    , m_uOwner(uOwner)
+{
+    for (uint32_t i = 0; i < SlabAllocator::kClassCount; i++)
+    {
+        uint32_t uBatch = kBatchBytes / SlabAllocator::GetClassSize(i);
+        m_arrList[i].uBatch = uBatch == 0 ? 1 : (uBatch > kMaxBatch ? kMaxBatch : uBatch);
+        m_arrList[i].uMaxCount = m_arrList[i].uBatch * 2;
+    }
+}
+
+uint64_t ThreadCache::NewOwner()
+{
+    return g_uNextOwner.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadCache::Detach(uint64_t uOwner)
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    auto it = std::remove_if(g_vecRegistry.begin(), g_vecRegistry.end(), [uOwner](ThreadCache *pCache) {
+        if (pCache->m_uOwner != uOwner)
+        {
+            return false;
+        }
+        pCache->m_bOrphaned = true;
+        return true;
+    });
+    g_vecRegistry.erase(it, g_vecRegistry.end());
+}
+
+void ThreadCache::Accumulate(uint64_t uOwner, AllocTotals &totals)
+{
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (const ThreadCache *pCache : g_vecRegistry)
+    {
+        if (pCache->m_uOwner == uOwner)
+        {
+            totals.Add(pCache->m_counters);
+        }
+    }
+}
+
+ThreadCache *ThreadCache::Attach(SlabAllocator *pAllocator, MemoryStats *pStats, uint64_t uOwner)
+{
+    if (uOwner == 0)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    ThreadCache *pFound = nullptr;
+    auto &vecCache = s_threadSet.vecCache;
+    for (auto it = vecCache.begin(); it != vecCache.end();)
+    {
+        ThreadCache *pCache = *it;
+        if (pCache->m_bOrphaned)
+        {
+            // 分配器已退出，顺带清理
+            if (s_pCurrent == pCache)
+            {
+                s_pCurrent = nullptr;
+            }
+            delete pCache;
+            it = vecCache.erase(it);
+            continue;
+        }
+        if (pCache->m_uOwner == uOwner)
+        {
+            pFound = pCache;
+        }
+        ++it;
+    }
+
+    if (pFound == nullptr)
+    {
+        pFound = new(std::nothrow) ThreadCache(pAllocator, pStats, uOwner);
+        if (pFound == nullptr)
+        {
+            return nullptr;
+        }
+
+        try
+        {
+            vecCache.push_back(pFound);
+            g_vecRegistry.push_back(pFound);
+        }
+        catch(const std::exception& e)
+        {
+            vecCache.erase(std::remove(vecCache.begin(), vecCache.end(), pFound), vecCache.end());
+            delete pFound;
+            return nullptr;
+        }
+    }
+
+    s_pCurrent = pFound;
+    return pFound;
+}
+
+void *ThreadCache::Refill(uint32_t uClass)
+{
+    FreeList &freeList = m_arrList[uClass];
+    void *pHead = nullptr;
+    uint32_t uCount = m_pAllocator->AllocateBatch(uClass, freeList.uBatch, pHead);
+    if (uCount == 0)
+    {
+        return nullptr;
+    }
+
+    freeList.pHead = *static_cast<void **>(pHead);
+    freeList.uCount = uCount - 1;
+    return pHead;
+}
+
+void ThreadCache::Shrink(uint32_t uClass)
+{
+    // 链表头部是最近释放的块，留在缓存里，把后面的一批还给分配器
+    FreeList &freeList = m_arrList[uClass];
+    uint32_t uKeep = freeList.uCount - freeList.uBatch;
+    void *pLast = freeList.pHead;
+    for (uint32_t i = 1; i < uKeep; i++)
+    {
+        pLast = *static_cast<void **>(pLast);
+    }
+
+    void *pRelease = *static_cast<void **>(pLast);
+    *static_cast<void **>(pLast) = nullptr;
+    freeList.uCount = uKeep;
+    m_pAllocator->FreeBatch(uClass, pRelease, freeList.uBatch);
+}
+
+void ThreadCache::Flush()
+{
+    for (uint32_t i = 0; i < SlabAllocator::kClassCount; i++)
+    {
+        FreeList &freeList = m_arrList[i];
+        if (freeList.uCount > 0)
+        {
+            m_pAllocator->FreeBatch(i, freeList.pHead, freeList.uCount);
+        }
+        freeList.pHead = nullptr;
+        freeList.uCount = 0;
+    }
+}
+
+}
+}
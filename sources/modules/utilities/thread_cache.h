@@ -0,0 +1,138 @@
+#ifndef __LITE_DRIVE_THREAD_CACHE_H__
+#define __LITE_DRIVE_THREAD_CACHE_H__
+
+#include "slab_allocator.h"
+#include "memory_stats.h"
+
+namespace lite_drive
+{
+namespace utilities
+{
+
+/**
+ * @brief 线程私有的空闲块缓存，位于SlabAllocator之前
+ * @note 每个级别一条单链表，分配和释放只操作本线程的链表，不加锁也没有原子操作；
+ *       链表为空时从分配器批量取一批，超过上限时批量还一批，一次加锁摊到整批上。
+ *       在其他线程释放的块直接进入释放线程的缓存，多出的部分整批还给分配器，再由分配线程整批取回，
+ *       IO线程分配、工作线程释放的消息不会在某一侧堆积。
+ *       缓存按分配器的实例标识区分，分配器退出时其缓存全部作废，线程退出时把缓存中的块还给仍在运行的分配器。
+ *       同时持有本线程的分配计数，线程退出时合入MemoryStats
+ */
+class ThreadCache
+{
+public:
+    /**
+     * @brief 获取当前线程在分配器上的缓存，首次使用时创建
+     * @param pAllocator 分配器
+     * @param pStats 分配统计，线程退出时合入本线程的计数
+     * @param uOwner 分配器的实例标识，由NewOwner生成，0表示分配器未初始化
+     * @return 缓存指针，未初始化或创建失败返回NULL，调用方退化为直接使用分配器
+     */
+    static ThreadCache *Get(SlabAllocator *pAllocator, MemoryStats *pStats, uint64_t uOwner)
+    {
+        ThreadCache *pCache = s_pCurrent;
+        if (pCache != nullptr && pCache->m_uOwner == uOwner)
+        {
+            return pCache;
+        }
+        return Attach(pAllocator, pStats, uOwner);
+    }
+
+    /**
+     * @brief 生成分配器的实例标识，进程内不重复
+     * @return 实例标识
+     */
+    static uint64_t NewOwner();
+
+    /**
+     * @brief 作废分配器在所有线程上的缓存，分配器退出前调用，缓存中的块随分配器一起释放
+     * @param uOwner 分配器的实例标识
+     */
+    static void Detach(uint64_t uOwner);
+
+    /**
+     * @brief 汇总分配器在所有线程上的分配计数，不含已退出的线程
+     * @param uOwner 分配器的实例标识
+     * @param totals 汇总结果
+     */
+    static void Accumulate(uint64_t uOwner, AllocTotals &totals);
+
+    /**
+     * @brief 获取本线程的分配计数
+     * @return 计数
+     */
+    AllocCounters &GetCounters() { return m_counters; }
+
+    /**
+     * @brief 从缓存分配一个块
+     * @param uClass 大小级别
+     * @return 内存指针，失败返回NULL
+     */
+    void *Allocate(uint32_t uClass)
+    {
+        FreeList &freeList = m_arrList[uClass];
+        void *pMem = freeList.pHead;
+        if (pMem == nullptr)
+        {
+            return Refill(uClass);
+        }
+        freeList.pHead = *static_cast<void **>(pMem);
+        freeList.uCount--;
+        return pMem;
+    }
+
+    /**
+     * @brief 把块放回缓存
+     * @param uClass 大小级别
+     * @param pMem 内存指针
+     */
+    void Free(uint32_t uClass, void *pMem)
+    {
+        FreeList &freeList = m_arrList[uClass];
+        *static_cast<void **>(pMem) = freeList.pHead;
+        freeList.pHead = pMem;
+        if (++freeList.uCount > freeList.uMaxCount)
+        {
+            Shrink(uClass);
+        }
+    }
+
+private:
+    struct FreeList
+    {
+        void *pHead{nullptr};
+        uint32_t uCount{0};
+        uint32_t uBatch{0};    // 每次和分配器交换的块数
+        uint32_t uMaxCount{0}; // 缓存的块数上限
+    };
+
+    static constexpr uint32_t kBatchBytes = 32 * 1024; // 每批的目标字节数，按级别大小折算成块数
+    static constexpr uint32_t kMaxBatch = 32;
+
+    ThreadCache(SlabAllocator *pAllocator, MemoryStats *pStats, uint64_t uOwner);
+    ~ThreadCache() = default;
+
+    // 线程持有的全部缓存，线程退出时归还
+    struct ThreadSet;
+
+    static ThreadCache *Attach(SlabAllocator *pAllocator, MemoryStats *pStats, uint64_t uOwner);
+
+    void *Refill(uint32_t uClass);
+    void Shrink(uint32_t uClass);
+    void Flush();
+
+private:
+    static thread_local ThreadCache *s_pCurrent; // 当前线程最近使用的缓存
+    static thread_local ThreadSet s_threadSet;
+
+    SlabAllocator *m_pAllocator{nullptr};
+    MemoryStats *m_pStats{nullptr};
+    uint64_t m_uOwner{0};
+    bool m_bOrphaned{false}; // 分配器已退出，持有的块随区域一起释放，不再归还
+    FreeList m_arrList[SlabAllocator::kClassCount];
+    AllocCounters m_counters;
+};
+
+}
+}
+#endif // __LITE_DRIVE_THREAD_CACHE_H__